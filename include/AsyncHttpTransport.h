@@ -0,0 +1,211 @@
+#ifndef ASYNC_HTTP_TRANSPORT_H
+#define ASYNC_HTTP_TRANSPORT_H
+
+#include <Arduino.h>
+
+#include <vector>
+
+#include "HttpTransport.h"
+
+#ifndef CP_HTTP_MAX_CLIENTS
+  #define CP_HTTP_MAX_CLIENTS 8  // Concurrent connections, keep below the lwIP socket limit
+#endif
+#ifndef CP_HTTP_HEADER_MAX
+  #define CP_HTTP_HEADER_MAX 2048  // Request line plus headers
+#endif
+#ifndef CP_HTTP_BODY_MAX
+  #define CP_HTTP_BODY_MAX 16384  // Largest request body or form field kept in memory, setBodyLimit() per uri (file uploads are streamed)
+#endif
+#ifndef CP_HTTP_OUTPUT_LIMIT
+  #define CP_HTTP_OUTPUT_LIMIT 4096  // Queued response bytes per connection before a handler has to wait
+#endif
+#ifndef CP_HTTP_TIMEOUT
+  #define CP_HTTP_TIMEOUT 10000UL  // Drop a connection after this many ms without progress
+#endif
+#ifndef CP_HTTP_KEEPALIVE_TIMEOUT
+  #define CP_HTTP_KEEPALIVE_TIMEOUT 5000UL  // Close an idle persistent connection after this many ms
+#endif
+#ifndef CP_HTTP_KEEPALIVE_REQUESTS
+  #define CP_HTTP_KEEPALIVE_REQUESTS 32  // Requests per connection, 0 disables keep-alive
+#endif
+
+/**
+ * @class AsyncHttpTransport
+ * @brief Event driven HTTP/1.1 server on non-blocking BSD sockets (lwIP or POSIX).
+ *
+ * Every handleClient() call polls all connections once with select(), reads what is
+ * available, and runs the handler of each request that is complete. Request bodies
+ * are collected per connection and multipart uploads are parsed as the data
+ * arrives, so a slow upload or download no longer holds up the other clients.
+ *
+ * Handlers run one at a time and use the same API as with the Arduino WebServer.
+ * Response data is written straight to the socket. What the socket cannot take yet
+ * is queued (up to CP_HTTP_OUTPUT_LIMIT bytes per connection) and sent by later
+ * handleClient() calls. A handler that writes more than that to a slow client
+ * waits for it, while the queued output of the other connections keeps flowing.
+ * Only one multipart upload with an upload handler can run at a time; a second
+ * one gets 503.
+ *
+ * Connections are kept open between requests (HTTP/1.1 keep-alive) up to an idle
+ * timeout and a number of requests. Every response is framed with Content-Length
+ * or chunked encoding; a body that does not match its Content-Length closes the
+ * connection. When all sockets are in use, the longest idle persistent connection
+ * (or else an unused one) is closed to make room for a new client, and responses
+ * are sent with "Connection: close" until there is room again. If every socket
+ * serves a request, new clients wait in the listen backlog.
+ */
+class AsyncHttpTransport : public HttpTransport {
+ public:
+  explicit AsyncHttpTransport(uint16_t port = 80, size_t maxClients = CP_HTTP_MAX_CLIENTS);
+  ~AsyncHttpTransport();
+
+  void begin() override;
+  void stop() override;
+  void handleClient() override;
+
+  void on(const String& uri, HTTPMethod method, Handler handler, Handler uploadHandler = nullptr) override;
+  using HttpTransport::on;
+  void onNotFound(Handler handler) override;
+  void setBodyLimit(const String& uri, size_t maxBytes) override;
+  void intercept(Interceptor* interceptor) override { this->interceptor = interceptor; }
+  void collectHeaders(const char* headerKeys[], size_t headerKeysCount) override;
+
+  String uri() override;
+  HTTPMethod method() override;
+  HTTPUpload& upload() override;
+  bool hasArg(const String& name) override;
+  String arg(const String& name) override;
+  bool hasHeader(const String& name) override;
+  String header(const String& name) override;
+
+  void setContentLength(size_t length) override;
+  void sendHeader(const String& name, const String& value, bool first = false) override;
+  void send(int code, const char* contentType, const String& content) override;
+  using HttpTransport::send;
+  void sendContent(const char* data, size_t len) override;
+  using HttpTransport::sendContent;
+
+  /**
+   * @brief Sets the keep-alive limits.
+   *
+   * @param idleTimeoutMs Close a persistent connection after this many ms without a request
+   * @param maxRequestsPerConnection Requests per connection, 0 disables keep-alive
+   */
+  void setKeepAlive(uint32_t idleTimeoutMs, uint16_t maxRequestsPerConnection);
+
+  size_t clientCount() const { return connections.size(); }  ///< Open connections
+  uint32_t requestCount() const { return requests; }          ///< Requests handled since begin()
+
+ private:
+  struct Route {
+    String uri;
+    HTTPMethod method;
+    Handler handler;
+    Handler uploadHandler;
+  };
+
+  struct Arg {
+    String name;
+    String value;
+  };
+
+  struct BodyLimit {
+    String uri;
+    size_t maxBytes;
+  };
+
+  enum class State : uint8_t {
+    Head,       // Reading the request line and headers
+    Body,       // Reading a request body into memory
+    Multipart,  // Streaming a multipart/form-data body
+    Drain       // Response complete, sending queued output
+  };
+
+  enum class PartState : uint8_t {
+    Preamble,   // Before the first delimiter
+    Headers,    // Part headers
+    Data,       // Part content
+    Delimiter,  // After a delimiter: "\r\n" (next part) or "--" (end)
+    End         // After the closing delimiter
+  };
+
+  struct Connection {
+    int fd = -1;
+    State state = State::Head;
+    unsigned long lastActivity = 0;
+    bool broken = false;       // Socket error or peer gone, close it
+    std::vector<uint8_t> in;   // Received, not yet parsed
+    std::vector<uint8_t> out;  // Response bytes the socket did not take yet
+
+    // Request
+    HTTPMethod method = HTTP_GET;
+    String uri;
+    std::vector<Arg> args;
+    std::vector<Arg> headers;  // Only the collected ones
+    String contentType;
+    size_t contentLength = 0;
+    size_t bodyReceived = 0;
+    int route = -1;
+    size_t bodyMax = CP_HTTP_BODY_MAX;  // Body or form field limit for this uri
+    bool keepAlive = false;  // Client accepts a persistent connection
+    uint16_t served = 0;     // Requests handled on this connection
+
+    // Multipart
+    String delimiter;  // "\r\n--" + boundary
+    PartState part = PartState::Preamble;
+    std::vector<uint8_t> partBuf;  // Body bytes not yet parsed
+    bool filePart = false;
+    String fieldName;
+    String fieldValue;
+    HTTPUpload* upload = nullptr;
+
+    // Response
+    String responseHeaders;
+    size_t responseLength = CONTENT_LENGTH_NOT_SET;
+    bool headersSent = false;
+    size_t bodySent = 0;  // Body bytes queued, checked against responseLength
+    bool chunked = false;
+    bool finished = false;  // Terminating chunk sent
+  };
+
+  uint16_t port;
+  size_t maxClients;
+  int listenFd = -1;
+  std::vector<Route> routes;
+  std::vector<BodyLimit> bodyLimits;
+  Handler notFoundHandler;
+  Interceptor* interceptor = nullptr;
+  std::vector<String> headerKeys;
+  std::vector<Connection*> connections;
+  Connection* current = nullptr;      // Connection whose handler is running
+  Connection* uploadOwner = nullptr;  // Connection with the active file upload
+  uint32_t requests = 0;
+  uint32_t idleTimeout = CP_HTTP_KEEPALIVE_TIMEOUT;
+  uint16_t maxRequests = CP_HTTP_KEEPALIVE_REQUESTS;
+  uint8_t readBuf[1460];
+
+  void acceptClients();
+  bool readClient(Connection& c);
+  void process(Connection& c, const uint8_t* data, size_t len);
+  bool parseHead(Connection& c, size_t headLen);
+  void parseArgs(Connection& c, const String& query);
+  void feedMultipart(Connection& c, const uint8_t* data, size_t len);
+  bool startPart(Connection& c, const String& partHeaders);
+  void partData(Connection& c, const uint8_t* data, size_t len);
+  void endPart(Connection& c);
+  void callUpload(Connection& c, HTTPUploadStatus status);
+  void dispatch(Connection& c);
+  void resetRequest(Connection& c);
+  void sendError(Connection& c, int code, const char* message);
+  void queue(Connection& c, const char* data, size_t len);
+  bool waitForRoom(Connection& c);
+  bool flushClient(Connection& c);
+  void closeClient(size_t index);
+  bool isIdle(const Connection& c) const;
+  int evictable() const;
+  int findRoute(const String& uri, HTTPMethod method) const;
+  size_t bodyLimit(const String& uri) const;
+  bool isCollected(const String& name) const;
+};
+
+#endif  // ASYNC_HTTP_TRANSPORT_H
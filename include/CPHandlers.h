@@ -2,7 +2,8 @@
 #define CP_HANDLERS_H
 
 #include <Arduino.h>
-#include <WebServer.h>
+
+#include "HttpTransport.h"
 
 class CaptivePortal;  // Forward declaration
 
@@ -13,7 +14,7 @@ struct CPContentType {
 
 class CPHandlers {
  public:
-  CPHandlers(WebServer* webServer, CaptivePortal* portal);
+  CPHandlers(HttpTransport* webServer, CaptivePortal* portal);
 
   /**
    * @brief Sends a styled HTML message to the client with a title and message.
@@ -53,10 +54,9 @@ class CPHandlers {
   void noCache();  // Sends no-chache headers to a client
 
  private:
-  WebServer* s_webServer;
+  HttpTransport* s_webServer;
   CaptivePortal* s_portal;
   CPContentType contentType;
-  String jsonEscape(const String& in);
 };
 
 #endif  // CP_HANDLERS_H
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef CAPTIVE_DNS_H
+#define CAPTIVE_DNS_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#include <atomic>
+
+#ifndef CP_DNS_BUDGET
+  #define CP_DNS_BUDGET 16  // Maximum queries answered per process() call
+#endif
+#ifndef CP_DNS_TTL
+  #define CP_DNS_TTL 10  // TTL (seconds) of captive answers, short so clients re-resolve after leaving the portal
+#endif
+
+#define CP_DNS_PACKET_SIZE 512  // Largest query accepted (classic DNS over UDP)
+#define CP_DNS_ANSWER_SIZE 16   // Compressed name pointer, type, class, TTL, length and IPv4 address
+
+/**
+ * @struct CaptiveDnsStats
+ * @brief Counters of a CaptiveDns responder.
+ */
+struct CaptiveDnsStats {
+  uint32_t queries = 0;     ///< Queries received
+  uint32_t answersA = 0;    ///< A (and ANY) queries answered with the portal address
+  uint32_t emptyAAAA = 0;   ///< AAAA queries answered without records
+  uint32_t emptyHttps = 0;  ///< HTTPS/SVCB queries answered without records
+  uint32_t emptyOther = 0;  ///< Other query types answered without records
+  uint32_t dropped = 0;     ///< Malformed queries, responses and send failures
+  uint32_t batches = 0;     ///< process() calls that found work
+};
+
+/**
+ * @class CaptiveDns
+ * @brief Minimal DNS responder that points every name to the portal.
+ *
+ * process() drains all pending queries from the UDP socket (up to a budget) and
+ * builds each response in place in one preallocated buffer: the question is kept,
+ * additional records (EDNS) are dropped and a single answer is appended. A queries
+ * get the portal address with a short TTL. AAAA, HTTPS and all other types get an
+ * immediate empty NOERROR answer, so clients do not wait for a timeout before
+ * falling back to IPv4.
+ *
+ * Uses plain BSD sockets (lwIP on the ESP32), so it also runs on a Linux host.
+ */
+class CaptiveDns {
+ public:
+  ~CaptiveDns();
+
+  /**
+   * @brief Opens the UDP socket.
+   *
+   * @param port UDP port, normally 53
+   * @param ip Address returned for every A query
+   * @return true if the socket is bound
+   */
+  bool start(uint16_t port, const IPAddress& ip);
+
+  void stop();  ///< Closes the socket
+
+  /**
+   * @brief Answers the pending queries.
+   *
+   * @param budget Maximum number of queries to handle in this call
+   * @return Number of queries handled
+   */
+  size_t process(size_t budget = CP_DNS_BUDGET);
+
+  void setAddress(const IPAddress& ip);             ///< Address returned from now on (the socket stays open). Safe while process() runs on another task
+  void setTtl(uint32_t seconds) { ttl = seconds; }  ///< TTL of captive answers
+  const CaptiveDnsStats& stats() const { return counters; }  ///< Counters since start()
+
+ private:
+  int fd = -1;
+  std::atomic<uint32_t> address{0};  // IPv4 address bytes in packet order, written by setAddress() from any task
+  std::atomic<uint32_t> ttl{CP_DNS_TTL};
+  CaptiveDnsStats counters;
+  uint8_t packet[CP_DNS_PACKET_SIZE + CP_DNS_ANSWER_SIZE];
+
+  size_t buildResponse(size_t len);
+};
+
+#endif  // CAPTIVE_DNS_H
@@ -2,14 +2,33 @@
 #define CAPTIVE_PORTAL_H
 
 #include <Arduino.h>
-#include <DNSServer.h>
-#include <WebServer.h>
-
-#include <map>
 
+#include "AsyncHttpTransport.h"
 #include "CPHandlers.h"
+#include "CaptiveDns.h"
+#include "CaptiveProbes.h"
 #include "Config.h"
+#include "ConfigKey.h"
+#include "ETagCache.h"
+#include "FileCache.h"
+#include "HttpTransport.h"
 #include "PageRenderer.h"
+#include "PageTemplate.h"
+#include "PortalTask.h"
+#include "SessionStore.h"
+#include "SessionTokens.h"
+#include "SettingsApplier.h"
+#include "TemplateVars.h"
+#include "WebServerTransport.h"
+
+#define CAPTIVE_PORTAL_VERSION "1.0.0"
+
+#ifndef CP_FIRMWARE_VERSION
+  #define CP_FIRMWARE_VERSION CAPTIVE_PORTAL_VERSION  // Shown as {{version}}, define in build_flags to override
+#endif
+#ifndef CP_EDIT_BODY_MAX
+  #define CP_EDIT_BODY_MAX 65536  // Largest urlencoded /editfile save, file content grows up to 3x when encoded
+#endif
 
 /**
  * @class CaptivePortal
@@ -21,6 +40,12 @@
  */
 class CaptivePortal {
  public:
+  /// How login sessions are kept
+  enum class SessionMode {
+    Stored,  ///< Random session IDs in a RAM table (default). Lost on reboot
+    Signed   ///< HMAC signed tokens, no server side state. Survive reboots
+  };
+
   /**
    * @brief CaptivePortal set Device configuration and the web file system
    *
@@ -68,7 +93,8 @@ class CaptivePortal {
    * Stops DNS and HTTP servers and disconnects the WiFi SoftAP.
    * Registered handlers and configuration remain intact.
    *
-   * @return true if the portal was stopped or already stopped.
+   * @return true if the portal was stopped or already stopped. false if a service
+   *         task did not stop in time; the servers are then left alone, call stop() again.
    */
   virtual bool stop();  ///< Stops the captive portal
 
@@ -80,6 +106,68 @@ class CaptivePortal {
    */
   virtual bool isRunning() const { return running; };  ///< true if the portal is running
 
+  /**
+   * @brief Runs DNS and HTTP in their own tasks instead of in handle(). Call before begin().
+   *
+   * HTTP handlers then lock getMutex() only while they read or change sessions and
+   * Settings, not while they wait for a client. handle() only watches the reset
+   * pin and expires sessions, so loop() work no longer delays DNS or HTTP.
+   *
+   * @param enabled true for threaded mode
+   * @param dnsTask Stack, priority and core of the DNS task
+   * @param httpTask Stack, priority and core of the HTTP task
+   */
+  void setThreaded(bool enabled, const PortalTaskConfig& dnsTask = PortalTaskConfig(3072, 2, 0),
+                   const PortalTaskConfig& httpTask = PortalTaskConfig(8192, 1, 1));
+
+  /**
+   * @brief Applies changed settings at runtime (default on).
+   *
+   * When Settings change (web UI, /editfile, save()), handle() applies them without
+   * a reboot: a new timezone is set with tzset(), LED and reset pins are set up
+   * again, and the SoftAP is reconfigured only when its SSID, password, IP or mask
+   * changed. When disabled, changes take effect after a reboot.
+   *
+   * The SoftAP restart waits CP_AP_RESTART_DELAY ms so the response to the change
+   * reaches the client, and is skipped when WiFi is not in an AP mode.
+   */
+  void setHotApply(bool enabled);
+
+  /**
+   * @brief true if the last SoftAP reconfiguration failed after CP_AP_RESTART_TRIES tries (a reboot applies it)
+   */
+  bool hotApplyFailed();
+
+  /**
+   * @brief returns the OS connectivity probe table (portal URL, hit counters)
+   */
+  const CaptiveProbes& getProbes();
+
+  /**
+   * @brief returns the DNS responder counters (queries, per type, drops)
+   */
+  const CaptiveDnsStats& getDnsStats();
+
+  /**
+   * @brief Replaces the HTTP server backend. Call before begin().
+   *
+   * The default is WebServerTransport (the Arduino WebServer). For keep-alive and
+   * many concurrent clients use: portal->setTransport(new AsyncHttpTransport(80));
+   *
+   * @param transport Backend, owned by the portal from now on
+   * @return false if the portal is already running (the caller keeps ownership)
+   */
+  bool setTransport(HttpTransport* transport);
+
+  /**
+   * @brief Mutex that guards sessions and Settings in threaded mode.
+   *
+   * Lock it (e.g. with PortalLock) in loop() before reading or changing Settings.
+   * Custom handlers in threaded mode lock it around their use of Settings too; keep
+   * sends outside the lock, a slow client would hold up loop().
+   */
+  PortalMutex& getMutex();
+
   /**
    * @brief Main loop handler.
    *
@@ -105,25 +193,97 @@ class CaptivePortal {
   bool isSessionValid(const String& sid);
 
   /**
-   * @brief Removes a session ID from the valid sessions map.
+   * @brief Removes a session ID from the session table.
    *
    * @param sid The session ID to remove
    */
   void removeSession(const String& sid);
 
+  /**
+   * @brief Invalidates all sessions (e.g. after a password change).
+   */
+  void revokeAllSessions();
+
+  /**
+   * @brief Resets the settings to factory defaults and restarts the ESP.
+   *
+   * Also deletes the session key, so tokens issued before the reset are no longer
+   * accepted. Use this instead of Settings.resetToFactoryDefault().
+   */
+  void factoryReset();
+
+  /**
+   * @brief Selects how sessions are kept. Call before begin().
+   *
+   * In SessionMode::Signed the token key is kept in "/session.key" on the settings
+   * file system. Logging out revokes all signed tokens, since there is no table to
+   * remove a single token from.
+   */
+  void setSessionMode(SessionMode mode);
+
   /**
    * @brief returns webFileSystem/settingsFileSystem
    */
   fs::LittleFSFS& getWebFileSystem();
   fs::LittleFSFS& getSettingsFileSystem();
 
+  /**
+   * @brief returns the "/tabmenu.html" template compiled during begin()
+   */
+  const PageTemplate& getMenuTemplate();
+
+  /**
+   * @brief Registers (or replaces) a {{name}} variable that is expanded in page bodies.
+   *
+   * Built-in variables: deviceName, hostname, ip, version, freeHeap, minFreeHeap, uptime.
+   *
+   * @param name Variable name (letters, digits, '_' and '.')
+   * @param provider Prints the current value
+   * @param escape true to HTML escape the value
+   */
+  void setTemplateVar(const String& name, TemplateVars::Provider provider, bool escape = true);
+
+  /**
+   * @brief returns the registered page variables
+   */
+  const TemplateVars& getTemplateVars();
+
+  /**
+   * @brief returns the ETag cache of the web file system
+   */
+  ETagCache& getETagCache();
+
+  /**
+   * @brief returns the file cache used for pages and assets (hit/miss counters, budget)
+   */
+  FileCache& getFileCache();
+
+  /**
+   * @brief Drops cached data (contents, ETag, templates) of a web file after it was written.
+   *
+   * The portal caches files of the web file system only. Code that writes, uploads
+   * or removes files there has to call this; the portal does not notice such writes.
+   * In threaded mode the caches belong to the HTTP task, so call it from a handler.
+   *
+   * @param path Path of the file on the web file system that changed
+   */
+  void invalidateAsset(const String& path);
+
+  /**
+   * @brief Same as invalidateAsset(path) for a file written to fileSystem.
+   *
+   * Does nothing unless fileSystem is the web file system (e.g. both are LittleFS),
+   * so a file on the settings file system never evicts a web file with the same path.
+   */
+  void invalidateAsset(fs::LittleFSFS& fileSystem, const String& path);
+
   /**
    * @brief true if the marker file exists (indicating a factory reset has occurred), false otherwise.
    */
   bool checkFactoryResetMarker();  // true if the marker file exists (indicating a factory reset has occurred), false otherwise.
 
  protected:
-  WebServer* webServer = new WebServer(80);
+  HttpTransport* webServer = new WebServerTransport(80);
   CPHandlers* cpHandlers = nullptr;
 
   /**
@@ -145,12 +305,31 @@ class CaptivePortal {
   virtual void onHttpRequest() {}
 
  private:
+  friend class PortalApplyTarget;
+
   bool running = false;  // true if begin() has been called and the portal is running
 
-  DNSServer* dnsServer = new DNSServer();
+  CaptiveDns* dnsServer = new CaptiveDns();  // Answers every A query with the portal address
+  CaptiveProbes probes;                       // Prepared answers to OS connectivity checks
+
+  unsigned long sessionTimeout = 3600;                                        // 1 hour
+  SessionStore sessions{CP_MAX_SESSIONS, (uint32_t)(sessionTimeout * 1000UL)};  // Login sessions
+  unsigned long lastSessionSweep = 0;                                         // millis() of the last expiry sweep
+  SessionMode sessionMode = SessionMode::Stored;
+  SessionTokens sessionTokens;  // Used in SessionMode::Signed
 
-  std::map<String, unsigned long> validSessions;  // sessionId -> expiry timestamp
-  unsigned long sessionTimeout = 3600;            // 1 hour
+  bool threaded = false;  // true if DNS and HTTP run in their own tasks
+  PortalTaskConfig dnsTaskConfig;
+  PortalTaskConfig httpTaskConfig;
+  PortalTask dnsTask;
+  PortalTask httpTask;
+  PortalMutex portalMutex;  // Held while HTTP handlers run in threaded mode
+
+  SettingsApplier applier;  // Applies changed settings without a reboot
+  bool hotApply = true;
+
+  PageTemplate menuTemplate;  // Parsed "/tabmenu.html", shared by all menu pages
+  TemplateVars templateVars;  // {{name}} variables for page bodies
 
   fs::LittleFSFS& webFileSystem;  // File system for html, css, etc. Does not format on Factory Reset
   bool fmtOnFail;
@@ -158,12 +337,27 @@ class CaptivePortal {
   uint8_t maxOpenFs;
   const char* partLbl;
 
+  ETagCache assetETags;  // Content hashes of the web file system
+  FileCache fileCache;   // Recently used file contents
+
+  /**
+   * @brief Stops the DNS and HTTP tasks.
+   *
+   * @return false if a task is still running (e.g. a handler stuck on a slow client)
+   */
+  bool stopTasks();
+
   /**
    * @brief Initializes the WiFi access point.
    *
    * @return true on success
    */
   bool setupWiFi();
+
+  /**
+   * @brief Registers the built-in page variables.
+   */
+  void setupTemplateVars();
 };
 
 #endif  // CAPTIVE_PORTAL_H
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef CAPTIVE_PROBES_H
+#define CAPTIVE_PROBES_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#include <vector>
+
+#include "HttpTransport.h"
+
+/**
+ * @class CaptiveProbes
+ * @brief Fixed table of the connectivity checks of Android, Apple, Windows, Firefox and ChromeOS.
+ *
+ * The probes make up most of the requests a portal sees. Their responses (status,
+ * Location header, body) are rendered once by build() when the AP address is
+ * known. The probes are checked by path hash before the route table, so a probe
+ * costs a hash and a send of prepared strings. Each probe counts its hits.
+ */
+class CaptiveProbes : public HttpTransport::Interceptor {
+ public:
+  /// How a probe is answered
+  enum class Reply : uint8_t {
+    NoContent,  ///< 204, the client considers the network online
+    Redirect    ///< 302 to the portal, the client opens its captive portal login
+  };
+
+  struct Probe {
+    const char* path;  ///< Request path
+    const char* os;    ///< Client that sends it
+    Reply reply;
+  };
+
+  CaptiveProbes();
+
+  /**
+   * @brief Renders the responses for the portal at ip. Call again when the AP address changes.
+   */
+  void build(const IPAddress& ip);
+
+  /**
+   * @brief Answers the probes on server before its routes are searched.
+   *
+   * @param server Transport to install on
+   * @param onHit Called before each probe response (e.g. request tracking), may be nullptr
+   */
+  void install(HttpTransport* server, HttpTransport::Handler onHit = nullptr);
+
+  /**
+   * @brief Index of the probe for uri, or -1.
+   */
+  int find(const String& uri) const;
+
+  bool matches(const String& uri) const override { return find(uri) != -1; }
+  void respond(HttpTransport* server, const String& uri) override;
+
+  /**
+   * @brief Sends the prepared response of probe index.
+   */
+  void respond(HttpTransport* server, size_t index);
+
+  const char* portalUrl() const { return url; }  ///< "http://<ap ip>/"
+
+  static size_t count();                   ///< Number of probes in the table
+  static const Probe& probe(size_t index);  ///< Table entry
+  uint32_t hits(size_t index) const;        ///< Requests answered for a probe
+  uint32_t totalHits() const;               ///< Requests answered for all probes
+
+ private:
+  char url[sizeof("http://255.255.255.255/")];  // Location of every redirect, rebuilt in place so HTTP can read it meanwhile
+  HttpTransport::Handler onHit;
+  std::vector<uint32_t> pathHashes;  // FNV-1a of each probe path
+  std::vector<uint32_t> hitCounts;
+};
+
+#endif  // CAPTIVE_PROBES_H
@@ -1,14 +1,28 @@
 #ifndef CP_CONFIG_H
 #define CP_CONFIG_H
+#include <ArduinoJson.h>
 #include <IPAddress.h>
 #include <LittleFS.h>
 
+#include <vector>
+
+#include "ConfigField.h"
+#include "ConfigObserver.h"
+#include "ConfigPath.h"
+#include "SaveScheduler.h"
+
 /**
  * @file Config.h
  * @brief Global configuration constants and function declarations for ESP32 Captive Portal.
  */
 class CaptivePortalConfig {
  public:
+  /// How the settings are encoded on flash
+  enum class StorageFormat {
+    Json,    ///< Pretty printed JSON in ConfigFile (default)
+    MsgPack  ///< MessagePack in ConfigFile with ".msgpack" instead of ".json". Smaller and faster to parse
+  };
+
   /**
    * @brief Sets the file system for config file(s)
    * Don't use the default LittleFS mount point else all html files will be gone after a factory reset.
@@ -27,31 +41,137 @@ class CaptivePortalConfig {
    * @return true on success
    */
   bool begin();
-  void resetToFactoryDefault();    // Reset config to factory default *** Resets the ESP ***
+  void resetToFactoryDefault();    // Reset config to factory default *** Resets the ESP *** (CaptivePortal::factoryReset() also drops the session key)
   bool checkFactoryResetMarker();  // true if the marker file exists (indicating a factory reset has occurred), false otherwise.
 
-  String ConfigFile = "/config.json";                    // Path to the configuration file in LittleFS
-  String AdminUser = "Admin";                            // Default admin username
-  String AdminPassword = "password";                     // Default admin password
-  String DefaultPassword = "password";                   // Default admin password
-  String DeviceHostname = "esp32-portal";                // Default device hostname
-  String DeviceName = "";                                // Custom device name (set by user)
-  String DeviceTimezone = "Etc/UTC";                     // Default device timezone
-  IPAddress DeviceIP = IPAddress(192, 168, 168, 168);    // Default device IP address
-  IPAddress DeviceIPMask = IPAddress(255, 255, 255, 0);  // Default device IP mask
-  uint8_t LedPin = 2;                                    // Pin number for the LED indicator
-  bool HasRgbLed = false;                                // True if the LED is an RGB LED
-  uint8_t RgbBrightness = 128;                           // Brightness of the RGB LED (0-255)
-  uint8_t ResetPin = GPIO_NUM_4;                         // Pin number for the reset button
-
-  bool configExists();                                             // Tests if ConfigFile Exists
-  bool loadConfig();                                               // Reads configuration from ConfigFile
+  String ConfigFile = "/config.json";  // Path to the configuration file in LittleFS
+
+  // Settings, defaults are in the field table in Config.cpp
+  String AdminUser;        // Admin username
+  String AdminPassword;    // Admin password
+  String DefaultPassword;  // Factory admin password
+  String DeviceHostname;   // Device hostname
+  String DeviceName;       // Custom device name (set by user)
+  String DeviceTimezone;   // Device timezone
+  IPAddress DeviceIP;      // Device IP address
+  IPAddress DeviceIPMask;  // Device IP mask
+  uint8_t LedPin;          // Pin number for the LED indicator
+  bool HasRgbLed;          // True if the LED is an RGB LED
+  uint8_t RgbBrightness;   // Brightness of the RGB LED (0-255)
+  uint8_t ResetPin;        // Pin number for the reset button
+
+  /**
+   * @brief Adds settings of a derived class to load, save and export. Call before begin().
+   *
+   * The table must stay valid (e.g. a static array). Its defaults are applied right away.
+   */
+  void addFields(const ConfigField* fields, size_t count);
+
+  /**
+   * @brief Writes the current value of every field to out, e.g. for a settings API.
+   *
+   * @param out Object to fill ({"user": {...}, "device": {...}})
+   * @param includeSecrets true to include passwords
+   */
+  void exportFields(JsonObject out, bool includeSecrets = false);
+  void applyDefaults();  // Sets every field to its default (the file is not touched)
+
+  bool configExists();                                             // Tests if the settings file exists
+  bool loadConfig();                                               // Reads configuration from ConfigFile (discards unsaved changes)
   bool imported();                                                 // Returns true if loadConfig() was successfull
   bool save(bool useDefaultValues = false);                        // Saves the configuration to LittleFS
-  bool add(const String& key, const String& value);                // Add a setting if it does not already exist
-  bool exist(const String& key, const String& value);              // Check whether if setting exists and matches the provided value
-  bool set(const String& key, const String& value);                // Set or update a configuration value
-  uint32_t getUInt(const String& key, uint32_t defaultValue = 0);  // Get an unsigned integer from config by key (dot-path)
+  bool add(const ConfigPath& key, const String& value);                // Add a setting if it does not already exist
+  bool exist(const ConfigPath& key, const String& value);              // Check whether if setting exists and matches the provided value
+  bool set(const ConfigPath& key, const String& value);                // Set or update a configuration value
+
+  /**
+   * @brief Sets or updates a value with its own JSON type (bool, integer, float or String).
+   *
+   * Unlike set(), the value is not parsed from text: a float is stored as a JSON
+   * number, and a String that looks like a number stays a string.
+   */
+  template <typename T>
+  bool setValue(const ConfigPath& key, const T& value) {
+    JsonVariant target = writableVariant(key);
+    if (target.isNull()) return false;
+    target.set(value);
+    return markDirty();
+  }
+  uint32_t getUInt(const ConfigPath& key, uint32_t defaultValue = 0);  // Get an unsigned integer from config by key (dot-path)
+  int32_t getInt(const ConfigPath& key, int32_t defaultValue = 0);     // Get a signed integer from config by key (dot-path)
+  bool getBool(const ConfigPath& key, bool defaultValue = false);      // Get a bool (true/false, 1/0, "true"/"false") by key
+  float getFloat(const ConfigPath& key, float defaultValue = 0.0f);    // Get a number from config by key (dot-path)
+  String getString(const ConfigPath& key, const String& defaultValue = String());  // Get a value as text by key
+
+  /**
+   * @brief Writes pending add()/set()/save() changes to ConfigFile.
+   *
+   * add(), set() and the getters work on a parsed copy of ConfigFile that is kept
+   * in memory after loadConfig(). Changes are written back by handle() when no
+   * change came in for CP_CONFIG_WRITEBACK_DELAY ms (or CP_CONFIG_WRITEBACK_MAX ms
+   * after the first one), or right away by flush(). A write that would not change
+   * the bytes on flash is skipped.
+   *
+   * So add(), set(), save() and setDeviceName() return true once the change is
+   * accepted in memory, not when it is on flash. A failed write-back is logged,
+   * retried by handle() and reported by writeFailed() until a write succeeds.
+   *
+   * @return true if there was nothing to write or the file was written
+   */
+  bool flush();
+  bool writeFailed() const { return writeError; }  // true if the last write-back failed (changes not on flash yet)
+  void handle();                          // Writes pending changes once the write-back window has passed
+  void invalidate();                      // Drops the in-memory copy (e.g. after ConfigFile was edited directly)
+  bool isDirty() const { return dirty; }  // true if there are changes not yet written
+  void setWriteBackDelay(uint32_t ms, uint32_t maxDelayMs = CP_CONFIG_WRITEBACK_MAX);  // 0 writes every change immediately
+  const SaveStats& getSaveStats() const { return saver.stats(); }                      // Flash write counters of the settings file
+
+  /**
+   * @brief Groups several add()/set()/save() calls into one write.
+   *
+   * Changes made after beginTransaction() stay in memory until commit() writes them
+   * with a single file write, or rollback() restores the document as it was.
+   * Member fields (AdminPassword, LedPin, ...) are not restored by rollback().
+   *
+   * Every write goes to ConfigFile + ".tmp" first and is then renamed into place.
+   * The previous file is kept as ConfigFile + ".bak". If ConfigFile is missing or
+   * cannot be parsed at boot, loadConfig() restores the newest complete copy.
+   *
+   * @return false if a transaction is already open or ConfigFile cannot be read
+   */
+  bool beginTransaction();
+  bool commit();    // Writes the changes made since beginTransaction(), false if the write failed
+  void rollback();  // Discards the changes made since beginTransaction()
+  bool inTransaction() const { return transaction; }
+
+  /**
+   * @brief Selects how the settings are stored. Call before begin().
+   *
+   * A file in the other format is migrated once on the next load. ConfigFile stays
+   * the name the web UI uses: /editfile shows and accepts JSON in both formats.
+   */
+  void setStorageFormat(StorageFormat format);
+  StorageFormat getStorageFormat() const { return storageFormat; }
+  String storageFile() const;  // File on flash: ConfigFile, or its ".msgpack" sibling
+
+  uint32_t generation() const { return changes; }  // Changes whenever the settings document changes (see ConfigKey)
+
+  /**
+   * @brief Calls observer for every change of a setting at or below prefix.
+   *
+   * Changes are found by comparing the settings before and after each successful
+   * write (flush(), commit(), save()) and after loadConfig(), once for all
+   * subscribers. Observers run in the task that wrote or loaded the settings.
+   *
+   * @param prefix Dot-path of a setting or section ("device", "device.ledPin"), "" for all
+   * @return Subscription id for unsubscribe()
+   */
+  int subscribe(const String& prefix, ConfigObserver observer);
+  int subscribe(const String& prefix, ConfigEventQueue& queue);  // Pushes the changes for another task
+  void unsubscribe(int id);
+
+  String toJson();                       // Current settings as pretty printed JSON
+  bool fromJson(const String& content);  // Replaces all settings with content, updates the members and writes them, false if not valid JSON
 
   bool setDeviceName(const String& name);  // Sets a custom device name in config.json
   String getEffectiveDeviceName() const;   // Returns DeviceName if set, otherwise DeviceHostname
@@ -63,8 +183,50 @@ class CaptivePortalConfig {
   const char* partitionLabel;
 
  private:
+  struct FieldTable {
+    const ConfigField* fields;
+    size_t count;
+  };
+  std::vector<FieldTable> fieldTables;  // Built-in fields first
+
+  void applyDefaults(const FieldTable& table);
+
   bool s_configLoaded = false;
   bool fsMounted = false;
+
+  JsonDocument doc;                                     // Parsed settings file, kept between calls
+  bool docLoaded = false;                               // true if doc holds the contents of the settings file
+  bool dirty = false;                                   // doc has changes that are not on flash yet
+  bool writeError = false;                              // The last write-back failed
+  SaveScheduler saver;                                  // When to write, and whether it is needed
+
+  JsonDocument snapshot;       // doc as it was at beginTransaction()
+  bool snapshotDirty = false;  // dirty as it was at beginTransaction()
+  bool transaction = false;    // true between beginTransaction() and commit()/rollback()
+  StorageFormat storageFormat = StorageFormat::Json;
+  uint32_t changes = 1;  // Bumped on every change of doc, ConfigKey compares it
+
+  struct Subscription {
+    int id;
+    String prefix;
+    ConfigObserver observer;
+  };
+  std::vector<Subscription> subscriptions;
+  int nextSubscription = 1;
+  JsonDocument published;       // Settings the subscribers were last told about
+  bool publishedValid = false;  // false until published holds a baseline
+
+  bool ensureLoaded();                                       // Parses the settings file into doc if that has not happened yet
+  JsonVariant writableVariant(const ConfigPath& key);        // Loads doc and creates the path, null on failure
+  bool parseFile(const String& path, StorageFormat format);  // Parses path into doc
+  bool readFields();                                         // Copies doc to the field members, false if a value is invalid
+  bool markDirty();                                          // Schedules a write-back (or writes now if the delay is 0)
+  void contentHash(uint32_t& crc, size_t& size);             // CRC32 and size of doc in the storage format
+  bool writeFile();                                          // Writes doc to a temp file and renames it to storageFile()
+  void publish();                                            // Tells the subscribers what changed since the last call
+  String fileFor(StorageFormat format) const;
+  String tempFile() const { return storageFile() + ".tmp"; }
+  String backupFile() const { return storageFile() + ".bak"; }
 };
 
 #endif  // CP_CONFIG_H
\ No newline at end of file
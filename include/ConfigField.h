@@ -0,0 +1,101 @@
+#ifndef CONFIG_FIELD_H
+#define CONFIG_FIELD_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <IPAddress.h>
+
+class CaptivePortalConfig;
+
+/// Returns false to reject a value read from the settings file (the field keeps its value)
+typedef bool (*ConfigValidator)(JsonVariantConst value);
+
+/// Packs an IPv4 address for a ConfigField default
+constexpr uint32_t configIPv4(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+  return (uint32_t)a << 24 | (uint32_t)b << 16 | (uint32_t)c << 8 | d;
+}
+
+/**
+ * @struct ConfigField
+ * @brief Binds a member of CaptivePortalConfig (or a derived class) to a key in the settings file.
+ *
+ * A table of fields drives loadConfig(), save(), the defaults and exportFields(),
+ * so a setting is declared once:
+ *
+ *   static const ConfigField kMyFields[] = {
+ *       {"sensor", "pin", &MyConfig::SensorPin, 34},
+ *       {"sensor", "interval", &MyConfig::Interval, 1000},
+ *   };
+ *   config.addFields(kMyFields, 2);
+ *
+ * Keys are "section.key", or just "key" with a nullptr section. Keep fields of the
+ * same section together, each section is looked up once per load or save.
+ */
+struct ConfigField {
+  enum class Type : uint8_t { Text, Address, Bool, UInt8, UInt16, UInt32, Int32, Float };
+
+  enum Flags : uint8_t {
+    Secret = 0x01  ///< Left out of exportFields() unless secrets are requested
+  };
+
+  typedef CaptivePortalConfig C;
+
+  union Member {
+    String C::*text;
+    IPAddress C::*address;
+    bool C::*flag;
+    uint8_t C::*u8;
+    uint16_t C::*u16;
+    uint32_t C::*u32;
+    int32_t C::*i32;
+    float C::*f;
+
+    constexpr Member(String C::*m) : text(m) {}
+    constexpr Member(IPAddress C::*m) : address(m) {}
+    constexpr Member(bool C::*m) : flag(m) {}
+    constexpr Member(uint8_t C::*m) : u8(m) {}
+    constexpr Member(uint16_t C::*m) : u16(m) {}
+    constexpr Member(uint32_t C::*m) : u32(m) {}
+    constexpr Member(int32_t C::*m) : i32(m) {}
+    constexpr Member(float C::*m) : f(m) {}
+  };
+
+  const char* section;       ///< First path segment, nullptr for a top level key
+  const char* key;           ///< Last path segment
+  Type type;                 ///< Type of the member
+  Member member;             ///< Member that holds the value
+  const char* defaultText;   ///< Default of Text fields
+  double defaultNumber;      ///< Default of the other types (addresses packed with configIPv4())
+  ConfigValidator validate;  ///< Optional check of loaded values
+  uint8_t flags;
+
+  template <class D>
+  constexpr ConfigField(const char* s, const char* k, String D::*m, const char* def, ConfigValidator v = nullptr, uint8_t fl = 0)
+      : section(s), key(k), type(Type::Text), member(static_cast<String C::*>(m)), defaultText(def), defaultNumber(0), validate(v), flags(fl) {}
+  template <class D>
+  constexpr ConfigField(const char* s, const char* k, IPAddress D::*m, uint32_t def, ConfigValidator v = nullptr, uint8_t fl = 0)
+      : section(s), key(k), type(Type::Address), member(static_cast<IPAddress C::*>(m)), defaultText(nullptr), defaultNumber(def), validate(v), flags(fl) {}
+  template <class D>
+  constexpr ConfigField(const char* s, const char* k, bool D::*m, bool def, ConfigValidator v = nullptr, uint8_t fl = 0)
+      : section(s), key(k), type(Type::Bool), member(static_cast<bool C::*>(m)), defaultText(nullptr), defaultNumber(def), validate(v), flags(fl) {}
+  template <class D>
+  constexpr ConfigField(const char* s, const char* k, uint8_t D::*m, uint8_t def, ConfigValidator v = nullptr, uint8_t fl = 0)
+      : section(s), key(k), type(Type::UInt8), member(static_cast<uint8_t C::*>(m)), defaultText(nullptr), defaultNumber(def), validate(v), flags(fl) {}
+  template <class D>
+  constexpr ConfigField(const char* s, const char* k, uint16_t D::*m, uint16_t def, ConfigValidator v = nullptr, uint8_t fl = 0)
+      : section(s), key(k), type(Type::UInt16), member(static_cast<uint16_t C::*>(m)), defaultText(nullptr), defaultNumber(def), validate(v), flags(fl) {}
+  template <class D>
+  constexpr ConfigField(const char* s, const char* k, uint32_t D::*m, uint32_t def, ConfigValidator v = nullptr, uint8_t fl = 0)
+      : section(s), key(k), type(Type::UInt32), member(static_cast<uint32_t C::*>(m)), defaultText(nullptr), defaultNumber(def), validate(v), flags(fl) {}
+  template <class D>
+  constexpr ConfigField(const char* s, const char* k, int32_t D::*m, int32_t def, ConfigValidator v = nullptr, uint8_t fl = 0)
+      : section(s), key(k), type(Type::Int32), member(static_cast<int32_t C::*>(m)), defaultText(nullptr), defaultNumber(def), validate(v), flags(fl) {}
+  template <class D>
+  constexpr ConfigField(const char* s, const char* k, float D::*m, float def, ConfigValidator v = nullptr, uint8_t fl = 0)
+      : section(s), key(k), type(Type::Float), member(static_cast<float C::*>(m)), defaultText(nullptr), defaultNumber(def), validate(v), flags(fl) {}
+};
+
+bool configValidGpio(JsonVariantConst value);   ///< Validator: an integer GPIO number
+bool configNotEmpty(JsonVariantConst value);    ///< Validator: a non-empty string
+
+#endif  // CONFIG_FIELD_H
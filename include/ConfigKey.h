@@ -0,0 +1,56 @@
+#ifndef CONFIG_KEY_H
+#define CONFIG_KEY_H
+
+#include <Arduino.h>
+
+#include "Config.h"
+#include "ConfigPath.h"
+
+/**
+ * @class ConfigKey
+ * @brief A typed setting bound to a dot-path and a default value.
+ *
+ * The value is read from the settings document on first use and kept until the
+ * document changes (set(), add(), save(), loadConfig(), an /editfile edit), so
+ * get() in a hot loop costs one counter compare. T is bool, uint32_t, int32_t,
+ * float or String.
+ *
+ *   ConfigKey<bool> rgbLed(Settings, "device.rgb_led", false);
+ *   if (rgbLed) ...
+ */
+template <typename T>
+class ConfigKey {
+ public:
+  ConfigKey(CaptivePortalConfig& config, const ConfigPath& path, const T& defaultValue)
+      : config(config), path(path), defaultValue(defaultValue), value(defaultValue) {}
+
+  /// Current value, or the default if the key is missing or has another type
+  const T& get() {
+    if (seen != config.generation()) {
+      value = read(defaultValue);
+      seen = config.generation();
+    }
+    return value;
+  }
+  operator const T&() { return get(); }
+
+  /// Stores the value with its JSON type (CaptivePortalConfig::setValue()), saved by the write-back
+  bool set(const T& newValue) { return config.setValue(path, newValue); }
+
+  const ConfigPath& key() const { return path; }
+
+ private:
+  CaptivePortalConfig& config;
+  ConfigPath path;
+  T defaultValue;
+  T value;
+  uint32_t seen = 0;  // Generation the value was read at, 0 = never
+
+  bool read(bool def) { return config.getBool(path, def); }
+  uint32_t read(uint32_t def) { return config.getUInt(path, def); }
+  int32_t read(int32_t def) { return config.getInt(path, def); }
+  float read(float def) { return config.getFloat(path, def); }
+  String read(const String& def) { return config.getString(path, def); }
+};
+
+#endif  // CONFIG_KEY_H
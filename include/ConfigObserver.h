@@ -0,0 +1,72 @@
+#ifndef CONFIG_OBSERVER_H
+#define CONFIG_OBSERVER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <functional>
+#include <vector>
+
+#include "PortalTask.h"
+
+#ifndef CP_CONFIG_QUEUE_SIZE
+  #define CP_CONFIG_QUEUE_SIZE 16  // Events a ConfigEventQueue holds before it drops the oldest
+#endif
+
+/**
+ * @struct ConfigChange
+ * @brief One setting that changed.
+ *
+ * Values are text: strings as they are, numbers and bools as in JSON, arrays as
+ * JSON. A key that did not exist (or no longer exists) has an empty value and
+ * existed/exists set to false.
+ */
+struct ConfigChange {
+  String path;       ///< Dot-path of the setting, e.g. "device.timezone"
+  String oldValue;   ///< Value before the change
+  String newValue;   ///< Value after the change
+  bool existed;      ///< The key existed before the change
+  bool exists;       ///< The key exists after the change
+};
+
+/// Receives a change of a subscribed setting
+typedef std::function<void(const ConfigChange& change)> ConfigObserver;
+
+/**
+ * @class ConfigEventQueue
+ * @brief Hands config changes to another task.
+ *
+ * CaptivePortalConfig::subscribe() pushes the changes, the other task takes them
+ * with pop(). When the queue is full the oldest change is dropped.
+ */
+class ConfigEventQueue {
+ public:
+  explicit ConfigEventQueue(size_t capacity = CP_CONFIG_QUEUE_SIZE);
+
+  void push(const ConfigChange& change);
+  bool pop(ConfigChange& change);  ///< false if the queue is empty
+  size_t size();
+  uint32_t dropped() const { return droppedCount; }  ///< Changes lost because the queue was full
+
+ private:
+  std::vector<ConfigChange> ring;
+  size_t head = 0;   // Oldest entry
+  size_t count = 0;  // Entries in the ring
+  uint32_t droppedCount = 0;
+  PortalMutex mutex;
+};
+
+/**
+ * @brief Compares two settings documents and lists the changed values.
+ *
+ * Objects are compared member by member, any other value (including arrays) as a whole.
+ */
+void diffConfig(JsonVariantConst before, JsonVariantConst after, std::vector<ConfigChange>& changes);
+
+/**
+ * @brief true if path is prefix or lies below it ("device" matches "device.ledPin").
+ * An empty prefix matches every path.
+ */
+bool configPathMatches(const String& prefix, const String& path);
+
+#endif  // CONFIG_OBSERVER_H
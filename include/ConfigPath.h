@@ -0,0 +1,54 @@
+#ifndef CONFIG_PATH_H
+#define CONFIG_PATH_H
+
+#include <Arduino.h>
+
+#ifndef CP_CONFIG_PATH_DEPTH
+  #define CP_CONFIG_PATH_DEPTH 6  // Maximum number of segments in a config key
+#endif
+#define CP_CONFIG_SEGMENT_MAX 48  // Longest segment name (bytes)
+#ifndef CP_CONFIG_PATH_INLINE
+  #define CP_CONFIG_PATH_INLINE 32  // Keys shorter than this are copied without a heap allocation
+#endif
+
+/**
+ * @class ConfigPath
+ * @brief A dot-separated config key (e.g. "device.rgb_led") split into segments once.
+ *
+ * The segments are kept as offsets into the key text, so resolving the key in the
+ * config document needs no substring copies. The key text is always copied, so a
+ * ConfigPath (and a ConfigKey holding one) stays valid when the string it was built
+ * from goes away. Keys shorter than CP_CONFIG_PATH_INLINE are stored in the object
+ * itself; only longer keys allocate. Keys used in a loop can be built once:
+ *
+ *   static const ConfigPath kRgbLed("device.rgb_led");
+ *   bool rgb = Settings.getBool(kRgbLed);
+ *
+ * Plain strings still work everywhere a ConfigPath is expected.
+ */
+class ConfigPath {
+ public:
+  ConfigPath(const char* path);
+  ConfigPath(const String& path);
+
+  bool isValid() const { return valid; }  ///< false if empty, too deep or a segment is empty or too long
+  size_t depth() const { return count; }  ///< Number of segments
+  const char* c_str() const { return text(); }
+
+  const char* segment(size_t i) const { return text() + offsets[i]; }  ///< Start of segment i (not terminated)
+  size_t segmentLength(size_t i) const { return lengths[i]; }           ///< Length of segment i
+
+ private:
+  char local[CP_CONFIG_PATH_INLINE];  // Key text if it fits
+  String owned;                       // Key text otherwise
+  uint8_t offsets[CP_CONFIG_PATH_DEPTH];
+  uint8_t lengths[CP_CONFIG_PATH_DEPTH];
+  uint8_t count = 0;
+  bool valid = false;
+
+  const char* text() const { return owned.isEmpty() ? local : owned.c_str(); }
+  void assign(const char* path, size_t len);
+  void split();
+};
+
+#endif  // CONFIG_PATH_H
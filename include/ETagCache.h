@@ -0,0 +1,78 @@
+#ifndef ETAG_CACHE_H
+#define ETAG_CACHE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include <map>
+
+#include "HttpTransport.h"
+
+/**
+ * @class ETagCache
+ * @brief Keeps content hashes of the files on a filesystem for use as HTTP ETags.
+ *
+ * Hashes are computed once (at begin() or on first use) and kept until the file
+ * is invalidated. Call invalidate() whenever a file is written.
+ */
+class ETagCache {
+ public:
+  explicit ETagCache(fs::LittleFSFS& fileSystem);
+
+  /**
+   * @brief Hashes all files on the filesystem.
+   */
+  void begin();
+
+  /**
+   * @brief Returns the quoted ETag of a file, or an empty string if the file does not exist.
+   */
+  String fileETag(const String& path);
+
+  /**
+   * @brief Returns the quoted ETag of a rendered menu page variant.
+   *
+   * @param menuHash Hash of the menu template
+   * @param activeTab Active tab of the page
+   * @param pageTitle Title of the page
+   * @param bodyPath Path of the body file as it is sent (plain or .gz)
+   * @return ETag, or an empty string if the body file does not exist or contains {{variables}}
+   */
+  String pageETag(uint32_t menuHash, const String& activeTab, const String& pageTitle, const String& bodyPath);
+
+  /**
+   * @brief Forgets the hash of a file and of its .gz sibling.
+   */
+  void invalidate(const String& path);
+
+  /**
+   * @brief Forgets all hashes.
+   */
+  void clear();
+
+  /**
+   * @brief true if the client's If-None-Match header matches etag.
+   *
+   * Requires "If-None-Match" to be collected with HttpTransport::collectHeaders().
+   */
+  static bool matches(HttpTransport* server, const String& etag);
+
+  /**
+   * @brief Sends "304 Not Modified" with the given ETag.
+   */
+  static void sendNotModified(HttpTransport* server, const String& etag);
+
+ private:
+  fs::LittleFSFS& fileSystem;
+  struct Tag {
+    uint32_t hash;   // CRC32 of the file content
+    bool templated;  // true if the file contains {{variables}}
+  };
+  std::map<String, Tag> tags;  // path -> tag
+
+  bool fileHash(const String& path, uint32_t& hash, bool* templated = nullptr);
+  void hashDirectory(const String& dir);
+  static String format(uint32_t hash);
+};
+
+#endif  // ETAG_CACHE_H
@@ -0,0 +1,58 @@
+#ifndef EMBEDDED_ASSETS_H
+#define EMBEDDED_ASSETS_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+/**
+ * @file EmbeddedAssets.h
+ * @brief Web files compiled into the firmware by tools/embed_assets.py.
+ *
+ * Build with -DCP_EMBED_ASSETS and "extra_scripts = pre:tools/embed_assets.py" to
+ * embed the data/ directory. Embedded files are served straight from flash; a file
+ * with the same path (or its .gz sibling) on the web file system overrides it.
+ */
+
+struct EmbeddedAsset {
+  const char* path;      ///< Absolute path, e.g. "/styles.css"
+  const char* mimeType;  ///< Content-Type
+  const uint8_t* data;   ///< File content
+  uint32_t length;       ///< Length of data
+  const uint8_t* gzData; ///< gzip compressed content, or nullptr
+  uint32_t gzLength;     ///< Length of gzData
+  uint32_t hash;         ///< CRC32 of data
+  uint32_t gzHash;       ///< CRC32 of gzData
+  bool templated;        ///< true if data contains {{variables}}
+};
+
+/**
+ * @brief Looks up an embedded asset by path.
+ *
+ * @return The asset, or nullptr if no asset with this path is embedded
+ */
+const EmbeddedAsset* findEmbeddedAsset(const char* path);
+
+/**
+ * @brief Number of embedded assets.
+ */
+size_t embeddedAssetCount();
+
+/**
+ * @brief Looks up an embedded asset that is not overridden by a file on fileSystem.
+ *
+ * Whether a file overrides the asset is checked once and remembered, so serving an
+ * embedded asset does not touch the file system. Call refreshEmbeddedAssetOverride()
+ * after writing a file.
+ *
+ * @return The asset, or nullptr if it is not embedded or overridden by a file
+ */
+const EmbeddedAsset* findEmbeddedAsset(fs::LittleFSFS& fileSystem, const String& path);
+
+/**
+ * @brief Re-checks whether a file on fileSystem overrides an embedded asset.
+ *
+ * @param path Path of the file that changed (plain or .gz)
+ */
+void refreshEmbeddedAssetOverride(fs::LittleFSFS& fileSystem, const String& path);
+
+#endif  // EMBEDDED_ASSETS_H
@@ -0,0 +1,82 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include <list>
+
+#ifndef CP_FILE_CACHE_SIZE
+  #define CP_FILE_CACHE_SIZE 8192  // Default byte budget of the file cache
+#endif
+
+#ifndef CP_FILE_CACHE_ENTRIES
+  #define CP_FILE_CACHE_ENTRIES 32  // Maximum number of files (including missing ones) remembered
+#endif
+
+/**
+ * @class FileCache
+ * @brief LRU cache of file contents with a fixed byte budget.
+ *
+ * Entries are keyed by file system and path. The cache also remembers files that
+ * do not exist or are too large to cache, so repeated lookups do not touch the
+ * file system. Call invalidate() after writing a file.
+ */
+class FileCache {
+ public:
+  struct Entry {
+    fs::LittleFSFS* fileSystem;
+    String path;
+    uint8_t* data;  ///< File content, nullptr if the file is missing or larger than the budget
+    size_t length;  ///< File size
+    bool found;     ///< true if the file exists
+  };
+
+  explicit FileCache(size_t budget = CP_FILE_CACHE_SIZE);
+  ~FileCache();
+
+  /**
+   * @brief Returns the cache entry of a file, loading it on a miss.
+   *
+   * The entry stays valid until the next call to get(), invalidate() or clear().
+   */
+  const Entry& get(fs::LittleFSFS& fileSystem, const String& path);
+
+  /**
+   * @brief Removes a file and its .gz sibling from the cache (on every file system).
+   */
+  void invalidate(const String& path);
+
+  /**
+   * @brief Removes all entries.
+   */
+  void clear();
+
+  /**
+   * @brief Sets the byte budget, evicting entries if needed. 0 disables caching of contents.
+   */
+  void setBudget(size_t bytes);
+
+  /**
+   * @brief Places cached contents in PSRAM when the board has it.
+   */
+  void usePsram(bool enable) { psram = enable; }
+
+  size_t budget() const { return maxBytes; }    ///< Byte budget
+  size_t usedBytes() const { return bytes; }    ///< Bytes of cached content
+  uint32_t hits() const { return hitCount; }    ///< Lookups served from the cache
+  uint32_t misses() const { return missCount; } ///< Lookups that went to the file system
+
+ private:
+  std::list<Entry> entries;  // Most recently used first
+  size_t maxBytes;
+  size_t bytes = 0;
+  bool psram = false;
+  uint32_t hitCount = 0;
+  uint32_t missCount = 0;
+
+  void evict(size_t needed);
+  void release(Entry& e);
+};
+
+#endif  // FILE_CACHE_H
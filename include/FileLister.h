@@ -0,0 +1,80 @@
+#ifndef FILE_LISTER_H
+#define FILE_LISTER_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <functional>
+
+#ifndef CP_LIST_PATH_MAX
+  #define CP_LIST_PATH_MAX 256  // Longest path in a listing, longer entries are skipped
+#endif
+#ifndef CP_LIST_LIMIT
+  #define CP_LIST_LIMIT 50  // Entries per /listfiles page without a limit argument
+#endif
+#ifndef CP_LIST_LIMIT_MAX
+  #define CP_LIST_LIMIT_MAX 200  // Largest limit a /listfiles request may ask for
+#endif
+#ifndef CP_LIST_DEPTH
+  #define CP_LIST_DEPTH 5  // Directory levels a recursive listing enters, each keeps a directory open
+#endif
+
+/**
+ * @brief A file system entry reported by FileLister.
+ */
+struct FileEntry {
+  const char* path;  // Full path, valid during the visit only
+  size_t size;       // File size, 0 for a directory
+  bool dir;          // true for a directory
+};
+
+/**
+ * @class FileLister
+ * @brief Lists a directory page by page, one openNextFile() at a time.
+ *
+ * Entries are visited in file system order, depth first when recursive. A page
+ * ends after limit entries; the path of the last entry is the cursor for the next
+ * page. Resuming opens only the directories on the way to the cursor and reads
+ * the names before it with getNextFileName(), without opening those entries. The
+ * path is built in a fixed buffer, only the open handles use the heap.
+ *
+ * The order is only stable while the directories do not change. A cursor that no
+ * longer exists is rejected by list(), the client should then start again.
+ */
+class FileLister {
+ public:
+  typedef std::function<void(const FileEntry& entry)> Visitor;
+
+  explicit FileLister(fs::FS& fileSystem, bool recursive = false);
+
+  /**
+   * @brief Visits up to limit entries below root, starting after the entry after.
+   *
+   * @param root Directory to list ("/" for the whole file system)
+   * @param after Cursor: full path of the last entry of the previous page, nullptr or "" to start
+   * @param limit Entries per page
+   * @param visit Called for each entry
+   * @return false if root is not a directory or after is not an entry below root
+   */
+  bool list(const char* root, const char* after, size_t limit, const Visitor& visit);
+
+  bool hasMore() const { return more; }   ///< true if list() stopped at limit with entries left
+  const char* next() const { return last; }  ///< Cursor for the next page (path of the last entry)
+  size_t count() const { return visited; }   ///< Entries visited by the last list()
+
+ private:
+  fs::FS& fileSystem;
+  bool recursive;
+  size_t limit = 0;
+  size_t visited = 0;
+  bool more = false;
+  const Visitor* visit = nullptr;
+  char path[CP_LIST_PATH_MAX];  // Path of the directory being listed, then of the entry
+  size_t pathLen = 0;
+  char last[CP_LIST_PATH_MAX];
+
+  bool listDir(const char* skipUntil, uint8_t depth);
+  bool setPath(const char* p, size_t len);
+};
+
+#endif  // FILE_LISTER_H
@@ -0,0 +1,96 @@
+#ifndef GZIP_UTIL_H
+#define GZIP_UTIL_H
+
+#include <Arduino.h>
+
+#include <functional>
+
+/**
+ * @file GzipUtil.h
+ * @brief Minimal gzip (RFC 1952) helpers used to splice pre-compressed files into a response.
+ */
+
+/// Size of the fixed gzip member header written by gzipWriteHeader()
+#define GZIP_HEADER_SIZE 10
+/// Size of the gzip member trailer (CRC32 + ISIZE)
+#define GZIP_TRAILER_SIZE 8
+/// Size of a deflate stored block header (BFINAL/BTYPE byte, LEN, NLEN)
+#define GZIP_STORED_BLOCK_HEADER_SIZE 5
+/// Longest output of deflateAppendStoredHeader()
+#define DEFLATE_APPEND_HEADER_MAX 6
+
+/**
+ * @brief Updates a CRC-32 (IEEE 802.3) with more data.
+ *
+ * @param crc CRC of the preceding data (0 for the first call)
+ */
+uint32_t crc32Update(uint32_t crc, const void* data, size_t len);
+
+/**
+ * @brief Combines CRC(A) and CRC(B) into CRC(A+B) given the length of B.
+ */
+uint32_t crc32Combine(uint32_t crcA, uint32_t crcB, size_t lenB);
+
+/**
+ * @brief Returns the offset of the deflate data in a gzip member.
+ *
+ * Skips the optional FEXTRA, FNAME, FCOMMENT and FHCRC fields.
+ *
+ * @param header First bytes of the gzip file
+ * @param len Number of bytes available in header
+ * @return Offset of the deflate stream, or 0 if the header is invalid or incomplete
+ */
+size_t gzipDataOffset(const uint8_t* header, size_t len);
+
+/**
+ * @brief Writes a minimal gzip member header (no name, no mtime).
+ */
+void gzipWriteHeader(uint8_t out[GZIP_HEADER_SIZE]);
+
+/**
+ * @brief Writes a non-final deflate stored block header for len bytes (len <= 65535).
+ */
+void gzipWriteStoredBlockHeader(uint8_t out[GZIP_STORED_BLOCK_HEADER_SIZE], uint16_t len);
+
+/// Where the last block of a deflate stream starts and ends, as bit offsets (LSB first)
+struct DeflateEnd {
+  size_t finalBit = 0;  ///< The BFINAL bit of the last block
+  size_t endBit = 0;    ///< First bit after the end-of-block code of the last block
+};
+
+/// Supplies deflate data to deflateFindEnd(), returns the number of bytes copied to buf (0 at the end)
+typedef std::function<size_t(uint8_t* buf, size_t len)> DeflateReader;
+
+/**
+ * @brief Walks the blocks of a deflate stream, without inflating it, to find its last block.
+ *
+ * Data can only be appended to a deflate stream after its BFINAL bit is cleared,
+ * with the next block starting at endBit. Uses about 1.5 KB of stack.
+ *
+ * @return false if the data ends early or is not valid deflate data
+ */
+bool deflateFindEnd(const DeflateReader& read, DeflateEnd& end);
+
+/**
+ * @brief Writes the last byte of deflate data followed by a final stored block header for len bytes.
+ *
+ * The stored block starts right after the used bits of lastByte (see DeflateEnd::endBit),
+ * its len bytes of data follow the header.
+ *
+ * @param lastByte Last byte of the deflate data, with its BFINAL bit already cleared if it has it
+ * @param usedBits Number of bits of lastByte that belong to the data (1-8)
+ * @return Number of bytes written to out
+ */
+size_t deflateAppendStoredHeader(uint8_t out[DEFLATE_APPEND_HEADER_MAX], uint8_t lastByte, uint8_t usedBits, uint16_t len);
+
+/**
+ * @brief Writes a gzip trailer (CRC32 and ISIZE, little endian).
+ */
+void gzipWriteTrailer(uint8_t out[GZIP_TRAILER_SIZE], uint32_t crc, uint32_t isize);
+
+/**
+ * @brief Reads a little endian uint32 (as used in the gzip trailer).
+ */
+uint32_t gzipReadLE32(const uint8_t* p);
+
+#endif  // GZIP_UTIL_H
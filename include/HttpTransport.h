@@ -0,0 +1,114 @@
+#ifndef HTTP_TRANSPORT_H
+#define HTTP_TRANSPORT_H
+
+#include <Arduino.h>
+
+#include <functional>
+
+#ifdef ESP32
+  #include <WebServer.h>  // HTTPMethod, HTTPUpload, CONTENT_LENGTH_UNKNOWN
+#else
+// Same definitions as the Arduino WebServer, for host builds
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END, UPLOAD_FILE_ABORTED };
+  #define CONTENT_LENGTH_UNKNOWN ((size_t) - 1)
+  #define CONTENT_LENGTH_NOT_SET ((size_t) - 2)
+  #ifndef HTTP_UPLOAD_BUFLEN
+    #define HTTP_UPLOAD_BUFLEN 1436
+  #endif
+struct HTTPUpload {
+  HTTPUploadStatus status;
+  String filename;
+  String name;
+  String type;
+  size_t totalSize;
+  size_t currentSize;
+  uint8_t buf[HTTP_UPLOAD_BUFLEN];
+};
+#endif
+
+/**
+ * @class HttpTransport
+ * @brief The HTTP server interface used by CaptivePortal and CPHandlers.
+ *
+ * It is the subset of the Arduino WebServer API the portal uses, so handlers are
+ * written the same way for every backend. Request accessors and the send
+ * functions refer to the request that is currently being handled.
+ *
+ * Backends: WebServerTransport (the Arduino WebServer, one client at a time, the
+ * default) and AsyncHttpTransport (non-blocking sockets, many clients, keep-alive).
+ */
+class HttpTransport {
+ public:
+  typedef std::function<void(void)> Handler;
+
+  /**
+   * @brief Answers a fixed set of requests before the routes are searched.
+   */
+  class Interceptor {
+   public:
+    virtual ~Interceptor() {}
+    virtual bool matches(const String& uri) const = 0;               ///< Cheap check, no side effects
+    virtual void respond(HttpTransport* server, const String& uri) = 0;  ///< Sends the response for a matching uri
+  };
+
+  virtual ~HttpTransport() {}
+
+  virtual void begin() = 0;         ///< Starts listening
+  virtual void stop() = 0;          ///< Closes the listening socket and all connections
+  virtual void handleClient() = 0;  ///< Services network I/O and runs handlers. Call often
+
+  /**
+   * @brief Registers a route.
+   *
+   * @param uri Exact path to match
+   * @param method HTTP method, HTTP_ANY matches every method
+   * @param handler Called when the request is complete
+   * @param uploadHandler Called for each piece of a multipart file upload (optional)
+   */
+  virtual void on(const String& uri, HTTPMethod method, Handler handler, Handler uploadHandler = nullptr) = 0;
+  void on(const String& uri, Handler handler) { on(uri, HTTP_ANY, handler); }
+
+  virtual void onNotFound(Handler handler) = 0;  ///< Called when no route matches
+
+  /**
+   * @brief Sets the largest request body accepted for uri, for every method.
+   *
+   * Only used by backends that cap the bodies they keep in memory
+   * (AsyncHttpTransport); the others accept any size and ignore it.
+   */
+  virtual void setBodyLimit(const String& uri, size_t maxBytes) {}
+
+  /**
+   * @brief Checks every request with interceptor before the routes. Call before on().
+   *
+   * @param interceptor Must stay valid while the server runs, nullptr removes it
+   */
+  virtual void intercept(Interceptor* interceptor) = 0;
+
+  /**
+   * @brief Selects the request headers that are kept for header()/hasHeader().
+   */
+  virtual void collectHeaders(const char* headerKeys[], size_t headerKeysCount) = 0;
+
+  // Current request
+  virtual String uri() = 0;
+  virtual HTTPMethod method() = 0;
+  virtual HTTPUpload& upload() = 0;
+  virtual bool hasArg(const String& name) = 0;
+  virtual String arg(const String& name) = 0;  ///< Query or form argument, "plain" is the raw body
+  virtual bool hasHeader(const String& name) = 0;
+  virtual String header(const String& name) = 0;
+
+  // Response
+  virtual void setContentLength(size_t length) = 0;  ///< CONTENT_LENGTH_UNKNOWN selects a chunked response
+  virtual void sendHeader(const String& name, const String& value, bool first = false) = 0;
+  virtual void send(int code, const char* contentType, const String& content) = 0;
+  virtual void sendContent(const char* data, size_t len) = 0;  ///< len 0 ends a chunked response
+
+  void send(int code, const char* contentType, const char* content) { send(code, contentType, String(content)); }
+  void send(int code, const String& contentType, const String& content) { send(code, contentType.c_str(), content); }
+  void sendContent(const String& content) { sendContent(content.c_str(), content.length()); }
+};
+
+#endif  // HTTP_TRANSPORT_H
@@ -0,0 +1,76 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <Arduino.h>
+
+/**
+ * @class JsonWriter
+ * @brief Writes JSON straight to a Print (e.g. a ResponseWriter) without building it in memory.
+ *
+ * Strings are escaped while they are written: runs of plain characters are passed
+ * on as is and only the characters that need an escape are replaced. Commas
+ * between members and elements are added automatically. The writer keeps a few
+ * bytes of state and never allocates heap memory.
+ *
+ * Usage:
+ *   ResponseWriter out(server);
+ *   out.begin(200, "application/json");
+ *   JsonWriter json(out);
+ *   json.beginArray();
+ *   json.beginObject();
+ *   json.member("ssid", ssid);
+ *   json.member("rssi", rssi);
+ *   json.endObject();
+ *   json.endArray();
+ *   out.end();
+ *
+ * Commas are tracked for 32 nesting levels. The writer does not check that the calls form
+ * valid JSON (e.g. a value without a key inside an object).
+ */
+class JsonWriter {
+ public:
+  explicit JsonWriter(Print& out) : out(out) {}
+
+  void beginObject();
+  void endObject();
+  void beginArray();
+  void endArray();
+
+  /**
+   * @brief Writes a member name inside an object. The next call writes its value.
+   */
+  void key(const char* name);
+
+  void value(const char* s);  ///< Escaped string, nullptr writes null
+  void value(const char* s, size_t len);
+  void value(const String& s) { value(s.c_str(), s.length()); }
+  void value(long n);
+  void value(unsigned long n);
+  void value(int n) { value((long)n); }
+  void value(unsigned int n) { value((unsigned long)n); }
+  void value(bool b);
+  void null();
+
+  template <typename T>
+  void member(const char* name, const T& v) {
+    key(name);
+    value(v);
+  }
+
+  /**
+   * @brief Writes s as the content of a JSON string (without quotes), escaped.
+   */
+  static void escape(Print& out, const char* s, size_t len);
+
+ private:
+  Print& out;
+  uint32_t hasItems = 0;  // Bit per nesting level: the container has an element
+  uint8_t depth = 0;
+  bool afterKey = false;  // A value follows a key, no comma
+
+  void separate();
+  void open(char c);
+  void close(char c);
+};
+
+#endif  // JSON_WRITER_H
@@ -3,7 +3,13 @@
 
 #include <Arduino.h>
 #include <LittleFS.h>
-#include <WebServer.h>
+
+#include "ETagCache.h"
+#include "FileCache.h"
+#include "HttpTransport.h"
+#include "PageTemplate.h"
+#include "TemplateVars.h"
+
 /**
  * @brief Loads the contents of a file from the filesystem.
  *
@@ -11,9 +17,35 @@
  * If the file does not exist or cannot be opened, a fallback HTML error message is returned.
  *
  * @param path The path to the file (e.g. "/home.html")
+ * @param cache Optional file cache to read through
  * @return A string containing the file contents, or an error message if failed.
  */
-String loadFile(fs::LittleFSFS& fileSystem, const String& path);
+String loadFile(fs::LittleFSFS& fileSystem, const String& path, FileCache* cache = nullptr);
+
+/**
+ * @brief Checks whether the client accepts a gzip Content-Encoding.
+ *
+ * Requires "Accept-Encoding" to be collected with HttpTransport::collectHeaders().
+ */
+bool clientAcceptsGzip(HttpTransport* server);
+
+/**
+ * @brief Sends a file from the filesystem, preferring a pre-compressed "<path>.gz" sibling.
+ *
+ * The .gz file is sent with "Content-Encoding: gzip" when the client accepts gzip,
+ * otherwise the plain file is sent. Sends a 404 page if neither exists.
+ * When etags is given, the response carries an ETag and a matching If-None-Match
+ * is answered with "304 Not Modified".
+ *
+ * @param path The path to the plain file (e.g. "/styles.css")
+ * @param contentType Content-Type of the plain file
+ * @param etags Optional ETag cache of fileSystem
+ * @param cache Optional file cache to serve from
+ * @return true if a file (or 304) was sent
+ */
+bool serveFile(HttpTransport* server, fs::LittleFSFS& fileSystem, const String& path,
+               const char* contentType, int code = 200, ETagCache* etags = nullptr,
+               FileCache* cache = nullptr);
 
 /**
  * @brief Streams a full HTML page with a navigation menu and dynamic title.
@@ -26,9 +58,41 @@ String loadFile(fs::LittleFSFS& fileSystem, const String& path);
  * @param pageTitle Title to be used in the <title> tag
  * @return A complete HTML page as a string
  */
-void streamPageWithMenu(WebServer* server, fs::LittleFSFS& fileSystem,
+void streamPageWithMenu(HttpTransport* server, fs::LittleFSFS& fileSystem,
                         const String& filePath,
                         const String& activeTab,
                         const String& pageTitle);
 
+/**
+ * @brief Streams a full HTML page using a menu template that was compiled in advance.
+ *
+ * The {home}, {edit}, {devices} and {system} slots of the menu render as "active" for the
+ * slot matching activeTab and as empty text otherwise. Other {...} text in the menu is
+ * sent as it is.
+ *
+ * If the client accepts gzip and "<filePath>.gz" exists, the response is sent as a single
+ * gzip member: head and menu as a stored deflate block followed by the deflate data of the
+ * pre-compressed body, with its last block made non-final, and the </body></html> end
+ * tags as a final stored block.
+ *
+ * {{name}} variables in the body are replaced with the values from vars while the body
+ * is streamed. With vars the plain file is sent, never "<filePath>.gz".
+ *
+ * @param menu Compiled "/tabmenu.html" template
+ * @param filePath Path to the HTML file to load into the <body>
+ * @param activeTab The tab to highlight as active ("home", "edit", "devices", "system")
+ * @param pageTitle Title to be used in the <title> tag
+ * @param etags Optional ETag cache of fileSystem, enables "304 Not Modified" responses
+ * @param vars Optional template variables for the body
+ * @param cache Optional file cache for the body
+ */
+void streamPageWithMenu(HttpTransport* server, fs::LittleFSFS& fileSystem,
+                        const PageTemplate& menu,
+                        const String& filePath,
+                        const String& activeTab,
+                        const String& pageTitle,
+                        ETagCache* etags = nullptr,
+                        const TemplateVars* vars = nullptr,
+                        FileCache* cache = nullptr);
+
 #endif  // PAGE_RENDERER_H
\ No newline at end of file
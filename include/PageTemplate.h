@@ -0,0 +1,65 @@
+#ifndef PAGE_TEMPLATE_H
+#define PAGE_TEMPLATE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include <functional>
+#include <vector>
+
+/**
+ * @class PageTemplate
+ * @brief A template that is parsed once into literal spans and placeholder slots.
+ *
+ * Placeholders have the form {name} where name consists of letters, digits and '_'.
+ * Rendering walks the segment list and emits literals and resolved slot values
+ * directly, without copying or rescanning the template text.
+ */
+class PageTemplate {
+ public:
+  /// Receives a piece of rendered output
+  typedef std::function<void(const char* data, size_t len)> Emitter;
+
+  /// Returns the value for a placeholder slot, nullptr keeps the placeholder text (e.g. "{name}") as it is
+  typedef std::function<const char*(const char* name, size_t len)> Resolver;
+
+  /**
+   * @brief Loads and parses a template file.
+   *
+   * If the file cannot be opened, the template renders a 404 message (like loadFile()).
+   *
+   * @return true if the file was loaded and parsed
+   */
+  bool compile(fs::LittleFSFS& fileSystem, const String& path);
+
+  /**
+   * @brief Parses template text that is already in memory.
+   */
+  void compile(const String& source);
+
+  bool isCompiled() const { return compiled; }  ///< true once compile() has been called
+  size_t literalLength() const;                 ///< Number of literal bytes emitted per render
+  uint32_t hash() const { return textHash; }    ///< CRC32 of the template source
+
+  /**
+   * @brief Renders the template.
+   *
+   * @param emit Receives the literal spans and slot values in order
+   * @param resolve Returns the value of each placeholder slot
+   */
+  void render(const Emitter& emit, const Resolver& resolve) const;
+
+ private:
+  struct Segment {
+    uint32_t offset;  // Offset into text (slot: offset of the name)
+    uint32_t length;  // Length of the literal or slot name
+    bool slot;        // true if this is a placeholder slot
+  };
+
+  String text;                    // Template source, kept as backing storage for the segments
+  std::vector<Segment> segments;  // Parsed literal spans and placeholder slots
+  uint32_t textHash = 0;          // CRC32 of text
+  bool compiled = false;
+};
+
+#endif  // PAGE_TEMPLATE_H
@@ -0,0 +1,144 @@
+#ifndef PORTAL_TASK_H
+#define PORTAL_TASK_H
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <functional>
+
+#ifdef ESP32
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/semphr.h>
+  #include <freertos/task.h>
+#else
+  #include <mutex>
+  #include <thread>
+#endif
+
+#ifndef CP_TASK_STOP_TIMEOUT
+  #define CP_TASK_STOP_TIMEOUT 12000UL  // ms to wait for a service task, longer than a handler waits for a slow client
+#endif
+
+/**
+ * @file PortalTask.h
+ * @brief Small threading layer for the portal services.
+ *
+ * On the ESP32 these wrap FreeRTOS tasks and recursive mutexes. On other
+ * platforms (e.g. a Linux host build) std::thread and std::recursive_mutex are used,
+ * so the threaded mode can be exercised without hardware.
+ */
+
+/**
+ * @class PortalMutex
+ * @brief Recursive mutex. The same task may lock it more than once.
+ */
+class PortalMutex {
+ public:
+  PortalMutex();
+  ~PortalMutex();
+
+  void lock();
+  void unlock();
+
+ private:
+#ifdef ESP32
+  SemaphoreHandle_t handle;
+#else
+  std::recursive_mutex mutex;
+#endif
+
+  PortalMutex(const PortalMutex&) = delete;
+  PortalMutex& operator=(const PortalMutex&) = delete;
+};
+
+/**
+ * @class PortalLock
+ * @brief Holds a PortalMutex for the lifetime of the object.
+ */
+class PortalLock {
+ public:
+  explicit PortalLock(PortalMutex& m) : mutex(m) { mutex.lock(); }
+  ~PortalLock() { mutex.unlock(); }
+
+ private:
+  PortalMutex& mutex;
+
+  PortalLock(const PortalLock&) = delete;
+  PortalLock& operator=(const PortalLock&) = delete;
+};
+
+/**
+ * @struct PortalTaskConfig
+ * @brief Stack size, priority and core affinity of a service task.
+ */
+struct PortalTaskConfig {
+  uint32_t stackSize;  ///< Stack size in bytes
+  uint8_t priority;    ///< FreeRTOS priority (ignored on the host)
+  int8_t core;         ///< Core to pin the task to, -1 for no affinity (ignored on the host)
+  uint32_t idleDelay;  ///< Milliseconds to sleep between iterations
+
+  PortalTaskConfig(uint32_t stackSize = 4096, uint8_t priority = 1, int8_t core = -1, uint32_t idleDelay = 2)
+      : stackSize(stackSize), priority(priority), core(core), idleDelay(idleDelay) {}
+};
+
+/**
+ * @class PortalTask
+ * @brief Runs a function in a loop on its own task until stop() is called.
+ */
+class PortalTask {
+ public:
+  typedef std::function<void()> Body;
+
+  ~PortalTask();
+
+  /**
+   * @brief Starts the task.
+   *
+   * @param name Task name (for debugging)
+   * @param body Called repeatedly, followed by config.idleDelay ms of sleep
+   * @param config Stack, priority and core
+   * @return true if the task was started or is already running
+   */
+  bool start(const char* name, Body body, const PortalTaskConfig& config = PortalTaskConfig());
+
+  /**
+   * @brief Requests the task to stop and waits for the current iteration to finish.
+   *
+   * When called from the task itself it only requests the stop; the task exits after
+   * the current iteration returns.
+   *
+   * @param timeoutMs Maximum time to wait
+   * @return true if the task has stopped (or will stop, when called from the task itself),
+   *         false if it is still running. Objects the task uses must then stay alive
+   */
+  bool stop(uint32_t timeoutMs = CP_TASK_STOP_TIMEOUT);
+
+  /**
+   * @brief Deletes a task that did not stop. Last resort before its objects are released.
+   *
+   * The task is removed wherever it is, so the locks, sockets and memory it holds at
+   * that moment are never released. On the host stop() always waits, so this only
+   * stops and joins the thread.
+   */
+  void kill();
+
+  bool isRunning() const { return active; }  ///< true while the task loop runs
+
+ private:
+  Body taskBody;
+  uint32_t idleDelay = 2;
+  std::atomic<bool> stopRequested{false};
+  std::atomic<bool> active{false};
+
+#ifdef ESP32
+  TaskHandle_t handle = nullptr;
+  std::atomic<bool> deleting{false};  // Set by whoever deletes the task: the task itself or kill()
+  static void entry(void* arg);
+#else
+  std::thread thread;
+#endif
+
+  void run();
+};
+
+#endif  // PORTAL_TASK_H
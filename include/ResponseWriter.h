@@ -0,0 +1,77 @@
+#ifndef RESPONSE_WRITER_H
+#define RESPONSE_WRITER_H
+
+#include <Arduino.h>
+
+#include "HttpTransport.h"
+
+#ifndef CP_RESPONSE_BUFFER_SIZE
+  #define CP_RESPONSE_BUFFER_SIZE 1429  // 1436 byte TCP MSS minus chunk size line and trailing CRLF
+#endif
+
+/**
+ * @class ResponseWriter
+ * @brief Coalesces response content into MSS sized chunks.
+ *
+ * Everything written is collected in a fixed buffer that is sent with
+ * HttpTransport::sendContent() only when it is full, or on flush()/end().
+ * A write of at least a full buffer into an empty buffer is sent as is.
+ * The writer itself never allocates heap memory.
+ *
+ * Usage: send the headers (e.g. with setContentLength() and send(code, type, "")),
+ * write the content, then call end(). Or let the writer choose the framing: call
+ * begin(code, type) instead of sending the headers. Content that fits in the buffer
+ * is then sent with a Content-Length header, larger content as a chunked response.
+ */
+class ResponseWriter : public Print {
+ public:
+  explicit ResponseWriter(HttpTransport* server);
+  ~ResponseWriter();
+
+  /**
+   * @brief Holds back the headers until the content length or the need for chunks is known.
+   *
+   * Headers added with sendHeader() before begin() are sent with them.
+   */
+  void begin(int code, const char* contentType);
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* data, size_t len) override;
+  using Print::write;
+
+  /**
+   * @brief Copies up to maxLen bytes from a stream (e.g. a File) straight into the buffer.
+   *
+   * @return Number of bytes copied
+   */
+  size_t writeFrom(Stream& in, size_t maxLen = (size_t)-1);
+
+  /**
+   * @brief Sends the buffered content as one chunk.
+   */
+  void flush() override;
+
+  /**
+   * @brief Flushes and, for chunked responses, sends the terminating chunk.
+   *
+   * After begin() the framing is chosen by the writer and chunked is ignored.
+   */
+  void end(bool chunked = true);
+
+  size_t chunks() const { return chunkCount; }  ///< Number of chunks sent so far
+  size_t bytes() const { return byteCount; }    ///< Number of content bytes written so far
+
+ private:
+  HttpTransport* server;
+  char buf[CP_RESPONSE_BUFFER_SIZE];
+  size_t used = 0;
+  size_t chunkCount = 0;
+  size_t byteCount = 0;
+  bool ended = false;
+  int code = 0;                      // Held back response status, 0 when headers are sent
+  const char* contentType = nullptr;
+
+  void sendHeaders(size_t length);
+};
+
+#endif  // RESPONSE_WRITER_H
@@ -0,0 +1,65 @@
+#ifndef SAVE_SCHEDULER_H
+#define SAVE_SCHEDULER_H
+
+#include <Arduino.h>
+
+#ifndef CP_CONFIG_WRITEBACK_DELAY
+  #define CP_CONFIG_WRITEBACK_DELAY 2000UL  // ms without changes before pending changes are written
+#endif
+#ifndef CP_CONFIG_WRITEBACK_MAX
+  #define CP_CONFIG_WRITEBACK_MAX 10000UL  // ms after the first change when they are written anyway
+#endif
+
+/// Write counters of one file
+struct SaveStats {
+  uint32_t requested = 0;     ///< Changes that asked for a save
+  uint32_t performed = 0;     ///< Writes to flash
+  uint32_t skipped = 0;       ///< Saves dropped because the file already had the same bytes
+  uint32_t failed = 0;        ///< Writes that failed (retried later)
+  uint32_t bytesWritten = 0;  ///< Total bytes written to flash
+};
+
+/**
+ * @class SaveScheduler
+ * @brief Decides when a file that changes in bursts is written to flash.
+ *
+ * Changes are collected until none came in for the debounce window, or until the
+ * first pending change is maxDelay old. Before writing, the caller compares the
+ * CRC32 and size of the new contents with isUnchanged(), so saving what is already
+ * on flash costs no write. The scheduler does not touch the file system itself.
+ */
+class SaveScheduler {
+ public:
+  explicit SaveScheduler(uint32_t debounceMs = CP_CONFIG_WRITEBACK_DELAY, uint32_t maxDelayMs = CP_CONFIG_WRITEBACK_MAX);
+
+  void setWindow(uint32_t debounceMs, uint32_t maxDelayMs);
+  uint32_t debounce() const { return debounceWindow; }
+
+  void request(unsigned long now);      ///< A change that needs saving happened
+  bool isPending() const { return pending; }
+  bool isDue(unsigned long now) const;  ///< true if a pending save should be written now
+  void cancel();                        ///< Drops the pending save (contents were discarded)
+
+  bool isUnchanged(uint32_t crc, size_t size) const;  ///< true if flash already holds these contents
+  void skipped();                                     ///< The pending save was not needed
+  void written(uint32_t crc, size_t size);            ///< The contents were written
+  void failed(unsigned long now);                     ///< The write failed, retry after the next window
+
+  void setFlashContent(uint32_t crc, size_t size);  ///< Contents read from flash
+  void forgetFlashContent();                        ///< Flash contents unknown (e.g. after a failed write)
+
+  const SaveStats& stats() const { return counters; }
+
+ private:
+  uint32_t debounceWindow;
+  uint32_t maxDelay;
+  bool pending = false;
+  unsigned long firstChange = 0;  // millis() of the first pending change
+  unsigned long lastChange = 0;   // millis() of the latest change
+  bool flashKnown = false;        // flashCrc/flashSize describe the file on flash
+  uint32_t flashCrc = 0;
+  size_t flashSize = 0;
+  SaveStats counters;
+};
+
+#endif  // SAVE_SCHEDULER_H
@@ -0,0 +1,83 @@
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include <Arduino.h>
+
+#ifndef CP_MAX_SESSIONS
+  #define CP_MAX_SESSIONS 16  // Maximum number of concurrent login sessions
+#endif
+
+#define CP_SESSION_ID_SIZE 16  // 128 bit session IDs
+
+/**
+ * @class SessionStore
+ * @brief Fixed capacity table of login sessions.
+ *
+ * Session IDs are 128 bit random values, exchanged with the client as 32 hex
+ * characters. The table is allocated once and uses open addressing (linear
+ * probing with backward shift deletion). When it is full, the least recently
+ * used session is evicted. Expiry is computed with unsigned millis() differences,
+ * so it keeps working when millis() wraps around.
+ */
+class SessionStore {
+ public:
+  /**
+   * @param maxSessions Maximum number of sessions
+   * @param timeoutMs Lifetime of a session in milliseconds
+   */
+  explicit SessionStore(size_t maxSessions = CP_MAX_SESSIONS, uint32_t timeoutMs = 3600UL * 1000UL);
+  ~SessionStore();
+
+  /**
+   * @brief Creates a session and returns its ID as 32 hex characters.
+   */
+  String create();
+
+  /**
+   * @brief true if the session exists and has not expired. Expired sessions are removed.
+   */
+  bool isValid(const String& sid);
+
+  /**
+   * @brief Removes a session (no-op if it does not exist).
+   */
+  void remove(const String& sid);
+
+  /**
+   * @brief Removes all sessions.
+   */
+  void clear();
+
+  /**
+   * @brief Removes all expired sessions.
+   *
+   * @return Number of sessions removed
+   */
+  size_t sweep();
+
+  void setTimeout(uint32_t ms) { timeout = ms; }  ///< Sets the session lifetime
+  size_t size() const { return count; }           ///< Number of sessions
+  size_t capacity() const { return maxCount; }    ///< Maximum number of sessions
+
+ private:
+  struct Slot {
+    uint8_t id[CP_SESSION_ID_SIZE];
+    uint32_t created;   // millis() at creation
+    uint32_t lastUsed;  // millis() of the last successful validation
+    bool used;
+  };
+
+  Slot* slots;
+  size_t slotCount;  // Power of two, at least twice maxCount
+  size_t maxCount;
+  size_t count = 0;
+  uint32_t timeout;
+
+  static bool parse(const String& sid, uint8_t id[CP_SESSION_ID_SIZE]);
+  size_t home(const uint8_t id[CP_SESSION_ID_SIZE]) const;
+  int find(const uint8_t id[CP_SESSION_ID_SIZE]) const;
+  void erase(size_t index);
+  bool expired(const Slot& s, uint32_t now) const { return (uint32_t)(now - s.created) >= timeout; }
+};
+
+#endif  // SESSION_STORE_H
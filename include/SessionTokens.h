@@ -0,0 +1,84 @@
+#ifndef SESSION_TOKENS_H
+#define SESSION_TOKENS_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#define CP_SESSION_KEY_SIZE 32    // HMAC-SHA256 key
+#define CP_SESSION_MAC_SIZE 16    // Truncated MAC in the token
+#define CP_SESSION_TOKEN_LENGTH 48  // 8 hex expiry + 8 hex nonce + 32 hex MAC
+#define CP_SESSION_KEY_FILE "/session.key"
+#ifndef CP_SESSION_CLOCK_SET
+  #define CP_SESSION_CLOCK_SET 1577836800UL  // time() at or after 2020-01-01 means the clock was set (NTP, RTC)
+#endif
+
+/**
+ * @class SessionTokens
+ * @brief Stateless, HMAC signed session tokens.
+ *
+ * A token carries its expiry time (seconds of time()) and a nonce, signed with
+ * HMAC-SHA256 over a device secret and a revocation epoch. Validation needs no
+ * server side table, so tokens survive reboots and memory use does not depend on
+ * the number of clients. Incrementing the epoch (revokeAll()) invalidates every
+ * token issued before.
+ *
+ * Secret and epoch are kept in a small file on the settings file system. Without
+ * a time source the clock restarts at boot, so expiry is then relative to uptime.
+ * A token is only accepted while the clock is in the same state as when it was
+ * issued (set or not set, see CP_SESSION_CLOCK_SET) and expires at most the
+ * issued lifetime from now. Tokens from before a reboot without a clock are
+ * therefore rejected instead of staying valid until the clock catches up.
+ */
+class SessionTokens {
+ public:
+  /**
+   * @brief Loads the secret and epoch, or creates them on first use.
+   *
+   * esp_fill_random() only gives true random numbers while WiFi or Bluetooth is
+   * running, so call this after the SoftAP has been started.
+   *
+   * @param fileSystem Settings file system
+   * @param keyFile Path of the key file
+   * @return true if the key is available
+   */
+  bool begin(fs::LittleFSFS& fileSystem, const char* keyFile = CP_SESSION_KEY_FILE);
+
+  /**
+   * @brief Deletes the key file, so the next begin() creates a new secret.
+   *
+   * Every token issued with the old secret becomes invalid. Used by a factory reset.
+   */
+  static bool removeKey(fs::LittleFSFS& fileSystem, const char* keyFile = CP_SESSION_KEY_FILE);
+
+  /**
+   * @brief Issues a token that is valid for lifetime seconds.
+   */
+  String issue(uint32_t lifetime);
+
+  /**
+   * @brief Checks the MAC (in constant time) and the expiry of a token.
+   *
+   * @param maxLifetime Lifetime the tokens are issued with, a token that expires later is rejected
+   */
+  bool isValid(const String& token, uint32_t maxLifetime) const;
+
+  /**
+   * @brief Invalidates all tokens issued so far by incrementing the epoch.
+   */
+  bool revokeAll();
+
+  bool ready() const { return loaded; }      ///< true after a successful begin()
+  uint32_t epoch() const { return keyEpoch; }  ///< Current revocation epoch
+
+ private:
+  fs::LittleFSFS* fileSystem = nullptr;
+  String keyPath;
+  uint8_t secret[CP_SESSION_KEY_SIZE];
+  uint32_t keyEpoch = 0;
+  bool loaded = false;
+
+  bool save();
+  void sign(uint32_t expiry, uint32_t nonce, uint8_t mac[CP_SESSION_MAC_SIZE]) const;
+};
+
+#endif  // SESSION_TOKENS_H
@@ -0,0 +1,105 @@
+#ifndef SETTINGS_APPLIER_H
+#define SETTINGS_APPLIER_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#ifndef CP_AP_RESTART_DELAY
+  #define CP_AP_RESTART_DELAY 1000UL  // ms between a SoftAP change and its restart, lets the HTTP response go out
+#endif
+#ifndef CP_AP_RESTART_TRIES
+  #define CP_AP_RESTART_TRIES 3  // SoftAP restart attempts before giving up until the next change or reboot
+#endif
+
+class CaptivePortalConfig;
+
+/**
+ * @struct AppliedSettings
+ * @brief The settings that have an effect at runtime, as they were last applied.
+ */
+struct AppliedSettings {
+  String ssid;      // Effective device name
+  String password;  // SoftAP password (the admin password)
+  IPAddress ip;
+  IPAddress mask;
+  String timezone;
+  uint8_t ledPin = 0;
+  bool rgbLed = false;
+  uint8_t rgbBrightness = 0;
+  uint8_t resetPin = 0;
+
+  static AppliedSettings from(const CaptivePortalConfig& config);
+};
+
+/**
+ * @class SettingsApplier
+ * @brief Applies changed settings without a reboot.
+ *
+ * After the settings change, apply() compares them with what was applied before
+ * and runs only the actions that are needed: tzset() for a new timezone, pin
+ * setup for LED or reset pin changes, and a SoftAP reconfiguration only when the
+ * SSID, password, IP or mask really changed. Other settings need no action.
+ *
+ * The SoftAP restart disconnects every client, including the one that saved the
+ * settings. It therefore runs CP_AP_RESTART_DELAY ms after the change, from a later
+ * apply() call, and a failed restart is retried up to CP_AP_RESTART_TRIES times.
+ *
+ * plan() is a pure function and the actions go through Target, so the decisions
+ * can be checked on a host with a mock Target.
+ */
+class SettingsApplier {
+ public:
+  enum Action : uint8_t {
+    None = 0x00,
+    Timezone = 0x01,     ///< setenv("TZ") and tzset()
+    Led = 0x02,          ///< LED pin, RGB flag or brightness
+    ResetPin = 0x04,     ///< Reset button pin
+    AccessPoint = 0x08,  ///< SoftAP SSID, password, IP or mask (disconnects the clients)
+  };
+
+  /// Performs the actions, e.g. with WiFi and GPIO calls
+  class Target {
+   public:
+    virtual ~Target() {}
+    virtual void setTimezone(const String& timezone) = 0;
+    virtual void setupLed(const AppliedSettings& before, const AppliedSettings& after) = 0;
+    virtual void setupResetPin(uint8_t before, uint8_t after) = 0;
+    virtual bool restartAccessPoint(const AppliedSettings& settings) = 0;
+  };
+
+  /**
+   * @brief Returns the actions (Action bits) needed to go from before to after.
+   */
+  static uint8_t plan(const AppliedSettings& before, const AppliedSettings& after);
+
+  /**
+   * @brief Remembers the settings as applied, e.g. after the portal started.
+   */
+  void begin(const CaptivePortalConfig& config);
+
+  /**
+   * @brief true if the settings changed since begin() or the last apply(), or a SoftAP restart is due.
+   */
+  bool hasChanges(const CaptivePortalConfig& config) const;
+
+  /**
+   * @brief Applies what changed and runs a SoftAP restart that is due.
+   *
+   * @return The actions that were run (Action bits)
+   */
+  uint8_t apply(const CaptivePortalConfig& config, Target& target);
+
+  const AppliedSettings& applied() const { return current; }  ///< Settings as last applied
+  bool accessPointPending() const { return apPending; }       ///< A SoftAP restart waits for its delay or a retry
+  bool accessPointFailed() const { return apFailed; }         ///< The last SoftAP restart failed on every try
+
+ private:
+  AppliedSettings current;
+  uint32_t seen = 0;  // Settings generation of current
+  bool apPending = false;
+  bool apFailed = false;
+  uint8_t apTries = 0;
+  unsigned long apSince = 0;  // millis() of the change or the last failed try
+};
+
+#endif  // SETTINGS_APPLIER_H
@@ -0,0 +1,87 @@
+#ifndef TEMPLATE_VARS_H
+#define TEMPLATE_VARS_H
+
+#include <Arduino.h>
+
+#include <functional>
+#include <vector>
+
+#ifndef CP_TEMPLATE_VAR_MAX
+  #define CP_TEMPLATE_VAR_MAX 32  // Maximum length of a {{variable}} name
+#endif
+
+/**
+ * @class TemplateVars
+ * @brief Registry of named values that can be inserted in pages as {{name}}.
+ *
+ * A provider prints the current value of a variable. Values are HTML escaped
+ * unless the variable was registered with escape = false.
+ */
+class TemplateVars {
+ public:
+  typedef std::function<void(Print& out)> Provider;
+
+  /**
+   * @brief Registers (or replaces) a variable.
+   *
+   * @param name Variable name, letters, digits, '_' and '.' only
+   * @param provider Prints the value of the variable
+   * @param escape true to HTML escape the value
+   */
+  void set(const String& name, Provider provider, bool escape = true);
+
+  /**
+   * @brief Removes a variable.
+   */
+  void remove(const String& name);
+
+  /**
+   * @brief Prints the value of a variable.
+   *
+   * @return false if no variable with this name is registered
+   */
+  bool print(const char* name, size_t len, Print& out) const;
+
+ private:
+  struct Var {
+    String name;
+    Provider provider;
+    bool escape;
+  };
+  std::vector<Var> vars;
+};
+
+/**
+ * @class TemplateStreamer
+ * @brief Expands {{name}} variables in text that arrives in chunks.
+ *
+ * Placeholders may be split over chunk boundaries. Unknown variables and
+ * anything that is not a valid placeholder are passed through unchanged.
+ */
+class TemplateStreamer {
+ public:
+  TemplateStreamer(const TemplateVars& vars, Print& out);
+
+  /**
+   * @brief Processes the next chunk of text.
+   */
+  void feed(const char* data, size_t len);
+
+  /**
+   * @brief Passes through a trailing incomplete placeholder.
+   */
+  void finish();
+
+ private:
+  enum State : uint8_t { TEXT, OPEN, NAME, CLOSE };
+
+  const TemplateVars& vars;
+  Print& out;
+  State state = TEXT;
+  char name[CP_TEMPLATE_VAR_MAX];
+  size_t nameLen = 0;
+
+  void flushPending();
+};
+
+#endif  // TEMPLATE_VARS_H
@@ -0,0 +1,53 @@
+#ifndef WEB_SERVER_TRANSPORT_H
+#define WEB_SERVER_TRANSPORT_H
+
+#include <Arduino.h>
+#include <WebServer.h>
+
+#include "HttpTransport.h"
+
+/**
+ * @class WebServerTransport
+ * @brief HttpTransport backed by the Arduino WebServer.
+ *
+ * Serves one client per handleClient() call. This is the default backend. The
+ * Arduino WebServer answers every request with "Connection: close", so each request
+ * opens a new TCP connection; use AsyncHttpTransport for keep-alive.
+ */
+class WebServerTransport : public HttpTransport {
+ public:
+  explicit WebServerTransport(int port = 80) : server(port) {}
+
+  void begin() override { server.begin(); }
+  void stop() override { server.stop(); }
+  void handleClient() override { server.handleClient(); }
+
+  void on(const String& uri, HTTPMethod method, Handler handler, Handler uploadHandler = nullptr) override;
+  using HttpTransport::on;
+  void onNotFound(Handler handler) override { server.onNotFound(handler); }
+  void intercept(Interceptor* interceptor) override;
+  void collectHeaders(const char* headerKeys[], size_t headerKeysCount) override;
+
+  String uri() override { return server.uri(); }
+  HTTPMethod method() override { return server.method(); }
+  HTTPUpload& upload() override { return server.upload(); }
+  bool hasArg(const String& name) override { return server.hasArg(name); }
+  String arg(const String& name) override { return server.arg(name); }
+  bool hasHeader(const String& name) override { return server.hasHeader(name); }
+  String header(const String& name) override { return server.header(name); }
+
+  void setContentLength(size_t length) override { server.setContentLength(length); }
+  void sendHeader(const String& name, const String& value, bool first = false) override;
+  void send(int code, const char* contentType, const String& content) override;
+  using HttpTransport::send;
+  void sendContent(const char* data, size_t len) override { server.sendContent(data, len); }
+  using HttpTransport::sendContent;
+
+  WebServer& webServer() { return server; }  ///< The wrapped server, e.g. for serveStatic()
+
+ private:
+  WebServer server;
+  RequestHandler* interceptHandler = nullptr;  // Added first, the WebServer checks handlers in order
+};
+
+#endif  // WEB_SERVER_TRANSPORT_H
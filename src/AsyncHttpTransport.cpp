@@ -0,0 +1,892 @@
+#include "AsyncHttpTransport.h"
+
+#include <dprintf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifdef ESP32
+  #include <lwip/sockets.h>
+#else
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <sys/select.h>
+  #include <sys/socket.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+  #define MSG_NOSIGNAL 0
+#endif
+
+static bool wouldBlock() {
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+static void setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Position of pattern in buffer, or -1
+static long findBytes(const std::vector<uint8_t>& buf, const char* pattern, size_t patternLen, size_t from = 0) {
+  if (buf.size() < from + patternLen) return -1;
+  auto it = std::search(buf.begin() + from, buf.end(), pattern, pattern + patternLen);
+  return it == buf.end() ? -1 : (long)(it - buf.begin());
+}
+
+static String urlDecode(const String& in) {
+  String out;
+  out.reserve(in.length());
+  for (unsigned int i = 0; i < in.length(); i++) {
+    char c = in[i];
+    if (c == '+') {
+      out += ' ';
+    } else if (c == '%' && i + 2 < in.length() && isxdigit((unsigned char)in[i + 1]) && isxdigit((unsigned char)in[i + 2])) {
+      char hex[3] = {in[i + 1], in[i + 2], 0};
+      out += (char)strtol(hex, nullptr, 16);
+      i += 2;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// Value of key="value" (or key=value) in a header like Content-Disposition
+static String headerParam(const String& header, const String& key) {
+  int pos = header.indexOf(key + "=");
+  if (pos == -1) return "";
+  pos += key.length() + 1;
+  if (header[pos] == '"') {
+    int end = header.indexOf('"', pos + 1);
+    return end == -1 ? header.substring(pos + 1) : header.substring(pos + 1, end);
+  }
+  int end = header.indexOf(';', pos);
+  String value = end == -1 ? header.substring(pos) : header.substring(pos, end);
+  value.trim();
+  return value;
+}
+
+static const char* reasonPhrase(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 411: return "Length Required";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "";
+  }
+}
+
+static HTTPMethod parseMethod(const String& m) {
+  if (m == "GET") return HTTP_GET;
+  if (m == "POST") return HTTP_POST;
+  if (m == "HEAD") return HTTP_HEAD;
+  if (m == "PUT") return HTTP_PUT;
+  if (m == "PATCH") return HTTP_PATCH;
+  if (m == "DELETE") return HTTP_DELETE;
+  if (m == "OPTIONS") return HTTP_OPTIONS;
+  return HTTP_ANY;  // Unknown
+}
+
+AsyncHttpTransport::AsyncHttpTransport(uint16_t port, size_t maxClients) : port(port), maxClients(maxClients) {}
+
+AsyncHttpTransport::~AsyncHttpTransport() {
+  stop();
+}
+
+void AsyncHttpTransport::begin() {
+  DPRINTF(0, "[AsyncHttpTransport::begin] port %u", (unsigned)port);
+  if (listenFd >= 0) return;
+
+  listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    DPRINTF(3, "socket() failed: %d", errno);
+    return;
+  }
+  int yes = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, (int)maxClients) != 0) {
+    DPRINTF(3, "bind()/listen() on port %u failed: %d", (unsigned)port, errno);
+    close(listenFd);
+    listenFd = -1;
+    return;
+  }
+  setNonBlocking(listenFd);
+}
+
+void AsyncHttpTransport::stop() {
+  DPRINTF(0, "[AsyncHttpTransport::stop]");
+  if (current) {
+    // Called from a handler: handleClient() closes the connections when it regains control
+    for (Connection* c : connections) c->broken = true;
+  } else {
+    while (!connections.empty()) closeClient(connections.size() - 1);
+  }
+  if (listenFd >= 0) {
+    close(listenFd);
+    listenFd = -1;
+  }
+}
+
+void AsyncHttpTransport::handleClient() {
+  if (current) return;  // Called from a handler
+  if (listenFd < 0) {
+    while (!connections.empty()) closeClient(connections.size() - 1);  // Left over from stop() in a handler
+    return;
+  }
+
+  fd_set readSet, writeSet;
+  FD_ZERO(&readSet);
+  FD_ZERO(&writeSet);
+  FD_SET(listenFd, &readSet);
+  int maxFd = listenFd;
+  for (Connection* c : connections) {
+    FD_SET(c->fd, &readSet);
+    if (!c->out.empty()) FD_SET(c->fd, &writeSet);
+    maxFd = std::max(maxFd, c->fd);
+  }
+
+  struct timeval tv = {0, 0};
+  int ready = select(maxFd + 1, &readSet, &writeSet, nullptr, &tv);
+  if (ready > 0) {
+    size_t count = connections.size();  // Connections accepted below were not polled
+    for (size_t i = 0; i < count; i++) {
+      Connection& c = *connections[i];
+      if (!c.broken && FD_ISSET(c.fd, &writeSet) && !flushClient(c)) c.broken = true;
+      if (!c.broken && FD_ISSET(c.fd, &readSet) && !readClient(c)) c.broken = true;
+    }
+    if (FD_ISSET(listenFd, &readSet)) acceptClients();
+  }
+
+  // Close finished, broken and stalled connections
+  unsigned long now = millis();
+  for (size_t i = connections.size(); i-- > 0;) {
+    Connection& c = *connections[i];
+    bool done = c.state == State::Drain && c.out.empty();
+    unsigned long timeout = isIdle(c) ? idleTimeout : CP_HTTP_TIMEOUT;
+    if (c.broken || done || now - c.lastActivity >= timeout) closeClient(i);
+  }
+}
+
+void AsyncHttpTransport::acceptClients() {
+  while (true) {
+    // When full, make room by closing a connection that is not in a request
+    int victim = -1;
+    if (connections.size() >= maxClients) {
+      victim = evictable();
+      if (victim == -1) {
+        // Every socket serves a request: the new client waits in the listen backlog
+        DPRINTF(0, "All HTTP connections busy, accepting later");
+        return;
+      }
+    }
+
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    int fd = accept(listenFd, (struct sockaddr*)&addr, &addrLen);
+    if (fd < 0) return;  // Nobody waiting, the victim stays open
+    if (victim != -1) closeClient(victim);
+
+    setNonBlocking(fd);
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));  // Responses are already coalesced
+
+    Connection* c = new Connection();
+    c->fd = fd;
+    c->lastActivity = millis();
+    connections.push_back(c);
+  }
+}
+
+bool AsyncHttpTransport::readClient(Connection& c) {
+  // Read what is available, but leave time for the other connections
+  for (int i = 0; i < 4 && !c.broken; i++) {
+    ssize_t n = recv(c.fd, readBuf, sizeof(readBuf), 0);
+    if (n == 0) return false;  // Peer closed
+    if (n < 0) return wouldBlock();
+    c.lastActivity = millis();
+    if (c.state == State::Drain) continue;  // Ignore anything after the request
+    process(c, readBuf, (size_t)n);
+  }
+  return true;
+}
+
+void AsyncHttpTransport::process(Connection& c, const uint8_t* data, size_t len) {
+  c.in.insert(c.in.end(), data, data + len);
+
+  // A persistent connection can carry several requests back to back
+  while (!c.broken) {
+    if (c.state == State::Head) {
+      long headEnd = findBytes(c.in, "\r\n\r\n", 4);
+      if (headEnd == -1) {
+        if (c.in.size() > CP_HTTP_HEADER_MAX) sendError(c, 431, "Request headers too large");
+        return;
+      }
+      if (!parseHead(c, (size_t)headEnd)) return;  // Requests without a body are handled right away
+      continue;
+    }
+
+    if (c.state == State::Body) {
+      if (c.in.size() < c.contentLength) return;
+      String body((const char*)c.in.data(), c.contentLength);
+      c.in.erase(c.in.begin(), c.in.begin() + c.contentLength);
+      if (c.contentType.startsWith("application/x-www-form-urlencoded"))
+        parseArgs(c, body);
+      else
+        c.args.push_back({"plain", body});
+      dispatch(c);
+      continue;
+    }
+
+    if (c.state == State::Multipart) {
+      size_t take = std::min(c.in.size(), c.contentLength - c.bodyReceived);
+      c.bodyReceived += take;
+      feedMultipart(c, c.in.data(), take);
+      c.in.erase(c.in.begin(), c.in.begin() + take);
+      if (c.state != State::Multipart || c.bodyReceived < c.contentLength) return;
+
+      // Body complete
+      if (c.part != PartState::End && c.filePart && c.upload) {
+        DPRINTF(2, "Multipart body ended without closing delimiter");
+        callUpload(c, UPLOAD_FILE_ABORTED);
+      }
+      if (uploadOwner == &c) uploadOwner = nullptr;
+      dispatch(c);
+      continue;
+    }
+
+    // Drain: the connection closes after this response, discard the rest
+    c.in.clear();
+    return;
+  }
+}
+
+bool AsyncHttpTransport::parseHead(Connection& c, size_t headLen) {
+  String head((const char*)c.in.data(), headLen);
+  c.in.erase(c.in.begin(), c.in.begin() + headLen + 4);
+
+  // Request line
+  int lineEnd = head.indexOf("\r\n");
+  String line = lineEnd == -1 ? head : head.substring(0, lineEnd);
+  int sp1 = line.indexOf(' ');
+  int sp2 = sp1 == -1 ? -1 : line.indexOf(' ', sp1 + 1);
+  if (sp1 <= 0 || sp2 == -1) {
+    sendError(c, 400, "Bad request");
+    return false;
+  }
+  c.method = parseMethod(line.substring(0, sp1));
+  if (c.method == HTTP_ANY) {
+    sendError(c, 405, "Method not allowed");
+    return false;
+  }
+  bool http11 = line.substring(sp2 + 1) == "HTTP/1.1";
+  String target = line.substring(sp1 + 1, sp2);
+  int q = target.indexOf('?');
+  c.uri = q == -1 ? target : target.substring(0, q);
+  if (q != -1) parseArgs(c, target.substring(q + 1));
+
+  // Headers
+  bool chunkedBody = false;
+  String connection;
+  int pos = lineEnd == -1 ? head.length() : lineEnd + 2;
+  while (pos < (int)head.length()) {
+    int end = head.indexOf("\r\n", pos);
+    if (end == -1) end = head.length();
+    int colon = head.indexOf(':', pos);
+    if (colon != -1 && colon < end) {
+      String name = head.substring(pos, colon);
+      String value = head.substring(colon + 1, end);
+      name.trim();
+      value.trim();
+      if (name.equalsIgnoreCase("Content-Length"))
+        c.contentLength = (size_t)value.toInt();
+      else if (name.equalsIgnoreCase("Content-Type"))
+        c.contentType = value;
+      else if (name.equalsIgnoreCase("Transfer-Encoding") && !value.equalsIgnoreCase("identity"))
+        chunkedBody = true;
+      else if (name.equalsIgnoreCase("Connection"))
+        connection = value;
+      if (isCollected(name)) c.headers.push_back({name, value});
+    }
+    pos = end + 2;
+  }
+
+  if (chunkedBody) {
+    sendError(c, 411, "Length required");
+    return false;
+  }
+
+  // HTTP/1.1 keeps the connection open unless the client asks otherwise, HTTP/1.0 only on request
+  connection.toLowerCase();
+  c.keepAlive = http11 ? connection.indexOf("close") == -1 : connection.indexOf("keep-alive") != -1;
+
+  if (c.contentLength == 0) {
+    dispatch(c);  // Looks for the route after the interceptor
+    return true;
+  }
+  c.route = findRoute(c.uri, c.method);
+  c.bodyMax = bodyLimit(c.uri);
+
+  if (c.contentType.startsWith("multipart/form-data")) {
+    String boundary = headerParam(c.contentType, "boundary");
+    if (boundary.isEmpty()) {
+      sendError(c, 400, "Missing boundary");
+      return false;
+    }
+    bool uploads = c.route != -1 && routes[c.route].uploadHandler;
+    if (uploads) {
+      if (uploadOwner && uploadOwner != &c) {
+        sendError(c, 503, "Another upload is in progress");
+        return false;
+      }
+      uploadOwner = &c;
+    }
+    c.delimiter = "\r\n--" + boundary;
+    c.part = PartState::Preamble;
+    c.state = State::Multipart;
+    return true;
+  }
+
+  if (c.contentLength > c.bodyMax) {
+    sendError(c, 413, "Request body too large");
+    return false;
+  }
+  c.state = State::Body;
+  return true;
+}
+
+void AsyncHttpTransport::parseArgs(Connection& c, const String& query) {
+  int pos = 0;
+  while (pos < (int)query.length()) {
+    int end = query.indexOf('&', pos);
+    if (end == -1) end = query.length();
+    int eq = query.indexOf('=', pos);
+    if (eq == -1 || eq > end) eq = end;
+    if (eq > pos) {
+      String value = eq < end ? query.substring(eq + 1, end) : String("");
+      c.args.push_back({urlDecode(query.substring(pos, eq)), urlDecode(value)});
+    }
+    pos = end + 1;
+  }
+}
+
+void AsyncHttpTransport::feedMultipart(Connection& c, const uint8_t* data, size_t len) {
+  c.partBuf.insert(c.partBuf.end(), data, data + len);
+  const char* delim = c.delimiter.c_str();
+  size_t delimLen = c.delimiter.length();
+
+  while (c.state == State::Multipart) {
+    switch (c.part) {
+      case PartState::Preamble: {
+        // The first delimiter has no leading CRLF
+        long pos = findBytes(c.partBuf, delim + 2, delimLen - 2);
+        if (pos == -1) {
+          if (c.partBuf.size() > delimLen) c.partBuf.erase(c.partBuf.begin(), c.partBuf.end() - delimLen);
+          return;
+        }
+        c.partBuf.erase(c.partBuf.begin(), c.partBuf.begin() + pos + delimLen - 2);
+        c.part = PartState::Delimiter;
+        break;
+      }
+
+      case PartState::Delimiter:
+        if (c.partBuf.size() < 2) return;
+        if (c.partBuf[0] == '-' && c.partBuf[1] == '-') {
+          c.part = PartState::End;
+        } else {
+          c.part = PartState::Headers;
+          c.partBuf.erase(c.partBuf.begin(), c.partBuf.begin() + 2);  // CRLF
+        }
+        break;
+
+      case PartState::Headers: {
+        long end = findBytes(c.partBuf, "\r\n\r\n", 4);
+        if (end == -1) {
+          if (c.partBuf.size() > CP_HTTP_HEADER_MAX) sendError(c, 431, "Part headers too large");
+          return;
+        }
+        String partHeaders((const char*)c.partBuf.data(), (size_t)end);
+        c.partBuf.erase(c.partBuf.begin(), c.partBuf.begin() + end + 4);
+        if (!startPart(c, partHeaders)) return;
+        c.part = PartState::Data;
+        break;
+      }
+
+      case PartState::Data: {
+        long pos = findBytes(c.partBuf, delim, delimLen);
+        if (pos == -1) {
+          // Keep enough bytes to recognise a delimiter that is split over two reads
+          if (c.partBuf.size() >= delimLen) {
+            size_t safe = c.partBuf.size() - (delimLen - 1);
+            partData(c, c.partBuf.data(), safe);
+            c.partBuf.erase(c.partBuf.begin(), c.partBuf.begin() + safe);
+          }
+          return;
+        }
+        partData(c, c.partBuf.data(), (size_t)pos);
+        if (c.state != State::Multipart) return;
+        c.partBuf.erase(c.partBuf.begin(), c.partBuf.begin() + pos + delimLen);
+        endPart(c);
+        c.part = PartState::Delimiter;
+        break;
+      }
+
+      case PartState::End:
+        c.partBuf.clear();
+        return;
+    }
+  }
+}
+
+bool AsyncHttpTransport::startPart(Connection& c, const String& partHeaders) {
+  String disposition, type;
+  int pos = 0;
+  while (pos < (int)partHeaders.length()) {
+    int end = partHeaders.indexOf("\r\n", pos);
+    if (end == -1) end = partHeaders.length();
+    String line = partHeaders.substring(pos, end);
+    int colon = line.indexOf(':');
+    if (colon != -1) {
+      String name = line.substring(0, colon);
+      String value = line.substring(colon + 1);
+      value.trim();
+      if (name.equalsIgnoreCase("Content-Disposition"))
+        disposition = value;
+      else if (name.equalsIgnoreCase("Content-Type"))
+        type = value;
+    }
+    pos = end + 2;
+  }
+
+  c.fieldName = headerParam(disposition, "name");
+  c.fieldValue = "";
+  c.filePart = disposition.indexOf("filename=") != -1;
+  if (!c.filePart || uploadOwner != &c) return true;  // Field, or a file nobody wants (discarded)
+
+  if (!c.upload) c.upload = new HTTPUpload();
+  c.upload->filename = headerParam(disposition, "filename");
+  c.upload->name = c.fieldName;
+  c.upload->type = type;
+  c.upload->totalSize = 0;
+  c.upload->currentSize = 0;
+  callUpload(c, UPLOAD_FILE_START);
+  return c.state == State::Multipart;
+}
+
+void AsyncHttpTransport::partData(Connection& c, const uint8_t* data, size_t len) {
+  if (!c.filePart) {
+    // Fields are kept in memory like a urlencoded body, a truncated value must not reach the handler
+    if (c.fieldValue.length() + len > c.bodyMax) {
+      sendError(c, 413, "Form field too large");
+      return;
+    }
+    c.fieldValue.concat((const char*)data, len);
+    return;
+  }
+  if (!c.upload || uploadOwner != &c) return;
+
+  // Hand the data to the upload handler in full HTTP_UPLOAD_BUFLEN pieces, like WebServer
+  while (len) {
+    size_t n = std::min(len, (size_t)HTTP_UPLOAD_BUFLEN - c.upload->currentSize);
+    memcpy(c.upload->buf + c.upload->currentSize, data, n);
+    c.upload->currentSize += n;
+    data += n;
+    len -= n;
+    if (c.upload->currentSize == HTTP_UPLOAD_BUFLEN) {
+      c.upload->totalSize += c.upload->currentSize;
+      callUpload(c, UPLOAD_FILE_WRITE);
+      c.upload->currentSize = 0;
+    }
+  }
+}
+
+void AsyncHttpTransport::endPart(Connection& c) {
+  if (!c.filePart) {
+    if (!c.fieldName.isEmpty()) c.args.push_back({c.fieldName, c.fieldValue});
+    c.fieldValue = "";
+    return;
+  }
+  if (!c.upload || uploadOwner != &c) return;
+
+  if (c.upload->currentSize) {
+    c.upload->totalSize += c.upload->currentSize;
+    callUpload(c, UPLOAD_FILE_WRITE);
+    c.upload->currentSize = 0;
+  }
+  callUpload(c, UPLOAD_FILE_END);
+  c.filePart = false;
+}
+
+void AsyncHttpTransport::callUpload(Connection& c, HTTPUploadStatus status) {
+  if (c.route == -1 || !routes[c.route].uploadHandler || !c.upload) return;
+  c.upload->status = status;
+  current = &c;
+  routes[c.route].uploadHandler();
+  current = nullptr;
+}
+
+void AsyncHttpTransport::dispatch(Connection& c) {
+  DPRINTF(0, "[AsyncHttpTransport::dispatch] %s", c.uri.c_str());
+  requests++;
+  c.state = State::Drain;
+  c.responseLength = CONTENT_LENGTH_NOT_SET;
+  current = &c;
+
+  if (c.contentLength == 0) c.route = findRoute(c.uri, c.method);  // Not looked up without a body
+
+  if (interceptor && interceptor->matches(c.uri))
+    interceptor->respond(this, c.uri);
+  else if (c.route != -1)
+    routes[c.route].handler();
+  else if (notFoundHandler)
+    notFoundHandler();
+  else
+    send(404, "text/plain", "Not found");
+
+  if (c.chunked && !c.finished) sendContent("", 0);  // Handler did not end the chunked response
+  current = nullptr;
+
+  // The client can only find the next response if this one ended where its framing says
+  bool framed = c.headersSent && (c.chunked ? c.finished : c.method == HTTP_HEAD || c.bodySent == c.responseLength);
+  if (c.headersSent && !framed) DPRINTF(2, "Response body does not match its Content-Length, closing connection");
+  bool reuse = c.keepAlive && framed && !c.broken;
+  c.served++;
+  resetRequest(c);
+  c.state = reuse ? State::Head : State::Drain;
+}
+
+void AsyncHttpTransport::resetRequest(Connection& c) {
+  c.method = HTTP_GET;
+  c.uri = "";
+  std::vector<Arg>().swap(c.args);
+  std::vector<Arg>().swap(c.headers);
+  c.contentType = "";
+  c.contentLength = 0;
+  c.bodyReceived = 0;
+  c.route = -1;
+  c.keepAlive = false;
+
+  c.delimiter = "";
+  c.part = PartState::Preamble;
+  c.filePart = false;
+  c.fieldName = "";
+  c.fieldValue = "";
+  std::vector<uint8_t>().swap(c.partBuf);
+  delete c.upload;
+  c.upload = nullptr;
+
+  c.responseHeaders = "";
+  c.responseLength = CONTENT_LENGTH_NOT_SET;
+  c.headersSent = false;
+  c.bodySent = 0;
+  c.chunked = false;
+  c.finished = false;
+}
+
+void AsyncHttpTransport::sendError(Connection& c, int code, const char* message) {
+  DPRINTF(2, "HTTP %d: %s", code, message);
+  c.state = State::Drain;  // The rest of the input cannot be parsed reliably
+  c.keepAlive = false;
+  c.responseLength = CONTENT_LENGTH_NOT_SET;
+  Connection* previous = current;
+  current = &c;
+  send(code, "text/plain", message);
+  current = previous;
+  if (uploadOwner == &c) {
+    if (c.filePart && c.upload) callUpload(c, UPLOAD_FILE_ABORTED);
+    uploadOwner = nullptr;
+  }
+}
+
+void AsyncHttpTransport::queue(Connection& c, const char* data, size_t len) {
+  if (c.broken) return;
+
+  // Nothing waiting: hand the data to the socket straight away
+  if (c.out.empty()) {
+    ssize_t n = ::send(c.fd, data, len, MSG_NOSIGNAL);
+    if (n < 0 && !wouldBlock()) {
+      c.broken = true;
+      return;
+    }
+    if (n > 0) {
+      data += n;
+      len -= n;
+      c.lastActivity = millis();
+    }
+  }
+
+  while (len) {
+    if (c.out.size() >= CP_HTTP_OUTPUT_LIMIT && !waitForRoom(c)) {
+      DPRINTF(2, "HTTP client too slow, dropping connection");
+      c.broken = true;
+      return;
+    }
+    size_t n = std::min(len, (size_t)CP_HTTP_OUTPUT_LIMIT - std::min(c.out.size(), (size_t)CP_HTTP_OUTPUT_LIMIT));
+    c.out.insert(c.out.end(), data, data + n);
+    data += n;
+    len -= n;
+  }
+}
+
+bool AsyncHttpTransport::waitForRoom(Connection& c) {
+  unsigned long start = millis();
+  while (true) {
+    if (!flushClient(c)) return false;
+    if (c.out.size() < CP_HTTP_OUTPUT_LIMIT) return true;
+    if (millis() - start >= CP_HTTP_TIMEOUT) return false;
+
+    // Wait until a socket can take more, and keep the output of the other connections flowing
+    fd_set writeSet;
+    FD_ZERO(&writeSet);
+    int maxFd = -1;
+    for (Connection* o : connections) {
+      if (o->broken || o->out.empty()) continue;
+      FD_SET(o->fd, &writeSet);
+      maxFd = std::max(maxFd, o->fd);
+    }
+    struct timeval tv = {0, 10000};
+    if (select(maxFd + 1, nullptr, &writeSet, nullptr, &tv) <= 0) continue;
+    for (Connection* o : connections) {
+      if (o != &c && !o->broken && FD_ISSET(o->fd, &writeSet) && !flushClient(*o)) o->broken = true;
+    }
+  }
+}
+
+bool AsyncHttpTransport::flushClient(Connection& c) {
+  while (!c.out.empty()) {
+    ssize_t n = ::send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+    if (n < 0) return wouldBlock();
+    if (n == 0) return true;
+    c.out.erase(c.out.begin(), c.out.begin() + n);
+    c.lastActivity = millis();
+  }
+  return true;
+}
+
+void AsyncHttpTransport::closeClient(size_t index) {
+  Connection* c = connections[index];
+  if (uploadOwner == c) {
+    if (c->filePart && c->upload) callUpload(*c, UPLOAD_FILE_ABORTED);  // Client went away during an upload
+    uploadOwner = nullptr;
+  }
+  close(c->fd);
+  delete c->upload;
+  delete c;
+  connections.erase(connections.begin() + index);
+}
+
+bool AsyncHttpTransport::isIdle(const Connection& c) const {
+  return c.state == State::Head && c.served > 0 && c.in.empty() && c.out.empty();
+}
+
+int AsyncHttpTransport::evictable() const {
+  // The longest idle persistent connection, else the oldest one that has not sent a byte yet
+  // (browsers open spare connections ahead of time)
+  int idle = -1;
+  int unused = -1;
+  for (size_t i = 0; i < connections.size(); i++) {
+    const Connection& c = *connections[i];
+    if (c.state != State::Head || !c.in.empty() || !c.out.empty()) continue;
+    int& best = c.served > 0 ? idle : unused;
+    if (best == -1 || c.lastActivity < connections[best]->lastActivity) best = (int)i;
+  }
+  return idle != -1 ? idle : unused;
+}
+
+void AsyncHttpTransport::setKeepAlive(uint32_t idleTimeoutMs, uint16_t maxRequestsPerConnection) {
+  idleTimeout = idleTimeoutMs;
+  maxRequests = maxRequestsPerConnection;
+}
+
+int AsyncHttpTransport::findRoute(const String& uri, HTTPMethod method) const {
+  for (size_t i = 0; i < routes.size(); i++) {
+    if (routes[i].uri == uri && (routes[i].method == HTTP_ANY || routes[i].method == method)) return (int)i;
+  }
+  return -1;
+}
+
+size_t AsyncHttpTransport::bodyLimit(const String& uri) const {
+  for (const BodyLimit& limit : bodyLimits) {
+    if (limit.uri == uri) return limit.maxBytes;
+  }
+  return CP_HTTP_BODY_MAX;
+}
+
+bool AsyncHttpTransport::isCollected(const String& name) const {
+  for (const String& key : headerKeys) {
+    if (key.equalsIgnoreCase(name)) return true;
+  }
+  return false;
+}
+
+void AsyncHttpTransport::on(const String& uri, HTTPMethod method, Handler handler, Handler uploadHandler) {
+  routes.push_back({uri, method, handler, uploadHandler});
+}
+
+void AsyncHttpTransport::onNotFound(Handler handler) {
+  notFoundHandler = handler;
+}
+
+void AsyncHttpTransport::setBodyLimit(const String& uri, size_t maxBytes) {
+  for (BodyLimit& limit : bodyLimits) {
+    if (limit.uri == uri) {
+      limit.maxBytes = maxBytes;
+      return;
+    }
+  }
+  bodyLimits.push_back({uri, maxBytes});
+}
+
+void AsyncHttpTransport::collectHeaders(const char* keys[], size_t count) {
+  headerKeys.clear();
+  for (size_t i = 0; i < count; i++) headerKeys.push_back(keys[i]);
+}
+
+String AsyncHttpTransport::uri() {
+  return current ? current->uri : String("");
+}
+
+HTTPMethod AsyncHttpTransport::method() {
+  return current ? current->method : HTTP_ANY;
+}
+
+HTTPUpload& AsyncHttpTransport::upload() {
+  static HTTPUpload none;
+  return (current && current->upload) ? *current->upload : none;
+}
+
+bool AsyncHttpTransport::hasArg(const String& name) {
+  if (!current) return false;
+  for (const Arg& a : current->args) {
+    if (a.name == name) return true;
+  }
+  return false;
+}
+
+String AsyncHttpTransport::arg(const String& name) {
+  if (!current) return "";
+  for (const Arg& a : current->args) {
+    if (a.name == name) return a.value;
+  }
+  return "";
+}
+
+bool AsyncHttpTransport::hasHeader(const String& name) {
+  if (!current) return false;
+  for (const Arg& h : current->headers) {
+    if (h.name.equalsIgnoreCase(name)) return true;
+  }
+  return false;
+}
+
+String AsyncHttpTransport::header(const String& name) {
+  if (!current) return "";
+  for (const Arg& h : current->headers) {
+    if (h.name.equalsIgnoreCase(name)) return h.value;
+  }
+  return "";
+}
+
+void AsyncHttpTransport::setContentLength(size_t length) {
+  if (current) current->responseLength = length;
+}
+
+void AsyncHttpTransport::sendHeader(const String& name, const String& value, bool first) {
+  if (!current || current->headersSent) return;
+  String line = name + ": " + value + "\r\n";
+  if (first)
+    current->responseHeaders = line + current->responseHeaders;
+  else
+    current->responseHeaders += line;
+}
+
+void AsyncHttpTransport::send(int code, const char* contentType, const String& content) {
+  if (!current) return;
+  Connection& c = *current;
+  if (c.headersSent) {
+    DPRINTF(2, "Response already sent, ignoring send(%d)", code);
+    return;
+  }
+
+  // 1xx, 204 and 304 end with the headers. Content-Length: 0 on a 304 would tell a cache
+  // the stored page is empty, so these get neither framing nor a content type
+  bool bodiless = (code >= 100 && code < 200) || code == 204 || code == 304;
+  size_t length = bodiless ? 0 : c.responseLength == CONTENT_LENGTH_NOT_SET ? content.length() : c.responseLength;
+  c.responseLength = length;
+  String head = "HTTP/1.1 " + String(code) + " " + reasonPhrase(code) + "\r\n";
+  if (contentType && *contentType && !bodiless) head += "Content-Type: " + String(contentType) + "\r\n";
+  if (length == CONTENT_LENGTH_UNKNOWN) {
+    c.chunked = true;
+    head += "Transfer-Encoding: chunked\r\n";
+  } else if (!bodiless) {
+    head += "Content-Length: " + String((unsigned long)length) + "\r\n";
+  }
+  head += c.responseHeaders;
+
+  // Keep the connection only while there are sockets to spare
+  c.keepAlive = c.keepAlive && maxRequests && c.served + 1 < maxRequests && connections.size() < maxClients;
+  if (c.keepAlive) {
+    char keepAlive[64];
+    snprintf(keepAlive, sizeof(keepAlive), "Connection: keep-alive\r\nKeep-Alive: timeout=%u, max=%u\r\n\r\n",
+             (unsigned)(idleTimeout / 1000), (unsigned)(maxRequests - c.served - 1));
+    head += keepAlive;
+  } else {
+    head += "Connection: close\r\n\r\n";
+  }
+  c.responseHeaders = "";
+  c.headersSent = true;
+
+  queue(c, head.c_str(), head.length());
+  if (content.length()) sendContent(content.c_str(), content.length());
+}
+
+void AsyncHttpTransport::sendContent(const char* data, size_t len) {
+  if (!current || !current->headersSent || current->finished) return;
+  Connection& c = *current;
+
+  if (c.method == HTTP_HEAD) {
+    c.finished = c.chunked && len == 0;  // Headers only, the client does not read a body
+    return;
+  }
+
+  if (!c.chunked) {
+    if (len > c.responseLength - c.bodySent) {
+      // More than the declared Content-Length would be read as the next response
+      DPRINTF(2, "Response body exceeds Content-Length %u, truncated", (unsigned)c.responseLength);
+      len = c.responseLength - c.bodySent;
+      c.keepAlive = false;
+    }
+    c.bodySent += len;
+    queue(c, data, len);
+    return;
+  }
+  if (len == 0) {
+    queue(c, "0\r\n\r\n", 5);
+    c.finished = true;
+    return;
+  }
+  char size[12];
+  int n = snprintf(size, sizeof(size), "%x\r\n", (unsigned)len);
+  queue(c, size, n);
+  queue(c, data, len);
+  queue(c, "\r\n", 2);
+}
@@ -9,15 +9,18 @@
 
 #include "CaptivePortal.h"
 #include "Config.h"
+#include "FileLister.h"
+#include "JsonWriter.h"
 #include "PageRenderer.h"
+#include "ResponseWriter.h"
 
 /**
  * @brief Construct a new CPHandlers object
  *
- * @param webServer Pointer to the WebServer instance
+ * @param webServer HTTP server (transport) the handlers respond on
  * @param portal Pointer to the CaptivePortal instance
  */
-CPHandlers::CPHandlers(WebServer* webServer, CaptivePortal* portal) : s_webServer(webServer), s_portal(portal) {
+CPHandlers::CPHandlers(HttpTransport* webServer, CaptivePortal* portal) : s_webServer(webServer), s_portal(portal) {
   DPRINTF(0, "[CPHandlers::CPHandlers]");
 }
 
@@ -81,7 +84,7 @@ bool CPHandlers::requireAuth() {
  */
 void CPHandlers::handleRoot() {
   DPRINTF(0, "[CPHandlers::handleRoot]");
-  s_webServer->send(200, contentType.texthtml, loadFile(s_portal->getWebFileSystem(), "/login.html"));
+  serveFile(s_webServer, s_portal->getWebFileSystem(), "/login.html", contentType.texthtml, 200, &s_portal->getETagCache(), &s_portal->getFileCache());
 }
 
 /**
@@ -94,12 +97,19 @@ void CPHandlers::handleLogin() {
     return;
   }
 
-  if (s_webServer->arg("user") == s_portal->Settings.AdminUser && s_webServer->arg("pass") == s_portal->Settings.AdminPassword) {
+  bool valid, defaultPass;
+  {
+    PortalLock lock(s_portal->getMutex());
+    valid = s_webServer->arg("user") == s_portal->Settings.AdminUser && s_webServer->arg("pass") == s_portal->Settings.AdminPassword;
+    defaultPass = s_webServer->arg("pass") == s_portal->Settings.DefaultPassword;
+  }
+
+  if (valid) {
     String sid = s_portal->createSession();
     DPRINTF(0, "Login successful, creating sessionId: %s", sid.c_str());
     s_webServer->sendHeader("Set-Cookie", "sessionId=" + sid + "; Path=/;");
-    if (s_webServer->arg("pass") == s_portal->Settings.DefaultPassword) {
-      s_webServer->send(200, contentType.texthtml, loadFile(s_portal->getWebFileSystem(), "/defaultpass_prompt.html"));
+    if (defaultPass) {
+      serveFile(s_webServer, s_portal->getWebFileSystem(), "/defaultpass_prompt.html", contentType.texthtml, 200, nullptr, &s_portal->getFileCache());
     } else {
       s_webServer->sendHeader("Location", "/home");
       s_webServer->send(302, contentType.textplain, "Redirecting...");
@@ -129,7 +139,13 @@ void CPHandlers::handleUpdateDeviceName() {
   String name = doc["name"] | "";
   name.trim();
 
-  if (!s_portal->Settings.setDeviceName(name)) {
+  // Accepted in memory and written back later, report a flash that refuses writes
+  bool saved;
+  {
+    PortalLock lock(s_portal->getMutex());
+    saved = s_portal->Settings.setDeviceName(name) && !s_portal->Settings.writeFailed();
+  }
+  if (!saved) {
     s_webServer->send(500, "application/json", "{\"error\":\"Failed to save\"}");
     return;
   }
@@ -154,9 +170,13 @@ void CPHandlers::handleUpdatePass() {
     return;
   }
 
-  s_portal->Settings.AdminPassword = s_webServer->arg("newpass");
-  s_portal->Settings.save();
+  {
+    PortalLock lock(s_portal->getMutex());
+    s_portal->Settings.AdminPassword = s_webServer->arg("newpass");
+    s_portal->Settings.save();
+  }
 
+  s_portal->revokeAllSessions();  // Log out other clients too
   handleLogout();
 }
 
@@ -166,27 +186,27 @@ void CPHandlers::handleUpdatePass() {
 void CPHandlers::handleHome() {
   DPRINTF(0, "[CPHandlers::handleHome]");
   if (!requireAuth()) return;
-  streamPageWithMenu(s_webServer, s_portal->getWebFileSystem(), "/home.html", "home", "Home");
+  streamPageWithMenu(s_webServer, s_portal->getWebFileSystem(), s_portal->getMenuTemplate(), "/home.html", "home", "Home", &s_portal->getETagCache(), &s_portal->getTemplateVars(), &s_portal->getFileCache());
 }
 
 void CPHandlers::handleEdit() {
   DPRINTF(0, "[CPHandlers::handleEdit]");
   if (!requireAuth()) return;
-  streamPageWithMenu(s_webServer, s_portal->getWebFileSystem(), "/edit.html", "edit", "Edit");
+  streamPageWithMenu(s_webServer, s_portal->getWebFileSystem(), s_portal->getMenuTemplate(), "/edit.html", "edit", "Edit", &s_portal->getETagCache(), &s_portal->getTemplateVars(), &s_portal->getFileCache());
 }
 
 void CPHandlers::handleDevices() {
   DPRINTF(0, "[CPHandlers::handleDevices]");
   if (!requireAuth()) return;
   noCache();
-  streamPageWithMenu(s_webServer, s_portal->getWebFileSystem(), "/devices.html", "devices", "Devices");
+  streamPageWithMenu(s_webServer, s_portal->getWebFileSystem(), s_portal->getMenuTemplate(), "/devices.html", "devices", "Devices", nullptr, &s_portal->getTemplateVars(), &s_portal->getFileCache());
 }
 
 void CPHandlers::handleSystem() {
   DPRINTF(0, "[CPHandlers::handleSystem]");
   if (!requireAuth()) return;
   noCache();
-  streamPageWithMenu(s_webServer, s_portal->getWebFileSystem(), "/system.html", "system", "System");
+  streamPageWithMenu(s_webServer, s_portal->getWebFileSystem(), s_portal->getMenuTemplate(), "/system.html", "system", "System", nullptr, &s_portal->getTemplateVars(), &s_portal->getFileCache());
 }
 
 /**
@@ -220,6 +240,8 @@ void CPHandlers::handleLogout() {
 void CPHandlers::handleReboot() {
   DPRINTF(0, "[CPHandlers::handleReboot]");
   if (!requireAuth()) return;
+  PortalLock lock(s_portal->getMutex());  // Held until the restart
+  s_portal->Settings.flush();             // Write pending config changes before restarting
   espResetUtil::espReset(s_portal->Settings.LedPin, s_portal->Settings.HasRgbLed, s_portal->Settings.RgbBrightness);
 }
 
@@ -230,7 +252,7 @@ void CPHandlers::handleFactoryReset() {
   DPRINTF(0, "[CPHandlers::handleFactoryReset]");
   if (!requireAuth()) return;
   handleLogout();
-  s_portal->Settings.resetToFactoryDefault();
+  s_portal->factoryReset();
 }
 
 /**
@@ -241,7 +263,7 @@ void CPHandlers::handleCaptive() {
 
   // DPRINTF(1, "URI: %s", _webServer->uri().c_str());
 
-  s_webServer->sendHeader("Location", String("http://") + WiFi.softAPIP().toString() + "/");
+  s_webServer->sendHeader("Location", s_portal->getProbes().portalUrl());
   s_webServer->send(302, contentType.textplain, "");
 }
 
@@ -280,32 +302,84 @@ void CPHandlers::handleFirmwareUpdateDone() {
     s_webServer->send(500, contentType.textplain, "Update failed!");
   } else {
     s_webServer->send(200, contentType.textplain, "Update successful. Rebooting...");
+    PortalLock lock(s_portal->getMutex());  // Held until the restart
+    s_portal->Settings.flush();             // Write pending config changes before restarting
     delay(3000);
     ESP.restart();
   }
 }
 
 /**
- * @brief Lists files in FSYS as a JSON array.
+ * @brief Lists a directory of the settings or web file system, page by page.
+ *
+ * GET /listfiles?fs=settings|web&dir=/&recursive=1&after=<path>&limit=<n>
+ *   -> {"fs":"settings","dir":"/","files":[{"name":"/config.json","size":412,"dir":false}, ...],"next":"/config.json"}
+ *
+ * next is the after value for the following page, null on the last page. An after
+ * entry that no longer exists gives 409, the client should start again.
  */
 void CPHandlers::handleListFiles() {
   DPRINTF(0, "[CPHandlers::handleListFiles]");
   if (!requireAuth()) return;
-  String json = "[";
-  File root = s_portal->getSettingsFileSystem().open("/");
-  if (root && root.isDirectory()) {
-    File file = root.openNextFile();
-    bool first = true;
-    while (file) {
-      if (!first) json += ",";
-      json += "\"" + String(file.name()) + "\"";
-      first = false;
-      file = root.openNextFile();
-    }
+
+  bool web = s_webServer->arg("fs") == "web";
+  fs::LittleFSFS& fileSystem = web ? s_portal->getWebFileSystem() : s_portal->getSettingsFileSystem();
+  String dir = s_webServer->hasArg("dir") ? s_webServer->arg("dir") : "/";
+  if (!dir.startsWith("/")) dir = "/" + dir;
+  String after = s_webServer->arg("after");
+  long limit = s_webServer->hasArg("limit") ? s_webServer->arg("limit").toInt() : CP_LIST_LIMIT;
+  if (limit < 1) limit = CP_LIST_LIMIT;
+  if (limit > CP_LIST_LIMIT_MAX) limit = CP_LIST_LIMIT_MAX;
+
+  // A MessagePack settings file is listed and edited as ConfigFile (JSON)
+  String configFile, settingsFile;
+  {
+    PortalLock lock(s_portal->getMutex());
+    configFile = s_portal->Settings.ConfigFile;
+    settingsFile = s_portal->Settings.storageFile();
   }
-  json += "]";
+  bool mapped = !web && settingsFile != configFile;
+  if (mapped && after == configFile) after = settingsFile;
+
+  File root = fileSystem.open(dir);
+  if (!root || !root.isDirectory()) {
+    s_webServer->send(404, contentType.textplain, "Directory not found");
+    return;
+  }
+  root.close();
+  if (after.length() && !fileSystem.exists(after)) {
+    s_webServer->send(409, contentType.textplain, "Listing changed, start again");
+    return;
+  }
+
   noCache();
-  s_webServer->send(200, "application/json", json);
+  ResponseWriter out(s_webServer);
+  out.begin(200, "application/json");
+  JsonWriter json(out);
+  json.beginObject();
+  json.member("fs", web ? "web" : "settings");
+  json.member("dir", dir);
+  json.key("files");
+  json.beginArray();
+  FileLister lister(fileSystem, s_webServer->arg("recursive") == "1");
+  bool ok = lister.list(dir.c_str(), after.c_str(), (size_t)limit, [&](const FileEntry& entry) {
+    json.beginObject();
+    json.member("name", mapped && settingsFile.equals(entry.path) ? configFile.c_str() : entry.path);
+    json.member("size", (unsigned long)entry.size);
+    json.member("dir", entry.dir);
+    json.endObject();
+  });
+  json.endArray();
+  json.key("next");
+  if (!lister.hasMore())
+    json.null();
+  else if (mapped && settingsFile.equals(lister.next()))
+    json.value(configFile);
+  else
+    json.value(lister.next());
+  if (!ok) json.member("error", "after is not an entry below dir");
+  json.endObject();
+  out.end();
 }
 
 /**
@@ -321,6 +395,18 @@ void CPHandlers::handleEditFileGet() {
   String name = s_webServer->arg("name");
   if (!name.startsWith("/")) name = "/" + name;  // <-- fix
 
+  // The settings are shown as JSON, whatever the storage format
+  String json;
+  {
+    PortalLock lock(s_portal->getMutex());
+    if (name.equals(s_portal->Settings.ConfigFile)) json = s_portal->Settings.toJson();
+  }
+  if (json.length()) {
+    noCache();
+    s_webServer->send(200, contentType.textplain, json);
+    return;
+  }
+
   File file = s_portal->getSettingsFileSystem().open(name, "r");
   if (!file) {
     s_webServer->send(404, contentType.textplain, "File not found");
@@ -346,6 +432,23 @@ void CPHandlers::handleEditFilePost() {
   if (!name.startsWith("/")) name = "/" + name;  // <-- fix
 
   String content = s_webServer->arg("content");
+  bool configFile, stored = false;
+  {
+    PortalLock lock(s_portal->getMutex());
+    configFile = name.equals(s_portal->Settings.ConfigFile);
+    if (configFile) stored = s_portal->Settings.fromJson(content);
+  }
+  if (configFile) {
+    // Stored in the configured format, an invalid edit leaves the settings untouched
+    if (!stored) {
+      s_webServer->send(400, contentType.textplain, "Invalid JSON, file not saved");
+      return;
+    }
+    noCache();
+    s_webServer->send(200, contentType.textplain, "File saved!");
+    return;
+  }
+
   File file = s_portal->getSettingsFileSystem().open(name, "w");
   if (!file) {
     s_webServer->send(500, contentType.textplain, "Could not open file for writing");
@@ -353,8 +456,7 @@ void CPHandlers::handleEditFilePost() {
   }
   file.print(content);
   file.close();
-  if (name.equals(s_portal->Settings.ConfigFile))
-    s_portal->Settings.loadConfig();  // Reload config after edit
+  s_portal->invalidateAsset(s_portal->getSettingsFileSystem(), name);  // Only if that is the web file system too
 
   noCache();
   s_webServer->send(200, contentType.textplain, "File saved!");
@@ -412,33 +514,47 @@ void CPHandlers::handleWiFiScan() {
 
   // r >= 0 -> results ready
   DPRINTF(1, "WiFi.scanComplete -> %d networks", r);
-  String json = "[";
-  for (int i = 0; i < r; ++i) {
-    if (i) json += ",";
-    bool secure = WiFi.encryptionType(i) != WIFI_AUTH_OPEN;
-    json += "{";
-    json += "\"ssid\":\"" + jsonEscape(String(WiFi.SSID(i))) + "\",";
-    json += "\"rssi\":" + String(WiFi.RSSI(i)) + ",";
-    json += "\"channel\":" + String(WiFi.channel(i)) + ",";
-    json += "\"secure\":" + String(secure ? "true" : "false");
-    json += "}";
+  {
+    // Streamed from the scan records, no copy of the SSIDs
+    ResponseWriter out(s_webServer);
+    out.begin(200, "application/json");
+    JsonWriter json(out);
+    json.beginArray();
+    for (int i = 0; i < r; ++i) {
+      const wifi_ap_record_t* ap = (const wifi_ap_record_t*)WiFi.getScanInfoByIndex(i);
+      if (!ap) continue;
+      json.beginObject();
+      json.key("ssid");
+      json.value((const char*)ap->ssid, strnlen((const char*)ap->ssid, sizeof(ap->ssid)));
+      json.member("rssi", (int)ap->rssi);
+      json.member("channel", (int)ap->primary);
+      json.member("secure", ap->authmode != WIFI_AUTH_OPEN);
+      json.endObject();
+    }
+    json.endArray();
+    out.end();
   }
-  json += "]";
 
   WiFi.scanDelete();  // free results
 
   // We blijven in AP+STA; dat is robuuster voor herhaalde scans
-  s_webServer->send(200, "application/json", json);
 }
 
 void CPHandlers::handleDeviceNameGet() {
   if (!requireAuth()) return;
 
-  JsonDocument doc;
-  doc["name"] = s_portal->Settings.DeviceName != "" ? s_portal->Settings.DeviceName : s_portal->Settings.DeviceHostname;
-  String out;
-  serializeJson(doc, out);
-  s_webServer->send(200, "application/json", out);
+  String name;
+  {
+    PortalLock lock(s_portal->getMutex());
+    name = s_portal->Settings.DeviceName != "" ? s_portal->Settings.DeviceName : s_portal->Settings.DeviceHostname;
+  }
+  ResponseWriter out(s_webServer);
+  out.begin(200, "application/json");
+  JsonWriter json(out);
+  json.beginObject();
+  json.member("name", name);
+  json.endObject();
+  out.end();
 }
 
 /**
@@ -450,43 +566,3 @@ void CPHandlers::noCache() {
   s_webServer->sendHeader("Pragma", "no-cache");
   s_webServer->sendHeader("Expires", "0");
 }
-
-String CPHandlers::jsonEscape(const String& in) {
-  String out;
-  for (size_t i = 0; i < in.length(); ++i) {
-    char c = in[i];
-    switch (c) {
-      case '\"':
-        out += "\\\"";
-        break;
-      case '\\':
-        out += "\\\\";
-        break;
-      case '\b':
-        out += "\\b";
-        break;
-      case '\f':
-        out += "\\f";
-        break;
-      case '\n':
-        out += "\\n";
-        break;
-      case '\r':
-        out += "\\r";
-        break;
-      case '\t':
-        out += "\\t";
-        break;
-      default:
-        if ((uint8_t)c < 0x20) {
-          // Control character as \u00XX
-          char buf[7];
-          snprintf(buf, sizeof(buf), "\\u%04X", (uint8_t)c);
-          out += buf;
-        } else {
-          out += c;
-        }
-    }
-  }
-  return out;
-}
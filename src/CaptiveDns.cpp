@@ -0,0 +1,156 @@
+#include "CaptiveDns.h"
+
+#include <dprintf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef ESP32
+  #include <lwip/sockets.h>
+#else
+  #include <netinet/in.h>
+  #include <sys/socket.h>
+#endif
+
+#define DNS_HEADER_SIZE 12
+#define DNS_FLAG_QR 0x80      // Byte 2: response
+#define DNS_FLAG_AA 0x04      // Byte 2: authoritative answer
+#define DNS_FLAG_RD 0x01      // Byte 2: recursion desired
+#define DNS_FLAG_RA 0x80      // Byte 3: recursion available
+#define DNS_OPCODE_MASK 0x78  // Byte 2
+#define DNS_RCODE_FORMERR 1
+#define DNS_RCODE_NOTIMP 4
+
+#define DNS_TYPE_A 1
+#define DNS_TYPE_AAAA 28
+#define DNS_TYPE_SVCB 64
+#define DNS_TYPE_HTTPS 65
+#define DNS_TYPE_ANY 255
+#define DNS_CLASS_IN 1
+
+CaptiveDns::~CaptiveDns() {
+  stop();
+}
+
+bool CaptiveDns::start(uint16_t port, const IPAddress& ip) {
+  DPRINTF(0, "[CaptiveDns::start] port %u, %s", (unsigned)port, ip.toString().c_str());
+  stop();
+  setAddress(ip);
+  counters = CaptiveDnsStats();
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    DPRINTF(3, "DNS socket() failed: %d", errno);
+    return false;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    DPRINTF(3, "DNS bind() on port %u failed: %d", (unsigned)port, errno);
+    stop();
+    return false;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  return true;
+}
+
+void CaptiveDns::setAddress(const IPAddress& ip) {
+  uint8_t bytes[4] = {ip[0], ip[1], ip[2], ip[3]};
+  uint32_t packed;
+  memcpy(&packed, bytes, 4);
+  address = packed;  // One atomic store, process() never sees half an address
+}
+
+void CaptiveDns::stop() {
+  if (fd < 0) return;
+  close(fd);
+  fd = -1;
+}
+
+size_t CaptiveDns::process(size_t budget) {
+  if (fd < 0) return 0;
+
+  size_t handled = 0;
+  while (handled < budget) {
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    ssize_t len = recvfrom(fd, packet, CP_DNS_PACKET_SIZE, 0, (struct sockaddr*)&from, &fromLen);
+    if (len < 0) break;  // Nothing pending (EAGAIN) or socket error
+    handled++;
+    counters.queries++;
+
+    size_t out = buildResponse((size_t)len);
+    if (!out) {
+      counters.dropped++;
+      continue;
+    }
+    if (sendto(fd, packet, out, 0, (struct sockaddr*)&from, fromLen) != (ssize_t)out) counters.dropped++;
+  }
+  if (handled) counters.batches++;
+  return handled;
+}
+
+size_t CaptiveDns::buildResponse(size_t len) {
+  if (len < DNS_HEADER_SIZE || (packet[2] & DNS_FLAG_QR)) return 0;  // Too short, or not a query
+
+  uint16_t qdCount = (packet[4] << 8) | packet[5];
+  uint8_t opcode = packet[2] & DNS_OPCODE_MASK;
+
+  // Response header: keep ID, opcode and RD, no authority/additional records
+  packet[2] = (packet[2] & (DNS_OPCODE_MASK | DNS_FLAG_RD)) | DNS_FLAG_QR | DNS_FLAG_AA;
+  packet[3] = DNS_FLAG_RA;
+  memset(packet + 6, 0, 6);  // ANCOUNT, NSCOUNT, ARCOUNT
+
+  if (opcode != 0 || qdCount != 1) {
+    // Only standard queries with one question; answer with the header only
+    packet[3] |= (opcode != 0) ? DNS_RCODE_NOTIMP : DNS_RCODE_FORMERR;
+    packet[4] = packet[5] = 0;
+    return DNS_HEADER_SIZE;
+  }
+
+  // Walk the question name (no compression allowed here)
+  size_t pos = DNS_HEADER_SIZE;
+  while (pos < len && packet[pos] != 0) {
+    if (packet[pos] & 0xC0) return 0;
+    pos += packet[pos] + 1;
+  }
+  if (pos + 5 > len) return 0;  // Name terminator plus QTYPE and QCLASS
+  pos++;
+  uint16_t qType = (packet[pos] << 8) | packet[pos + 1];
+  uint16_t qClass = (packet[pos + 2] << 8) | packet[pos + 3];
+  pos += 4;  // End of the question, anything after it (EDNS) is dropped
+
+  if ((qType != DNS_TYPE_A && qType != DNS_TYPE_ANY) || qClass != DNS_CLASS_IN) {
+    if (qType == DNS_TYPE_AAAA)
+      counters.emptyAAAA++;
+    else if (qType == DNS_TYPE_HTTPS || qType == DNS_TYPE_SVCB)
+      counters.emptyHttps++;
+    else
+      counters.emptyOther++;
+    return pos;  // NOERROR without records
+  }
+
+  // One A record, name as a pointer to the question
+  uint8_t* a = packet + pos;
+  a[0] = 0xC0;
+  a[1] = DNS_HEADER_SIZE;
+  a[2] = 0;
+  a[3] = DNS_TYPE_A;
+  a[4] = 0;
+  a[5] = DNS_CLASS_IN;
+  uint32_t seconds = ttl;
+  uint32_t ip = address;
+  a[6] = seconds >> 24;
+  a[7] = seconds >> 16;
+  a[8] = seconds >> 8;
+  a[9] = seconds;
+  a[10] = 0;
+  a[11] = 4;
+  memcpy(a + 12, &ip, 4);
+  packet[7] = 1;  // ANCOUNT
+  counters.answersA++;
+  return pos + CP_DNS_ANSWER_SIZE;
+}
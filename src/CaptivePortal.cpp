@@ -5,12 +5,58 @@
 #include <WiFi.h>
 #include <dprintf.h>
 
+#include "EmbeddedAssets.h"
+
 #ifdef BROWNOUT_HACK
   #include "soc/rtc_cntl_reg.h"
   #include "soc/soc.h"
 #endif
 
 #define DNS_PORT 53
+#define SESSION_SWEEP_INTERVAL 60000UL  // Remove expired sessions once a minute
+
+/**
+ * @brief Performs the actions of the SettingsApplier on the running portal.
+ */
+class PortalApplyTarget : public SettingsApplier::Target {
+ public:
+  explicit PortalApplyTarget(CaptivePortal& portal) : portal(portal) {}
+
+  void setTimezone(const String& timezone) override {
+    setenv("TZ", timezone.c_str(), 1);
+    tzset();
+  }
+
+  void setupLed(const AppliedSettings& before, const AppliedSettings& after) override {
+    if (before.ledPin != after.ledPin) {
+      digitalWrite(before.ledPin, LOW);
+      pinMode(before.ledPin, INPUT);  // Release the old pin
+    }
+    pinMode(after.ledPin, OUTPUT);
+  }
+
+  void setupResetPin(uint8_t before, uint8_t after) override {
+    pinMode(before, INPUT);
+    pinMode(after, INPUT_PULLUP);
+  }
+
+  bool restartAccessPoint(const AppliedSettings& settings) override {
+    if (!(WiFi.getMode() & WIFI_AP)) {
+      DPRINTF(1, "SoftAP not running, nothing to reconfigure");
+      return true;
+    }
+    DPRINTF(1, "Reconfiguring SoftAP: %s", settings.ssid.c_str());
+    bool ok = WiFi.softAPConfig(settings.ip, settings.ip, settings.mask) &&
+              WiFi.softAP(settings.ssid.c_str(), settings.password.c_str());
+    IPAddress ip = WiFi.softAPIP();
+    portal.dnsServer->setAddress(ip);  // The DNS socket stays open
+    portal.probes.build(ip);
+    return ok;
+  }
+
+ private:
+  CaptivePortal& portal;
+};
 
 /**
  * @brief CaptivePortal set Device configuration and the web file system
@@ -22,13 +68,25 @@ CaptivePortal::CaptivePortal(CaptivePortalConfig& config,
                              fs::LittleFSFS& fileSystem, /* Use LittleFS if you run: pio run --target uploadfs */
                              bool formatOnFail, const char* basePath,
                              uint8_t maxOpenFiles, const char* partitionLabel)
-    : Settings(config), webFileSystem(fileSystem), fmtOnFail(formatOnFail), basePth(basePath), maxOpenFs(maxOpenFiles), partLbl(partitionLabel) {
+    : Settings(config), webFileSystem(fileSystem), fmtOnFail(formatOnFail), basePth(basePath), maxOpenFs(maxOpenFiles), partLbl(partitionLabel), assetETags(fileSystem) {
   DPRINTF(0, "[CaptivePortal::CaptivePortal]");
+  setupTemplateVars();
 }
 
 CaptivePortal::~CaptivePortal() {
   DPRINTF(0, "[CaptivePortal::~CaptivePortal]");
 
+  // Stop service tasks before their servers are deleted. Each one gets CP_TASK_STOP_TIMEOUT;
+  // a task stuck in a handler is deleted, and the servers it was using are leaked
+  if (!stopTasks()) {
+    DPRINTF(3, "Service task did not stop, deleting it and leaking the servers");
+    dnsTask.kill();
+    httpTask.kill();
+    cpHandlers = nullptr;
+    webServer = nullptr;
+    dnsServer = nullptr;
+  }
+
   // Stop AP
   if (dnsServer) dnsServer->stop();
   if (webServer) webServer->stop();
@@ -96,6 +154,12 @@ void CaptivePortal::begin(const char* ssid) {
     DPRINTF(0, "  %d file(s)..", cnt);
   }
 
+  // Parse the tab menu once instead of on every page request
+  if (!menuTemplate.compile(webFileSystem, "/tabmenu.html")) {
+    DPRINTF(2, "Menu template /tabmenu.html not found");
+  }
+  assetETags.begin();  // Hash all web files for conditional GETs
+
   // Only update hostname in config if SSID has changed
   if (!Settings.DeviceHostname.equals(ssid)) {
     DPRINTF(0, "SSID changed, updating hostname in config to '%s'", ssid);
@@ -111,10 +175,10 @@ void CaptivePortal::begin(const char* ssid) {
 
   // Check if reset button is held
   if (espResetUtil::factoryResetRequest(Settings.ResetPin, Settings.LedPin, Settings.HasRgbLed, Settings.RgbBrightness)) {
-    Settings.resetToFactoryDefault();  // Reset to factory defaults
+    factoryReset();  // Reset to factory defaults
   }
 
-  static const char* headerKeys[] = {"Cookie", "Authorization"};
+  static const char* headerKeys[] = {"Cookie", "Authorization", "Accept-Encoding", "If-None-Match"};
   if (webServer) {
     webServer->collectHeaders(headerKeys, sizeof(headerKeys) / sizeof(headerKeys[0]));
     setupHandlers();  // Register all route handlers
@@ -138,7 +202,8 @@ bool CaptivePortal::start() {
   if (!webServer || !dnsServer) return false;
 
   bool wifi_ok = setupWiFi();                                      // Start SoftAP
-  bool dns_ok = dnsServer->start(DNS_PORT, "*", WiFi.softAPIP());  // Start DNS redirector
+  bool dns_ok = dnsServer->start(DNS_PORT, WiFi.softAPIP());  // Start DNS redirector
+  probes.build(WiFi.softAPIP());                               // Probe answers for this AP address
 
   if (!wifi_ok || !dns_ok) {
     DPRINTF(3, "WiFi.softAP failed");
@@ -146,7 +211,20 @@ bool CaptivePortal::start() {
     return false;
   }
 
+  // A new key needs the RF noise behind esp_fill_random(), so only create it with WiFi running
+  if (sessionMode == SessionMode::Signed && !sessionTokens.ready() && !sessionTokens.begin(Settings.fileSystem)) {
+    DPRINTF(3, "Session key not available, falling back to stored sessions");
+    sessionMode = SessionMode::Stored;
+  }
+
   webServer->begin();  // Start web server
+
+  if (threaded) {
+    CaptiveDns* dns = dnsServer;
+    dnsTask.start("cp_dns", [dns]() { dns->process(); }, dnsTaskConfig);
+    HttpTransport* http = webServer;
+    httpTask.start("cp_http", [http]() { http->handleClient(); }, httpTaskConfig);  // Handlers lock what they share
+  }
   DPRINTF(1,
           "Captive Portal SSID started\n\t"
           "Connect WiFi to: %s\n\t"
@@ -154,6 +232,7 @@ bool CaptivePortal::start() {
           Settings.getEffectiveDeviceName().c_str(), WiFi.softAPIP().toString().c_str());
 
   blinkLedOnPin(Settings.LedPin, 3, 1000, Settings.HasRgbLed, Settings.RgbBrightness);  // Indicate setup completion
+  applier.begin(Settings);  // Everything is applied now
   running = true;
   return true;
 }
@@ -168,6 +247,12 @@ bool CaptivePortal::stop() {
   DPRINTF(0, "CaptivePortal::stop");
   if (!running) return true;
 
+  // Stop service tasks (returns immediately when called from an HTTP handler)
+  if (!stopTasks()) {
+    DPRINTF(3, "Service task did not stop, servers left running");
+    return false;
+  }
+
   // Stop servers first
   if (dnsServer) dnsServer->stop();
   if (webServer) webServer->stop();
@@ -185,13 +270,19 @@ bool CaptivePortal::stop() {
   return true;
 }
 
+bool CaptivePortal::stopTasks() {
+  bool dnsStopped = dnsTask.stop();
+  bool httpStopped = httpTask.stop();
+  return dnsStopped && httpStopped;
+}
+
 /**
  * @brief Loads configuration from LittleFS or creates defaults.
  */
 bool CaptivePortal::loadConfig() {
   if (!Settings.begin()) {
     DPRINTF(3, "Failed to load configuration.");
-    return Settings.save(true);  // save default values
+    return Settings.save(true) && Settings.flush();  // save default values now
   }
   return true;
 }
@@ -233,7 +324,10 @@ bool CaptivePortal::checkFactoryResetMarker() {
 void CaptivePortal::setupHandlers() {
   cpHandlers = new CPHandlers(webServer, this);
 
-  webServer->serveStatic("/styles.css", webFileSystem, "/styles.css");
+  // OS connectivity checks are the bulk of the requests, answered before the route table
+  probes.install(webServer, [this]() { this->onHttpRequest(); });
+
+  webServer->on("/styles.css", HTTP_GET, [this]() { serveFile(webServer, webFileSystem, "/styles.css", "text/css", 200, &assetETags, &fileCache); });
 
   webServer->on("/", HTTP_GET, [this]() {this->onHttpRequest(); cpHandlers->handleRoot(); });
   webServer->on("/login", HTTP_POST, [this]() {this->onHttpRequest(); cpHandlers->handleLogin(); });
@@ -249,14 +343,12 @@ void CaptivePortal::setupHandlers() {
   webServer->on("/listfiles", HTTP_GET, [this]() {this->onHttpRequest(); cpHandlers->handleListFiles(); });
   webServer->on("/editfile", HTTP_GET, [this]() {this->onHttpRequest(); cpHandlers->handleEditFileGet(); });
   webServer->on("/editfile", HTTP_POST, [this]() {this->onHttpRequest(); cpHandlers->handleEditFilePost(); });
+  webServer->setBodyLimit("/editfile", CP_EDIT_BODY_MAX);  // edit.html posts whole files urlencoded
   webServer->on("/wifiscan", HTTP_GET, [this]() {this->onHttpRequest(); cpHandlers->handleWiFiScan(); });
   webServer->on("/devicename", HTTP_GET, [this]() {this->onHttpRequest(); cpHandlers->handleDeviceNameGet(); });
   webServer->on("/updatedevicename", HTTP_POST, [this]() {this->onHttpRequest(); cpHandlers->handleUpdateDeviceName(); });
 
   // Redirect all other requests to captive portal
-  webServer->on("/generate_204", HTTP_GET, [this]() { webServer->send(204, "text/plain", ""); });
-  webServer->on("/fwlink", [this]() {this->onHttpRequest(); cpHandlers->handleCaptive(); });
-  webServer->on("/hotspot-detect.html", [this]() {this->onHttpRequest(); cpHandlers->handleCaptive(); });
   webServer->onNotFound([this]() {this->onHttpRequest(); cpHandlers->handleCaptive(); });
 }
 
@@ -266,29 +358,44 @@ void CaptivePortal::setupHandlers() {
 void CaptivePortal::handle() {
   if (!running) return;
 
-  dnsServer->processNextRequest();
-  webServer->handleClient();
+  if (!threaded) {
+    dnsServer->process();  // All pending queries, up to CP_DNS_BUDGET
+    webServer->handleClient();
+  }
+
+  if (millis() - lastSessionSweep >= SESSION_SWEEP_INTERVAL) {
+    lastSessionSweep = millis();
+    PortalLock lock(portalMutex);
+    size_t removed = sessions.sweep();
+    if (removed) DPRINTF(0, "Removed %d expired session(s)", (int)removed);
+  }
+
+  if (Settings.isDirty()) {
+    PortalLock lock(portalMutex);
+    Settings.handle();  // Delayed config write-back
+  }
+
+  if (hotApply && applier.hasChanges(Settings)) {
+    PortalLock lock(portalMutex);
+    PortalApplyTarget target(*this);
+    applier.apply(Settings, target);
+  }
 
   if (digitalRead(Settings.ResetPin) == LOW) {
     DPRINTF(2, "[Loop] Reset button pressed during runtime");
+    Settings.flush();
     espResetUtil::espReset(Settings.LedPin, Settings.HasRgbLed, Settings.RgbBrightness);
   }
 }
 
 /**
- * @brief Creates a new session ID and stores it with an expiry timestamp.
+ * @brief Creates a new session ID and stores it with its creation timestamp.
  */
 String CaptivePortal::createSession() {
   DPRINTF(0, "[CaptivePortal::createSession]");
-  char buf[33];
-  for (int i = 0; i < 32; i++) {
-    uint8_t r = (uint8_t)esp_random() % 16;
-    buf[i] = "0123456789abcdef"[r];
-  }
-  buf[32] = 0;
-  String sid(buf);
-  validSessions[sid] = millis() + sessionTimeout * 1000UL;
-  return sid;
+  PortalLock lock(portalMutex);
+  if (sessionMode == SessionMode::Signed) return sessionTokens.issue(sessionTimeout);
+  return sessions.create();
 }
 
 /**
@@ -296,25 +403,106 @@ String CaptivePortal::createSession() {
  */
 bool CaptivePortal::isSessionValid(const String& sid) {
   DPRINTF(0, "[CaptivePortal::isSessionValid]");
-  auto it = validSessions.find(sid);
-  if (it == validSessions.end()) {
-    DPRINTF(0, " SessionId: %s not found", sid.c_str());
-    return false;
+  PortalLock lock(portalMutex);
+  bool valid = (sessionMode == SessionMode::Signed) ? sessionTokens.isValid(sid, sessionTimeout) : sessions.isValid(sid);
+  DPRINTF(0, " SessionId: %s is %s", sid.c_str(), valid ? "valid" : "invalid or expired");
+  return valid;
+}
+
+/**
+ * @brief Removes a session ID from the session table.
+ */
+void CaptivePortal::removeSession(const String& sid) {
+  PortalLock lock(portalMutex);
+  if (sessionMode == SessionMode::Signed) {
+    // A signed token cannot be removed individually, bump the revocation epoch instead
+    if (sessionTokens.isValid(sid, sessionTimeout)) sessionTokens.revokeAll();
+    return;
   }
-  if (millis() > it->second) {
-    DPRINTF(0, " SessionId: %s expired", sid.c_str());
-    validSessions.erase(it);
-    return false;
+  sessions.remove(sid);
+}
+
+/**
+ * @brief Invalidates all sessions.
+ */
+void CaptivePortal::revokeAllSessions() {
+  DPRINTF(0, "[CaptivePortal::revokeAllSessions]");
+  PortalLock lock(portalMutex);
+  if (sessionMode == SessionMode::Signed)
+    sessionTokens.revokeAll();
+  else
+    sessions.clear();
+}
+
+/**
+ * @brief Resets to factory defaults, including the session key. Resets the ESP.
+ */
+void CaptivePortal::factoryReset() {
+  DPRINTF(0, "[CaptivePortal::factoryReset]");
+  PortalLock lock(portalMutex);
+  SessionTokens::removeKey(Settings.fileSystem);  // Signed tokens die with the secret
+  Settings.resetToFactoryDefault();               // Resets the ESP
+}
+
+/**
+ * @brief Selects how sessions are kept.
+ */
+void CaptivePortal::setSessionMode(SessionMode mode) {
+  if (running) {
+    DPRINTF(2, "setSessionMode() must be called before begin()");
+    return;
   }
-  DPRINTF(0, " SessionId: %s is valid", sid.c_str());
-  return true;
+  sessionMode = mode;
 }
 
 /**
- * @brief Removes a session ID from the valid sessions map.
+ * @brief Runs DNS and HTTP in their own tasks.
  */
-void CaptivePortal::removeSession(const String& sid) {
-  validSessions.erase(sid);
+void CaptivePortal::setThreaded(bool enabled, const PortalTaskConfig& dnsTask, const PortalTaskConfig& httpTask) {
+  if (running) {
+    DPRINTF(2, "setThreaded() must be called before begin()");
+    return;
+  }
+  threaded = enabled;
+  dnsTaskConfig = dnsTask;
+  httpTaskConfig = httpTask;
+}
+
+/**
+ * @brief Applies changed settings at runtime.
+ */
+void CaptivePortal::setHotApply(bool enabled) {
+  hotApply = enabled;
+  if (enabled) applier.begin(Settings);  // Changes made while disabled wait for a reboot
+}
+
+const CaptiveProbes& CaptivePortal::getProbes() {
+  return probes;
+}
+
+bool CaptivePortal::hotApplyFailed() {
+  return applier.accessPointFailed();
+}
+
+const CaptiveDnsStats& CaptivePortal::getDnsStats() {
+  return dnsServer->stats();
+}
+
+/**
+ * @brief Replaces the HTTP server backend.
+ */
+bool CaptivePortal::setTransport(HttpTransport* transport) {
+  if (!transport || running || cpHandlers) {
+    DPRINTF(2, "setTransport() must be called before begin()");
+    return false;
+  }
+  delete webServer;
+  webServer = transport;
+  return true;
+}
+
+PortalMutex& CaptivePortal::getMutex() {
+  return portalMutex;
 }
 
 fs::LittleFSFS& CaptivePortal::getWebFileSystem() {
@@ -324,3 +512,63 @@ fs::LittleFSFS& CaptivePortal::getWebFileSystem() {
 fs::LittleFSFS& CaptivePortal::getSettingsFileSystem() {
   return Settings.fileSystem;
 }
+
+const PageTemplate& CaptivePortal::getMenuTemplate() {
+  if (!menuTemplate.isCompiled()) menuTemplate.compile(webFileSystem, "/tabmenu.html");
+  return menuTemplate;
+}
+
+/**
+ * @brief Registers the built-in page variables.
+ */
+void CaptivePortal::setupTemplateVars() {
+  // Settings are copied under the lock, printing may wait for the client
+  templateVars.set("deviceName", [this](Print& out) {
+    String name;
+    {
+      PortalLock lock(portalMutex);
+      name = Settings.getEffectiveDeviceName();
+    }
+    out.print(name);
+  });
+  templateVars.set("hostname", [this](Print& out) {
+    String hostname;
+    {
+      PortalLock lock(portalMutex);
+      hostname = Settings.DeviceHostname;
+    }
+    out.print(hostname);
+  });
+  templateVars.set("ip", [](Print& out) { out.print(WiFi.softAPIP().toString()); });
+  templateVars.set("version", [](Print& out) { out.print(CP_FIRMWARE_VERSION); });
+  templateVars.set("freeHeap", [](Print& out) { out.print(ESP.getFreeHeap()); });
+  templateVars.set("minFreeHeap", [](Print& out) { out.print(ESP.getMinFreeHeap()); });
+  templateVars.set("uptime", [](Print& out) { out.print(millis() / 1000UL); });
+}
+
+void CaptivePortal::setTemplateVar(const String& name, TemplateVars::Provider provider, bool escape) {
+  templateVars.set(name, provider, escape);
+}
+
+const TemplateVars& CaptivePortal::getTemplateVars() {
+  return templateVars;
+}
+
+ETagCache& CaptivePortal::getETagCache() {
+  return assetETags;
+}
+
+FileCache& CaptivePortal::getFileCache() {
+  return fileCache;
+}
+
+void CaptivePortal::invalidateAsset(fs::LittleFSFS& fileSystem, const String& path) {
+  if (&fileSystem == &webFileSystem) invalidateAsset(path);  // Only web files are cached
+}
+
+void CaptivePortal::invalidateAsset(const String& path) {
+  refreshEmbeddedAssetOverride(webFileSystem, path);
+  assetETags.invalidate(path);
+  fileCache.invalidate(path);
+  if (path == "/tabmenu.html" || path == "/tabmenu.html.gz") menuTemplate.compile(webFileSystem, "/tabmenu.html");
+}
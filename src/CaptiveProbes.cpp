@@ -0,0 +1,91 @@
+#include "CaptiveProbes.h"
+
+#include <dprintf.h>
+
+static const CaptiveProbes::Probe PROBES[] = {
+    // Android and ChromeOS (answered with 204, as before)
+    {"/generate_204", "Android/ChromeOS", CaptiveProbes::Reply::NoContent},
+    {"/gen_204", "Android", CaptiveProbes::Reply::NoContent},
+    // iOS and macOS
+    {"/hotspot-detect.html", "Apple", CaptiveProbes::Reply::Redirect},
+    {"/library/test/success.html", "Apple", CaptiveProbes::Reply::Redirect},
+    // Windows (NCSI)
+    {"/connecttest.txt", "Windows", CaptiveProbes::Reply::Redirect},
+    {"/ncsi.txt", "Windows", CaptiveProbes::Reply::Redirect},
+    {"/redirect", "Windows", CaptiveProbes::Reply::Redirect},
+    {"/fwlink", "Windows", CaptiveProbes::Reply::Redirect},
+    // Firefox
+    {"/success.txt", "Firefox", CaptiveProbes::Reply::Redirect},
+    {"/canonical.html", "Firefox", CaptiveProbes::Reply::Redirect},
+};
+
+#define PROBE_COUNT (sizeof(PROBES) / sizeof(PROBES[0]))
+
+// FNV-1a, 32 bit
+static uint32_t pathHash(const char* s, size_t len) {
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)s[i];
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+CaptiveProbes::CaptiveProbes() : url(), hitCounts(PROBE_COUNT, 0) {
+  pathHashes.reserve(PROBE_COUNT);
+  for (size_t i = 0; i < PROBE_COUNT; i++) pathHashes.push_back(pathHash(PROBES[i].path, strlen(PROBES[i].path)));
+}
+
+void CaptiveProbes::build(const IPAddress& ip) {
+  snprintf(url, sizeof(url), "http://%u.%u.%u.%u/", ip[0], ip[1], ip[2], ip[3]);
+  DPRINTF(0, "[CaptiveProbes::build] %d probes redirect to %s", (int)PROBE_COUNT, url);
+}
+
+void CaptiveProbes::install(HttpTransport* server, HttpTransport::Handler onHit) {
+  this->onHit = onHit;
+  server->intercept(this);
+}
+
+int CaptiveProbes::find(const String& uri) const {
+  uint32_t h = pathHash(uri.c_str(), uri.length());
+  for (size_t i = 0; i < PROBE_COUNT; i++) {
+    if (pathHashes[i] == h && strcmp(PROBES[i].path, uri.c_str()) == 0) return (int)i;
+  }
+  return -1;
+}
+
+void CaptiveProbes::respond(HttpTransport* server, const String& uri) {
+  int index = find(uri);
+  if (index == -1) return;
+  if (onHit) onHit();
+  respond(server, (size_t)index);
+}
+
+void CaptiveProbes::respond(HttpTransport* server, size_t index) {
+  hitCounts[index]++;
+  server->sendHeader("Cache-Control", "no-store");
+  if (PROBES[index].reply == Reply::NoContent) {
+    server->send(204, "text/plain", "");
+    return;
+  }
+  server->sendHeader("Location", url);
+  server->send(302, "text/plain", "");
+}
+
+size_t CaptiveProbes::count() {
+  return PROBE_COUNT;
+}
+
+const CaptiveProbes::Probe& CaptiveProbes::probe(size_t index) {
+  return PROBES[index];
+}
+
+uint32_t CaptiveProbes::hits(size_t index) const {
+  return index < PROBE_COUNT ? hitCounts[index] : 0;
+}
+
+uint32_t CaptiveProbes::totalHits() const {
+  uint32_t total = 0;
+  for (size_t i = 0; i < PROBE_COUNT; i++) total += hitCounts[i];
+  return total;
+}
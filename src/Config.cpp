@@ -4,31 +4,54 @@
 #include <ESPResetUtil.h>
 #include <dprintf.h>
 
-// Helper: split dot-path traversal and optionally create missing objects.
-static JsonVariant getPathVariant(JsonDocument& doc, const String& path, bool createMissing) {
-  JsonVariant cur = doc.as<JsonVariant>();
-  int start = 0;
+#include "GzipUtil.h"
+
+// Print sink that only hashes, to compare serialized contents without buffering them
+class CrcPrint : public Print {
+ public:
+  uint32_t crc = 0;
+  size_t size = 0;
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* data, size_t len) override {
+    crc = crc32Update(crc, data, len);
+    size += len;
+    return len;
+  }
+};
 
-  while (start < (int)path.length()) {
-    int dot = path.indexOf('.', start);
-    String token = (dot == -1) ? path.substring(start) : path.substring(start, dot);
-    start = (dot == -1) ? path.length() : dot + 1;
+// Helper: find a member of obj by a key that is not null terminated.
+static JsonVariant findMember(JsonObject obj, const char* key, size_t len) {
+  for (JsonPair kv : obj) {
+    JsonString k = kv.key();
+    if (k.size() == len && memcmp(k.c_str(), key, len) == 0) return kv.value();
+  }
+  return JsonVariant();
+}
 
+// Helper: walk a precompiled dot-path and optionally create missing objects.
+static JsonVariant getPathVariant(JsonDocument& doc, const ConfigPath& path, bool createMissing) {
+  if (!path.isValid()) return JsonVariant();
+  JsonVariant cur = doc.as<JsonVariant>();
+
+  for (size_t i = 0; i < path.depth(); i++) {
     if (!cur.is<JsonObject>()) {
       if (!createMissing) return JsonVariant();
       cur.to<JsonObject>();
     }
 
     JsonObject obj = cur.as<JsonObject>();
-
-    JsonVariant child = obj[token];
+    JsonVariant child = findMember(obj, path.segment(i), path.segmentLength(i));
 
     // Missing path element?
     if (child.isNull()) {
       if (!createMissing) return JsonVariant();
-      // Create intermediate object
-      obj[token].to<JsonObject>();
-      child = obj[token];
+      // Create intermediate object (char[] keys are copied into the document)
+      char name[CP_CONFIG_SEGMENT_MAX + 1];
+      memcpy(name, path.segment(i), path.segmentLength(i));
+      name[path.segmentLength(i)] = '\0';
+      obj[name].to<JsonObject>();
+      child = obj[name];
     }
 
     cur = child;
@@ -67,8 +90,80 @@ static void setVariantFromString(JsonVariant v, const String& value) {
     return;
   }
 
-  // fallback string
-  v.set(s.c_str());
+  // fallback string (a String is always copied into the document)
+  v.set(s);
+}
+
+bool configValidGpio(JsonVariantConst value) {
+  return value.is<uint8_t>() && value.as<uint8_t>() < GPIO_NUM_MAX;
+}
+
+bool configNotEmpty(JsonVariantConst value) {
+  const char* s = value.as<const char*>();
+  return s && *s;
+}
+
+// Built-in settings: path, member, default, validator. Fields of a section stay together.
+typedef CaptivePortalConfig CPC;
+static constexpr ConfigField kDeviceFields[] = {
+    {"user", "name", &CPC::AdminUser, "Admin", configNotEmpty},
+    {"user", "pass", &CPC::AdminPassword, "password", nullptr, ConfigField::Secret},
+    {"user", "defaultPass", &CPC::DefaultPassword, "password", nullptr, ConfigField::Secret},
+    {"device", "name", &CPC::DeviceName, ""},
+    {"device", "hostname", &CPC::DeviceHostname, "esp32-portal", configNotEmpty},
+    {"device", "timezone", &CPC::DeviceTimezone, "Etc/UTC", configNotEmpty},
+    {"device", "IP", &CPC::DeviceIP, configIPv4(192, 168, 168, 168)},
+    {"device", "IPMask", &CPC::DeviceIPMask, configIPv4(255, 255, 255, 0)},
+    {"device", "ledPin", &CPC::LedPin, (uint8_t)2, configValidGpio},
+    {"device", "hasRgbLed", &CPC::HasRgbLed, false},
+    {"device", "rgbBrightness", &CPC::RgbBrightness, (uint8_t)128},
+    {"device", "resetPin", &CPC::ResetPin, (uint8_t)GPIO_NUM_4, configValidGpio},
+};
+
+static IPAddress unpackIPv4(uint32_t packed) {
+  return IPAddress(packed >> 24, (packed >> 16) & 0xff, (packed >> 8) & 0xff, packed & 0xff);
+}
+
+// Helper: the object of a field's section (nullptr section: root itself), created if missing when create is set.
+static JsonObject sectionObject(JsonObject root, const char* section, bool create) {
+  if (!section || root.isNull()) return root;
+  JsonObject obj = root[section].as<JsonObject>();
+  if (obj.isNull() && create) obj = root[section].to<JsonObject>();
+  return obj;
+}
+
+// Helper: store the value of field f of cfg in sec.
+static void putField(JsonObject sec, const ConfigField& f, CaptivePortalConfig& cfg) {
+  switch (f.type) {
+    case ConfigField::Type::Text:
+      sec[f.key] = cfg.*f.member.text;  // A String is copied into the document
+      break;
+    case ConfigField::Type::Address:
+      sec[f.key] = (cfg.*f.member.address).toString();
+      break;
+    case ConfigField::Type::Bool:
+      sec[f.key] = cfg.*f.member.flag;
+      break;
+    case ConfigField::Type::UInt8:
+      sec[f.key] = cfg.*f.member.u8;
+      break;
+    case ConfigField::Type::UInt16:
+      sec[f.key] = cfg.*f.member.u16;
+      break;
+    case ConfigField::Type::UInt32:
+      sec[f.key] = cfg.*f.member.u32;
+      break;
+    case ConfigField::Type::Int32:
+      sec[f.key] = cfg.*f.member.i32;
+      break;
+    case ConfigField::Type::Float:
+      sec[f.key] = cfg.*f.member.f;
+      break;
+  }
+}
+
+static bool sameSection(const char* a, const char* b) {
+  return a == b || (a && b && strcmp(a, b) == 0);
 }
 
 /**
@@ -84,7 +179,9 @@ CaptivePortalConfig::CaptivePortalConfig(fs::LittleFSFS& file_system /* Use a mo
       formatOnFail(format_on_fail),
       basePath(base_path),
       maxOpenFiles(max_open_files),
-      partitionLabel(partition_label) {}
+      partitionLabel(partition_label) {
+  addFields(kDeviceFields, sizeof(kDeviceFields) / sizeof(kDeviceFields[0]));
+}
 
 CaptivePortalConfig::~CaptivePortalConfig() {
   s_configLoaded = false;
@@ -125,6 +222,10 @@ bool CaptivePortalConfig::begin() {
 
 void CaptivePortalConfig::resetToFactoryDefault() {
   DPRINTF(1, "Factory Reset: %s", basePath);
+  invalidate();  // Pending changes must not recreate the file
+  fileSystem.remove(tempFile());
+  fileSystem.remove(backupFile());  // Or loadConfig() would restore it
+  fileSystem.remove(fileFor(StorageFormat::MsgPack));  // factoryReset() only knows ConfigFile
   espResetUtil::factoryReset(formatOnFail, fileSystem, {ConfigFile.c_str()});  // Format or just delete config.json
 }
 
@@ -135,11 +236,11 @@ bool CaptivePortalConfig::checkFactoryResetMarker() {
 /**
  * @brief Checks whether the configuration file exists on the file system.
  *
- * @return true if /config.json is present in LittleFS
+ * @return true if /config.json (or /config.msgpack) is present in LittleFS
  * @return false otherwise
  */
 bool CaptivePortalConfig::configExists() {
-  return fileSystem.exists(ConfigFile);
+  return fileSystem.exists(storageFile());
 }
 
 /**
@@ -149,56 +250,78 @@ bool CaptivePortalConfig::configExists() {
  */
 bool CaptivePortalConfig::loadConfig() {
   s_configLoaded = false;
-  DPRINTF(0, "[CaptivePortalConfig::loadConfig] %s", ConfigFile);
-
-  File f = fileSystem.open(ConfigFile, "r");
-  if (!f) return false;
+  DPRINTF(0, "[CaptivePortalConfig::loadConfig] %s", storageFile().c_str());
 
-  JsonDocument doc;
-  DeserializationError err = deserializeJson(doc, f);
-  f.close();
-  if (err) return false;
-
-  // Load user settings
-  String user = doc["user"]["name"] | AdminUser;
-  String pass = doc["user"]["pass"] | AdminPassword;
-  String defaultPass = doc["user"]["defaultPass"] | DefaultPassword;
-
-  // Load device settings from JSON, or use defaults
-  String hostname = doc["device"]["hostname"] | DeviceHostname;
-  String devicename = doc["device"]["name"] | DeviceName;
-  String timezone = doc["device"]["timezone"] | DeviceTimezone;
-  String ipStr = doc["device"]["IP"] | DeviceIP.toString();
-  String ipMaskStr = doc["device"]["IPMask"] | DeviceIPMask.toString();
-  uint8_t cLedPin = doc["device"]["ledPin"] | LedPin;
-  bool cRgbLed = doc["device"]["hasRgbLed"] | HasRgbLed;
-  uint8_t cRgbBrightness = doc["device"]["rgbBrightness"] | RgbBrightness;
-  uint8_t cResetPin = doc["device"]["resetPin"] | ResetPin;
-
-  if (!DeviceIP.fromString(ipStr) || !DeviceIPMask.fromString(ipMaskStr))
-    return false;
+  invalidate();
+  if (!ensureLoaded()) return false;
+  if (!readFields()) return false;
 
-  AdminUser = user;
-  AdminPassword = pass;
-  DefaultPassword = defaultPass;
-
-  DeviceName = devicename;
-  DeviceHostname = hostname;
-  DeviceTimezone = timezone;
+  s_configLoaded = true;
+  publish();
+  return s_configLoaded;
+}
 
-  uint8_t first_octet, second_octet, third_octet, fourth_octet;
-  sscanf(ipStr.c_str(), "%hhu.%hhu.%hhu.%hhu", &first_octet, &second_octet, &third_octet, &fourth_octet);
-  DeviceIP = IPAddress(first_octet, second_octet, third_octet, fourth_octet);
-  sscanf(ipMaskStr.c_str(), "%hhu.%hhu.%hhu.%hhu", &first_octet, &second_octet, &third_octet, &fourth_octet);
-  DeviceIPMask = IPAddress(first_octet, second_octet, third_octet, fourth_octet);
+/**
+ * @brief Copies the values in doc to the field members. Missing or invalid values keep the current value.
+ *
+ * @return false if a value could not be used and makes the load fail (an invalid address)
+ */
+bool CaptivePortalConfig::readFields() {
+  bool valid = true;
+  JsonObject root = doc.as<JsonObject>();
+  for (const FieldTable& table : fieldTables) {
+    const char* section = nullptr;
+    JsonObject sec;
+    for (size_t i = 0; i < table.count; i++) {
+      const ConfigField& f = table.fields[i];
+      if (i == 0 || !sameSection(f.section, section)) {
+        section = f.section;
+        sec = sectionObject(root, section, false);  // Once per section
+      }
 
-  LedPin = cLedPin;
-  HasRgbLed = cRgbLed;
-  RgbBrightness = cRgbBrightness;
-  ResetPin = cResetPin;
+      JsonVariantConst v = sec[f.key];
+      if (v.isNull()) continue;  // Missing: keep the current value
+      if (f.validate && !f.validate(v)) {
+        DPRINTF(2, "Ignoring invalid value of %s.%s", f.section ? f.section : "", f.key);
+        continue;
+      }
 
-  s_configLoaded = true;
-  return s_configLoaded;
+      switch (f.type) {
+        case ConfigField::Type::Text:
+          if (v.is<const char*>()) this->*f.member.text = v.as<const char*>();
+          break;
+        case ConfigField::Type::Address: {
+          IPAddress ip;
+          if (v.is<const char*>() && ip.fromString(v.as<const char*>())) {
+            this->*f.member.address = ip;
+          } else {
+            DPRINTF(3, "Invalid address %s.%s", f.section ? f.section : "", f.key);
+            valid = false;  // Reported as a failed load, like a broken file
+          }
+          break;
+        }
+        case ConfigField::Type::Bool:
+          if (v.is<bool>()) this->*f.member.flag = v.as<bool>();
+          break;
+        case ConfigField::Type::UInt8:
+          if (v.is<uint8_t>()) this->*f.member.u8 = v.as<uint8_t>();
+          break;
+        case ConfigField::Type::UInt16:
+          if (v.is<uint16_t>()) this->*f.member.u16 = v.as<uint16_t>();
+          break;
+        case ConfigField::Type::UInt32:
+          if (v.is<uint32_t>()) this->*f.member.u32 = v.as<uint32_t>();
+          break;
+        case ConfigField::Type::Int32:
+          if (v.is<int32_t>()) this->*f.member.i32 = v.as<int32_t>();
+          break;
+        case ConfigField::Type::Float:
+          if (v.is<float>()) this->*f.member.f = v.as<float>();
+          break;
+      }
+    }
+  }
+  return valid;
 }
 
 bool CaptivePortalConfig::imported() {
@@ -206,37 +329,96 @@ bool CaptivePortalConfig::imported() {
 }
 
 /**
- * @brief Creates a config.json file with user and device settings.
- *
- * The default values are configurable in Config.h
+ * @brief Stores the user and device settings in config.json.
  *
+ * The default values are configurable in Config.h. The file is written by the
+ * write-back (see flush()), together with other changes made in the same window.
  */
 bool CaptivePortalConfig::save(bool useDefaultValues) {
   DPRINTF(0, "[CaptivePortalConfig::save]");
-  JsonDocument doc;
-  doc["user"]["name"] = AdminUser.c_str();
-  doc["user"]["pass"] = useDefaultValues ? DefaultPassword.c_str() : AdminPassword.c_str();  // save default password if requested
-  doc["user"]["defaultPass"] = DefaultPassword.c_str();
-  doc["device"]["name"] = DeviceName.c_str();
-  doc["device"]["hostname"] = DeviceHostname.c_str();
-  doc["device"]["timezone"] = DeviceTimezone.c_str();
-  doc["device"]["IP"] = DeviceIP.toString().c_str();
-  doc["device"]["IPMask"] = DeviceIPMask.toString().c_str();
-  doc["device"]["ledPin"] = LedPin;
-  doc["device"]["hasRgbLed"] = HasRgbLed;
-  doc["device"]["rgbBrightness"] = RgbBrightness;
-  doc["device"]["resetPin"] = ResetPin;
-
-  File f = fileSystem.open(ConfigFile, "w");
-  if (f) {
-    serializeJsonPretty(doc, f);
-    f.close();
-    DPRINTF(1, "Config file saved");
-  } else {
-    DPRINTF(3, "Failed to save config file");
-    return false;
+  if (!docLoaded) {
+    ensureLoaded();    // Keep custom keys that are already in the file
+    docLoaded = true;  // A missing or broken file is replaced by the fields below
+  }
+  if (!doc.is<JsonObject>()) doc.to<JsonObject>();
+
+  JsonObject root = doc.as<JsonObject>();
+  for (const FieldTable& table : fieldTables) {
+    const char* section = nullptr;
+    JsonObject sec;
+    for (size_t i = 0; i < table.count; i++) {
+      const ConfigField& f = table.fields[i];
+      if (i == 0 || !sameSection(f.section, section)) {
+        section = f.section;
+        sec = sectionObject(root, section, true);  // Once per section
+      }
+      putField(sec, f, *this);
+    }
+  }
+  if (useDefaultValues) doc["user"]["pass"] = DefaultPassword;  // save default password if requested
+
+  return markDirty();
+}
+
+/**
+ * @brief Adds the settings of a derived class.
+ */
+void CaptivePortalConfig::addFields(const ConfigField* fields, size_t count) {
+  if (!fields || !count) return;
+  fieldTables.push_back({fields, count});
+  applyDefaults(fieldTables.back());
+}
+
+/**
+ * @brief Sets every field to its default.
+ */
+void CaptivePortalConfig::applyDefaults() {
+  for (const FieldTable& table : fieldTables) applyDefaults(table);
+}
+
+void CaptivePortalConfig::applyDefaults(const FieldTable& table) {
+  for (size_t i = 0; i < table.count; i++) {
+    const ConfigField& f = table.fields[i];
+    switch (f.type) {
+      case ConfigField::Type::Text:
+        this->*f.member.text = f.defaultText ? f.defaultText : "";
+        break;
+      case ConfigField::Type::Address:
+        this->*f.member.address = unpackIPv4((uint32_t)f.defaultNumber);
+        break;
+      case ConfigField::Type::Bool:
+        this->*f.member.flag = f.defaultNumber != 0;
+        break;
+      case ConfigField::Type::UInt8:
+        this->*f.member.u8 = (uint8_t)f.defaultNumber;
+        break;
+      case ConfigField::Type::UInt16:
+        this->*f.member.u16 = (uint16_t)f.defaultNumber;
+        break;
+      case ConfigField::Type::UInt32:
+        this->*f.member.u32 = (uint32_t)f.defaultNumber;
+        break;
+      case ConfigField::Type::Int32:
+        this->*f.member.i32 = (int32_t)f.defaultNumber;
+        break;
+      case ConfigField::Type::Float:
+        this->*f.member.f = (float)f.defaultNumber;
+        break;
+    }
+  }
+}
+
+/**
+ * @brief Writes the current value of every field to out.
+ */
+void CaptivePortalConfig::exportFields(JsonObject out, bool includeSecrets) {
+  for (const FieldTable& table : fieldTables) {
+    for (size_t i = 0; i < table.count; i++) {
+      const ConfigField& f = table.fields[i];
+      if ((f.flags & ConfigField::Secret) && !includeSecrets) continue;
+      putField(sectionObject(out, f.section, true), f, *this);
+    }
   }
-  return true;
 }
 
 /**
@@ -246,24 +428,11 @@ bool CaptivePortalConfig::save(bool useDefaultValues) {
  *
  * @param key Dot-separated JSON path.
  * @param value Value as string. Will be auto-converted to bool/int if possible.
- * @return true if the key was added and config saved, false otherwise.
+ * @return true if the key was added (written back later, see flush()), false otherwise.
  */
-bool CaptivePortalConfig::add(const String& key, const String& value) {
+bool CaptivePortalConfig::add(const ConfigPath& key, const String& value) {
   DPRINTF(0, "[CaptivePortalConfig::add] key=%s", key.c_str());
-
-  File f = fileSystem.open(ConfigFile, "r");
-  if (!f) {
-    DPRINTF(3, "Config file not found: %s", ConfigFile.c_str());
-    return false;
-  }
-
-  JsonDocument doc;
-  DeserializationError err = deserializeJson(doc, f);
-  f.close();
-  if (err) {
-    DPRINTF(3, "Failed to parse config.json: %s", err.c_str());
-    return false;
-  }
+  if (!ensureLoaded()) return false;
 
   // Does it already exist?
   JsonVariant existing = getPathVariant(doc, key, false);
@@ -280,23 +449,7 @@ bool CaptivePortalConfig::add(const String& key, const String& value) {
   }
 
   setVariantFromString(target, value);
-
-  // Save back to file (reuse your existing save pattern)
-  File out = fileSystem.open(ConfigFile, "w");
-  if (!out) {
-    DPRINTF(3, "Failed to open config for writing");
-    return false;
-  }
-
-  const size_t written = serializeJsonPretty(doc, out);
-  out.close();
-
-  if (written == 0) {
-    DPRINTF(3, "Failed to save config file");
-    return false;
-  }
-
-  return true;
+  return markDirty();
 }
 
 /**
@@ -308,15 +461,9 @@ bool CaptivePortalConfig::add(const String& key, const String& value) {
  * @param value Expected value as string ("true"/"false", numbers, or text).
  * @return true if key exists and equals value, false otherwise.
  */
-bool CaptivePortalConfig::exist(const String& key, const String& value) {
+bool CaptivePortalConfig::exist(const ConfigPath& key, const String& value) {
   DPRINTF(0, "[CaptivePortalConfig::exist] key=%s", key.c_str());
-  File f = fileSystem.open(ConfigFile, "r");
-  if (!f) return false;
-
-  JsonDocument doc;
-  DeserializationError err = deserializeJson(doc, f);
-  f.close();
-  if (err) return false;
+  if (!ensureLoaded()) return false;
 
   JsonVariant v = getPathVariant(doc, key, false);
   if (v.isNull()) return false;
@@ -362,51 +509,25 @@ bool CaptivePortalConfig::exist(const String& key, const String& value) {
  *
  * @param key   Dot-separated JSON path.
  * @param value Value as string ("true"/"false", number, or text).
- * @return true if the value was written successfully.
+ * @return true if the value was set (written back later, see flush()).
  * @return false on error.
  */
-bool CaptivePortalConfig::set(const String& key, const String& value) {
+bool CaptivePortalConfig::set(const ConfigPath& key, const String& value) {
   DPRINTF(0, "[CaptivePortalConfig::set] key=%s", key.c_str());
-
-  File f = fileSystem.open(ConfigFile, "r");
-  if (!f) {
-    DPRINTF(3, "Config file not found: %s", ConfigFile.c_str());
-    return false;
-  }
-
-  JsonDocument doc;
-  DeserializationError err = deserializeJson(doc, f);
-  f.close();
-  if (err) {
-    DPRINTF(3, "Failed to parse config.json: %s", err.c_str());
-    return false;
-  }
-
-  // Create path (or reuse existing) and set value
-  JsonVariant target = getPathVariant(doc, key, true);
-  if (target.isNull()) {
-    DPRINTF(3, "Failed to resolve key path: %s", key.c_str());
-    return false;
-  }
+  JsonVariant target = writableVariant(key);
+  if (target.isNull()) return false;
 
   setVariantFromString(target, value);
+  return markDirty();
+}
 
-  // Save back to file
-  File out = fileSystem.open(ConfigFile, "w");
-  if (!out) {
-    DPRINTF(3, "Failed to open config for writing");
-    return false;
-  }
-
-  const size_t written = serializeJsonPretty(doc, out);
-  out.close();
-
-  if (written == 0) {
-    DPRINTF(3, "Failed to save config file");
-    return false;
-  }
+JsonVariant CaptivePortalConfig::writableVariant(const ConfigPath& key) {
+  if (!ensureLoaded()) return JsonVariant();
 
-  return true;
+  // Create path (or reuse existing)
+  JsonVariant target = getPathVariant(doc, key, true);
+  if (target.isNull()) DPRINTF(3, "Failed to resolve key path: %s", key.c_str());
+  return target;
 }
 
 /**
@@ -415,14 +536,8 @@ bool CaptivePortalConfig::set(const String& key, const String& value) {
  * @param defaultValue Value returned when missing or invalid
  * @return Parsed value or defaultValue
  */
-uint32_t CaptivePortalConfig::getUInt(const String& key, uint32_t defaultValue) {
-  File f = fileSystem.open(ConfigFile, "r");
-  if (!f) return defaultValue;
-
-  JsonDocument doc;
-  DeserializationError err = deserializeJson(doc, f);
-  f.close();
-  if (err) return defaultValue;
+uint32_t CaptivePortalConfig::getUInt(const ConfigPath& key, uint32_t defaultValue) {
+  if (!ensureLoaded()) return defaultValue;
 
   JsonVariant v = getPathVariant(doc, key, false);
   if (v.isNull()) return defaultValue;
@@ -441,6 +556,68 @@ uint32_t CaptivePortalConfig::getUInt(const String& key, uint32_t defaultValue)
   return defaultValue;
 }
 
+/**
+ * @brief Get a signed integer from config by key (dot-path).
+ * @return Parsed value or defaultValue
+ */
+int32_t CaptivePortalConfig::getInt(const ConfigPath& key, int32_t defaultValue) {
+  if (!ensureLoaded()) return defaultValue;
+
+  JsonVariant v = getPathVariant(doc, key, false);
+  if (v.is<long>()) return (int32_t)v.as<long>();
+  if (v.is<const char*>()) return (int32_t)String(v.as<const char*>()).toInt();
+  return defaultValue;
+}
+
+/**
+ * @brief Get a bool from config by key (dot-path).
+ *
+ * Accepts JSON booleans, numbers (0 is false) and the strings "true"/"false".
+ *
+ * @return Parsed value or defaultValue
+ */
+bool CaptivePortalConfig::getBool(const ConfigPath& key, bool defaultValue) {
+  if (!ensureLoaded()) return defaultValue;
+
+  JsonVariant v = getPathVariant(doc, key, false);
+  if (v.is<bool>()) return v.as<bool>();
+  if (v.is<long>()) return v.as<long>() != 0;
+  if (v.is<const char*>()) {
+    const char* s = v.as<const char*>();
+    if (strcasecmp(s, "true") == 0) return true;
+    if (strcasecmp(s, "false") == 0) return false;
+  }
+  return defaultValue;
+}
+
+/**
+ * @brief Get a number from config by key (dot-path).
+ * @return Parsed value or defaultValue
+ */
+float CaptivePortalConfig::getFloat(const ConfigPath& key, float defaultValue) {
+  if (!ensureLoaded()) return defaultValue;
+
+  JsonVariant v = getPathVariant(doc, key, false);
+  if (v.is<float>()) return v.as<float>();
+  if (v.is<const char*>()) return String(v.as<const char*>()).toFloat();
+  return defaultValue;
+}
+
+/**
+ * @brief Get a value as text by key (dot-path). Numbers and bools are converted.
+ * @return Value or defaultValue if the key is missing or an object/array
+ */
+String CaptivePortalConfig::getString(const ConfigPath& key, const String& defaultValue) {
+  if (!ensureLoaded()) return defaultValue;
+
+  JsonVariant v = getPathVariant(doc, key, false);
+  if (v.is<const char*>()) return String(v.as<const char*>());
+  if (v.is<bool>()) return v.as<bool>() ? "true" : "false";
+  if (v.is<long>()) return String(v.as<long>());
+  if (v.is<float>()) return String(v.as<float>());
+  return defaultValue;
+}
+
 bool CaptivePortalConfig::setDeviceName(const String& name) {
   DeviceName = name;
   return save();
@@ -449,3 +626,321 @@ bool CaptivePortalConfig::setDeviceName(const String& name) {
 String CaptivePortalConfig::getEffectiveDeviceName() const {
   return DeviceName.length() > 0 ? DeviceName : DeviceHostname;
 }
+
+/**
+ * @brief Writes pending changes to ConfigFile.
+ */
+bool CaptivePortalConfig::flush() {
+  if (!dirty || transaction) return true;  // Inside a transaction commit() writes
+  if (!writeFile()) {
+    DPRINTF(3, "Config write-back failed, retrying in %u ms", (unsigned)saver.debounce());
+    saver.failed(millis());  // Stays dirty, handle() retries after the next window
+    writeError = true;
+    return false;
+  }
+  dirty = false;
+  writeError = false;
+  publish();
+  return true;
+}
+
+/**
+ * @brief Writes pending changes once they are older than the write-back delay.
+ *
+ * Called from CaptivePortal::handle(). Call it from loop() when the config is used without the portal.
+ */
+void CaptivePortalConfig::handle() {
+  if (!dirty || transaction || !saver.isDue(millis())) return;
+  flush();
+}
+
+/**
+ * @brief Drops the in-memory copy and any unsaved changes. The next access reads ConfigFile again.
+ */
+void CaptivePortalConfig::invalidate() {
+  doc.clear();
+  docLoaded = false;
+  dirty = false;
+  writeError = false;
+  snapshot.clear();
+  transaction = false;
+  saver.cancel();
+  saver.forgetFlashContent();
+  changes++;
+}
+
+void CaptivePortalConfig::setWriteBackDelay(uint32_t ms, uint32_t maxDelayMs) {
+  saver.setWindow(ms, maxDelayMs);
+  if (ms == 0) flush();
+}
+
+/**
+ * @brief Starts a transaction.
+ */
+bool CaptivePortalConfig::beginTransaction() {
+  DPRINTF(0, "[CaptivePortalConfig::beginTransaction]");
+  if (transaction) {
+    DPRINTF(2, "Config transaction already open");
+    return false;
+  }
+  if (!ensureLoaded()) return false;
+
+  snapshot = doc;
+  snapshotDirty = dirty;
+  transaction = true;
+  return true;
+}
+
+/**
+ * @brief Ends the transaction and writes its changes with one file write.
+ */
+bool CaptivePortalConfig::commit() {
+  DPRINTF(0, "[CaptivePortalConfig::commit]");
+  if (!transaction) return false;
+
+  transaction = false;
+  snapshot.clear();
+  return flush();
+}
+
+/**
+ * @brief Ends the transaction and restores the document.
+ */
+void CaptivePortalConfig::rollback() {
+  DPRINTF(0, "[CaptivePortalConfig::rollback]");
+  if (!transaction) return;
+
+  doc = snapshot;
+  dirty = snapshotDirty;
+  changes++;
+  snapshot.clear();
+  transaction = false;
+}
+
+/**
+ * @brief Selects how the settings are stored.
+ */
+void CaptivePortalConfig::setStorageFormat(StorageFormat format) {
+  if (format == storageFormat) return;
+  storageFormat = format;
+  invalidate();  // Read (and migrate) again in the new format
+}
+
+String CaptivePortalConfig::storageFile() const {
+  return fileFor(storageFormat);
+}
+
+/**
+ * @brief Returns the settings as pretty printed JSON, e.g. for /editfile.
+ */
+String CaptivePortalConfig::toJson() {
+  String json;
+  if (ensureLoaded()) serializeJsonPretty(doc, json);
+  return json;
+}
+
+/**
+ * @brief Replaces all settings with JSON content, updates the member fields and writes them in the storage format.
+ *
+ * The members are updated before the write, so observers called by it see the new values.
+ */
+bool CaptivePortalConfig::fromJson(const String& content) {
+  DPRINTF(0, "[CaptivePortalConfig::fromJson]");
+  JsonDocument parsed;
+  DeserializationError err = deserializeJson(parsed, content);
+  if (err || !parsed.is<JsonObject>()) {
+    DPRINTF(3, "Rejected config JSON: %s", err.c_str());
+    return false;
+  }
+
+  invalidate();
+  doc = parsed;
+  docLoaded = true;
+  s_configLoaded = readFields();  // Like loadConfig(), an invalid address keeps the current one
+  dirty = true;
+  return flush();
+}
+
+/**
+ * @brief Calls observer for changes at or below prefix.
+ */
+int CaptivePortalConfig::subscribe(const String& prefix, ConfigObserver observer) {
+  if (!observer) return 0;
+  if (!publishedValid && docLoaded) {
+    published = doc;  // Baseline for the first diff
+    publishedValid = true;
+  }
+  subscriptions.push_back({nextSubscription, prefix, observer});
+  return nextSubscription++;
+}
+
+int CaptivePortalConfig::subscribe(const String& prefix, ConfigEventQueue& queue) {
+  ConfigEventQueue* q = &queue;
+  return subscribe(prefix, [q](const ConfigChange& change) { q->push(change); });
+}
+
+void CaptivePortalConfig::unsubscribe(int id) {
+  for (size_t i = 0; i < subscriptions.size(); i++) {
+    if (subscriptions[i].id != id) continue;
+    subscriptions.erase(subscriptions.begin() + i);
+    break;
+  }
+}
+
+void CaptivePortalConfig::publish() {
+  if (subscriptions.empty()) {
+    if (publishedValid) published.clear();  // No one to compare for
+    publishedValid = false;
+    return;
+  }
+  if (!publishedValid) {
+    published = doc;
+    publishedValid = true;
+    return;
+  }
+
+  std::vector<ConfigChange> changed;
+  diffConfig(published, doc, changed);
+  published = doc;
+  if (changed.empty()) return;
+
+  DPRINTF(0, "[CaptivePortalConfig::publish] %d change(s)", (int)changed.size());
+  std::vector<Subscription> subs = subscriptions;  // Observers may (un)subscribe
+  for (const ConfigChange& change : changed) {
+    for (const Subscription& sub : subs) {
+      if (configPathMatches(sub.prefix, change.path)) sub.observer(change);
+    }
+  }
+}
+
+String CaptivePortalConfig::fileFor(StorageFormat format) const {
+  if (format == StorageFormat::Json) return ConfigFile;
+  String base = ConfigFile;
+  if (base.endsWith(".json")) base.remove(base.length() - 5);
+  return base + ".msgpack";
+}
+
+bool CaptivePortalConfig::ensureLoaded() {
+  if (docLoaded) return true;
+
+  String live = storageFile();
+  if (!fileSystem.exists(live) || !parseFile(live, storageFormat)) {
+    // A write was interrupted: use the newest complete copy
+    String candidates[] = {tempFile(), backupFile()};
+    bool recovered = false;
+    for (const String& path : candidates) {
+      if (!fileSystem.exists(path) || !parseFile(path, storageFormat)) continue;
+      DPRINTF(2, "Restoring %s from %s", live.c_str(), path.c_str());
+      fileSystem.remove(live);
+      fileSystem.rename(path, live);
+      recovered = true;
+      break;
+    }
+
+    // Settings stored in the other format: convert them once
+    if (!recovered) {
+      StorageFormat other = (storageFormat == StorageFormat::Json) ? StorageFormat::MsgPack : StorageFormat::Json;
+      String old = fileFor(other);
+      if (!fileSystem.exists(old) || !parseFile(old, other)) {
+        DPRINTF(3, "Config file not found: %s", live.c_str());
+        return false;
+      }
+      DPRINTF(1, "Migrating %s to %s", old.c_str(), live.c_str());
+      docLoaded = true;
+      dirty = true;
+      if (flush()) fileSystem.remove(old);
+      return true;
+    }
+  }
+
+  uint32_t crc;
+  size_t size;
+  contentHash(crc, size);
+  saver.setFlashContent(crc, size);  // Lets flush() skip saves that change nothing
+  docLoaded = true;
+  return true;
+}
+
+bool CaptivePortalConfig::parseFile(const String& path, StorageFormat format) {
+  File f = fileSystem.open(path, "r");
+  if (!f) {
+    DPRINTF(3, "Config file not found: %s", path.c_str());
+    return false;
+  }
+
+  DeserializationError err = (format == StorageFormat::MsgPack) ? deserializeMsgPack(doc, f) : deserializeJson(doc, f);
+  f.close();
+  if (err) {
+    DPRINTF(3, "Failed to parse %s: %s", path.c_str(), err.c_str());
+    doc.clear();
+    return false;
+  }
+  return true;
+}
+
+bool CaptivePortalConfig::markDirty() {
+  dirty = true;
+  changes++;
+  saver.request(millis());
+  if (saver.debounce() == 0) return flush();
+  return true;
+}
+
+void CaptivePortalConfig::contentHash(uint32_t& crc, size_t& size) {
+  CrcPrint hash;
+  if (storageFormat == StorageFormat::MsgPack)
+    serializeMsgPack(doc, hash);
+  else
+    serializeJsonPretty(doc, hash);
+  crc = hash.crc;
+  size = hash.size;
+}
+
+bool CaptivePortalConfig::writeFile() {
+  uint32_t crc;
+  size_t expected;
+  contentHash(crc, expected);
+  if (saver.isUnchanged(crc, expected)) {
+    DPRINTF(0, "Config unchanged, not written");
+    saver.skipped();
+    return true;
+  }
+
+  // Write the new contents next to the live file, so a power failure leaves one of them intact
+  String tmp = tempFile();
+  File out = fileSystem.open(tmp, "w");
+  if (!out) {
+    DPRINTF(3, "Failed to open config for writing");
+    return false;
+  }
+
+  const bool msgPack = (storageFormat == StorageFormat::MsgPack);
+  const size_t written = msgPack ? serializeMsgPack(doc, out) : serializeJsonPretty(doc, out);
+  out.close();
+
+  if (written == 0 || written != expected) {
+    DPRINTF(3, "Failed to save config file (%d of %d bytes)", (int)written, (int)expected);
+    fileSystem.remove(tmp);
+    return false;
+  }
+
+  // Keep the previous file as last good copy, then move the new one in place
+  String live = storageFile();
+  String bak = backupFile();
+  if (fileSystem.exists(live)) {
+    fileSystem.remove(bak);
+    if (!fileSystem.rename(live, bak)) {
+      DPRINTF(3, "Failed to keep %s", bak.c_str());
+      fileSystem.remove(tmp);
+      return false;
+    }
+  }
+  if (!fileSystem.rename(tmp, live)) {
+    DPRINTF(3, "Failed to rename %s", tmp.c_str());  // Restored from tmp or bak at the next boot
+    return false;
+  }
+
+  saver.written(crc, written);
+  DPRINTF(1, "Config file saved");
+  return true;
+}
@@ -0,0 +1,93 @@
+#include "ConfigObserver.h"
+
+ConfigEventQueue::ConfigEventQueue(size_t capacity) : ring(capacity ? capacity : 1) {}
+
+void ConfigEventQueue::push(const ConfigChange& change) {
+  PortalLock lock(mutex);
+  if (count == ring.size()) {
+    head = (head + 1) % ring.size();  // Drop the oldest
+    count--;
+    droppedCount++;
+  }
+  ring[(head + count) % ring.size()] = change;
+  count++;
+}
+
+bool ConfigEventQueue::pop(ConfigChange& change) {
+  PortalLock lock(mutex);
+  if (count == 0) return false;
+  change = ring[head];
+  ring[head] = ConfigChange();  // Release the strings
+  head = (head + 1) % ring.size();
+  count--;
+  return true;
+}
+
+size_t ConfigEventQueue::size() {
+  PortalLock lock(mutex);
+  return count;
+}
+
+static String valueText(JsonVariantConst v) {
+  if (v.isNull()) return String();
+  if (v.is<const char*>()) return String(v.as<const char*>());
+  String text;
+  serializeJson(v, text);
+  return text;
+}
+
+static void addChange(const String& path, JsonVariantConst before, JsonVariantConst after, std::vector<ConfigChange>& changes) {
+  ConfigChange change;
+  change.path = path;
+  change.oldValue = valueText(before);
+  change.newValue = valueText(after);
+  change.existed = !before.isNull();
+  change.exists = !after.isNull();
+  changes.push_back(change);
+}
+
+static void diffNode(JsonVariantConst before, JsonVariantConst after, String& path, std::vector<ConfigChange>& changes) {
+  bool beforeObj = before.is<JsonObjectConst>();
+  bool afterObj = after.is<JsonObjectConst>();
+
+  if (!beforeObj && !afterObj) {
+    if (before.isNull() && after.isNull()) return;
+    if (before.isNull() != after.isNull() || valueText(before) != valueText(after) ||
+        before.is<const char*>() != after.is<const char*>())
+      addChange(path, before, after, changes);
+    return;
+  }
+
+  // An object replaced a plain value or the other way round
+  if (!beforeObj && !before.isNull()) addChange(path, before, JsonVariantConst(), changes);
+  if (!afterObj && !after.isNull()) addChange(path, JsonVariantConst(), after, changes);
+
+  size_t base = path.length();
+  JsonObjectConst a = before.as<JsonObjectConst>();
+  JsonObjectConst b = after.as<JsonObjectConst>();
+
+  for (JsonPairConst kv : a) {
+    if (base) path += '.';
+    path += kv.key().c_str();
+    diffNode(kv.value(), afterObj ? b[kv.key()] : JsonVariantConst(), path, changes);
+    path.remove(base);
+  }
+  for (JsonPairConst kv : b) {
+    if (beforeObj && !a[kv.key()].isNull()) continue;  // Compared above
+    if (base) path += '.';
+    path += kv.key().c_str();
+    diffNode(JsonVariantConst(), kv.value(), path, changes);
+    path.remove(base);
+  }
+}
+
+void diffConfig(JsonVariantConst before, JsonVariantConst after, std::vector<ConfigChange>& changes) {
+  String path;
+  diffNode(before, after, path, changes);
+}
+
+bool configPathMatches(const String& prefix, const String& path) {
+  if (prefix.isEmpty()) return true;
+  if (!path.startsWith(prefix)) return false;
+  return path.length() == prefix.length() || path[prefix.length()] == '.';
+}
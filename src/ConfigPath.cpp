@@ -0,0 +1,40 @@
+#include "ConfigPath.h"
+
+ConfigPath::ConfigPath(const char* path) {
+  assign(path ? path : "", path ? strlen(path) : 0);
+}
+
+ConfigPath::ConfigPath(const String& path) {
+  assign(path.c_str(), path.length());
+}
+
+void ConfigPath::assign(const char* path, size_t len) {
+  if (len < sizeof(local)) {
+    memcpy(local, path, len + 1);
+  } else {
+    local[0] = '\0';
+    owned = path;
+  }
+  split();
+}
+
+void ConfigPath::split() {
+  const char* s = text();
+  size_t len = strlen(s);
+  count = 0;
+  valid = false;
+  if (len == 0 || len > 255) return;  // Offsets are 8 bit
+
+  size_t start = 0;
+  for (size_t i = 0; i <= len; i++) {
+    if (i < len && s[i] != '.') continue;
+
+    size_t segLen = i - start;
+    if (segLen == 0 || segLen > CP_CONFIG_SEGMENT_MAX || count >= CP_CONFIG_PATH_DEPTH) return;
+    offsets[count] = (uint8_t)start;
+    lengths[count] = (uint8_t)segLen;
+    count++;
+    start = i + 1;
+  }
+  valid = true;
+}
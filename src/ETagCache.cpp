@@ -0,0 +1,134 @@
+#include "ETagCache.h"
+
+#include <dprintf.h>
+
+#include "EmbeddedAssets.h"
+#include "GzipUtil.h"
+
+ETagCache::ETagCache(fs::LittleFSFS& fileSystem) : fileSystem(fileSystem) {}
+
+void ETagCache::begin() {
+  DPRINTF(0, "[ETagCache::begin]");
+  tags.clear();
+  hashDirectory("/");
+  DPRINTF(0, "  %d file hash(es)", (int)tags.size());
+}
+
+void ETagCache::hashDirectory(const String& dir) {
+  File root = fileSystem.open(dir);
+  if (!root || !root.isDirectory()) return;
+
+  File file = root.openNextFile();
+  while (file) {
+    String path = dir.endsWith("/") ? dir + file.name() : dir + "/" + file.name();
+    bool isDir = file.isDirectory();
+    file.close();
+    if (isDir) {
+      hashDirectory(path);
+    } else {
+      uint32_t hash;
+      fileHash(path, hash);
+    }
+    file = root.openNextFile();
+  }
+}
+
+bool ETagCache::fileHash(const String& path, uint32_t& hash, bool* templated) {
+  // Embedded assets carry their hashes (unless a file overrides them)
+  bool gz = path.endsWith(".gz");
+  const EmbeddedAsset* asset = findEmbeddedAsset(fileSystem, gz ? path.substring(0, path.length() - 3) : path);
+  if (asset) {
+    if (gz && !asset->gzData) return false;
+    hash = gz ? asset->gzHash : asset->hash;
+    if (templated) *templated = asset->templated && !gz;
+    return true;
+  }
+
+  auto it = tags.find(path);
+  if (it != tags.end()) {
+    hash = it->second.hash;
+    if (templated) *templated = it->second.templated;
+    return true;
+  }
+
+  File f = fileSystem.open(path, "r");
+  if (!f || f.isDirectory()) return false;
+
+  uint8_t buf[256];
+  uint32_t crc = 0;
+  bool vars = false;
+  uint8_t prev = 0;
+  while (size_t n = f.read(buf, sizeof(buf))) {
+    crc = crc32Update(crc, buf, n);
+    for (size_t i = 0; i < n && !vars; i++) {
+      vars = (prev == '{' && buf[i] == '{');
+      prev = buf[i];
+    }
+  }
+  f.close();
+
+  tags[path] = {crc, vars};
+  hash = crc;
+  if (templated) *templated = vars;
+  return true;
+}
+
+String ETagCache::format(uint32_t hash) {
+  char buf[12];
+  snprintf(buf, sizeof(buf), "\"%08lx\"", (unsigned long)hash);
+  return String(buf);
+}
+
+String ETagCache::fileETag(const String& path) {
+  uint32_t hash;
+  if (!fileHash(path, hash)) return "";
+  return format(hash);
+}
+
+String ETagCache::pageETag(uint32_t menuHash, const String& activeTab, const String& pageTitle, const String& bodyPath) {
+  uint32_t hash;
+  bool templated = false;
+  if (!fileHash(bodyPath, hash, &templated) || templated) return "";  // Content varies per request
+
+  // Combine everything the rendered page depends on
+  hash = crc32Update(hash, &menuHash, sizeof(menuHash));
+  hash = crc32Update(hash, activeTab.c_str(), activeTab.length() + 1);
+  hash = crc32Update(hash, pageTitle.c_str(), pageTitle.length() + 1);
+  return format(hash);
+}
+
+void ETagCache::invalidate(const String& path) {
+  DPRINTF(0, "[ETagCache::invalidate] %s", path.c_str());
+  String plain = path.endsWith(".gz") ? path.substring(0, path.length() - 3) : path;
+  tags.erase(plain);
+  tags.erase(plain + ".gz");
+}
+
+void ETagCache::clear() {
+  tags.clear();
+}
+
+bool ETagCache::matches(HttpTransport* server, const String& etag) {
+  if (etag.isEmpty() || !server->hasHeader("If-None-Match")) return false;
+  String inm = server->header("If-None-Match");
+  inm.trim();
+  if (inm == "*") return true;
+
+  // Comma separated list of (possibly weak) entity tags
+  int start = 0;
+  while (start < (int)inm.length()) {
+    int comma = inm.indexOf(',', start);
+    String tag = (comma == -1) ? inm.substring(start) : inm.substring(start, comma);
+    tag.trim();
+    if (tag.startsWith("W/")) tag = tag.substring(2);
+    if (tag == etag) return true;
+    if (comma == -1) break;
+    start = comma + 1;
+  }
+  return false;
+}
+
+void ETagCache::sendNotModified(HttpTransport* server, const String& etag) {
+  server->sendHeader("ETag", etag);
+  server->send(304, "text/plain", "");
+}
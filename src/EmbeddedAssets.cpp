@@ -0,0 +1,77 @@
+#include "EmbeddedAssets.h"
+
+#include <map>
+#include <vector>
+
+#if defined(CP_EMBED_ASSETS) && __has_include("EmbeddedAssetsData.h")
+  #include "EmbeddedAssetsData.h"
+#else
+  #define CP_EMBEDDED_ASSET_COUNT 0
+  #define CP_EMBEDDED_ASSET_TABLE
+#endif
+
+// Sorted by path, terminated by an empty entry (so the table is never empty)
+static constexpr EmbeddedAsset ASSETS[] = {
+    CP_EMBEDDED_ASSET_TABLE {nullptr, nullptr, nullptr, 0, nullptr, 0, 0, 0, false}};
+
+static constexpr int pathCompare(const char* a, const char* b) {
+  return (*a != *b || *a == 0) ? (int)(uint8_t)*a - (int)(uint8_t)*b : pathCompare(a + 1, b + 1);
+}
+
+static constexpr bool assetsSorted(size_t i = 1) {
+  return i + 1 > CP_EMBEDDED_ASSET_COUNT || (pathCompare(ASSETS[i - 1].path, ASSETS[i].path) < 0 && assetsSorted(i + 1));
+}
+static_assert(assetsSorted(), "Embedded asset table must be sorted by path");
+
+// Per file system: bit0 = override checked, bit1 = overridden by a file
+static std::map<fs::LittleFSFS*, std::vector<uint8_t>> overrides;
+
+#define OVERRIDE_CHECKED 0x01
+#define OVERRIDE_ACTIVE 0x02
+
+size_t embeddedAssetCount() {
+  return CP_EMBEDDED_ASSET_COUNT;
+}
+
+static int assetIndex(const char* path) {
+  int lo = 0;
+  int hi = (int)CP_EMBEDDED_ASSET_COUNT - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    int cmp = strcmp(path, ASSETS[mid].path);
+    if (cmp == 0) return mid;
+    if (cmp < 0)
+      hi = mid - 1;
+    else
+      lo = mid + 1;
+  }
+  return -1;
+}
+
+const EmbeddedAsset* findEmbeddedAsset(const char* path) {
+  int i = assetIndex(path);
+  return (i < 0) ? nullptr : &ASSETS[i];
+}
+
+const EmbeddedAsset* findEmbeddedAsset(fs::LittleFSFS& fileSystem, const String& path) {
+  int i = assetIndex(path.c_str());
+  if (i < 0) return nullptr;
+
+  std::vector<uint8_t>& flags = overrides[&fileSystem];
+  if (flags.empty()) flags.resize(CP_EMBEDDED_ASSET_COUNT, 0);
+
+  if (!(flags[i] & OVERRIDE_CHECKED)) {
+    bool onFs = fileSystem.exists(path) || fileSystem.exists(path + ".gz");
+    flags[i] = OVERRIDE_CHECKED | (onFs ? OVERRIDE_ACTIVE : 0);
+  }
+  return (flags[i] & OVERRIDE_ACTIVE) ? nullptr : &ASSETS[i];
+}
+
+void refreshEmbeddedAssetOverride(fs::LittleFSFS& fileSystem, const String& path) {
+  String plain = path.endsWith(".gz") ? path.substring(0, path.length() - 3) : path;
+  int i = assetIndex(plain.c_str());
+  if (i < 0) return;
+
+  auto it = overrides.find(&fileSystem);
+  if (it != overrides.end() && !it->second.empty()) it->second[i] = 0;  // Check again on next use
+}
@@ -0,0 +1,87 @@
+#include "FileCache.h"
+
+#include <dprintf.h>
+
+FileCache::FileCache(size_t budget) : maxBytes(budget) {}
+
+FileCache::~FileCache() {
+  clear();
+}
+
+void FileCache::release(Entry& e) {
+  if (e.data) {
+    free(e.data);
+    bytes -= e.length;
+    e.data = nullptr;
+  }
+}
+
+// Frees least recently used contents until needed bytes fit in the budget
+void FileCache::evict(size_t needed) {
+  for (auto it = entries.rbegin(); it != entries.rend() && bytes + needed > maxBytes; ++it) {
+    release(*it);
+  }
+}
+
+const FileCache::Entry& FileCache::get(fs::LittleFSFS& fileSystem, const String& path) {
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->fileSystem != &fileSystem || it->path != path) continue;
+    if (it->data || !it->found || it->length == 0 || it->length > maxBytes) {
+      hitCount++;
+      entries.splice(entries.begin(), entries, it);  // Move to front
+      return entries.front();
+    }
+    entries.erase(it);  // Contents were evicted, load again
+    break;
+  }
+
+  missCount++;
+  Entry e = {&fileSystem, path, nullptr, 0, false};
+  File f = fileSystem.open(path, "r");
+  if (f && !f.isDirectory()) {
+    e.found = true;
+    e.length = f.size();
+    if (e.length > 0 && e.length <= maxBytes) {
+      evict(e.length);
+      e.data = (uint8_t*)((psram && psramFound()) ? ps_malloc(e.length) : malloc(e.length));
+      if (e.data && f.read(e.data, e.length) == e.length) {
+        bytes += e.length;
+      } else {
+        free(e.data);
+        e.data = nullptr;
+      }
+    }
+  }
+  if (f) f.close();
+
+  DPRINTF(0, "[FileCache::get] miss %s (%d bytes cached)", path.c_str(), (int)bytes);
+  entries.push_front(e);
+  while (entries.size() > CP_FILE_CACHE_ENTRIES) {
+    release(entries.back());
+    entries.pop_back();
+  }
+  return entries.front();
+}
+
+void FileCache::invalidate(const String& path) {
+  String plain = path.endsWith(".gz") ? path.substring(0, path.length() - 3) : path;
+  String gz = plain + ".gz";
+  for (auto it = entries.begin(); it != entries.end();) {
+    if (it->path == plain || it->path == gz) {
+      release(*it);
+      it = entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void FileCache::clear() {
+  for (Entry& e : entries) release(e);
+  entries.clear();
+}
+
+void FileCache::setBudget(size_t bytesBudget) {
+  maxBytes = bytesBudget;
+  evict(0);
+}
@@ -0,0 +1,133 @@
+#include "FileLister.h"
+
+#include <dprintf.h>
+
+FileLister::FileLister(fs::FS& fileSystem, bool recursive) : fileSystem(fileSystem), recursive(recursive) {
+  path[0] = 0;
+  last[0] = 0;
+}
+
+bool FileLister::setPath(const char* p, size_t len) {
+  while (len > 1 && p[len - 1] == '/') len--;  // "/logs/" -> "/logs", "/" stays
+  if (len == 0 || len >= sizeof(path)) return false;
+  memcpy(path, p, len);
+  path[len] = 0;
+  pathLen = len;
+  return true;
+}
+
+// Directory level of p below root: 0 for the entries of root itself
+static uint8_t levelOf(const char* p, size_t rootLen) {
+  uint8_t level = 0;
+  const char* rest = p + rootLen;
+  if (*rest == '/') rest++;
+  for (; *rest; rest++) {
+    if (*rest == '/') level++;
+  }
+  return level;
+}
+
+bool FileLister::list(const char* root, const char* after, size_t limit, const Visitor& visit) {
+  DPRINTF(0, "[FileLister::list] %s after %s", root, after ? after : "");
+  this->limit = limit ? limit : 1;
+  this->visit = &visit;
+  visited = 0;
+  more = false;
+  last[0] = 0;
+
+  if (!setPath(root, strlen(root))) return false;
+  File dir = fileSystem.open(path);
+  if (!dir || !dir.isDirectory()) return false;
+  dir.close();
+  if (!after || !*after) {
+    listDir(nullptr, 0);
+    return true;
+  }
+
+  // The cursor has to be an existing entry below root
+  size_t rootLen = pathLen == 1 ? 0 : pathLen;
+  size_t afterLen = strlen(after);
+  if (afterLen <= rootLen + 1 || afterLen >= sizeof(last) || strncmp(after, path, rootLen) != 0 || after[rootLen] != '/')
+    return false;
+  File entry = fileSystem.open(after);
+  if (!entry) return false;
+  bool afterIsDir = entry.isDirectory();
+  entry.close();
+
+  // Copy the cursor, path is reused while listing
+  char cursor[CP_LIST_PATH_MAX];
+  memcpy(cursor, after, afterLen + 1);
+  uint8_t level = levelOf(cursor, rootLen);
+
+  // The children of a directory cursor come right after it
+  if (afterIsDir && recursive && level + 1 < CP_LIST_DEPTH) {
+    setPath(cursor, afterLen);
+    if (!listDir(nullptr, level + 1)) return true;
+  }
+
+  // Then the rest of each directory on the way back up to root
+  size_t childLen = afterLen;
+  while (childLen > rootLen) {
+    size_t parentLen = childLen;
+    while (parentLen > 0 && cursor[parentLen - 1] != '/') parentLen--;
+    const char* name = cursor + parentLen;  // Name of the child in its parent
+    cursor[childLen] = 0;
+    setPath(parentLen > 1 ? cursor : "/", parentLen > 1 ? parentLen - 1 : 1);
+    if (!listDir(name, level)) return true;
+    childLen = parentLen - 1;
+    level--;
+  }
+  return true;
+}
+
+bool FileLister::listDir(const char* skipUntil, uint8_t level) {
+  File dir = fileSystem.open(path);
+  if (!dir || !dir.isDirectory()) return true;
+
+  if (skipUntil) {
+    // Only read names up to the cursor, without opening the entries
+    for (;;) {
+      String next = dir.getNextFileName();
+      if (next.length() == 0) return true;  // Cursor gone, nothing after it
+      const char* slash = strrchr(next.c_str(), '/');
+      if (strcmp(slash ? slash + 1 : next.c_str(), skipUntil) == 0) break;
+    }
+  }
+
+  size_t base = pathLen;
+  for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+    const char* name = file.name();
+    const char* slash = strrchr(name, '/');  // Older cores return the full path
+    if (slash) name = slash + 1;
+
+    if (visited == limit) {
+      more = true;  // At least one more entry
+      return false;
+    }
+
+    size_t nameLen = strlen(name);
+    size_t sep = path[base - 1] == '/' ? 0 : 1;
+    if (base + sep + nameLen >= sizeof(path)) {
+      DPRINTF(2, "Path too long, skipped: %s", name);
+      continue;
+    }
+    pathLen = base;
+    if (sep) path[pathLen++] = '/';
+    memcpy(path + pathLen, name, nameLen + 1);
+    pathLen += nameLen;
+
+    bool isDir = file.isDirectory();
+    FileEntry entry = {path, isDir ? 0 : file.size(), isDir};
+    file.close();
+    (*visit)(entry);
+    visited++;
+    memcpy(last, path, pathLen + 1);
+
+    if (isDir && recursive && level + 1 < CP_LIST_DEPTH) {
+      if (!listDir(nullptr, level + 1)) return false;
+    }
+    pathLen = base;
+    path[pathLen] = 0;
+  }
+  return true;
+}
@@ -0,0 +1,340 @@
+#include "GzipUtil.h"
+
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+
+uint32_t crc32Update(uint32_t crc, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+// GF(2) matrix helpers for crc32Combine (same approach as zlib's crc32_combine)
+static uint32_t gf2MatrixTimes(const uint32_t* mat, uint32_t vec) {
+  uint32_t sum = 0;
+  while (vec) {
+    if (vec & 1) sum ^= *mat;
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+static void gf2MatrixSquare(uint32_t* square, const uint32_t* mat) {
+  for (int n = 0; n < 32; n++) square[n] = gf2MatrixTimes(mat, mat[n]);
+}
+
+uint32_t crc32Combine(uint32_t crcA, uint32_t crcB, size_t lenB) {
+  if (lenB == 0) return crcA;
+
+  uint32_t even[32];  // Even-power-of-two zeros operator
+  uint32_t odd[32];   // Odd-power-of-two zeros operator
+
+  // Operator for one zero bit in odd
+  odd[0] = 0xEDB88320UL;
+  uint32_t row = 1;
+  for (int n = 1; n < 32; n++) {
+    odd[n] = row;
+    row <<= 1;
+  }
+  gf2MatrixSquare(even, odd);  // Two zero bits
+  gf2MatrixSquare(odd, even);  // Four zero bits
+
+  // Apply lenB zero bytes to crcA
+  do {
+    gf2MatrixSquare(even, odd);
+    if (lenB & 1) crcA = gf2MatrixTimes(even, crcA);
+    lenB >>= 1;
+    if (lenB == 0) break;
+
+    gf2MatrixSquare(odd, even);
+    if (lenB & 1) crcA = gf2MatrixTimes(odd, crcA);
+    lenB >>= 1;
+  } while (lenB != 0);
+
+  return crcA ^ crcB;
+}
+
+size_t gzipDataOffset(const uint8_t* header, size_t len) {
+  if (len < GZIP_HEADER_SIZE) return 0;
+  if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8) return 0;  // Not gzip/deflate
+
+  uint8_t flags = header[3];
+  size_t pos = GZIP_HEADER_SIZE;
+
+  if (flags & GZIP_FEXTRA) {
+    if (pos + 2 > len) return 0;
+    pos += 2 + (header[pos] | (header[pos + 1] << 8));
+  }
+  if (flags & GZIP_FNAME) {
+    while (pos < len && header[pos]) pos++;
+    pos++;
+  }
+  if (flags & GZIP_FCOMMENT) {
+    while (pos < len && header[pos]) pos++;
+    pos++;
+  }
+  if (flags & GZIP_FHCRC) pos += 2;
+
+  return (pos < len) ? pos : 0;
+}
+
+void gzipWriteHeader(uint8_t out[GZIP_HEADER_SIZE]) {
+  static const uint8_t header[GZIP_HEADER_SIZE] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+  memcpy(out, header, GZIP_HEADER_SIZE);
+}
+
+void gzipWriteStoredBlockHeader(uint8_t out[GZIP_STORED_BLOCK_HEADER_SIZE], uint16_t len) {
+  out[0] = 0x00;  // BFINAL = 0, BTYPE = 00 (stored)
+  out[1] = len & 0xff;
+  out[2] = len >> 8;
+  out[3] = ~len & 0xff;
+  out[4] = (~len >> 8) & 0xff;
+}
+
+// Reads a deflate stream bit by bit (LSB first) and counts the bits consumed
+struct DeflateBits {
+  const DeflateReader& read;
+  uint8_t buf[64];
+  size_t avail = 0;
+  size_t pos = 0;
+  uint32_t bitBuf = 0;
+  uint8_t bitCount = 0;
+  size_t consumed = 0;  // Bits
+  bool failed = false;  // Ran out of data
+
+  explicit DeflateBits(const DeflateReader& read) : read(read) {}
+
+  bool nextByte(uint8_t& b) {
+    if (pos == avail) {
+      avail = read(buf, sizeof(buf));
+      pos = 0;
+      if (avail == 0) {
+        failed = true;
+        return false;
+      }
+    }
+    b = buf[pos++];
+    return true;
+  }
+
+  uint32_t bits(uint8_t n) {
+    while (bitCount < n) {
+      uint8_t b;
+      if (!nextByte(b)) return 0;
+      bitBuf |= (uint32_t)b << bitCount;
+      bitCount += 8;
+    }
+    uint32_t v = bitBuf & ((1UL << n) - 1);
+    bitBuf >>= n;
+    bitCount -= n;
+    consumed += n;
+    return v;
+  }
+
+  // Drops the bits up to the next byte boundary
+  void align() {
+    consumed += bitCount;
+    bitBuf = 0;
+    bitCount = 0;
+  }
+
+  bool skipBytes(size_t n) {
+    uint8_t b;
+    for (; n; n--) {
+      if (!nextByte(b)) return false;
+      consumed += 8;
+    }
+    return true;
+  }
+};
+
+// Canonical Huffman code as in RFC 1951 3.2.2 (decoded like zlib's puff.c)
+struct DeflateHuffman {
+  int16_t count[16];  // Codes of each length
+  int16_t* symbol;    // Symbols ordered by code
+
+  // Returns 0 for a complete code, > 0 for an incomplete code, < 0 for an oversubscribed one
+  int build(const int16_t* lengths, int n) {
+    int16_t offs[16];
+    for (int len = 0; len < 16; len++) count[len] = 0;
+    for (int sym = 0; sym < n; sym++) count[lengths[sym]]++;
+    if (count[0] == n) return 0;
+
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+      left <<= 1;
+      left -= count[len];
+      if (left < 0) return left;
+    }
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++) offs[len + 1] = offs[len] + count[len];
+    for (int sym = 0; sym < n; sym++) {
+      if (lengths[sym] != 0) symbol[offs[lengths[sym]]++] = sym;
+    }
+    return left;
+  }
+
+  int decode(DeflateBits& in) const {
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++) {
+      code |= in.bits(1);
+      int n = count[len];
+      if (code - n < first) return symbol[index + (code - first)];
+      index += n;
+      first += n;
+      first <<= 1;
+      code <<= 1;
+    }
+    return -1;  // Ran out of codes
+  }
+};
+
+// Extra bits of the length (257..285) and distance codes
+static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                         2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                           6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Skips the codes of a Huffman block up to its end-of-block code
+static bool skipCodes(DeflateBits& in, const DeflateHuffman& lengths, const DeflateHuffman& distances) {
+  for (;;) {
+    int sym = lengths.decode(in);
+    if (in.failed || sym < 0) return false;
+    if (sym == 256) return true;
+    if (sym < 256) continue;  // Literal
+
+    sym -= 257;
+    if (sym >= 29) return false;
+    in.bits(LENGTH_EXTRA[sym]);
+    int dist = distances.decode(in);
+    if (in.failed || dist < 0 || dist >= 30) return false;
+    in.bits(DISTANCE_EXTRA[dist]);
+  }
+}
+
+static bool skipFixedBlock(DeflateBits& in) {
+  int16_t lengths[288 + 30];
+  int16_t lengthSymbols[288], distanceSymbols[30];
+  DeflateHuffman lencode, distcode;
+  lencode.symbol = lengthSymbols;
+  distcode.symbol = distanceSymbols;
+
+  int sym = 0;
+  for (; sym < 144; sym++) lengths[sym] = 8;
+  for (; sym < 256; sym++) lengths[sym] = 9;
+  for (; sym < 280; sym++) lengths[sym] = 7;
+  for (; sym < 288; sym++) lengths[sym] = 8;
+  lencode.build(lengths, 288);
+  for (sym = 0; sym < 30; sym++) lengths[sym] = 5;
+  distcode.build(lengths, 30);
+  return skipCodes(in, lencode, distcode);
+}
+
+static bool skipDynamicBlock(DeflateBits& in) {
+  static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+  int16_t lengths[286 + 30];
+  int16_t lengthSymbols[286], distanceSymbols[30];
+  DeflateHuffman lencode, distcode;
+  lencode.symbol = lengthSymbols;
+  distcode.symbol = distanceSymbols;
+
+  int nlen = in.bits(5) + 257;
+  int ndist = in.bits(5) + 1;
+  int ncode = in.bits(4) + 4;
+  if (in.failed || nlen > 286 || ndist > 30) return false;
+
+  // Code length code, then the literal/length and distance code lengths
+  int index = 0;
+  for (; index < ncode; index++) lengths[order[index]] = in.bits(3);
+  for (; index < 19; index++) lengths[order[index]] = 0;
+  if (in.failed || lencode.build(lengths, 19) != 0) return false;
+
+  index = 0;
+  while (index < nlen + ndist) {
+    int sym = lencode.decode(in);
+    if (in.failed || sym < 0) return false;
+    if (sym < 16) {
+      lengths[index++] = sym;
+      continue;
+    }
+    int16_t len = 0;
+    int repeat;
+    if (sym == 16) {
+      if (index == 0) return false;
+      len = lengths[index - 1];
+      repeat = 3 + in.bits(2);
+    } else if (sym == 17) {
+      repeat = 3 + in.bits(3);
+    } else {
+      repeat = 11 + in.bits(7);
+    }
+    if (index + repeat > nlen + ndist) return false;
+    while (repeat--) lengths[index++] = len;
+  }
+  if (lengths[256] == 0) return false;  // No end-of-block code
+
+  // Incomplete codes are only allowed for a single length
+  int err = lencode.build(lengths, nlen);
+  if (err < 0 || (err > 0 && nlen - lencode.count[0] != 1)) return false;
+  err = distcode.build(lengths + nlen, ndist);
+  if (err < 0 || (err > 0 && ndist - distcode.count[0] != 1)) return false;
+  return skipCodes(in, lencode, distcode);
+}
+
+bool deflateFindEnd(const DeflateReader& read, DeflateEnd& end) {
+  DeflateBits in(read);
+  bool last;
+  do {
+    size_t start = in.consumed;
+    last = in.bits(1);
+    uint32_t type = in.bits(2);
+    bool ok;
+    if (type == 0) {
+      in.align();
+      uint32_t len = in.bits(16);
+      uint32_t nlen = in.bits(16);
+      ok = !in.failed && len == (~nlen & 0xffff) && in.skipBytes(len);
+    } else if (type == 1) {
+      ok = skipFixedBlock(in);
+    } else if (type == 2) {
+      ok = skipDynamicBlock(in);
+    } else {
+      ok = false;
+    }
+    if (!ok || in.failed) return false;
+    end.finalBit = start;
+  } while (!last);
+  end.endBit = in.consumed;
+  return true;
+}
+
+size_t deflateAppendStoredHeader(uint8_t out[DEFLATE_APPEND_HEADER_MAX], uint8_t lastByte, uint8_t usedBits, uint16_t len) {
+  // BFINAL = 1 and BTYPE = 00 (stored) right after the used bits, then up to the byte boundary
+  uint16_t bits = (usedBits < 8 ? lastByte & ((1 << usedBits) - 1) : lastByte) | (1 << usedBits);
+  size_t n = 0;
+  out[n++] = bits & 0xff;
+  if (usedBits + 3 > 8) out[n++] = bits >> 8;
+  out[n++] = len & 0xff;
+  out[n++] = len >> 8;
+  out[n++] = ~len & 0xff;
+  out[n++] = (~len >> 8) & 0xff;
+  return n;
+}
+
+void gzipWriteTrailer(uint8_t out[GZIP_TRAILER_SIZE], uint32_t crc, uint32_t isize) {
+  for (int i = 0; i < 4; i++) {
+    out[i] = (crc >> (8 * i)) & 0xff;
+    out[4 + i] = (isize >> (8 * i)) & 0xff;
+  }
+}
+
+uint32_t gzipReadLE32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
@@ -0,0 +1,130 @@
+#include "JsonWriter.h"
+
+void JsonWriter::separate() {
+  if (afterKey) {
+    afterKey = false;
+    return;
+  }
+  if (depth == 0 || depth > 32) return;
+  uint32_t bit = 1UL << (depth - 1);
+  if (hasItems & bit) out.write(',');
+  hasItems |= bit;
+}
+
+void JsonWriter::open(char c) {
+  separate();
+  out.write(c);
+  depth++;
+  if (depth <= 32) hasItems &= ~(1UL << (depth - 1));
+}
+
+void JsonWriter::close(char c) {
+  if (depth > 0) depth--;
+  afterKey = false;
+  out.write(c);
+}
+
+void JsonWriter::beginObject() {
+  open('{');
+}
+
+void JsonWriter::endObject() {
+  close('}');
+}
+
+void JsonWriter::beginArray() {
+  open('[');
+}
+
+void JsonWriter::endArray() {
+  close(']');
+}
+
+void JsonWriter::key(const char* name) {
+  separate();
+  out.write('"');
+  escape(out, name, strlen(name));
+  out.write("\":", 2);
+  afterKey = true;
+}
+
+void JsonWriter::value(const char* s) {
+  if (!s) {
+    null();
+    return;
+  }
+  value(s, strlen(s));
+}
+
+void JsonWriter::value(const char* s, size_t len) {
+  separate();
+  out.write('"');
+  escape(out, s, len);
+  out.write('"');
+}
+
+void JsonWriter::value(long n) {
+  separate();
+  out.print(n);
+}
+
+void JsonWriter::value(unsigned long n) {
+  separate();
+  out.print(n);
+}
+
+void JsonWriter::value(bool b) {
+  separate();
+  if (b)
+    out.write("true", 4);
+  else
+    out.write("false", 5);
+}
+
+void JsonWriter::null() {
+  separate();
+  out.write("null", 4);
+}
+
+void JsonWriter::escape(Print& out, const char* s, size_t len) {
+  static const char hex[] = "0123456789abcdef";
+  size_t run = 0;  // Start of the current run of plain characters
+  for (size_t i = 0; i < len; i++) {
+    uint8_t c = (uint8_t)s[i];
+    if (c >= 0x20 && c != '"' && c != '\\') continue;  // UTF-8 bytes pass through
+
+    if (i > run) out.write((const uint8_t*)s + run, i - run);
+    run = i + 1;
+
+    char esc[6] = {'\\', 0, '0', '0', 0, 0};
+    switch (c) {
+      case '"':
+      case '\\':
+        esc[1] = (char)c;
+        break;
+      case '\b':
+        esc[1] = 'b';
+        break;
+      case '\f':
+        esc[1] = 'f';
+        break;
+      case '\n':
+        esc[1] = 'n';
+        break;
+      case '\r':
+        esc[1] = 'r';
+        break;
+      case '\t':
+        esc[1] = 't';
+        break;
+      default:  // Other control characters as \u00XX
+        esc[1] = 'u';
+        esc[4] = hex[c >> 4];
+        esc[5] = hex[c & 0x0f];
+        out.write((const uint8_t*)esc, 6);
+        continue;
+    }
+    out.write((const uint8_t*)esc, 2);
+  }
+  if (len > run) out.write((const uint8_t*)s + run, len - run);
+}
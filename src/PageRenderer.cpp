@@ -1,9 +1,22 @@
 #include "PageRenderer.h"
 
 #include <LittleFS.h>
-#include <WebServer.h>  // of ESP32WebServer
+#include <dprintf.h>
+
+#include "EmbeddedAssets.h"
+#include "GzipUtil.h"
+#include "ResponseWriter.h"
+
+String loadFile(fs::LittleFSFS& fileSystem, const String& path, FileCache* cache) {
+  const EmbeddedAsset* asset = findEmbeddedAsset(fileSystem, path);
+  if (asset) return String((const char*)asset->data, asset->length);
+
+  if (cache) {
+    const FileCache::Entry& e = cache->get(fileSystem, path);
+    if (!e.found) return "<h2>404 Not Found</h2>";
+    if (e.data) return String((const char*)e.data, e.length);
+  }
 
-String loadFile(fs::LittleFSFS& fileSystem, const String& path) {
   File f = fileSystem.open(path, "r");
   if (!f) return "<h2>404 Not Found</h2>";
   String content = f.readString();
@@ -11,44 +24,394 @@ String loadFile(fs::LittleFSFS& fileSystem, const String& path) {
   return content;
 }
 
-void streamPageWithMenu(WebServer* server, fs::LittleFSFS& fileSystem,
+bool clientAcceptsGzip(HttpTransport* server) {
+  if (!server->hasHeader("Accept-Encoding")) return false;
+  String enc = server->header("Accept-Encoding");
+  enc.toLowerCase();
+  int pos = enc.indexOf("gzip");
+  if (pos == -1) return false;
+
+  // Honour an explicit "gzip;q=0"
+  int end = enc.indexOf(',', pos);
+  String token = (end == -1) ? enc.substring(pos) : enc.substring(pos, end);
+  int q = token.indexOf("q=");
+  if (q == -1) return true;
+  return token.substring(q + 2).toFloat() > 0.0f;
+}
+
+bool serveFile(HttpTransport* server, fs::LittleFSFS& fileSystem, const String& path,
+               const char* contentType, int code, ETagCache* etags, FileCache* cache) {
+  const EmbeddedAsset* asset = findEmbeddedAsset(fileSystem, path);
+  String gzPath = path + ".gz";
+  bool hasGz;
+  if (asset)
+    hasGz = asset->gzData != nullptr;
+  else if (cache)
+    hasGz = cache->get(fileSystem, gzPath).found;
+  else
+    hasGz = fileSystem.exists(gzPath);
+  bool gzipped = hasGz && clientAcceptsGzip(server);
+
+  // Content from flash or RAM (data), or from a file (f)
+  const uint8_t* data = nullptr;
+  size_t len = 0;
+  File f;
+  if (asset) {
+    data = gzipped ? asset->gzData : asset->data;
+    len = gzipped ? asset->gzLength : asset->length;
+  } else {
+    bool found = true;
+    if (cache) {
+      const FileCache::Entry* e = &cache->get(fileSystem, gzipped ? gzPath : path);
+      if (!e->found && hasGz && !gzipped) {
+        e = &cache->get(fileSystem, gzPath);
+        gzipped = true;
+      }
+      found = e->found;
+      data = e->data;
+      len = e->length;
+    }
+    if (found && !data) {
+      f = fileSystem.open(gzipped ? gzPath : path, "r");
+      if (!f && hasGz && !gzipped) {
+        // Only the compressed file exists, every browser accepts gzip anyway
+        f = fileSystem.open(gzPath, "r");
+        gzipped = true;
+      }
+      if (f) len = f.size();
+    }
+    if (!data && !f) {
+      server->send(404, "text/html", "<h2>404 Not Found</h2>");
+      return false;
+    }
+  }
+
+  if (hasGz) server->sendHeader("Vary", "Accept-Encoding");
+  if (etags) {
+    String etag = etags->fileETag(gzipped ? gzPath : path);
+    if (ETagCache::matches(server, etag)) {
+      if (f) f.close();
+      ETagCache::sendNotModified(server, etag);
+      return true;
+    }
+    if (!etag.isEmpty()) {
+      server->sendHeader("ETag", etag);
+      server->sendHeader("Cache-Control", "no-cache");
+    }
+  }
+  if (gzipped) server->sendHeader("Content-Encoding", "gzip");
+
+  server->setContentLength(len);
+  server->send(code, contentType, "");
+
+  if (data) {
+    // Straight from flash or the file cache, no copy
+    server->sendContent((const char*)data, len);
+    return true;
+  }
+
+  ResponseWriter out(server);
+  out.writeFrom(f);
+  out.end(false);
+  f.close();
+  return true;
+}
+
+void streamPageWithMenu(HttpTransport* server, fs::LittleFSFS& fileSystem,
                         const String& filePath,
                         const String& activeTab,
                         const String& pageTitle) {
+  PageTemplate menu;
+  menu.compile(fileSystem, "/tabmenu.html");
+  streamPageWithMenu(server, fileSystem, menu, filePath, activeTab, pageTitle);
+}
+
+static const char PAGE_HEAD[] =
+    "<!DOCTYPE html><html><head>"
+    "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">"
+    "<link rel=\"preload\" href=\"/styles.css\" as=\"style\" onload=\"this.rel='stylesheet'\" />"
+    "<noscript><link rel=\"stylesheet\" href=\"/styles.css\" /></noscript>"
+    "<title>";
+static const char PAGE_HEAD_END[] = "</title></head><body>";
+static const char PAGE_FOOTER[] = "</body></html>";
+static const char PAGE_NOT_FOUND[] = "<h2>404 Not Found</h2>";
+
+// The {home}, {devices}, {system} and {edit} slots of tabmenu.html
+static bool isMenuTab(const char* name, size_t len) {
+  static const char* const tabs[] = {"home", "devices", "system", "edit"};
+  for (const char* tab : tabs) {
+    if (strlen(tab) == len && strncmp(tab, name, len) == 0) return true;
+  }
+  return false;
+}
+
+// Emits the page head and the rendered menu
+static void emitHeadAndMenu(const PageTemplate& menu, const String& pageTitle,
+                            const PageTemplate::Resolver& slot, const PageTemplate::Emitter& emit) {
+  emit(PAGE_HEAD, sizeof(PAGE_HEAD) - 1);
+  emit(pageTitle.c_str(), pageTitle.length());
+  emit(PAGE_HEAD_END, sizeof(PAGE_HEAD_END) - 1);
+  menu.render(emit, slot);
+}
+
+// Body of a menu page: a file on the web file system or an embedded asset
+struct PageBody {
+  File file;
+  const uint8_t* data = nullptr;  // Embedded content, used instead of file
+  size_t offset = 0;              // Start of the bytes to send (gzip: deflate data)
+  size_t length = 0;              // Number of bytes to send
+  bool gzipped = false;           // true: deflate data of a gzip member
+  uint32_t gzCrc = 0;             // gzip trailer: CRC32 of the uncompressed body
+  uint32_t gzSize = 0;            // gzip trailer: uncompressed size
+  DeflateEnd end;                 // gzip: last deflate block, the footer block follows it
+  bool found() const { return file || data; }
+};
+
+// Locates the deflate data and trailer of a gzip member
+static bool parseGzip(const uint8_t* header, size_t headerLen, const uint8_t* trailer, size_t size, PageBody& body) {
+  body.offset = gzipDataOffset(header, headerLen);
+  if (body.offset == 0 || size < body.offset + GZIP_TRAILER_SIZE) return false;
+  body.length = size - body.offset - GZIP_TRAILER_SIZE;
+  body.gzCrc = gzipReadLE32(trailer);
+  body.gzSize = gzipReadLE32(trailer + 4);
+  body.gzipped = true;
+  return true;
+}
+
+static void openPageBody(fs::LittleFSFS& fileSystem, const String& filePath, bool acceptGzip, FileCache* cache, PageBody& body) {
+  const EmbeddedAsset* asset = findEmbeddedAsset(fileSystem, filePath);
+
+  if (asset) {
+    if (acceptGzip && asset->gzData &&
+        parseGzip(asset->gzData, asset->gzLength, asset->gzData + asset->gzLength - GZIP_TRAILER_SIZE, asset->gzLength, body)) {
+      body.data = asset->gzData;
+      return;
+    }
+    body.data = asset->data;
+    body.length = asset->length;
+    return;
+  }
+
+  if (cache) {
+    // Cached contents behave like embedded assets
+    if (acceptGzip) {
+      const FileCache::Entry& gz = cache->get(fileSystem, filePath + ".gz");
+      if (gz.data && parseGzip(gz.data, gz.length, gz.data + gz.length - GZIP_TRAILER_SIZE, gz.length, body)) {
+        body.data = gz.data;
+        return;
+      }
+      body.gzipped = false;
+      if (!gz.data && !gz.found) acceptGzip = false;  // No need to look for it again
+    }
+    if (!acceptGzip) {
+      const FileCache::Entry& plain = cache->get(fileSystem, filePath);
+      if (plain.data) {
+        body.data = plain.data;
+        body.length = plain.length;
+        return;
+      }
+      if (!plain.found) return;
+    }
+  }
+
+  if (acceptGzip) {
+    File gz = fileSystem.open(filePath + ".gz", "r");
+    if (gz) {
+      uint8_t hdr[128];
+      uint8_t trailer[GZIP_TRAILER_SIZE];
+      size_t n = gz.read(hdr, sizeof(hdr));
+      if (gz.size() > GZIP_TRAILER_SIZE && gz.seek(gz.size() - GZIP_TRAILER_SIZE) &&
+          gz.read(trailer, sizeof(trailer)) == sizeof(trailer) &&
+          parseGzip(hdr, n, trailer, gz.size(), body) && gz.seek(body.offset)) {
+        body.file = gz;
+        return;
+      }
+      body.gzipped = false;
+      gz.close();
+    }
+  }
+
+  body.file = fileSystem.open(filePath, "r");
+  if (body.file) body.length = body.file.size();
+}
+
+// Bodies whose last deflate block was located before, identified by their trailer and length
+struct DeflateEndEntry {
+  uint32_t crc;
+  uint32_t size;
+  size_t length;
+  DeflateEnd end;
+};
+static DeflateEndEntry s_deflateEnds[4];
+static uint8_t s_nextDeflateEnd = 0;
+
+// Locates the last deflate block of a gzip body, false if the footer cannot be appended to it
+static bool findDeflateEnd(PageBody& body) {
+  for (const DeflateEndEntry& e : s_deflateEnds) {
+    if (e.length && e.length == body.length && e.crc == body.gzCrc && e.size == body.gzSize) {
+      body.end = e.end;
+      return true;
+    }
+  }
+
+  size_t pos = 0;
+  bool ok = deflateFindEnd(
+      [&](uint8_t* buf, size_t len) {
+        size_t n = std::min(len, body.length - pos);
+        if (body.data)
+          memcpy(buf, body.data + body.offset + pos, n);
+        else
+          n = body.file.read(buf, n);
+        pos += n;
+        return n;
+      },
+      body.end);
+  if (body.file && !body.file.seek(body.offset)) ok = false;
+  // The footer block starts in the last byte of the body
+  if (!ok || body.length == 0 || (body.end.endBit + 7) / 8 != body.length) {
+    DPRINTF(2, "Invalid deflate data, sending the plain page");
+    return false;
+  }
+
+  s_deflateEnds[s_nextDeflateEnd] = {body.gzCrc, body.gzSize, body.length, body.end};
+  s_nextDeflateEnd = (s_nextDeflateEnd + 1) % (sizeof(s_deflateEnds) / sizeof(s_deflateEnds[0]));
+  return true;
+}
+
+// Sends the deflate data of a gzip body with its last block made non-final, except for the
+// last byte: that one is returned, the footer block starts in it
+static uint8_t writeDeflateBody(ResponseWriter& out, PageBody& body) {
+  size_t last = body.length - 1;
+  size_t finalByte = body.end.finalBit / 8;
+  auto copy = [&](size_t from, size_t count) {
+    if (body.data)
+      out.write(body.data + body.offset + from, count);
+    else
+      out.writeFrom(body.file, count);
+  };
+  auto byteAt = [&](size_t at) -> uint8_t {
+    if (body.data) return body.data[body.offset + at];
+    int c = body.file.read();
+    return c < 0 ? 0 : (uint8_t)c;
+  };
+
+  copy(0, finalByte);
+  uint8_t b = byteAt(finalByte) & ~(1 << (body.end.finalBit % 8));  // Clear BFINAL
+  if (finalByte == last) return b;
+  out.write(b);
+  copy(finalByte + 1, last - finalByte - 1);
+  return byteAt(last);
+}
+
+void streamPageWithMenu(HttpTransport* server, fs::LittleFSFS& fileSystem,
+                        const PageTemplate& menu,
+                        const String& filePath,
+                        const String& activeTab,
+                        const String& pageTitle,
+                        ETagCache* etags,
+                        const TemplateVars* vars,
+                        FileCache* cache) {
+  PageTemplate::Resolver activeSlot = [&](const char* name, size_t len) -> const char* {
+    if (!isMenuTab(name, len)) return nullptr;  // Other {...} text is copied as it is
+    return (activeTab.length() == len && strncmp(activeTab.c_str(), name, len) == 0) ? "active" : "";
+  };
+
+  // Pre-compressed body? Head + menu must then fit in one stored deflate block.
+  // {{variables}} can only be replaced in the plain body
+  size_t prefixLen = 0;
+  bool acceptGzip = !vars && clientAcceptsGzip(server);
+  if (acceptGzip) {
+    emitHeadAndMenu(menu, pageTitle, activeSlot, [&](const char*, size_t len) { prefixLen += len; });
+    acceptGzip = prefixLen <= 0xffff;
+  }
+
+  PageBody body;
+  openPageBody(fileSystem, filePath, acceptGzip, cache, body);
+  if (body.gzipped && !findDeflateEnd(body)) {
+    if (body.file) body.file.close();
+    body = PageBody();
+    openPageBody(fileSystem, filePath, false, cache, body);
+  }
+
+  // Page variant unchanged since the client's copy?
+  if (etags) {
+    String etag = etags->pageETag(menu.hash(), activeTab, pageTitle, body.gzipped ? filePath + ".gz" : filePath);
+    if (ETagCache::matches(server, etag)) {
+      if (body.file) body.file.close();
+      ETagCache::sendNotModified(server, etag);
+      return;
+    }
+    if (!etag.isEmpty()) server->sendHeader("ETag", etag);
+  }
+
   // 1. Begin chunked response
+  if (body.gzipped) {
+    server->sendHeader("Content-Encoding", "gzip");
+    server->sendHeader("Vary", "Accept-Encoding");
+  }
   server->setContentLength(CONTENT_LENGTH_UNKNOWN);
   server->send(200, "text/html", "");
 
-  // 2. Menu en head in een paar kleine stukken
-  String menu = loadFile(fileSystem, "/tabmenu.html");
-  menu.replace("{home}", activeTab == "home" ? "active" : "");
-  menu.replace("{devices}", activeTab == "devices" ? "active" : "");
-  menu.replace("{system}", activeTab == "system" ? "active" : "");
-  menu.replace("{edit}", activeTab == "edit" ? "active" : "");
-
-  String head = "<!DOCTYPE html><html><head>";
-  head += "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">";
-  head += "<link rel=\"preload\" href=\"/styles.css\" as=\"style\" onload=\"this.rel='stylesheet'\" />";
-  head += "<noscript><link rel=\"stylesheet\" href=\"/styles.css\" /></noscript>";
-  head += "<title>" + pageTitle + "</title>";
-  head += "</head><body>";
-
-  server->sendContent(head);
-  server->sendContent(menu);
-
-  // 3. Body file in kleine chunks streamen
-  File f = fileSystem.open(filePath, "r");
-  if (!f) {
-    server->sendContent("<h2>404 Not Found</h2>");
+  // Alles via out, die alleen volle chunks verstuurt
+  ResponseWriter out(server);
+  uint32_t prefixCrc = 0;
+
+  if (body.gzipped) {
+    // 2. Head + menu als stored deflate blok, gevolgd door de deflate data van de body
+    uint8_t hdr[GZIP_HEADER_SIZE + GZIP_STORED_BLOCK_HEADER_SIZE];
+    gzipWriteHeader(hdr);
+    gzipWriteStoredBlockHeader(hdr + GZIP_HEADER_SIZE, (uint16_t)prefixLen);
+    out.write(hdr, sizeof(hdr));
+
+    emitHeadAndMenu(menu, pageTitle, activeSlot, [&](const char* data, size_t len) {
+      out.write((const uint8_t*)data, len);
+      prefixCrc = crc32Update(prefixCrc, data, len);
+    });
   } else {
-    static char buf[512];
-    while (int n = f.readBytes(buf, sizeof(buf))) {
-      server->sendContent(String(buf, n));
+    // 2. Head en menu
+    emitHeadAndMenu(menu, pageTitle, activeSlot, [&](const char* data, size_t len) { out.write((const uint8_t*)data, len); });
+  }
+
+  // 3. Body (gzip: deflate data zonder gzip header en trailer)
+  uint8_t lastByte = 0;  // gzip: laatste byte van de body, het footer blok begint daarin
+  if (body.gzipped) {
+    lastByte = writeDeflateBody(out, body);
+    if (body.file) body.file.close();
+  } else if (vars && body.found()) {
+    // Variabelen vervangen tijdens het streamen
+    TemplateStreamer expander(*vars, out);
+    if (body.data) {
+      expander.feed((const char*)body.data, body.length);
+    } else {
+      char buf[256];
+      while (size_t n = body.file.readBytes(buf, sizeof(buf))) expander.feed(buf, n);
+      body.file.close();
     }
-    f.close();
+    expander.finish();
+  } else if (body.data) {
+    out.write(body.data + body.offset, body.length);
+  } else if (body.file) {
+    out.writeFrom(body.file, body.length);
+    body.file.close();
+  } else {
+    out.write(PAGE_NOT_FOUND);
   }
 
-  // 4. Sluit HTML af
-  server->sendContent("</body></html>");
-  server->sendContent("");  // flush
+  if (body.gzipped) {
+    // 4. Footer als laatste stored blok, dan de trailer over head + menu + body + footer
+    const size_t footerLen = sizeof(PAGE_FOOTER) - 1;
+    uint8_t tail[DEFLATE_APPEND_HEADER_MAX];
+    out.write(tail, deflateAppendStoredHeader(tail, lastByte, body.end.endBit - (body.length - 1) * 8, footerLen));
+    out.write(PAGE_FOOTER);
+
+    uint32_t crc = crc32Combine(prefixCrc, body.gzCrc, body.gzSize);
+    crc = crc32Combine(crc, crc32Update(0, PAGE_FOOTER, footerLen), footerLen);
+    uint8_t trailer[GZIP_TRAILER_SIZE];
+    gzipWriteTrailer(trailer, crc, prefixLen + body.gzSize + footerLen);
+    out.write(trailer, sizeof(trailer));
+  } else {
+    // 4. Sluit HTML af
+    out.write(PAGE_FOOTER);
+  }
+  out.end();
 }
@@ -0,0 +1,78 @@
+#include "PageTemplate.h"
+
+#include <dprintf.h>
+
+#include "EmbeddedAssets.h"
+#include "GzipUtil.h"
+#include "PageRenderer.h"
+
+static bool isSlotChar(char c) {
+  return isalnum((unsigned char)c) || c == '_';
+}
+
+bool PageTemplate::compile(fs::LittleFSFS& fileSystem, const String& path) {
+  DPRINTF(0, "[PageTemplate::compile] %s", path.c_str());
+  bool found = findEmbeddedAsset(fileSystem, path) || fileSystem.exists(path);
+  compile(loadFile(fileSystem, path));
+  return found;
+}
+
+void PageTemplate::compile(const String& source) {
+  text = source;
+  segments.clear();
+
+  const char* s = text.c_str();
+  size_t len = text.length();
+  size_t literalStart = 0;
+  size_t i = 0;
+
+  while (i < len) {
+    if (s[i] != '{') {
+      i++;
+      continue;
+    }
+
+    // Scan a candidate {name}
+    size_t nameStart = i + 1;
+    size_t j = nameStart;
+    while (j < len && isSlotChar(s[j])) j++;
+    if (j == nameStart || j >= len || s[j] != '}') {
+      i++;  // Not a placeholder, keep as literal text
+      continue;
+    }
+
+    if (i > literalStart) segments.push_back({(uint32_t)literalStart, (uint32_t)(i - literalStart), false});
+    segments.push_back({(uint32_t)nameStart, (uint32_t)(j - nameStart), true});
+    i = j + 1;
+    literalStart = i;
+  }
+  if (len > literalStart) segments.push_back({(uint32_t)literalStart, (uint32_t)(len - literalStart), false});
+
+  segments.shrink_to_fit();
+  textHash = crc32Update(0, s, len);
+  compiled = true;
+  DPRINTF(0, "  %d segment(s)", (int)segments.size());
+}
+
+size_t PageTemplate::literalLength() const {
+  size_t total = 0;
+  for (const Segment& seg : segments) {
+    if (!seg.slot) total += seg.length;
+  }
+  return total;
+}
+
+void PageTemplate::render(const Emitter& emit, const Resolver& resolve) const {
+  const char* s = text.c_str();
+  for (const Segment& seg : segments) {
+    if (!seg.slot) {
+      emit(s + seg.offset, seg.length);
+      continue;
+    }
+    const char* value = resolve(s + seg.offset, seg.length);
+    if (!value)
+      emit(s + seg.offset - 1, seg.length + 2);  // Not ours: the braces and the name
+    else if (*value)
+      emit(value, strlen(value));
+  }
+}
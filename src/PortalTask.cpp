@@ -0,0 +1,127 @@
+#include "PortalTask.h"
+
+#include <dprintf.h>
+
+#ifdef ESP32
+
+PortalMutex::PortalMutex() : handle(xSemaphoreCreateRecursiveMutex()) {}
+
+PortalMutex::~PortalMutex() {
+  if (handle) vSemaphoreDelete(handle);
+}
+
+void PortalMutex::lock() {
+  xSemaphoreTakeRecursive(handle, portMAX_DELAY);
+}
+
+void PortalMutex::unlock() {
+  xSemaphoreGiveRecursive(handle);
+}
+
+#else
+
+PortalMutex::PortalMutex() {}
+PortalMutex::~PortalMutex() {}
+
+void PortalMutex::lock() {
+  mutex.lock();
+}
+
+void PortalMutex::unlock() {
+  mutex.unlock();
+}
+
+#endif
+
+PortalTask::~PortalTask() {
+  stop();
+}
+
+void PortalTask::run() {
+  while (!stopRequested) {
+    taskBody();
+#ifdef ESP32
+    TickType_t ticks = pdMS_TO_TICKS(idleDelay);
+    vTaskDelay(ticks ? ticks : 1);  // Always yield, so lower priority tasks (and the idle task) can run
+#else
+    std::this_thread::sleep_for(std::chrono::milliseconds(idleDelay));
+#endif
+  }
+  active = false;
+}
+
+bool PortalTask::start(const char* name, Body body, const PortalTaskConfig& config) {
+  DPRINTF(0, "[PortalTask::start] %s (stack %u, prio %u, core %d)", name, (unsigned)config.stackSize,
+          (unsigned)config.priority, (int)config.core);
+  if (active) return true;
+
+  taskBody = body;
+  idleDelay = config.idleDelay;
+  stopRequested = false;
+  active = true;
+
+#ifdef ESP32
+  deleting = false;
+  BaseType_t core = config.core < 0 ? tskNO_AFFINITY : config.core;
+  if (xTaskCreatePinnedToCore(entry, name, config.stackSize, this, config.priority, &handle, core) != pdPASS) {
+    DPRINTF(3, "Failed to create task %s", name);
+    handle = nullptr;
+    active = false;
+    return false;
+  }
+#else
+  if (thread.joinable()) thread.join();  // Previous run was stopped from its own thread
+  thread = std::thread(&PortalTask::run, this);
+#endif
+  return true;
+}
+
+bool PortalTask::stop(uint32_t timeoutMs) {
+  stopRequested = true;
+
+#ifdef ESP32
+  if (!handle) return true;
+  if (xTaskGetCurrentTaskHandle() == handle) return true;  // Exits when the current iteration returns
+
+  unsigned long startMs = millis();
+  while (active) {
+    if (millis() - startMs >= timeoutMs) {
+      DPRINTF(3, "[PortalTask::stop] Task did not stop within %u ms", (unsigned)timeoutMs);
+      return false;
+    }
+    vTaskDelay(1);
+  }
+  handle = nullptr;
+#else
+  (void)timeoutMs;  // join() waits for the current iteration to return
+  if (!thread.joinable()) return true;
+  if (thread.get_id() == std::this_thread::get_id()) return true;  // Joined by the next start() or the destructor
+  thread.join();
+#endif
+  return true;
+}
+
+void PortalTask::kill() {
+#ifdef ESP32
+  stopRequested = true;
+  if (!handle) return;
+  if (xTaskGetCurrentTaskHandle() == handle) return;  // Exits when the current iteration returns
+  if (!deleting.exchange(true)) {
+    DPRINTF(3, "[PortalTask::kill] Deleting a task that did not stop");
+    vTaskDelete(handle);
+  }
+  active = false;
+  handle = nullptr;
+#else
+  stop();
+#endif
+}
+
+#ifdef ESP32
+void PortalTask::entry(void* arg) {
+  PortalTask* task = static_cast<PortalTask*>(arg);
+  task->run();
+  if (!task->deleting.exchange(true)) vTaskDelete(nullptr);
+  vTaskSuspend(nullptr);  // kill() is deleting this task
+}
+#endif
@@ -0,0 +1,88 @@
+#include "ResponseWriter.h"
+
+ResponseWriter::ResponseWriter(HttpTransport* server) : server(server) {}
+
+ResponseWriter::~ResponseWriter() {
+  if (ended) return;
+  if (contentType)
+    end();  // begin() was called, complete the response
+  else
+    flush();
+}
+
+void ResponseWriter::begin(int code, const char* contentType) {
+  this->code = code;
+  this->contentType = contentType;
+}
+
+void ResponseWriter::sendHeaders(size_t length) {
+  server->setContentLength(length);
+  server->send(code, contentType, "");
+  code = 0;
+}
+
+size_t ResponseWriter::write(uint8_t c) {
+  buf[used++] = (char)c;
+  byteCount++;
+  if (used == sizeof(buf)) flush();
+  return 1;
+}
+
+size_t ResponseWriter::write(const uint8_t* data, size_t len) {
+  size_t total = len;
+  if (used == 0 && len >= sizeof(buf)) {
+    // Already chunk sized, send it without copying (e.g. embedded assets in flash)
+    if (code) sendHeaders(CONTENT_LENGTH_UNKNOWN);
+    server->sendContent((const char*)data, len);
+    chunkCount++;
+    byteCount += len;
+    return len;
+  }
+  while (len > 0) {
+    size_t n = sizeof(buf) - used;
+    if (n > len) n = len;
+    memcpy(buf + used, data, n);
+    used += n;
+    data += n;
+    len -= n;
+    if (used == sizeof(buf)) flush();
+  }
+  byteCount += total;
+  return total;
+}
+
+size_t ResponseWriter::writeFrom(Stream& in, size_t maxLen) {
+  size_t total = 0;
+  while (total < maxLen) {
+    size_t n = sizeof(buf) - used;
+    if (n > maxLen - total) n = maxLen - total;
+    n = in.readBytes(buf + used, n);
+    if (n == 0) break;
+    used += n;
+    total += n;
+    if (used == sizeof(buf)) flush();
+  }
+  byteCount += total;
+  return total;
+}
+
+void ResponseWriter::flush() {
+  if (used == 0) return;
+  if (code) sendHeaders(CONTENT_LENGTH_UNKNOWN);  // More content may follow
+  server->sendContent(buf, used);
+  chunkCount++;
+  used = 0;
+}
+
+void ResponseWriter::end(bool chunked) {
+  if (code) {
+    // Everything fits in the buffer, send it with its length
+    sendHeaders(used);
+    chunked = false;
+  } else if (contentType) {
+    chunked = true;  // begin() was called and the headers went out chunked
+  }
+  flush();
+  if (chunked) server->sendContent("", 0);  // Terminating chunk
+  ended = true;
+}
@@ -0,0 +1,57 @@
+#include "SaveScheduler.h"
+
+SaveScheduler::SaveScheduler(uint32_t debounceMs, uint32_t maxDelayMs) : debounceWindow(debounceMs), maxDelay(maxDelayMs) {}
+
+void SaveScheduler::setWindow(uint32_t debounceMs, uint32_t maxDelayMs) {
+  debounceWindow = debounceMs;
+  maxDelay = maxDelayMs < debounceMs ? debounceMs : maxDelayMs;
+}
+
+void SaveScheduler::request(unsigned long now) {
+  counters.requested++;
+  if (!pending) firstChange = now;
+  lastChange = now;
+  pending = true;
+}
+
+bool SaveScheduler::isDue(unsigned long now) const {
+  if (!pending) return false;
+  return now - lastChange >= debounceWindow || now - firstChange >= maxDelay;  // Unsigned, survives millis() wrap
+}
+
+void SaveScheduler::cancel() {
+  pending = false;
+}
+
+bool SaveScheduler::isUnchanged(uint32_t crc, size_t size) const {
+  return flashKnown && crc == flashCrc && size == flashSize;
+}
+
+void SaveScheduler::skipped() {
+  counters.skipped++;
+  pending = false;
+}
+
+void SaveScheduler::written(uint32_t crc, size_t size) {
+  counters.performed++;
+  counters.bytesWritten += size;
+  setFlashContent(crc, size);
+  pending = false;
+}
+
+void SaveScheduler::failed(unsigned long now) {
+  counters.failed++;
+  forgetFlashContent();
+  pending = true;
+  firstChange = lastChange = now;  // Try again one window later
+}
+
+void SaveScheduler::setFlashContent(uint32_t crc, size_t size) {
+  flashKnown = true;
+  flashCrc = crc;
+  flashSize = size;
+}
+
+void SaveScheduler::forgetFlashContent() {
+  flashKnown = false;
+}
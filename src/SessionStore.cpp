@@ -0,0 +1,149 @@
+#include "SessionStore.h"
+
+#include <dprintf.h>
+
+SessionStore::SessionStore(size_t maxSessions, uint32_t timeoutMs) : maxCount(maxSessions ? maxSessions : 1), timeout(timeoutMs) {
+  slotCount = 1;
+  while (slotCount < maxCount * 2) slotCount <<= 1;
+  slots = new Slot[slotCount];
+  clear();
+}
+
+SessionStore::~SessionStore() {
+  delete[] slots;
+}
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool SessionStore::parse(const String& sid, uint8_t id[CP_SESSION_ID_SIZE]) {
+  if (sid.length() != CP_SESSION_ID_SIZE * 2) return false;
+  const char* s = sid.c_str();
+  for (size_t i = 0; i < CP_SESSION_ID_SIZE; i++) {
+    int hi = hexValue(s[2 * i]);
+    int lo = hexValue(s[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    id[i] = (uint8_t)((hi << 4) | lo);
+  }
+  return true;
+}
+
+// IDs are random, so their first bytes make a good hash
+size_t SessionStore::home(const uint8_t id[CP_SESSION_ID_SIZE]) const {
+  uint32_t h = (uint32_t)id[0] | ((uint32_t)id[1] << 8) | ((uint32_t)id[2] << 16) | ((uint32_t)id[3] << 24);
+  return h & (slotCount - 1);
+}
+
+int SessionStore::find(const uint8_t id[CP_SESSION_ID_SIZE]) const {
+  for (size_t i = home(id), n = 0; n < slotCount; i = (i + 1) & (slotCount - 1), n++) {
+    if (!slots[i].used) return -1;
+    if (memcmp(slots[i].id, id, CP_SESSION_ID_SIZE) == 0) return (int)i;
+  }
+  return -1;
+}
+
+// Backward shift deletion: move later entries of the probe sequence into the gap
+void SessionStore::erase(size_t index) {
+  size_t gap = index;
+  size_t i = index;
+  for (;;) {
+    i = (i + 1) & (slotCount - 1);
+    if (!slots[i].used) break;
+    size_t h = home(slots[i].id);
+    // Move i into the gap unless its home lies cyclically in (gap, i]
+    bool inRange = (gap <= i) ? (gap < h && h <= i) : (gap < h || h <= i);
+    if (!inRange) {
+      slots[gap] = slots[i];
+      gap = i;
+    }
+  }
+  slots[gap].used = false;
+  count--;
+}
+
+String SessionStore::create() {
+  uint32_t now = millis();
+
+  if (count >= maxCount) {
+    sweep();
+    if (count >= maxCount) {
+      // Evict the least recently used session
+      size_t lru = 0;
+      bool first = true;
+      for (size_t i = 0; i < slotCount; i++) {
+        if (!slots[i].used) continue;
+        if (first || (uint32_t)(now - slots[i].lastUsed) > (uint32_t)(now - slots[lru].lastUsed)) lru = i;
+        first = false;
+      }
+      DPRINTF(1, "Session table full, evicting least recently used session");
+      erase(lru);
+    }
+  }
+
+  uint8_t id[CP_SESSION_ID_SIZE];
+  do {
+    esp_fill_random(id, sizeof(id));
+  } while (find(id) >= 0);
+
+  size_t i = home(id);
+  while (slots[i].used) i = (i + 1) & (slotCount - 1);
+  memcpy(slots[i].id, id, sizeof(id));
+  slots[i].created = now;
+  slots[i].lastUsed = now;
+  slots[i].used = true;
+  count++;
+
+  char buf[CP_SESSION_ID_SIZE * 2 + 1];
+  for (size_t k = 0; k < CP_SESSION_ID_SIZE; k++) {
+    buf[2 * k] = "0123456789abcdef"[id[k] >> 4];
+    buf[2 * k + 1] = "0123456789abcdef"[id[k] & 0x0f];
+  }
+  buf[sizeof(buf) - 1] = 0;
+  return String(buf);
+}
+
+bool SessionStore::isValid(const String& sid) {
+  uint8_t id[CP_SESSION_ID_SIZE];
+  if (!parse(sid, id)) return false;
+  int i = find(id);
+  if (i < 0) return false;
+
+  uint32_t now = millis();
+  if (expired(slots[i], now)) {
+    erase(i);
+    return false;
+  }
+  slots[i].lastUsed = now;
+  return true;
+}
+
+void SessionStore::remove(const String& sid) {
+  uint8_t id[CP_SESSION_ID_SIZE];
+  if (!parse(sid, id)) return;
+  int i = find(id);
+  if (i >= 0) erase(i);
+}
+
+void SessionStore::clear() {
+  for (size_t i = 0; i < slotCount; i++) slots[i].used = false;
+  count = 0;
+}
+
+size_t SessionStore::sweep() {
+  uint32_t now = millis();
+  size_t removed = 0;
+  size_t i = 0;
+  while (i < slotCount) {
+    if (slots[i].used && expired(slots[i], now)) {
+      erase(i);  // May shift another entry into i, check it again
+      removed++;
+    } else {
+      i++;
+    }
+  }
+  return removed;
+}
@@ -0,0 +1,145 @@
+#include "SessionTokens.h"
+
+#include <dprintf.h>
+#include <mbedtls/md.h>
+#include <time.h>
+
+static void putLE32(uint8_t* p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xff;
+}
+
+static uint32_t getLE32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void toHex(const uint8_t* data, size_t len, char* out) {
+  for (size_t i = 0; i < len; i++) {
+    out[2 * i] = "0123456789abcdef"[data[i] >> 4];
+    out[2 * i + 1] = "0123456789abcdef"[data[i] & 0x0f];
+  }
+}
+
+static bool fromHex(const char* in, size_t len, uint8_t* out) {
+  for (size_t i = 0; i < len; i++) {
+    uint8_t v = 0;
+    for (int k = 0; k < 2; k++) {
+      char c = in[2 * i + k];
+      v <<= 4;
+      if (c >= '0' && c <= '9')
+        v |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        v |= c - 'a' + 10;
+      else
+        return false;
+    }
+    out[i] = v;
+  }
+  return true;
+}
+
+bool SessionTokens::begin(fs::LittleFSFS& fs, const char* keyFile) {
+  DPRINTF(0, "[SessionTokens::begin] %s", keyFile);
+  fileSystem = &fs;
+  keyPath = keyFile;
+
+  File f = fs.open(keyPath, "r");
+  if (f) {
+    uint8_t buf[CP_SESSION_KEY_SIZE + 4];
+    bool ok = f.read(buf, sizeof(buf)) == sizeof(buf);
+    f.close();
+    if (ok) {
+      memcpy(secret, buf, CP_SESSION_KEY_SIZE);
+      keyEpoch = getLE32(buf + CP_SESSION_KEY_SIZE);
+      loaded = true;
+      return true;
+    }
+    DPRINTF(2, "Session key file invalid, creating a new key");
+  }
+
+  // First use: create a new secret
+  esp_fill_random(secret, sizeof(secret));
+  keyEpoch = 0;
+  loaded = save();
+  return loaded;
+}
+
+bool SessionTokens::removeKey(fs::LittleFSFS& fs, const char* keyFile) {
+  DPRINTF(0, "[SessionTokens::removeKey] %s", keyFile);
+  return !fs.exists(keyFile) || fs.remove(keyFile);
+}
+
+bool SessionTokens::save() {
+  if (!fileSystem) return false;
+  uint8_t buf[CP_SESSION_KEY_SIZE + 4];
+  memcpy(buf, secret, CP_SESSION_KEY_SIZE);
+  putLE32(buf + CP_SESSION_KEY_SIZE, keyEpoch);
+
+  File f = fileSystem->open(keyPath, "w");
+  if (!f) {
+    DPRINTF(3, "Failed to save session key");
+    return false;
+  }
+  bool ok = f.write(buf, sizeof(buf)) == sizeof(buf);
+  f.close();
+  return ok;
+}
+
+void SessionTokens::sign(uint32_t expiry, uint32_t nonce, uint8_t mac[CP_SESSION_MAC_SIZE]) const {
+  uint8_t msg[12];
+  putLE32(msg, expiry);
+  putLE32(msg + 4, nonce);
+  putLE32(msg + 8, keyEpoch);
+
+  uint8_t full[32];
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), secret, sizeof(secret), msg, sizeof(msg), full);
+  memcpy(mac, full, CP_SESSION_MAC_SIZE);
+}
+
+String SessionTokens::issue(uint32_t lifetime) {
+  if (!loaded) return "";
+
+  uint8_t raw[8 + CP_SESSION_MAC_SIZE];
+  uint32_t expiry = (uint32_t)time(nullptr) + lifetime;
+  uint32_t nonce = esp_random();
+  uint8_t be[8] = {(uint8_t)(expiry >> 24), (uint8_t)(expiry >> 16), (uint8_t)(expiry >> 8), (uint8_t)expiry,
+                   (uint8_t)(nonce >> 24), (uint8_t)(nonce >> 16), (uint8_t)(nonce >> 8), (uint8_t)nonce};
+  memcpy(raw, be, sizeof(be));
+  sign(expiry, nonce, raw + 8);
+
+  char buf[CP_SESSION_TOKEN_LENGTH + 1];
+  toHex(raw, sizeof(raw), buf);
+  buf[CP_SESSION_TOKEN_LENGTH] = 0;
+  return String(buf);
+}
+
+bool SessionTokens::isValid(const String& token, uint32_t maxLifetime) const {
+  if (!loaded || token.length() != CP_SESSION_TOKEN_LENGTH) return false;
+
+  uint8_t raw[8 + CP_SESSION_MAC_SIZE];
+  if (!fromHex(token.c_str(), sizeof(raw), raw)) return false;
+
+  uint32_t expiry = ((uint32_t)raw[0] << 24) | ((uint32_t)raw[1] << 16) | ((uint32_t)raw[2] << 8) | raw[3];
+  uint32_t nonce = ((uint32_t)raw[4] << 24) | ((uint32_t)raw[5] << 16) | ((uint32_t)raw[6] << 8) | raw[7];
+
+  uint8_t mac[CP_SESSION_MAC_SIZE];
+  sign(expiry, nonce, mac);
+
+  // Constant time compare
+  uint8_t diff = 0;
+  for (size_t i = 0; i < CP_SESSION_MAC_SIZE; i++) diff |= mac[i] ^ raw[8 + i];
+  if (diff != 0) return false;
+
+  uint32_t now = (uint32_t)time(nullptr);
+  bool clockSet = now >= CP_SESSION_CLOCK_SET;
+  if (clockSet != (expiry >= CP_SESSION_CLOCK_SET)) {
+    DPRINTF(1, "Session token from a %s clock rejected", clockSet ? "unset" : "set");
+    return false;  // Issued before the clock was set, or before a reboot without a clock
+  }
+  return now < expiry && expiry - now <= maxLifetime;
+}
+
+bool SessionTokens::revokeAll() {
+  DPRINTF(1, "[SessionTokens::revokeAll] epoch %u", (unsigned)(keyEpoch + 1));
+  keyEpoch++;
+  return save();
+}
@@ -0,0 +1,76 @@
+#include "SettingsApplier.h"
+
+#include <dprintf.h>
+
+#include "Config.h"
+
+AppliedSettings AppliedSettings::from(const CaptivePortalConfig& config) {
+  AppliedSettings s;
+  s.ssid = config.getEffectiveDeviceName();
+  s.password = config.AdminPassword;
+  s.ip = config.DeviceIP;
+  s.mask = config.DeviceIPMask;
+  s.timezone = config.DeviceTimezone;
+  s.ledPin = config.LedPin;
+  s.rgbLed = config.HasRgbLed;
+  s.rgbBrightness = config.RgbBrightness;
+  s.resetPin = config.ResetPin;
+  return s;
+}
+
+uint8_t SettingsApplier::plan(const AppliedSettings& before, const AppliedSettings& after) {
+  uint8_t actions = None;
+  if (before.timezone != after.timezone) actions |= Timezone;
+  if (before.ledPin != after.ledPin || before.rgbLed != after.rgbLed || before.rgbBrightness != after.rgbBrightness)
+    actions |= Led;
+  if (before.resetPin != after.resetPin) actions |= ResetPin;
+  if (before.ssid != after.ssid || before.password != after.password || before.ip != after.ip || before.mask != after.mask)
+    actions |= AccessPoint;
+  return actions;
+}
+
+void SettingsApplier::begin(const CaptivePortalConfig& config) {
+  current = AppliedSettings::from(config);
+  seen = config.generation();
+}
+
+bool SettingsApplier::hasChanges(const CaptivePortalConfig& config) const {
+  return config.generation() != seen || (apPending && millis() - apSince >= CP_AP_RESTART_DELAY);
+}
+
+uint8_t SettingsApplier::apply(const CaptivePortalConfig& config, Target& target) {
+  uint8_t actions = None;
+  if (config.generation() != seen) {
+    seen = config.generation();
+    AppliedSettings next = AppliedSettings::from(config);
+    uint8_t planned = plan(current, next);
+    if (planned != None) DPRINTF(1, "[SettingsApplier::apply] actions 0x%02x", planned);
+    if (planned & Timezone) target.setTimezone(next.timezone);
+    if (planned & Led) target.setupLed(current, next);
+    if (planned & ResetPin) target.setupResetPin(current.resetPin, next.resetPin);
+    if (planned & AccessPoint) {
+      // Restarted later, after the response to the request that changed it
+      apPending = true;
+      apFailed = false;
+      apTries = 0;
+      apSince = millis();
+    }
+    actions = planned & ~AccessPoint;
+    current = next;
+  }
+
+  if (apPending && millis() - apSince >= CP_AP_RESTART_DELAY) {
+    actions |= AccessPoint;
+    if (target.restartAccessPoint(current)) {
+      apPending = false;
+    } else if (++apTries < CP_AP_RESTART_TRIES) {
+      DPRINTF(2, "SoftAP reconfiguration failed, retrying");
+      apSince = millis();
+    } else {
+      DPRINTF(3, "SoftAP reconfiguration failed, reboot to apply");
+      apPending = false;
+      apFailed = true;
+    }
+  }
+  return actions;
+}
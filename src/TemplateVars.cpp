@@ -0,0 +1,148 @@
+#include "TemplateVars.h"
+
+// Prints HTML escaped text to another Print
+class HtmlEscaper : public Print {
+ public:
+  explicit HtmlEscaper(Print& out) : out(out) {}
+
+  size_t write(uint8_t c) override {
+    switch (c) {
+      case '&':
+        return out.write("&amp;");
+      case '<':
+        return out.write("&lt;");
+      case '>':
+        return out.write("&gt;");
+      case '"':
+        return out.write("&quot;");
+      case '\'':
+        return out.write("&#39;");
+      default:
+        return out.write(c);
+    }
+  }
+
+  size_t write(const uint8_t* data, size_t len) override {
+    for (size_t i = 0; i < len; i++) write(data[i]);
+    return len;
+  }
+
+ private:
+  Print& out;
+};
+
+static bool isNameChar(char c) {
+  return isalnum((unsigned char)c) || c == '_' || c == '.';
+}
+
+void TemplateVars::set(const String& name, Provider provider, bool escape) {
+  for (Var& v : vars) {
+    if (v.name == name) {
+      v.provider = provider;
+      v.escape = escape;
+      return;
+    }
+  }
+  vars.push_back({name, provider, escape});
+}
+
+void TemplateVars::remove(const String& name) {
+  for (auto it = vars.begin(); it != vars.end(); ++it) {
+    if (it->name == name) {
+      vars.erase(it);
+      return;
+    }
+  }
+}
+
+bool TemplateVars::print(const char* name, size_t len, Print& out) const {
+  for (const Var& v : vars) {
+    if (v.name.length() != len || strncmp(v.name.c_str(), name, len) != 0) continue;
+    if (v.escape) {
+      HtmlEscaper escaped(out);
+      v.provider(escaped);
+    } else {
+      v.provider(out);
+    }
+    return true;
+  }
+  return false;
+}
+
+TemplateStreamer::TemplateStreamer(const TemplateVars& vars, Print& out) : vars(vars), out(out) {}
+
+// Writes the characters consumed by an unfinished placeholder as literal text
+void TemplateStreamer::flushPending() {
+  if (state == OPEN) out.write('{');
+  if (state == NAME || state == CLOSE) {
+    out.write("{{");
+    out.write(name, nameLen);
+  }
+  if (state == CLOSE) out.write('}');
+  state = TEXT;
+  nameLen = 0;
+}
+
+void TemplateStreamer::feed(const char* data, size_t len) {
+  size_t i = 0;
+  while (i < len) {
+    if (state == TEXT) {
+      // Copy literal text up to the next '{' in one go
+      const char* brace = (const char*)memchr(data + i, '{', len - i);
+      size_t run = brace ? (size_t)(brace - (data + i)) : len - i;
+      if (run) out.write(data + i, run);
+      i += run;
+      if (!brace) return;
+      state = OPEN;
+      i++;
+      continue;
+    }
+
+    char c = data[i];
+    switch (state) {
+      case OPEN:
+        if (c == '{') {
+          state = NAME;
+          i++;
+        } else {
+          flushPending();  // Single '{', reprocess c as text
+        }
+        break;
+
+      case NAME:
+        if (c == '}' && nameLen > 0) {
+          state = CLOSE;
+          i++;
+        } else if (isNameChar(c) && nameLen < sizeof(name)) {
+          name[nameLen++] = c;
+          i++;
+        } else {
+          flushPending();
+        }
+        break;
+
+      case CLOSE:
+        if (c == '}') {
+          i++;
+          if (!vars.print(name, nameLen, out)) {
+            // Unknown variable, keep it as is
+            out.write("{{");
+            out.write(name, nameLen);
+            out.write("}}");
+          }
+          state = TEXT;
+          nameLen = 0;
+        } else {
+          flushPending();
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+}
+
+void TemplateStreamer::finish() {
+  flushPending();
+}
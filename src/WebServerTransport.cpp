@@ -0,0 +1,53 @@
+#include "WebServerTransport.h"
+
+void WebServerTransport::on(const String& uri, HTTPMethod method, Handler handler, Handler uploadHandler) {
+  if (uploadHandler)
+    server.on(uri, method, handler, uploadHandler);
+  else
+    server.on(uri, method, handler);
+}
+
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 3
+typedef const String& UriArg;  // Core 3 passes the uri by reference
+#else
+typedef String UriArg;
+#endif
+
+// Hands the request to the interceptor before the WebServer tries its routes
+class InterceptHandler : public RequestHandler {
+ public:
+  InterceptHandler(WebServerTransport* transport) : transport(transport) {}
+
+  bool canHandle(HTTPMethod method, UriArg uri) override { return interceptor && interceptor->matches(uri); }
+
+  bool handle(WebServer& server, HTTPMethod requestMethod, UriArg requestUri) override {
+    if (!canHandle(requestMethod, requestUri)) return false;
+    interceptor->respond(transport, requestUri);
+    return true;
+  }
+
+  HttpTransport::Interceptor* interceptor = nullptr;
+
+ private:
+  WebServerTransport* transport;
+};
+
+void WebServerTransport::intercept(Interceptor* interceptor) {
+  if (!interceptHandler) {
+    interceptHandler = new InterceptHandler(this);
+    server.addHandler(interceptHandler);  // The WebServer owns and deletes it
+  }
+  static_cast<InterceptHandler*>(interceptHandler)->interceptor = interceptor;
+}
+
+void WebServerTransport::collectHeaders(const char* headerKeys[], size_t headerKeysCount) {
+  server.collectHeaders(headerKeys, headerKeysCount);
+}
+
+void WebServerTransport::sendHeader(const String& name, const String& value, bool first) {
+  server.sendHeader(name, value, first);
+}
+
+void WebServerTransport::send(int code, const char* contentType, const String& content) {
+  server.send(code, contentType, content);
+}
@@ -0,0 +1,16 @@
+#ifndef HOST_ALLOC_COUNT_H
+#define HOST_ALLOC_COUNT_H
+
+#include <stddef.h>
+
+/**
+ * @file AllocCount.h
+ * @brief Host tests only: counts heap allocations made with operator new.
+ *
+ * String, std::vector and the other containers allocate through operator new,
+ * so the difference of two testAllocations() calls is the number of heap
+ * allocations the code in between made (on every thread).
+ */
+size_t testAllocations();
+
+#endif  // HOST_ALLOC_COUNT_H
@@ -0,0 +1,35 @@
+#include <Arduino.h>
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+static unsigned long skipped = 0;  // ms added by testAdvanceMillis()
+static std::mt19937 rng(std::random_device{}());
+
+unsigned long millis() {
+  return micros() / 1000;
+}
+
+unsigned long micros() {
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + skipped * 1000UL;
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void testAdvanceMillis(unsigned long ms) {
+  skipped += ms;
+}
+
+uint32_t esp_random() {
+  return (uint32_t)rng();
+}
+
+void esp_fill_random(void* buffer, size_t length) {
+  uint8_t* p = (uint8_t*)buffer;
+  for (size_t i = 0; i < length; i++) p[i] = (uint8_t)rng();
+}
@@ -0,0 +1,60 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ * @file Arduino.h
+ * @brief The part of the Arduino core the host tests need (env:native in platformio.ini).
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "IPAddress.h"
+#include "Print.h"
+#include "Stream.h"
+#include "WString.h"
+
+typedef const char* PGM_P;
+#define PROGMEM
+#define F(s) (s)
+#define FPSTR(s) (s)
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+inline void yield() {}
+
+// ESP32 (original) GPIO numbers
+enum gpio_num_t { GPIO_NUM_0 = 0, GPIO_NUM_2 = 2, GPIO_NUM_4 = 4, GPIO_NUM_MAX = 40 };
+
+inline bool isDigit(int c) { return isdigit(c) != 0; }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+
+// No PSRAM on the host
+inline bool psramFound() { return false; }
+inline void* ps_malloc(size_t size) { return malloc(size); }
+
+uint32_t esp_random();
+void esp_fill_random(void* buffer, size_t length);
+
+/// Host tests only: moves millis() and micros() forward without waiting
+void testAdvanceMillis(unsigned long ms);
+
+#endif  // HOST_ARDUINO_H
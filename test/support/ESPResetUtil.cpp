@@ -0,0 +1,23 @@
+#include <ESPResetUtil.h>
+
+#define MARKER_FILE "/.factory_reset"
+
+namespace espResetUtil {
+
+void factoryReset(bool format, fs::LittleFSFS& fileSystem, std::initializer_list<const char*> files) {
+  if (format) {
+    fileSystem.format();
+  } else {
+    for (const char* path : files) fileSystem.remove(path);
+  }
+  File marker = fileSystem.open(MARKER_FILE, "w");
+  marker.close();
+}
+
+bool checkFactoryResetMarker(fs::LittleFSFS& fileSystem) {
+  if (!fileSystem.exists(MARKER_FILE)) return false;
+  fileSystem.remove(MARKER_FILE);
+  return true;
+}
+
+}  // namespace espResetUtil
@@ -0,0 +1,22 @@
+#ifndef HOST_ESP_RESET_UTIL_H
+#define HOST_ESP_RESET_UTIL_H
+
+#include <LittleFS.h>
+
+#include <initializer_list>
+
+/**
+ * @file ESPResetUtil.h
+ * @brief ESPResetUtil for host tests: factory resets touch the in-memory file system, nothing restarts.
+ */
+namespace espResetUtil {
+
+/// Formats fileSystem, or only removes files when format is false. Leaves the marker file
+void factoryReset(bool format, fs::LittleFSFS& fileSystem, std::initializer_list<const char*> files = {});
+
+/// true once after factoryReset()
+bool checkFactoryResetMarker(fs::LittleFSFS& fileSystem);
+
+}  // namespace espResetUtil
+
+#endif  // HOST_ESP_RESET_UTIL_H
@@ -0,0 +1,184 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <Arduino.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @file FS.h
+ * @brief In-memory file system with the Arduino fs::FS and fs::File API, for host tests.
+ *
+ * Directories exist implicitly as prefixes of file paths. Writes are visible to
+ * other handles right away. FS::faults() makes opens, writes and renames fail,
+ * to test what a failed or interrupted write leaves behind.
+ */
+namespace fs {
+
+typedef std::vector<uint8_t> Data;
+
+/// Host tests only: failures to inject, for every path or only for path
+struct Faults {
+  std::string path;        // Empty for every path (for a rename: the source)
+  int openFailures = 0;    // Opens for writing that fail
+  long writeLimit = -1;    // Bytes written before writes fail (like a full disk), -1 for no limit
+  int renameFailures = 0;  // Renames that fail
+
+  bool matches(const std::string& p) const { return path.empty() || path == p; }
+};
+
+struct Files {
+  std::map<std::string, std::shared_ptr<Data>> entries;
+  Faults faults;
+};
+
+class File : public Stream {
+ public:
+  File() {}
+  File(std::shared_ptr<Files> files, const std::string& path, std::shared_ptr<Data> data, bool append)
+      : files(files), path_(path), data(data), pos(append && data ? data->size() : 0) {}
+
+  explicit operator bool() const { return files != nullptr; }
+  bool isDirectory() const { return files && !data; }
+  const char* path() const { return path_.c_str(); }
+  const char* name() const { return path_.c_str() + path_.rfind('/') + 1; }
+  size_t size() const { return data ? data->size() : 0; }
+  size_t position() const { return pos; }
+  bool seek(uint32_t p) {
+    if (!data || p > data->size()) return false;
+    pos = p;
+    return true;
+  }
+  void close() { *this = File(); }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    if (!data) return 0;
+    Faults& faults = files->faults;
+    if (faults.writeLimit >= 0 && faults.matches(path_)) {
+      size = std::min(size, (size_t)faults.writeLimit);
+      faults.writeLimit -= size;
+      if (!size) return 0;
+    }
+    if (data->size() < pos + size) data->resize(pos + size);
+    memcpy(data->data() + pos, buffer, size);
+    pos += size;
+    return size;
+  }
+  using Print::write;
+
+  int available() override { return data ? (int)(data->size() - pos) : 0; }
+  int read() override { return available() ? (*data)[pos++] : -1; }
+  int peek() override { return available() ? (*data)[pos] : -1; }
+  size_t read(uint8_t* buffer, size_t length) { return readBytes(buffer, length); }
+  size_t readBytes(uint8_t* buffer, size_t length) override {
+    size_t n = std::min(length, (size_t)available());
+    if (n) memcpy(buffer, data->data() + pos, n);
+    pos += n;
+    return n;
+  }
+  using Stream::readBytes;
+
+  File openNextFile(const char* mode = "r") {
+    String next = getNextFileName();
+    if (next.isEmpty()) return File();
+    auto it = files->entries.find(next.c_str());
+    return File(files, next.c_str(), it == files->entries.end() ? nullptr : it->second, false);
+  }
+  String getNextFileName() {
+    if (!isDirectory()) return String();
+    // Direct children in name order, a directory once for all files below it
+    std::string prefix = path_ == "/" ? "/" : path_ + "/";
+    for (auto it = files->entries.upper_bound(cursor.empty() ? prefix : cursor); it != files->entries.end(); ++it) {
+      if (it->first.compare(0, prefix.size(), prefix) != 0) break;
+      size_t slash = it->first.find('/', prefix.size());
+      std::string child = slash == std::string::npos ? it->first : it->first.substr(0, slash);
+      if (child <= cursor) continue;
+      cursor = child;
+      return String(child.c_str());
+    }
+    cursor = std::string(1, '\xff');
+    return String();
+  }
+
+ private:
+  std::shared_ptr<Files> files;
+  std::string path_;
+  std::shared_ptr<Data> data;  // nullptr for a directory
+  size_t pos = 0;
+  std::string cursor;  // Last child returned by getNextFileName()
+};
+
+class FS {
+ public:
+  FS() : files(std::make_shared<Files>()) {}
+
+  File open(const char* path, const char* mode = "r", bool create = false) {
+    std::string p = path;
+    auto it = files->entries.find(p);
+    if (*mode == 'w' || *mode == 'a') {
+      Faults& faults = files->faults;
+      if (faults.openFailures > 0 && faults.matches(p)) {
+        faults.openFailures--;
+        return File();
+      }
+    }
+    if (*mode == 'w' || (*mode == 'a' && it == files->entries.end())) {
+      auto data = std::make_shared<Data>();
+      files->entries[p] = data;
+      return File(files, p, data, false);
+    }
+    if (it != files->entries.end()) return File(files, p, it->second, *mode == 'a');
+    if (isDirectory(p)) return File(files, p, nullptr, false);
+    return File();
+  }
+  File open(const String& path, const char* mode = "r", bool create = false) { return open(path.c_str(), mode, create); }
+
+  bool exists(const char* path) { return files->entries.count(path) || isDirectory(path); }
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path) { return files->entries.erase(path) > 0; }
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* from, const char* to) {
+    auto it = files->entries.find(from);
+    if (it == files->entries.end()) return false;
+    Faults& faults = files->faults;
+    if (faults.renameFailures > 0 && faults.matches(from)) {
+      faults.renameFailures--;
+      return false;
+    }
+    auto data = it->second;
+    files->entries.erase(it);
+    files->entries[to] = data;
+    return true;
+  }
+  bool rename(const String& from, const String& to) { return rename(from.c_str(), to.c_str()); }
+  bool mkdir(const char*) { return true; }
+  bool mkdir(const String&) { return true; }
+
+  /// Host tests only: drops every file and fault
+  void clear() {
+    files->entries.clear();
+    files->faults = Faults();
+  }
+  /// Host tests only: failures to inject into the next operations
+  Faults& faults() { return files->faults; }
+
+ private:
+  std::shared_ptr<Files> files;
+
+  bool isDirectory(const std::string& p) const {
+    if (p == "/") return true;
+    auto it = files->entries.lower_bound(p + "/");
+    return it != files->entries.end() && it->first.compare(0, p.size() + 1, p + "/") == 0;
+  }
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif  // HOST_FS_H
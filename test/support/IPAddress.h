@@ -0,0 +1,48 @@
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "WString.h"
+
+/**
+ * @file IPAddress.h
+ * @brief Arduino IPAddress for host tests. Like the ESP32 core, the uint32_t value is in network byte order.
+ */
+class IPAddress {
+ public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
+  IPAddress(uint32_t address) { memcpy(bytes, &address, 4); }
+
+  bool fromString(const char* s) {
+    unsigned a, b, c, d;
+    char end;
+    if (sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &end) != 4 || a > 255 || b > 255 || c > 255 || d > 255) return false;
+    *this = IPAddress(a, b, c, d);
+    return true;
+  }
+  bool fromString(const String& s) { return fromString(s.c_str()); }
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+    return String(buf);
+  }
+
+  operator uint32_t() const {
+    uint32_t v;
+    memcpy(&v, bytes, 4);
+    return v;
+  }
+  uint8_t operator[](int i) const { return bytes[i]; }
+  uint8_t& operator[](int i) { return bytes[i]; }
+  bool operator==(const IPAddress& o) const { return (uint32_t)*this == (uint32_t)o; }
+  bool operator!=(const IPAddress& o) const { return !(*this == o); }
+
+ private:
+  uint8_t bytes[4] = {0, 0, 0, 0};
+};
+
+#endif  // HOST_IPADDRESS_H
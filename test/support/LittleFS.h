@@ -0,0 +1,27 @@
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+#include <FS.h>
+
+namespace fs {
+
+/**
+ * @brief LittleFS on the in-memory host file system. Mounting always succeeds.
+ */
+class LittleFSFS : public FS {
+ public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10, const char* partitionLabel = "spiffs") {
+    return true;
+  }
+  bool format() {
+    clear();
+    return true;
+  }
+  void end() {}
+};
+
+}  // namespace fs
+
+extern fs::LittleFSFS LittleFS;
+
+#endif  // HOST_LITTLEFS_H
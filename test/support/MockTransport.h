@@ -0,0 +1,97 @@
+#ifndef HOST_MOCK_TRANSPORT_H
+#define HOST_MOCK_TRANSPORT_H
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "HttpTransport.h"
+
+/**
+ * @file MockTransport.h
+ * @brief Host tests only: an HttpTransport that records the response instead of sending it.
+ *
+ * Request headers are set by the test. The response is recorded as the status,
+ * headers, content length and every chunk. Once constructed it does not allocate
+ * while recording (up to 64 chunks and 16 KB of content), so it can be used in
+ * allocation counts.
+ */
+class MockTransport : public HttpTransport {
+ public:
+  std::map<std::string, std::string> requestHeaders;  // Set by the test, e.g. Accept-Encoding
+
+  size_t contentLength = CONTENT_LENGTH_NOT_SET;
+  int code = 0;
+  std::string contentType;
+  std::vector<std::pair<std::string, std::string>> headers;  // Sent with sendHeader()
+  int headerSends = 0;                                       // send() calls
+  int terminators = 0;                                       // Zero length sendContent() calls
+  std::vector<size_t> chunks;                                // Length of each content chunk
+  std::vector<const char*> chunkData;                        // Data pointer of each content chunk
+  std::string body;                                          // All content
+
+  MockTransport() {
+    contentType.reserve(64);
+    chunks.reserve(64);
+    chunkData.reserve(64);
+    body.reserve(16384);
+  }
+
+  /// Value of a response header, empty if it was not sent
+  std::string responseHeader(const char* name) const {
+    for (const auto& h : headers) {
+      if (strcasecmp(h.first.c_str(), name) == 0) return h.second;
+    }
+    return std::string();
+  }
+
+  void begin() override {}
+  void stop() override {}
+  void handleClient() override {}
+  void on(const String&, HTTPMethod, Handler, Handler) override {}
+  void onNotFound(Handler) override {}
+  void intercept(Interceptor*) override {}
+  void collectHeaders(const char*[], size_t) override {}
+  String uri() override { return String(); }
+  HTTPMethod method() override { return HTTP_GET; }
+  HTTPUpload& upload() override { return upload_; }
+  bool hasArg(const String&) override { return false; }
+  String arg(const String&) override { return String(); }
+  bool hasHeader(const String& name) override { return requestHeaders.count(name.c_str()) > 0; }
+  String header(const String& name) override {
+    auto it = requestHeaders.find(name.c_str());
+    return it == requestHeaders.end() ? String() : String(it->second.c_str());
+  }
+
+  void setContentLength(size_t length) override { contentLength = length; }
+  void sendHeader(const String& name, const String& value, bool) override {
+    headers.push_back({name.c_str(), value.c_str()});
+  }
+  void send(int c, const char* type, const String& content) override {
+    TEST_ASSERT_EQUAL_MESSAGE(0, headerSends, "headers sent twice");
+    code = c;
+    contentType = type;
+    headerSends++;
+    if (content.length()) sendContent(content.c_str(), content.length());
+  }
+  void sendContent(const char* data, size_t len) override {
+    TEST_ASSERT_EQUAL_MESSAGE(1, headerSends, "content before the headers");
+    if (len == 0) {
+      terminators++;
+      return;
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(0, terminators, "content after the last chunk");
+    chunks.push_back(len);
+    chunkData.push_back(data);
+    body.append(data, len);
+  }
+
+ private:
+  HTTPUpload upload_;
+};
+
+#endif  // HOST_MOCK_TRANSPORT_H
@@ -0,0 +1,59 @@
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "WString.h"
+
+/**
+ * @file Print.h
+ * @brief Arduino Print for host tests. Numbers are formatted on the stack, like the core does.
+ */
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (n < size && write(buffer[n])) n++;
+    return n;
+  }
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+  virtual void flush() {}
+
+  size_t print(const String& s) { return write(s.c_str(), s.length()); }
+  size_t print(const char* s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned int v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+  template <typename T>
+  size_t println(const T& v) {
+    return print(v) + println();
+  }
+  size_t println() { return write("\r\n"); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (n < 0) return 0;
+    return write(buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+  }
+};
+
+class Printable {
+ public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print& p) const = 0;
+};
+
+#endif  // HOST_PRINT_H
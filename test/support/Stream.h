@@ -0,0 +1,30 @@
+#ifndef HOST_STREAM_H
+#define HOST_STREAM_H
+
+#include "Print.h"
+
+/**
+ * @file Stream.h
+ * @brief Arduino Stream for host tests.
+ */
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  virtual size_t readBytes(uint8_t* buffer, size_t length) {
+    size_t n = 0;
+    for (int c; n < length && (c = read()) >= 0; n++) buffer[n] = (uint8_t)c;
+    return n;
+  }
+  size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+  String readString() {
+    String s;
+    for (int c; (c = read()) >= 0;) s += (char)c;
+    return s;
+  }
+  void setTimeout(unsigned long) {}
+};
+
+#endif  // HOST_STREAM_H
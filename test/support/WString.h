@@ -0,0 +1,158 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <string>
+
+/**
+ * @file WString.h
+ * @brief Arduino String for host tests, backed by std::string.
+ */
+class String {
+ public:
+  String(const char* s = "") : s(s ? s : "") {}
+  String(const char* p, size_t n) : s(p, n) {}
+  String(const String& o) = default;
+  String(String&& o) = default;
+  explicit String(char c) : s(1, c) {}
+  explicit String(int v, unsigned char base = 10) : s(number((long)v, base)) {}
+  explicit String(unsigned int v, unsigned char base = 10) : s(number((unsigned long)v, base)) {}
+  explicit String(long v, unsigned char base = 10) : s(number(v, base)) {}
+  explicit String(unsigned long v, unsigned char base = 10) : s(number(v, base)) {}
+  explicit String(float v, unsigned int decimals = 2) : s(fixed(v, decimals)) {}
+  explicit String(double v, unsigned int decimals = 2) : s(fixed(v, decimals)) {}
+
+  String& operator=(const String& o) = default;
+  String& operator=(String&& o) = default;
+  String& operator=(const char* p) {
+    s = p ? p : "";
+    return *this;
+  }
+
+  bool reserve(unsigned int n) {
+    s.reserve(n);
+    return true;
+  }
+  unsigned int length() const { return (unsigned int)s.size(); }
+  bool isEmpty() const { return s.empty(); }
+  void clear() { s.clear(); }
+  const char* c_str() const { return s.c_str(); }
+  char* begin() { return &s[0]; }
+  char* end() { return &s[0] + s.size(); }
+  const char* begin() const { return s.c_str(); }
+  const char* end() const { return s.c_str() + s.size(); }
+
+  bool concat(const String& o) { return append(o.s); }
+  bool concat(const char* p) { return append(p ? p : ""); }
+  bool concat(const char* p, unsigned int n) { return append(std::string(p, n)); }
+  bool concat(char c) { return append(std::string(1, c)); }
+  bool concat(int v) { return append(number((long)v, 10)); }
+  bool concat(unsigned int v) { return append(number((unsigned long)v, 10)); }
+  bool concat(long v) { return append(number(v, 10)); }
+  bool concat(unsigned long v) { return append(number(v, 10)); }
+
+  template <typename T>
+  String& operator+=(const T& v) {
+    concat(v);
+    return *this;
+  }
+  friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+  friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+  friend String operator+(const char* a, const String& b) { return String(a + b.s); }
+  friend String operator+(const String& a, char b) { return String(a.s + b); }
+
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator==(const char* p) const { return s == (p ? p : ""); }
+  bool operator!=(const String& o) const { return s != o.s; }
+  bool operator!=(const char* p) const { return !(*this == p); }
+  bool operator<(const String& o) const { return s < o.s; }
+  bool equals(const String& o) const { return s == o.s; }
+  bool equals(const char* p) const { return *this == p; }
+  bool equalsIgnoreCase(const String& o) const { return s.size() == o.s.size() && strcasecmp(c_str(), o.c_str()) == 0; }
+  bool startsWith(const String& o) const { return s.compare(0, o.s.size(), o.s) == 0; }
+  bool startsWith(const String& o, unsigned int offset) const { return offset <= s.size() && s.compare(offset, o.s.size(), o.s) == 0; }
+  bool endsWith(const String& o) const { return s.size() >= o.s.size() && s.compare(s.size() - o.s.size(), o.s.size(), o.s) == 0; }
+
+  char charAt(unsigned int i) const { return i < s.size() ? s[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  char& operator[](unsigned int i) { return s[i]; }
+  int indexOf(char c, unsigned int from = 0) const { return position(s.find(c, from)); }
+  int indexOf(const String& o, unsigned int from = 0) const { return position(s.find(o.s, from)); }
+  int lastIndexOf(char c) const { return position(s.rfind(c)); }
+  String substring(unsigned int from) const { return from < s.size() ? String(s.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    return from < s.size() ? String(s.substr(from, to - from)) : String();
+  }
+
+  void replace(char from, char to) {
+    for (char& c : s)
+      if (c == from) c = to;
+  }
+  void replace(const String& from, const String& to) {
+    if (from.s.empty()) return;
+    for (size_t p = s.find(from.s); p != std::string::npos; p = s.find(from.s, p + to.s.size())) s.replace(p, from.s.size(), to.s);
+  }
+  void remove(unsigned int index) {
+    if (index < s.size()) s.erase(index);
+  }
+  void remove(unsigned int index, unsigned int count) {
+    if (index < s.size()) s.erase(index, count);
+  }
+  void toLowerCase() {
+    for (char& c : s) c = (char)tolower((unsigned char)c);
+  }
+  void toUpperCase() {
+    for (char& c : s) c = (char)toupper((unsigned char)c);
+  }
+  void trim() {
+    size_t b = 0, e = s.size();
+    while (b < e && isspace((unsigned char)s[b])) b++;
+    while (e > b && isspace((unsigned char)s[e - 1])) e--;
+    s = s.substr(b, e - b);
+  }
+
+  long toInt() const { return atol(c_str()); }
+  float toFloat() const { return (float)atof(c_str()); }
+  double toDouble() const { return atof(c_str()); }
+
+ private:
+  std::string s;
+
+  explicit String(const std::string& str) : s(str) {}
+  bool append(const std::string& more) {
+    s += more;
+    return true;
+  }
+  static int position(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+  static std::string number(unsigned long v, unsigned char base) {
+    char buf[72];
+    char* p = buf + sizeof(buf);
+    *--p = 0;
+    do {
+      *--p = "0123456789abcdefghijklmnopqrstuvwxyz"[v % base];
+      v /= base;
+    } while (v);
+    return p;
+  }
+  static std::string number(long v, unsigned char base) {
+    return v < 0 && base == 10 ? "-" + number((unsigned long)-v, base) : number((unsigned long)v, base);
+  }
+  static std::string fixed(double v, unsigned int decimals) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    return buf;
+  }
+};
+
+class StringSumHelper : public String {
+ public:
+  StringSumHelper(const String& s) : String(s) {}
+};
+
+#endif  // HOST_WSTRING_H
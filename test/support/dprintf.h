@@ -0,0 +1,15 @@
+#ifndef HOST_DPRINTF_H
+#define HOST_DPRINTF_H
+
+#include <stdio.h>
+
+// Only errors are printed in host tests
+#define DPRINTF(level, ...)              \
+  do {                                   \
+    if ((level) >= 3) {                  \
+      fprintf(stderr, __VA_ARGS__);      \
+      fputc('\n', stderr);               \
+    }                                    \
+  } while (0)
+
+#endif  // HOST_DPRINTF_H
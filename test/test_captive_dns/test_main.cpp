@@ -0,0 +1,210 @@
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unity.h>
+
+#include <vector>
+
+#include "CaptiveDns.h"
+
+#define PORT 15353
+
+static CaptiveDns* dns;
+static int client = -1;
+
+typedef std::vector<uint8_t> Packet;
+
+// Query with one question for name (dotted) of the given type and class IN
+static Packet query(const char* name, uint16_t type, uint16_t id = 0x1234) {
+  Packet p = {(uint8_t)(id >> 8), (uint8_t)id, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0};
+  const char* label = name;
+  while (*label) {
+    const char* dot = strchr(label, '.');
+    size_t len = dot ? (size_t)(dot - label) : strlen(label);
+    p.push_back((uint8_t)len);
+    p.insert(p.end(), label, label + len);
+    label += len + (dot ? 1 : 0);
+  }
+  p.push_back(0);
+  p.push_back(type >> 8);
+  p.push_back(type & 0xff);
+  p.push_back(0);
+  p.push_back(1);
+  return p;
+}
+
+// Sends p to the responder, runs process() and returns the response (empty if none)
+static Packet ask(const Packet& p) {
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sendto(client, p.data(), p.size(), 0, (struct sockaddr*)&addr, sizeof(addr));
+  usleep(1000);
+  dns->process();
+
+  uint8_t buf[CP_DNS_PACKET_SIZE + CP_DNS_ANSWER_SIZE];
+  ssize_t n = -1;
+  for (int i = 0; i < 20 && n < 0; i++) {
+    n = recv(client, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n < 0) usleep(1000);
+  }
+  return n < 0 ? Packet() : Packet(buf, buf + n);
+}
+
+static uint16_t word(const Packet& p, size_t pos) {
+  return (uint16_t)((p[pos] << 8) | p[pos + 1]);
+}
+
+void setUp() {
+  dns = new CaptiveDns();
+  TEST_ASSERT_TRUE(dns->start(PORT, IPAddress(192, 168, 4, 1)));
+  client = socket(AF_INET, SOCK_DGRAM, 0);
+}
+
+void tearDown() {
+  close(client);
+  delete dns;
+}
+
+void test_a_query_gets_portal_address() {
+  Packet q = query("connectivitycheck.gstatic.com", 1, 0xbeef);
+  Packet r = ask(q);
+  TEST_ASSERT_EQUAL(q.size() + CP_DNS_ANSWER_SIZE, r.size());
+  TEST_ASSERT_EQUAL_HEX16(0xbeef, word(r, 0));
+  TEST_ASSERT_EQUAL_HEX8(0x85, r[2]);  // QR, AA, RD
+  TEST_ASSERT_EQUAL_HEX8(0x80, r[3]);  // RA, NOERROR
+  TEST_ASSERT_EQUAL(1, word(r, 4));    // QDCOUNT
+  TEST_ASSERT_EQUAL(1, word(r, 6));    // ANCOUNT
+  TEST_ASSERT_EQUAL(0, word(r, 10));   // ARCOUNT
+  TEST_ASSERT_EQUAL_MEMORY(q.data() + 12, r.data() + 12, q.size() - 12);  // Question kept
+
+  size_t a = q.size();
+  TEST_ASSERT_EQUAL_HEX16(0xc00c, word(r, a));  // Pointer to the question name
+  TEST_ASSERT_EQUAL(1, word(r, a + 2));         // Type A
+  TEST_ASSERT_EQUAL(1, word(r, a + 4));         // Class IN
+  TEST_ASSERT_EQUAL(CP_DNS_TTL, (word(r, a + 6) << 16) | word(r, a + 8));
+  TEST_ASSERT_EQUAL(4, word(r, a + 10));
+  const uint8_t ip[] = {192, 168, 4, 1};
+  TEST_ASSERT_EQUAL_MEMORY(ip, r.data() + a + 12, 4);
+  TEST_ASSERT_EQUAL(1, dns->stats().answersA);
+}
+
+void test_any_query_is_answered_like_a() {
+  Packet r = ask(query("example.com", 255));
+  TEST_ASSERT_EQUAL(1, word(r, 6));
+  TEST_ASSERT_EQUAL(1, dns->stats().answersA);
+}
+
+void test_other_types_get_empty_noerror() {
+  const uint16_t types[] = {28, 65, 64, 16};  // AAAA, HTTPS, SVCB, TXT
+  for (uint16_t type : types) {
+    Packet q = query("example.com", type);
+    Packet r = ask(q);
+    TEST_ASSERT_EQUAL(q.size(), r.size());
+    TEST_ASSERT_EQUAL_HEX8(0x80, r[3]);  // NOERROR
+    TEST_ASSERT_EQUAL(0, word(r, 6));    // No answer
+  }
+  const CaptiveDnsStats& s = dns->stats();
+  TEST_ASSERT_EQUAL(1, s.emptyAAAA);
+  TEST_ASSERT_EQUAL(2, s.emptyHttps);
+  TEST_ASSERT_EQUAL(1, s.emptyOther);
+  TEST_ASSERT_EQUAL(0, s.answersA);
+}
+
+void test_edns_record_is_dropped() {
+  Packet q = query("example.com", 1);
+  q[11] = 1;  // ARCOUNT
+  const uint8_t opt[] = {0, 0, 41, 0x10, 0, 0, 0, 0, 0, 0, 0};  // Root name, OPT, 4096 byte payload
+  size_t questionEnd = q.size();
+  q.insert(q.end(), opt, opt + sizeof(opt));
+
+  Packet r = ask(q);
+  TEST_ASSERT_EQUAL(questionEnd + CP_DNS_ANSWER_SIZE, r.size());
+  TEST_ASSERT_EQUAL(0, word(r, 10));  // ARCOUNT
+  TEST_ASSERT_EQUAL_HEX16(0xc00c, word(r, questionEnd));
+}
+
+void test_malformed_packets_are_dropped() {
+  Packet shortHeader = {0x12, 0x34, 0x01};
+  TEST_ASSERT_EQUAL(0, ask(shortHeader).size());
+
+  Packet response = query("example.com", 1);
+  response[2] |= 0x80;  // QR: a response, not a query
+  TEST_ASSERT_EQUAL(0, ask(response).size());
+
+  Packet truncated = query("example.com", 1);
+  truncated.resize(truncated.size() - 3);  // QTYPE/QCLASS cut off
+  TEST_ASSERT_EQUAL(0, ask(truncated).size());
+
+  Packet compressed = query("example.com", 1);
+  compressed[12] = 0xc0;  // Pointer in the question name
+  TEST_ASSERT_EQUAL(0, ask(compressed).size());
+
+  TEST_ASSERT_EQUAL(4, dns->stats().queries);
+  TEST_ASSERT_EQUAL(4, dns->stats().dropped);
+}
+
+void test_unsupported_queries_get_error_header() {
+  Packet twoQuestions = query("example.com", 1);
+  twoQuestions[5] = 2;
+  Packet r = ask(twoQuestions);
+  TEST_ASSERT_EQUAL(12, r.size());
+  TEST_ASSERT_EQUAL(1, r[3] & 0x0f);  // FORMERR
+  TEST_ASSERT_EQUAL(0, word(r, 4));
+
+  Packet status = query("example.com", 1);
+  status[2] = 0x10;  // Opcode 2 (STATUS)
+  r = ask(status);
+  TEST_ASSERT_EQUAL(12, r.size());
+  TEST_ASSERT_EQUAL(4, r[3] & 0x0f);  // NOTIMP
+  TEST_ASSERT_EQUAL_HEX8(0x10, r[2] & 0x78);
+}
+
+void test_address_and_ttl_can_change() {
+  dns->setAddress(IPAddress(10, 0, 0, 7));
+  dns->setTtl(300);
+  Packet q = query("example.com", 1);
+  Packet r = ask(q);
+  size_t a = q.size();
+  TEST_ASSERT_EQUAL(300, (word(r, a + 6) << 16) | word(r, a + 8));
+  const uint8_t ip[] = {10, 0, 0, 7};
+  TEST_ASSERT_EQUAL_MEMORY(ip, r.data() + a + 12, 4);
+}
+
+void test_process_respects_budget() {
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  Packet q = query("example.com", 1);
+  for (int i = 0; i < 5; i++) sendto(client, q.data(), q.size(), 0, (struct sockaddr*)&addr, sizeof(addr));
+  usleep(2000);
+
+  TEST_ASSERT_EQUAL(3, dns->process(3));
+  TEST_ASSERT_EQUAL(2, dns->process(3));
+  TEST_ASSERT_EQUAL(0, dns->process(3));
+  TEST_ASSERT_EQUAL(5, dns->stats().answersA);
+  TEST_ASSERT_EQUAL(2, dns->stats().batches);
+}
+
+void test_stopped_responder_does_nothing() {
+  dns->stop();
+  TEST_ASSERT_EQUAL(0, dns->process());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_a_query_gets_portal_address);
+  RUN_TEST(test_any_query_is_answered_like_a);
+  RUN_TEST(test_other_types_get_empty_noerror);
+  RUN_TEST(test_edns_record_is_dropped);
+  RUN_TEST(test_malformed_packets_are_dropped);
+  RUN_TEST(test_unsupported_queries_get_error_header);
+  RUN_TEST(test_address_and_ttl_can_change);
+  RUN_TEST(test_process_respects_budget);
+  RUN_TEST(test_stopped_responder_does_nothing);
+  return UNITY_END();
+}
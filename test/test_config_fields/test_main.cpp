@@ -0,0 +1,313 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include "AllocCount.h"
+#include "Config.h"
+
+#define BENCH_ROUNDS 2000
+
+// Settings of an application, added to the built-in table
+class SensorConfig : public CaptivePortalConfig {
+ public:
+  explicit SensorConfig(fs::LittleFSFS& fileSystem);
+
+  uint16_t Interval;
+  int32_t Offset;
+  float Scale;
+  uint32_t Serial;
+  String ApiKey;
+
+  static const ConfigField kFields[];
+};
+
+const ConfigField SensorConfig::kFields[] = {
+    {"sensor", "interval", &SensorConfig::Interval, (uint16_t)1000},
+    {"sensor", "offset", &SensorConfig::Offset, (int32_t)-5},
+    {"sensor", "scale", &SensorConfig::Scale, 1.5f},
+    {nullptr, "serial", &SensorConfig::Serial, (uint32_t)42},
+    {"sensor", "apiKey", &SensorConfig::ApiKey, "none", nullptr, ConfigField::Secret},
+};
+
+SensorConfig::SensorConfig(fs::LittleFSFS& fileSystem) : CaptivePortalConfig(fileSystem) {
+  addFields(kFields, sizeof(kFields) / sizeof(kFields[0]));
+}
+
+static void writeFile(const char* json) {
+  File f = LittleFS.open("/config.json", "w");
+  f.print(json);
+  f.close();
+}
+
+static JsonDocument readFile() {
+  JsonDocument doc;
+  File f = LittleFS.open("/config.json", "r");
+  deserializeJson(doc, f);
+  f.close();
+  return doc;
+}
+
+void setUp() {
+  LittleFS.format();
+}
+
+void tearDown() {}
+
+void test_defaults_come_from_the_table() {
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_EQUAL_STRING("Admin", cfg.AdminUser.c_str());
+  TEST_ASSERT_EQUAL_STRING("password", cfg.AdminPassword.c_str());
+  TEST_ASSERT_EQUAL_STRING("", cfg.DeviceName.c_str());
+  TEST_ASSERT_EQUAL_STRING("esp32-portal", cfg.DeviceHostname.c_str());
+  TEST_ASSERT_EQUAL_STRING("Etc/UTC", cfg.DeviceTimezone.c_str());
+  TEST_ASSERT_EQUAL_STRING("192.168.168.168", cfg.DeviceIP.toString().c_str());
+  TEST_ASSERT_EQUAL_STRING("255.255.255.0", cfg.DeviceIPMask.toString().c_str());
+  TEST_ASSERT_EQUAL(2, cfg.LedPin);
+  TEST_ASSERT_FALSE(cfg.HasRgbLed);
+  TEST_ASSERT_EQUAL(128, cfg.RgbBrightness);
+  TEST_ASSERT_EQUAL(4, cfg.ResetPin);
+
+  cfg.AdminUser = "root";
+  cfg.LedPin = 13;
+  cfg.DeviceIP = IPAddress(10, 0, 0, 1);
+  cfg.applyDefaults();
+  TEST_ASSERT_EQUAL_STRING("Admin", cfg.AdminUser.c_str());
+  TEST_ASSERT_EQUAL(2, cfg.LedPin);
+  TEST_ASSERT_EQUAL_STRING("192.168.168.168", cfg.DeviceIP.toString().c_str());
+}
+
+void test_save_and_load_round_trip() {
+  {
+    CaptivePortalConfig cfg(LittleFS);
+    cfg.setWriteBackDelay(0);
+    cfg.AdminPassword = "s3cret";
+    cfg.DeviceName = "Lab";
+    cfg.DeviceIP = IPAddress(10, 1, 2, 3);
+    cfg.LedPin = 5;
+    cfg.HasRgbLed = true;
+    TEST_ASSERT_TRUE(cfg.save());
+    TEST_ASSERT_FALSE(cfg.isDirty());
+  }
+
+  JsonDocument file = readFile();
+  TEST_ASSERT_EQUAL_STRING("s3cret", file["user"]["pass"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("10.1.2.3", file["device"]["IP"].as<const char*>());
+  TEST_ASSERT_EQUAL(5, file["device"]["ledPin"].as<int>());
+  TEST_ASSERT_TRUE(file["device"]["hasRgbLed"].as<bool>());
+
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(cfg.begin());
+  TEST_ASSERT_TRUE(cfg.imported());
+  TEST_ASSERT_EQUAL_STRING("s3cret", cfg.AdminPassword.c_str());
+  TEST_ASSERT_EQUAL_STRING("Lab", cfg.DeviceName.c_str());
+  TEST_ASSERT_EQUAL_STRING("10.1.2.3", cfg.DeviceIP.toString().c_str());
+  TEST_ASSERT_EQUAL(5, cfg.LedPin);
+  TEST_ASSERT_TRUE(cfg.HasRgbLed);
+}
+
+void test_save_keeps_custom_keys() {
+  writeFile("{\"custom\":{\"mode\":\"eco\"},\"device\":{\"name\":\"Old\"}}");
+  CaptivePortalConfig cfg(LittleFS);
+  cfg.setWriteBackDelay(0);
+  TEST_ASSERT_TRUE(cfg.begin());
+  cfg.DeviceName = "New";
+  TEST_ASSERT_TRUE(cfg.save());
+
+  JsonDocument file = readFile();
+  TEST_ASSERT_EQUAL_STRING("eco", file["custom"]["mode"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("New", file["device"]["name"].as<const char*>());
+}
+
+void test_missing_fields_keep_their_value() {
+  writeFile("{\"device\":{\"name\":\"Lab\"}}");
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(cfg.begin());
+  TEST_ASSERT_EQUAL_STRING("Lab", cfg.DeviceName.c_str());
+  TEST_ASSERT_EQUAL_STRING("Admin", cfg.AdminUser.c_str());
+  TEST_ASSERT_EQUAL_STRING("esp32-portal", cfg.DeviceHostname.c_str());
+  TEST_ASSERT_EQUAL(2, cfg.LedPin);
+}
+
+void test_validators_reject_invalid_values() {
+  writeFile(
+      "{\"user\":{\"name\":\"\"},"
+      "\"device\":{\"ledPin\":99,\"resetPin\":-1,\"hostname\":\"\",\"timezone\":\"Europe/Amsterdam\"}}");
+  CaptivePortalConfig cfg(LittleFS);
+  cfg.LedPin = 13;
+  TEST_ASSERT_TRUE(cfg.loadConfig());
+  TEST_ASSERT_EQUAL(13, cfg.LedPin);  // Keeps the value it had
+  TEST_ASSERT_EQUAL(4, cfg.ResetPin);
+  TEST_ASSERT_EQUAL_STRING("Admin", cfg.AdminUser.c_str());
+  TEST_ASSERT_EQUAL_STRING("esp32-portal", cfg.DeviceHostname.c_str());
+  TEST_ASSERT_EQUAL_STRING("Europe/Amsterdam", cfg.DeviceTimezone.c_str());  // Valid fields still load
+}
+
+void test_wrong_types_are_ignored() {
+  writeFile("{\"device\":{\"ledPin\":\"5\",\"hasRgbLed\":1,\"rgbBrightness\":300,\"name\":7}}");
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(cfg.loadConfig());
+  TEST_ASSERT_EQUAL(2, cfg.LedPin);
+  TEST_ASSERT_FALSE(cfg.HasRgbLed);
+  TEST_ASSERT_EQUAL(128, cfg.RgbBrightness);  // Out of range for uint8_t
+  TEST_ASSERT_EQUAL_STRING("", cfg.DeviceName.c_str());
+}
+
+void test_invalid_address_fails_the_load() {
+  writeFile("{\"device\":{\"IP\":\"300.1.2.3\",\"name\":\"Lab\"}}");
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_FALSE(cfg.loadConfig());
+  TEST_ASSERT_FALSE(cfg.imported());
+  TEST_ASSERT_EQUAL_STRING("192.168.168.168", cfg.DeviceIP.toString().c_str());
+}
+
+void test_export_leaves_out_secrets() {
+  CaptivePortalConfig cfg(LittleFS);
+  JsonDocument out;
+  cfg.exportFields(out.to<JsonObject>());
+  TEST_ASSERT_EQUAL_STRING("Admin", out["user"]["name"].as<const char*>());
+  TEST_ASSERT_TRUE(out["user"]["pass"].isNull());
+  TEST_ASSERT_TRUE(out["user"]["defaultPass"].isNull());
+  TEST_ASSERT_EQUAL_STRING("192.168.168.168", out["device"]["IP"].as<const char*>());
+  TEST_ASSERT_EQUAL(2, out["device"]["ledPin"].as<int>());
+  TEST_ASSERT_FALSE(out["device"]["hasRgbLed"].as<bool>());
+
+  JsonDocument all;
+  cfg.exportFields(all.to<JsonObject>(), true);
+  TEST_ASSERT_EQUAL_STRING("password", all["user"]["pass"].as<const char*>());
+  TEST_ASSERT_EQUAL_STRING("password", all["user"]["defaultPass"].as<const char*>());
+}
+
+void test_derived_fields() {
+  {
+    SensorConfig cfg(LittleFS);
+    TEST_ASSERT_EQUAL(1000, cfg.Interval);
+    TEST_ASSERT_EQUAL(-5, cfg.Offset);
+    TEST_ASSERT_EQUAL_FLOAT(1.5f, cfg.Scale);
+    TEST_ASSERT_EQUAL(42, cfg.Serial);
+    TEST_ASSERT_EQUAL_STRING("none", cfg.ApiKey.c_str());
+    TEST_ASSERT_EQUAL_STRING("Admin", cfg.AdminUser.c_str());  // Built-in fields still there
+
+    JsonDocument out;
+    cfg.exportFields(out.to<JsonObject>());
+    TEST_ASSERT_EQUAL(1000, out["sensor"]["interval"].as<int>());
+    TEST_ASSERT_EQUAL(42, out["serial"].as<int>());  // Top level key
+    TEST_ASSERT_TRUE(out["sensor"]["apiKey"].isNull());
+
+    cfg.setWriteBackDelay(0);
+    cfg.Interval = 250;
+    cfg.Offset = -40000;
+    cfg.Scale = 0.25f;
+    cfg.Serial = 4000000000UL;
+    cfg.ApiKey = "k";
+    TEST_ASSERT_TRUE(cfg.save());
+  }
+
+  SensorConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(cfg.begin());
+  TEST_ASSERT_EQUAL(250, cfg.Interval);
+  TEST_ASSERT_EQUAL(-40000, cfg.Offset);
+  TEST_ASSERT_EQUAL_FLOAT(0.25f, cfg.Scale);
+  TEST_ASSERT_EQUAL_UINT32(4000000000UL, cfg.Serial);
+  TEST_ASSERT_EQUAL_STRING("k", cfg.ApiKey.c_str());
+}
+
+void test_from_json_updates_fields_before_observers() {
+  writeFile("{\"device\": {\"timezone\": \"Etc/UTC\"}}");
+  CaptivePortalConfig cfg(LittleFS);
+  cfg.setWriteBackDelay(0);
+  TEST_ASSERT_TRUE(cfg.loadConfig());
+
+  String seen;
+  cfg.subscribe("device.timezone", [&](const ConfigChange& change) { seen = cfg.DeviceTimezone; });
+  TEST_ASSERT_TRUE(cfg.fromJson("{\"device\": {\"timezone\": \"Europe/Amsterdam\", \"ledPin\": 13}}"));
+  TEST_ASSERT_EQUAL_STRING("Europe/Amsterdam", seen.c_str());  // The member, not only the document
+  TEST_ASSERT_EQUAL(13, cfg.LedPin);
+  TEST_ASSERT_TRUE(cfg.imported());
+  TEST_ASSERT_EQUAL_STRING("Europe/Amsterdam", readFile()["device"]["timezone"].as<const char*>());
+}
+
+// The field by field load that the table replaced, for the benchmark
+struct LegacySettings {
+  String user, pass, defaultPass, hostname, name, timezone;
+  IPAddress ip, mask;
+  uint8_t ledPin = 0, rgbBrightness = 0, resetPin = 0;
+  bool rgbLed = false;
+};
+
+static bool legacyLoad(LegacySettings& s) {
+  JsonDocument doc;
+  File f = LittleFS.open("/config.json", "r");
+  if (deserializeJson(doc, f)) return false;
+  f.close();
+
+  s.user = doc["user"]["name"] | s.user;
+  s.pass = doc["user"]["pass"] | s.pass;
+  s.defaultPass = doc["user"]["defaultPass"] | s.defaultPass;
+  s.hostname = doc["device"]["hostname"] | s.hostname;
+  s.name = doc["device"]["name"] | s.name;
+  s.timezone = doc["device"]["timezone"] | s.timezone;
+  String ipStr = doc["device"]["IP"] | s.ip.toString();
+  String maskStr = doc["device"]["IPMask"] | s.mask.toString();
+  s.ledPin = doc["device"]["ledPin"] | s.ledPin;
+  s.rgbLed = doc["device"]["hasRgbLed"] | s.rgbLed;
+  s.rgbBrightness = doc["device"]["rgbBrightness"] | s.rgbBrightness;
+  s.resetPin = doc["device"]["resetPin"] | s.resetPin;
+  if (!s.ip.fromString(ipStr) || !s.mask.fromString(maskStr)) return false;
+
+  uint8_t a, b, c, d;
+  sscanf(ipStr.c_str(), "%hhu.%hhu.%hhu.%hhu", &a, &b, &c, &d);
+  s.ip = IPAddress(a, b, c, d);
+  sscanf(maskStr.c_str(), "%hhu.%hhu.%hhu.%hhu", &a, &b, &c, &d);
+  s.mask = IPAddress(a, b, c, d);
+  return true;
+}
+
+// Host numbers only show the relative cost; the JSON parser here is not the one on the device
+static void report(const char* what, unsigned long us, size_t allocs) {
+  printf("  %-22s %7.1f us/load, %5.1f allocations/load\n", what, (double)us / BENCH_ROUNDS, (double)allocs / BENCH_ROUNDS);
+}
+
+void test_bench_load_config() {
+  {
+    CaptivePortalConfig cfg(LittleFS);
+    cfg.setWriteBackDelay(0);
+    TEST_ASSERT_TRUE(cfg.save(true));
+  }
+  CaptivePortalConfig cfg(LittleFS);
+  LegacySettings legacy;
+
+  size_t allocs = testAllocations();
+  unsigned long start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) TEST_ASSERT_TRUE(legacyLoad(legacy));
+  report("field by field", micros() - start, testAllocations() - allocs);
+
+  allocs = testAllocations();
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) TEST_ASSERT_TRUE(cfg.loadConfig());
+  report("loadConfig() (table)", micros() - start, testAllocations() - allocs);
+
+  // Same values either way
+  TEST_ASSERT_EQUAL_STRING(legacy.hostname.c_str(), cfg.DeviceHostname.c_str());
+  TEST_ASSERT_EQUAL_STRING(legacy.timezone.c_str(), cfg.DeviceTimezone.c_str());
+  TEST_ASSERT_TRUE(legacy.ip == cfg.DeviceIP);
+  TEST_ASSERT_TRUE(legacy.mask == cfg.DeviceIPMask);
+  TEST_ASSERT_EQUAL(legacy.ledPin, cfg.LedPin);
+  TEST_ASSERT_EQUAL(legacy.resetPin, cfg.ResetPin);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_defaults_come_from_the_table);
+  RUN_TEST(test_save_and_load_round_trip);
+  RUN_TEST(test_save_keeps_custom_keys);
+  RUN_TEST(test_missing_fields_keep_their_value);
+  RUN_TEST(test_validators_reject_invalid_values);
+  RUN_TEST(test_wrong_types_are_ignored);
+  RUN_TEST(test_invalid_address_fails_the_load);
+  RUN_TEST(test_export_leaves_out_secrets);
+  RUN_TEST(test_derived_fields);
+  RUN_TEST(test_from_json_updates_fields_before_observers);
+  RUN_TEST(test_bench_load_config);
+  return UNITY_END();
+}
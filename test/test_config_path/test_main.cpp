@@ -0,0 +1,148 @@
+#include <AllocCount.h>
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include "Config.h"
+#include "ConfigKey.h"
+#include "ConfigPath.h"
+
+#define BENCH_ROUNDS 100000
+
+static CaptivePortalConfig* config;
+
+void setUp() {
+  LittleFS.format();
+  File f = LittleFS.open("/config.json", "w");
+  f.print("{\"device\": {\"rgb_led\": true, \"name\": \"kitchen\"}, \"app\": {\"sensor\": {\"interval\": 250}}}");
+  f.close();
+  config = new CaptivePortalConfig(LittleFS);
+  config->setWriteBackDelay(0);
+  TEST_ASSERT_TRUE(config->loadConfig());
+}
+
+void tearDown() {
+  delete config;
+}
+
+static void assertSegment(const ConfigPath& path, size_t i, const char* expected) {
+  TEST_ASSERT_EQUAL(strlen(expected), path.segmentLength(i));
+  TEST_ASSERT_EQUAL_MEMORY(expected, path.segment(i), strlen(expected));
+}
+
+void test_key_is_split_into_segments() {
+  ConfigPath path("app.sensor.interval");
+  TEST_ASSERT_TRUE(path.isValid());
+  TEST_ASSERT_EQUAL(3, path.depth());
+  assertSegment(path, 0, "app");
+  assertSegment(path, 1, "sensor");
+  assertSegment(path, 2, "interval");
+  TEST_ASSERT_EQUAL_STRING("app.sensor.interval", path.c_str());
+}
+
+void test_invalid_keys() {
+  TEST_ASSERT_FALSE(ConfigPath("").isValid());
+  TEST_ASSERT_FALSE(ConfigPath((const char*)nullptr).isValid());
+  TEST_ASSERT_FALSE(ConfigPath("a..b").isValid());
+  TEST_ASSERT_FALSE(ConfigPath(".a").isValid());
+  TEST_ASSERT_FALSE(ConfigPath("a.").isValid());
+  TEST_ASSERT_FALSE(ConfigPath("a.b.c.d.e.f.g").isValid());  // Deeper than CP_CONFIG_PATH_DEPTH
+  TEST_ASSERT_FALSE(ConfigPath(String(CP_CONFIG_SEGMENT_MAX + 1, 'x')).isValid());
+  TEST_ASSERT_TRUE(ConfigPath(String(CP_CONFIG_SEGMENT_MAX, 'x')).isValid());
+}
+
+void test_key_outlives_its_source() {
+  char buffer[64];
+  strcpy(buffer, "device.name");
+  ConfigPath shortKey(buffer);
+  strcpy(buffer, "app.sensor.interval.with_a_long_name");
+  ConfigPath longKey(buffer);
+  strcpy(buffer, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+
+  TEST_ASSERT_EQUAL_STRING("device.name", shortKey.c_str());
+  assertSegment(shortKey, 1, "name");
+  TEST_ASSERT_EQUAL_STRING("app.sensor.interval.with_a_long_name", longKey.c_str());
+  assertSegment(longKey, 3, "with_a_long_name");
+
+  ConfigPath copy = longKey;  // Copies keep their own text too
+  TEST_ASSERT_EQUAL_STRING(longKey.c_str(), copy.c_str());
+  TEST_ASSERT_NOT_EQUAL(longKey.c_str(), copy.c_str());
+}
+
+void test_config_key_from_a_temporary_string() {
+  String section = "device";
+  ConfigKey<String> name(*config, section + ".name", "none");
+  section = "xxxxxx";
+  TEST_ASSERT_EQUAL_STRING("kitchen", name.get().c_str());
+}
+
+void test_short_keys_do_not_allocate() {
+  size_t before = testAllocations();
+  ConfigPath path("app.sensor.interval");
+  ConfigPath copy = path;
+  TEST_ASSERT_EQUAL(0, testAllocations() - before);
+  TEST_ASSERT_EQUAL(3, copy.depth());
+
+  // Longer keys keep one copy on the heap
+  before = testAllocations();
+  ConfigPath longKey("app.sensor.interval.with_a_long_name");
+  TEST_ASSERT_EQUAL(1, testAllocations() - before);
+}
+
+void test_reads_do_not_allocate() {
+  static const ConfigPath kInterval("app.sensor.interval");
+  ConfigKey<uint32_t> interval(*config, "app.sensor.interval", 0);
+  TEST_ASSERT_EQUAL(250, interval.get());
+
+  size_t before = testAllocations();
+  TEST_ASSERT_EQUAL(250, config->getUInt(kInterval));
+  TEST_ASSERT_EQUAL(250, config->getUInt("app.sensor.interval"));  // Built on the stack for the call
+  TEST_ASSERT_TRUE(config->getBool("device.rgb_led"));
+  TEST_ASSERT_EQUAL(250, interval.get());
+  TEST_ASSERT_EQUAL(0, testAllocations() - before);
+}
+
+// Prints the time per lookup, host numbers only show the relative cost
+static void report(const char* what, unsigned long us, uint32_t sum) {
+  printf("  %-28s %7.1f ns/lookup (checksum %u)\n", what, us * 1000.0 / BENCH_ROUNDS, (unsigned)sum);
+}
+
+void test_bench_key_resolution() {
+  static const ConfigPath kInterval("app.sensor.interval");
+  ConfigKey<uint32_t> interval(*config, kInterval, 0);
+  uint32_t sum = 0;
+
+  unsigned long start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) sum += ConfigPath("app.sensor.interval").depth();
+  report("split only", micros() - start, sum);
+
+  sum = 0;
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) sum += config->getUInt("app.sensor.interval");
+  report("getUInt(\"...\")", micros() - start, sum);
+  TEST_ASSERT_EQUAL_UINT32(250UL * BENCH_ROUNDS, sum);
+
+  sum = 0;
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) sum += config->getUInt(kInterval);
+  report("getUInt(prebuilt ConfigPath)", micros() - start, sum);
+  TEST_ASSERT_EQUAL_UINT32(250UL * BENCH_ROUNDS, sum);
+
+  sum = 0;
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) sum += interval.get();
+  report("ConfigKey::get()", micros() - start, sum);
+  TEST_ASSERT_EQUAL_UINT32(250UL * BENCH_ROUNDS, sum);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_key_is_split_into_segments);
+  RUN_TEST(test_invalid_keys);
+  RUN_TEST(test_key_outlives_its_source);
+  RUN_TEST(test_config_key_from_a_temporary_string);
+  RUN_TEST(test_short_keys_do_not_allocate);
+  RUN_TEST(test_reads_do_not_allocate);
+  RUN_TEST(test_bench_key_resolution);
+  return UNITY_END();
+}
@@ -0,0 +1,288 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include "AllocCount.h"
+#include "Config.h"
+
+#define BENCH_ROUNDS 2000
+
+#define LIVE "/config.json"
+#define TMP "/config.json.tmp"
+#define BAK "/config.json.bak"
+
+// Saves name right away, like a settings change with the write-back delay off
+static bool saveName(CaptivePortalConfig& cfg, const char* name) {
+  cfg.setWriteBackDelay(0);
+  cfg.DeviceName = name;
+  return cfg.save();
+}
+
+// What a fresh start (e.g. after a power cut) reads from flash
+static String nameAfterReboot() {
+  CaptivePortalConfig cfg(LittleFS);
+  if (!cfg.loadConfig()) return "(not loaded)";
+  return cfg.DeviceName;
+}
+
+static void writeRaw(const char* path, const char* content) {
+  File f = LittleFS.open(path, "w");
+  f.print(content);
+  f.close();
+}
+
+static String readRaw(const char* path) {
+  File f = LittleFS.open(path, "r");
+  String s = f.readString();
+  f.close();
+  return s;
+}
+
+void setUp() {
+  LittleFS.format();  // Also clears the faults
+}
+
+void tearDown() {}
+
+void test_save_replaces_live_and_keeps_backup() {
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(saveName(cfg, "first"));
+  TEST_ASSERT_TRUE(LittleFS.exists(LIVE));
+  TEST_ASSERT_FALSE(LittleFS.exists(BAK));  // Nothing to keep yet
+
+  String first = readRaw(LIVE);
+  TEST_ASSERT_TRUE(saveName(cfg, "second"));
+  TEST_ASSERT_FALSE(LittleFS.exists(TMP));
+  TEST_ASSERT_EQUAL_STRING(first.c_str(), readRaw(BAK).c_str());
+  TEST_ASSERT_EQUAL_STRING("second", nameAfterReboot().c_str());
+}
+
+void test_failed_open_keeps_live_and_retries() {
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(saveName(cfg, "first"));
+
+  LittleFS.faults().path = TMP;
+  LittleFS.faults().openFailures = 1;
+  TEST_ASSERT_FALSE(saveName(cfg, "second"));
+  TEST_ASSERT_TRUE(cfg.writeFailed());
+  TEST_ASSERT_TRUE(cfg.isDirty());  // Kept for the retry
+  TEST_ASSERT_EQUAL_STRING("first", nameAfterReboot().c_str());
+
+  TEST_ASSERT_TRUE(cfg.flush());
+  TEST_ASSERT_FALSE(cfg.writeFailed());
+  TEST_ASSERT_EQUAL_STRING("second", nameAfterReboot().c_str());
+}
+
+void test_short_write_keeps_live() {
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(saveName(cfg, "first"));
+  String first = readRaw(LIVE);
+
+  LittleFS.faults().path = TMP;
+  LittleFS.faults().writeLimit = 10;  // Disk full after 10 bytes
+  TEST_ASSERT_FALSE(saveName(cfg, "second"));
+  TEST_ASSERT_FALSE(LittleFS.exists(TMP));  // The partial copy is not left behind
+  TEST_ASSERT_EQUAL_STRING(first.c_str(), readRaw(LIVE).c_str());
+  TEST_ASSERT_EQUAL_STRING("first", nameAfterReboot().c_str());
+}
+
+void test_failed_backup_rename_keeps_live() {
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(saveName(cfg, "first"));
+
+  LittleFS.faults().path = LIVE;
+  LittleFS.faults().renameFailures = 1;
+  TEST_ASSERT_FALSE(saveName(cfg, "second"));
+  TEST_ASSERT_FALSE(LittleFS.exists(TMP));
+  TEST_ASSERT_EQUAL_STRING("first", nameAfterReboot().c_str());
+}
+
+void test_failed_swap_recovers_from_tmp() {
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(saveName(cfg, "first"));
+
+  // The live file is already the backup when tmp -> live fails
+  LittleFS.faults().path = TMP;
+  LittleFS.faults().renameFailures = 1;
+  TEST_ASSERT_FALSE(saveName(cfg, "second"));
+  TEST_ASSERT_FALSE(LittleFS.exists(LIVE));
+  TEST_ASSERT_TRUE(LittleFS.exists(TMP));
+  TEST_ASSERT_TRUE(LittleFS.exists(BAK));
+
+  TEST_ASSERT_EQUAL_STRING("second", nameAfterReboot().c_str());  // The complete new copy wins
+  TEST_ASSERT_TRUE(LittleFS.exists(LIVE));
+  TEST_ASSERT_FALSE(LittleFS.exists(TMP));
+}
+
+void test_interrupted_write_falls_back_to_backup() {
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(saveName(cfg, "first"));
+  TEST_ASSERT_TRUE(saveName(cfg, "second"));
+
+  // Power cut while tmp was written, with the live file lost
+  LittleFS.remove(LIVE);
+  writeRaw(TMP, "{\"device\": {\"na");
+  TEST_ASSERT_EQUAL_STRING("first", nameAfterReboot().c_str());
+  TEST_ASSERT_TRUE(LittleFS.exists(LIVE));
+  TEST_ASSERT_FALSE(LittleFS.exists(BAK));
+
+  // Saving works again from the recovered file
+  CaptivePortalConfig next(LittleFS);
+  TEST_ASSERT_TRUE(next.loadConfig());
+  TEST_ASSERT_TRUE(saveName(next, "third"));
+  TEST_ASSERT_EQUAL_STRING("third", nameAfterReboot().c_str());
+}
+
+void test_interrupted_write_keeps_intact_live() {
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(saveName(cfg, "first"));
+
+  writeRaw(TMP, "{\"device\": {\"na");  // Power cut before the renames
+  TEST_ASSERT_EQUAL_STRING("first", nameAfterReboot().c_str());
+}
+
+void test_corrupt_live_is_restored_from_backup() {
+  CaptivePortalConfig cfg(LittleFS);
+  TEST_ASSERT_TRUE(saveName(cfg, "first"));
+  TEST_ASSERT_TRUE(saveName(cfg, "second"));
+
+  writeRaw(LIVE, "{\"device\": ");
+  TEST_ASSERT_EQUAL_STRING("first", nameAfterReboot().c_str());
+}
+
+// Reads and writes as they were before the document stayed in memory: the file is
+// opened and parsed on every call, and every set() rewrites it
+static uint32_t legacyGetUInt(const char* path) {
+  File f = LittleFS.open(path, "r");
+  JsonDocument doc;
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+  if (err) return 0;
+  return doc["app"]["sensor"]["interval"] | 0U;
+}
+
+static bool legacySet(const char* path, uint32_t value) {
+  File f = LittleFS.open(path, "r");
+  JsonDocument doc;
+  DeserializationError err = deserializeJson(doc, f);
+  f.close();
+  if (err) return false;
+  doc["app"]["sensor"]["interval"] = value;
+  File out = LittleFS.open(path, "w");
+  size_t written = serializeJsonPretty(doc, out);
+  out.close();
+  return written > 0;
+}
+
+// Host numbers only show the relative cost; the JSON parser here is not the one on the device
+static void report(const char* what, unsigned long us, size_t allocs) {
+  printf("  %-26s %7.2f us/call, %5.1f allocations/call\n", what, (double)us / BENCH_ROUNDS, (double)allocs / BENCH_ROUNDS);
+}
+
+void test_bench_resident_document() {
+  CaptivePortalConfig cfg(LittleFS);
+  cfg.setWriteBackDelay(0);
+  TEST_ASSERT_TRUE(cfg.save(true));
+  TEST_ASSERT_TRUE(cfg.setValue("app.sensor.interval", 250));
+  cfg.setWriteBackDelay(60000);  // Sets below are written back once, by the flush()
+  writeRaw("/legacy.json", readRaw(LIVE).c_str());
+  uint32_t sum = 0;
+
+  size_t allocs = testAllocations();
+  unsigned long start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) sum += legacyGetUInt("/legacy.json");
+  report("get, parse file per call", micros() - start, testAllocations() - allocs);
+  TEST_ASSERT_EQUAL_UINT32(250UL * BENCH_ROUNDS, sum);
+
+  sum = 0;
+  allocs = testAllocations();
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) sum += cfg.getUInt("app.sensor.interval");
+  report("get, resident document", micros() - start, testAllocations() - allocs);
+  TEST_ASSERT_EQUAL_UINT32(250UL * BENCH_ROUNDS, sum);
+
+  allocs = testAllocations();
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) TEST_ASSERT_TRUE(legacySet("/legacy.json", i));
+  report("set, rewrite file per call", micros() - start, testAllocations() - allocs);
+
+  allocs = testAllocations();
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) TEST_ASSERT_TRUE(cfg.setValue("app.sensor.interval", i));
+  TEST_ASSERT_TRUE(cfg.flush());
+  report("set, one write-back", micros() - start, testAllocations() - allocs);
+
+  TEST_ASSERT_EQUAL(BENCH_ROUNDS - 1, legacyGetUInt("/legacy.json"));
+  TEST_ASSERT_EQUAL(BENCH_ROUNDS - 1, legacyGetUInt(LIVE));
+}
+
+static size_t fileSize(const char* path) {
+  File f = LittleFS.open(path, "r");
+  size_t size = f ? f.size() : 0;
+  f.close();
+  return size;
+}
+
+void test_bench_msgpack_against_json() {
+  CaptivePortalConfig cfg(LittleFS);
+  cfg.setWriteBackDelay(0);
+  TEST_ASSERT_TRUE(cfg.save(true));
+  // A typical application section next to the built-in settings
+  TEST_ASSERT_TRUE(cfg.setValue("app.sensor.interval", 250));
+  TEST_ASSERT_TRUE(cfg.setValue("app.sensor.offset", -40));
+  TEST_ASSERT_TRUE(cfg.set("app.mqtt.host", "broker.local"));
+  TEST_ASSERT_TRUE(cfg.setValue("app.mqtt.port", 1883));
+  TEST_ASSERT_TRUE(cfg.setValue("app.mqtt.tls", true));
+  String json = readRaw(LIVE);
+  size_t jsonSize = fileSize(LIVE);
+
+  unsigned long start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) TEST_ASSERT_TRUE(cfg.loadConfig());
+  unsigned long jsonLoadUs = micros() - start;
+
+  cfg.setStorageFormat(CaptivePortalConfig::StorageFormat::MsgPack);
+  TEST_ASSERT_TRUE(cfg.loadConfig());  // Migrates config.json once
+  TEST_ASSERT_FALSE(LittleFS.exists(LIVE));
+  size_t msgpackSize = fileSize("/config.msgpack");
+  TEST_ASSERT_EQUAL(250, cfg.getUInt("app.sensor.interval"));
+
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) TEST_ASSERT_TRUE(cfg.loadConfig());
+  unsigned long msgpackLoadUs = micros() - start;
+
+  // The parsers alone, from memory
+  JsonDocument doc;
+  char packed[1024];
+  TEST_ASSERT_FALSE(deserializeJson(doc, json));
+  size_t packedSize = serializeMsgPack(doc, packed, sizeof(packed));
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) TEST_ASSERT_FALSE(deserializeJson(doc, json));
+  unsigned long jsonParseUs = micros() - start;
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) TEST_ASSERT_FALSE(deserializeMsgPack(doc, packed, packedSize));
+  unsigned long msgpackParseUs = micros() - start;
+
+  // The sizes are fixed by the formats; the times are host times and only show the ratio
+  printf("  %-8s %5u bytes (%u compact), loadConfig() %6.1f us, parse %6.1f us\n", "JSON", (unsigned)jsonSize,
+         (unsigned)measureJson(doc), (double)jsonLoadUs / BENCH_ROUNDS, (double)jsonParseUs / BENCH_ROUNDS);
+  printf("  %-8s %5u bytes,               loadConfig() %6.1f us, parse %6.1f us\n", "MsgPack", (unsigned)msgpackSize,
+         (double)msgpackLoadUs / BENCH_ROUNDS, (double)msgpackParseUs / BENCH_ROUNDS);
+  TEST_ASSERT_EQUAL(packedSize, msgpackSize);
+  TEST_ASSERT_TRUE(msgpackSize < measureJson(doc));  // Smaller than JSON without the indentation too
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_save_replaces_live_and_keeps_backup);
+  RUN_TEST(test_failed_open_keeps_live_and_retries);
+  RUN_TEST(test_short_write_keeps_live);
+  RUN_TEST(test_failed_backup_rename_keeps_live);
+  RUN_TEST(test_failed_swap_recovers_from_tmp);
+  RUN_TEST(test_interrupted_write_falls_back_to_backup);
+  RUN_TEST(test_interrupted_write_keeps_intact_live);
+  RUN_TEST(test_corrupt_live_is_restored_from_backup);
+  RUN_TEST(test_bench_resident_document);
+  RUN_TEST(test_bench_msgpack_against_json);
+  return UNITY_END();
+}
@@ -0,0 +1,263 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+
+#include "GzipUtil.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+static const char PREFIX[] = "<!DOCTYPE html><html><head><title>Home</title></head><body><nav>menu</nav>";
+static const char BODY[] = "<h1>Welcome</h1><p>Body text that is stored pre-compressed, repeated repeated repeated.</p>";
+
+static const char FOOTER[] = "</body></html>";
+
+// Compresses data into a gzip member with zlib, optionally with a file name in the header
+static Bytes gzip(const std::string& data, const char* name = nullptr, int level = Z_BEST_COMPRESSION,
+                  int strategy = Z_DEFAULT_STRATEGY) {
+  z_stream z = {};
+  deflateInit2(&z, level, Z_DEFLATED, 16 + MAX_WBITS, 8, strategy);
+  gz_header header = {};
+  if (name) {
+    header.name = (Bytef*)name;
+    deflateSetHeader(&z, &header);
+  }
+  Bytes out(deflateBound(&z, data.size()) + 64);
+  z.next_in = (Bytef*)data.data();
+  z.avail_in = data.size();
+  z.next_out = out.data();
+  z.avail_out = out.size();
+  deflate(&z, Z_FINISH);
+  out.resize(z.total_out);
+  deflateEnd(&z);
+  return out;
+}
+
+static bool gunzip(const Bytes& in, std::string& out) {
+  z_stream z = {};
+  inflateInit2(&z, 16 + MAX_WBITS);  // Checks the CRC32 and ISIZE of the trailer
+  char buf[4096];
+  z.next_in = (Bytef*)in.data();
+  z.avail_in = in.size();
+  int rc;
+  do {
+    z.next_out = (Bytef*)buf;
+    z.avail_out = sizeof(buf);
+    rc = inflate(&z, Z_NO_FLUSH);
+    out.append(buf, sizeof(buf) - z.avail_out);
+  } while (rc == Z_OK);
+  inflateEnd(&z);
+  return rc == Z_STREAM_END && z.avail_in == 0;
+}
+
+// Deflate data of a gzip member
+static Bytes deflateData(const Bytes& gz) {
+  size_t offset = gzipDataOffset(gz.data(), gz.size());
+  return Bytes(gz.begin() + offset, gz.end() - GZIP_TRAILER_SIZE);
+}
+
+static bool findEnd(const Bytes& data, DeflateEnd& end) {
+  size_t pos = 0;
+  return deflateFindEnd(
+      [&](uint8_t* buf, size_t len) {
+        size_t n = std::min(len, data.size() - pos);
+        memcpy(buf, data.data() + pos, n);
+        pos += n;
+        return n;
+      },
+      end);
+}
+
+// Splices prefix in front of and suffix behind a gzip file, the way streamPageWithMenu() sends a menu page
+static Bytes splice(const std::string& prefix, const Bytes& gz, const std::string& suffix = FOOTER) {
+  uint32_t bodyCrc = gzipReadLE32(gz.data() + gz.size() - GZIP_TRAILER_SIZE);
+  uint32_t bodySize = gzipReadLE32(gz.data() + gz.size() - 4);
+  Bytes body = deflateData(gz);
+  DeflateEnd end;
+  if (!findEnd(body, end)) return Bytes();  // Fails the gunzip() of the caller
+
+  Bytes out(GZIP_HEADER_SIZE + GZIP_STORED_BLOCK_HEADER_SIZE);
+  gzipWriteHeader(out.data());
+  gzipWriteStoredBlockHeader(out.data() + GZIP_HEADER_SIZE, (uint16_t)prefix.size());
+  out.insert(out.end(), prefix.begin(), prefix.end());
+
+  // The body's last block is followed by a final stored block with the suffix
+  body[end.finalBit / 8] &= ~(1 << (end.finalBit % 8));
+  uint8_t tail[DEFLATE_APPEND_HEADER_MAX];
+  size_t n = deflateAppendStoredHeader(tail, body.back(), end.endBit - (body.size() - 1) * 8, suffix.size());
+  out.insert(out.end(), body.begin(), body.end() - 1);
+  out.insert(out.end(), tail, tail + n);
+  out.insert(out.end(), suffix.begin(), suffix.end());
+
+  uint8_t trailer[GZIP_TRAILER_SIZE];
+  uint32_t crc = crc32Combine(crc32Update(0, prefix.data(), prefix.size()), bodyCrc, bodySize);
+  crc = crc32Combine(crc, crc32Update(0, suffix.data(), suffix.size()), suffix.size());
+  gzipWriteTrailer(trailer, crc, prefix.size() + bodySize + suffix.size());
+  out.insert(out.end(), trailer, trailer + sizeof(trailer));
+  return out;
+}
+
+// Text that compresses into several dynamic blocks
+static std::string longText(size_t size) {
+  std::string text;
+  uint32_t x = 12345;
+  while (text.size() < size) {
+    x = x * 1103515245 + 12345;
+    text += "<li>item " + std::to_string(x % 1000) + (x & 0x10000 ? " on</li>" : " off</li>");
+  }
+  return text;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_crc32_check_value() {
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32Update(0, "123456789", 9));
+  TEST_ASSERT_EQUAL_HEX32(0, crc32Update(0, "", 0));
+}
+
+void test_crc32_update_in_parts() {
+  uint32_t crc = crc32Update(0, "1234", 4);
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32Update(crc, "56789", 5));
+}
+
+void test_crc32_combine_matches_whole() {
+  std::string data(BODY);
+  for (size_t split = 0; split <= data.size(); split += 7) {
+    uint32_t a = crc32Update(0, data.data(), split);
+    uint32_t b = crc32Update(0, data.data() + split, data.size() - split);
+    TEST_ASSERT_EQUAL_HEX32(crc32Update(0, data.data(), data.size()), crc32Combine(a, b, data.size() - split));
+  }
+}
+
+void test_data_offset_plain_header() {
+  Bytes gz = gzip(BODY);
+  TEST_ASSERT_EQUAL(GZIP_HEADER_SIZE, gzipDataOffset(gz.data(), gz.size()));
+}
+
+void test_data_offset_skips_optional_fields() {
+  // FEXTRA (2 bytes), FNAME, FCOMMENT and FHCRC
+  const uint8_t header[] = {0x1f, 0x8b, 8, 0x1e, 0, 0, 0, 0, 0, 3, 2, 0, 'x', 'y', 'a', '.', 'h', 0, 'c', 0, 0xaa, 0xbb, 0x55};
+  TEST_ASSERT_EQUAL(sizeof(header) - 1, gzipDataOffset(header, sizeof(header)));
+
+  Bytes named = gzip(BODY, "index.html");
+  TEST_ASSERT_EQUAL(GZIP_HEADER_SIZE + strlen("index.html") + 1, gzipDataOffset(named.data(), named.size()));
+}
+
+void test_data_offset_rejects_invalid_headers() {
+  Bytes gz = gzip(BODY);
+  TEST_ASSERT_EQUAL(0, gzipDataOffset(gz.data(), GZIP_HEADER_SIZE - 1));  // Truncated
+  gz[1] = 0;
+  TEST_ASSERT_EQUAL(0, gzipDataOffset(gz.data(), gz.size()));  // Bad magic
+
+  const uint8_t unterminated[] = {0x1f, 0x8b, 8, 0x08, 0, 0, 0, 0, 0, 3, 'a', 'b'};
+  TEST_ASSERT_EQUAL(0, gzipDataOffset(unterminated, sizeof(unterminated)));
+}
+
+void test_trailer_round_trip() {
+  uint8_t trailer[GZIP_TRAILER_SIZE];
+  gzipWriteTrailer(trailer, 0x12345678, 0x9abcdef0);
+  TEST_ASSERT_EQUAL_HEX8(0x78, trailer[0]);
+  TEST_ASSERT_EQUAL_HEX32(0x12345678, gzipReadLE32(trailer));
+  TEST_ASSERT_EQUAL_HEX32(0x9abcdef0, gzipReadLE32(trailer + 4));
+}
+
+void test_splice_inflates_to_prefix_body_and_footer() {
+  std::string text;
+  TEST_ASSERT_TRUE(gunzip(splice(PREFIX, gzip(BODY)), text));
+  TEST_ASSERT_EQUAL_STRING((std::string(PREFIX) + BODY + FOOTER).c_str(), text.c_str());
+}
+
+void test_splice_with_named_member_and_empty_body() {
+  std::string text;
+  TEST_ASSERT_TRUE(gunzip(splice(PREFIX, gzip(BODY, "home.html")), text));
+  TEST_ASSERT_EQUAL_STRING((std::string(PREFIX) + BODY + FOOTER).c_str(), text.c_str());
+
+  text.clear();
+  TEST_ASSERT_TRUE(gunzip(splice(PREFIX, gzip("")), text));
+  TEST_ASSERT_EQUAL_STRING((std::string(PREFIX) + FOOTER).c_str(), text.c_str());
+}
+
+void test_find_end_of_each_block_type() {
+  struct {
+    int level, strategy;
+    size_t size;
+  } cases[] = {
+      {0, Z_DEFAULT_STRATEGY, 100},       // One stored block
+      {0, Z_DEFAULT_STRATEGY, 200000},    // Several stored blocks
+      {9, Z_FIXED, 100},                  // Fixed Huffman
+      {9, Z_DEFAULT_STRATEGY, 5000},      // Dynamic Huffman
+      {9, Z_DEFAULT_STRATEGY, 400000},    // Several dynamic blocks
+      {1, Z_HUFFMAN_ONLY, 3000},          // Literals only
+      {9, Z_RLE, 3000},                   // Distance 1 only
+  };
+  for (const auto& c : cases) {
+    std::string text = longText(c.size);
+    Bytes data = deflateData(gzip(text, nullptr, c.level, c.strategy));
+    DeflateEnd end;
+    TEST_ASSERT_TRUE(findEnd(data, end));
+    TEST_ASSERT_EQUAL(data.size(), (end.endBit + 7) / 8);
+    TEST_ASSERT_TRUE(end.finalBit < end.endBit);
+    TEST_ASSERT_EQUAL(1, (data[end.finalBit / 8] >> (end.finalBit % 8)) & 1);
+
+    std::string out;
+    TEST_ASSERT_TRUE(gunzip(splice(PREFIX, gzip(text, nullptr, c.level, c.strategy)), out));
+    TEST_ASSERT_TRUE(out == PREFIX + text + FOOTER);
+  }
+}
+
+void test_splice_at_every_bit_position() {
+  // Different inputs end the last block at different bits of the last byte
+  bool seen[9] = {};
+  std::string source = longText(400);
+  for (size_t len = 0; len < 256; len++) {
+    std::string text = source.substr(0, len);
+    Bytes gz = gzip(text, nullptr, 9, Z_FIXED);
+    DeflateEnd end;
+    TEST_ASSERT_TRUE(findEnd(deflateData(gz), end));
+    seen[end.endBit % 8 == 0 ? 8 : end.endBit % 8] = true;
+
+    std::string out;
+    TEST_ASSERT_TRUE(gunzip(splice(PREFIX, gz), out));
+    TEST_ASSERT_TRUE(out == PREFIX + text + FOOTER);
+  }
+  for (int bits = 1; bits <= 8; bits++) TEST_ASSERT_TRUE(seen[bits]);
+}
+
+void test_find_end_rejects_invalid_data() {
+  Bytes data = deflateData(gzip(longText(5000)));
+  DeflateEnd end;
+  TEST_ASSERT_FALSE(findEnd(Bytes(data.begin(), data.begin() + data.size() / 2), end));  // Truncated
+  TEST_ASSERT_FALSE(findEnd(Bytes(), end));
+  TEST_ASSERT_FALSE(findEnd(Bytes{0x07}, end));  // BTYPE 11 is reserved
+  TEST_ASSERT_FALSE(findEnd(Bytes{0x01, 0x05, 0x00, 0x00, 0x00}, end));  // Stored LEN and NLEN do not match
+}
+
+void test_splice_with_largest_prefix() {
+  // The menu must fit in one stored block
+  std::string prefix(0xffff, 'm');
+  std::string text;
+  TEST_ASSERT_TRUE(gunzip(splice(prefix, gzip(BODY)), text));
+  TEST_ASSERT_EQUAL(prefix.size() + strlen(BODY) + strlen(FOOTER), text.size());
+  TEST_ASSERT_EQUAL_STRING((std::string(BODY) + FOOTER).c_str(), text.c_str() + prefix.size());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc32_check_value);
+  RUN_TEST(test_crc32_update_in_parts);
+  RUN_TEST(test_crc32_combine_matches_whole);
+  RUN_TEST(test_data_offset_plain_header);
+  RUN_TEST(test_data_offset_skips_optional_fields);
+  RUN_TEST(test_data_offset_rejects_invalid_headers);
+  RUN_TEST(test_trailer_round_trip);
+  RUN_TEST(test_splice_inflates_to_prefix_body_and_footer);
+  RUN_TEST(test_splice_with_named_member_and_empty_body);
+  RUN_TEST(test_find_end_of_each_block_type);
+  RUN_TEST(test_splice_at_every_bit_position);
+  RUN_TEST(test_find_end_rejects_invalid_data);
+  RUN_TEST(test_splice_with_largest_prefix);
+  return UNITY_END();
+}
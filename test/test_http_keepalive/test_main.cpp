@@ -0,0 +1,417 @@
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "AsyncHttpTransport.h"
+#include "ETagCache.h"
+
+#define PORT 18080
+
+static AsyncHttpTransport* server;
+
+struct Response {
+  int status = 0;
+  std::string headers;  // Lower case
+  std::string body;
+  bool closed = false;  // Server closed the connection after the response
+  bool has(const char* header) const { return headers.find(header) != std::string::npos; }
+};
+
+static int connectClient() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+  server->handleClient();  // Accept
+  return fd;
+}
+
+// Runs the server once and appends what the client received to in
+static void pump(int fd, std::string& in, bool& closed) {
+  char buf[2048];
+  ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+  if (n > 0) in.append(buf, n);
+  if (n == 0) closed = true;
+  server->handleClient();
+}
+
+// Takes one response off the front of in, false if it is not complete yet
+static bool parse(std::string& in, Response& r) {
+  size_t headEnd = in.find("\r\n\r\n");
+  if (headEnd == std::string::npos) return false;
+  std::string head = in.substr(0, headEnd + 2);
+  for (char& c : head) c = (char)tolower((unsigned char)c);
+  size_t pos = headEnd + 4;
+  std::string body;
+
+  if (head.find("transfer-encoding: chunked") != std::string::npos) {
+    for (;;) {
+      size_t lineEnd = in.find("\r\n", pos);
+      if (lineEnd == std::string::npos) return false;
+      size_t size = strtoul(in.c_str() + pos, nullptr, 16);
+      if (in.size() < lineEnd + 2 + size + 2) return false;
+      body.append(in, lineEnd + 2, size);
+      pos = lineEnd + 2 + size + 2;
+      if (size == 0) break;
+    }
+  } else {
+    size_t cl = head.find("content-length: ");
+    size_t length = cl == std::string::npos ? 0 : strtoul(head.c_str() + cl + 16, nullptr, 10);
+    if (in.size() < pos + length) return false;
+    body = in.substr(pos, length);
+    pos += length;
+  }
+  r.status = atoi(head.c_str() + 9);
+  r.headers = head;
+  r.body = body;
+  in.erase(0, pos);
+  return true;
+}
+
+// Sends request and reads count responses, gives up after 2 s
+static std::vector<Response> exchange(int fd, const std::string& request, size_t count = 1) {
+  send(fd, request.data(), request.size(), 0);
+  std::vector<Response> responses;
+  std::string in;
+  bool closed = false;
+  unsigned long start = millis();
+  while (millis() - start < 2000) {
+    pump(fd, in, closed);
+    Response r;
+    while (responses.size() < count && parse(in, r)) responses.push_back(r);
+    if (responses.size() == count || closed) break;
+    usleep(1000);
+  }
+  // Give the server a moment to close the connection
+  for (int i = 0; i < 20 && !closed; i++) {
+    pump(fd, in, closed);
+    usleep(500);
+  }
+  if (!responses.empty()) responses.back().closed = closed;
+  return responses;
+}
+
+static Response get(int fd, const char* path, const char* extraHeaders = "") {
+  std::string request = std::string("GET ") + path + " HTTP/1.1\r\nHost: portal\r\n" + extraHeaders + "\r\n";
+  std::vector<Response> r = exchange(fd, request);
+  return r.empty() ? Response() : r[0];
+}
+
+// Discards what the server sends until it closes the connection, false after 50 ms
+static bool isClosed(int fd) {
+  char buf[512];
+  for (int i = 0; i < 50; i++) {
+    server->handleClient();
+    ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n == 0) return true;
+    usleep(1000);
+  }
+  return false;
+}
+
+void setUp() {
+  server = new AsyncHttpTransport(PORT, 2);
+  const char* headers[] = {"If-None-Match"};
+  server->collectHeaders(headers, 1);
+  server->on("/", HTTP_GET, []() { server->send(200, "text/plain", "home"); });
+  server->on("/chunked", HTTP_GET, []() {
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send(200, "text/plain", "");
+    server->sendContent("part1,");
+    server->sendContent("part2");
+  });
+  server->on("/echo", HTTP_POST, []() { server->send(200, "text/plain", server->arg("plain")); });
+  server->on("/form", HTTP_POST, []() { server->send(200, "text/plain", server->arg("note")); });
+  server->on("/cached", HTTP_GET, []() {
+    if (ETagCache::matches(server, "\"v1\"")) {
+      ETagCache::sendNotModified(server, "\"v1\"");
+      return;
+    }
+    server->sendHeader("ETag", "\"v1\"");
+    server->send(200, "text/css", "body{}");
+  });
+  server->on("/nocontent", HTTP_GET, []() { server->send(204, "text/plain", ""); });
+  server->on("/big", HTTP_POST, []() { server->send(200, "text/plain", String(server->arg("content").length())); });
+  server->setBodyLimit("/big", 4 * CP_HTTP_BODY_MAX);
+  server->on("/short", HTTP_GET, []() {
+    server->setContentLength(10);
+    server->send(200, "text/plain", "");
+    server->sendContent("abc");
+  });
+  server->begin();
+}
+
+void tearDown() {
+  delete server;
+}
+
+void test_requests_share_one_connection() {
+  int fd = connectClient();
+  for (int i = 0; i < 3; i++) {
+    Response r = get(fd, "/");
+    TEST_ASSERT_EQUAL(200, r.status);
+    TEST_ASSERT_EQUAL_STRING("home", r.body.c_str());
+    TEST_ASSERT_TRUE(r.has("connection: keep-alive"));
+    TEST_ASSERT_TRUE(r.has("content-length: 4"));
+    TEST_ASSERT_FALSE(r.closed);
+  }
+  Response r = get(fd, "/chunked");
+  TEST_ASSERT_TRUE(r.has("transfer-encoding: chunked"));
+  TEST_ASSERT_EQUAL_STRING("part1,part2", r.body.c_str());
+  TEST_ASSERT_FALSE(r.closed);
+  TEST_ASSERT_EQUAL(4, server->requestCount());
+  TEST_ASSERT_EQUAL(1, server->clientCount());
+  close(fd);
+}
+
+void test_pipelined_requests_are_answered_in_order() {
+  int fd = connectClient();
+  std::vector<Response> r = exchange(fd,
+                                     "POST /echo HTTP/1.1\r\nContent-Length: 3\r\n\r\none"
+                                     "GET /chunked HTTP/1.1\r\n\r\n"
+                                     "POST /echo HTTP/1.1\r\nContent-Length: 3\r\n\r\ntwo",
+                                     3);
+  TEST_ASSERT_EQUAL(3, r.size());
+  TEST_ASSERT_EQUAL_STRING("one", r[0].body.c_str());
+  TEST_ASSERT_EQUAL_STRING("part1,part2", r[1].body.c_str());
+  TEST_ASSERT_EQUAL_STRING("two", r[2].body.c_str());
+  close(fd);
+}
+
+void test_not_found_keeps_the_connection() {
+  int fd = connectClient();
+  Response r = get(fd, "/missing");
+  TEST_ASSERT_EQUAL(404, r.status);
+  TEST_ASSERT_FALSE(r.closed);
+  TEST_ASSERT_EQUAL(200, get(fd, "/").status);
+  close(fd);
+}
+
+void test_connection_close_is_honoured() {
+  int fd = connectClient();
+  Response r = get(fd, "/", "Connection: close\r\n");
+  TEST_ASSERT_EQUAL(200, r.status);
+  TEST_ASSERT_TRUE(r.has("connection: close"));
+  TEST_ASSERT_TRUE(r.closed);
+  close(fd);
+
+  // HTTP/1.0 closes unless it asks for keep-alive
+  fd = connectClient();
+  r = exchange(fd, "GET / HTTP/1.0\r\n\r\n")[0];
+  TEST_ASSERT_TRUE(r.closed);
+  close(fd);
+}
+
+void test_request_limit_closes_the_connection() {
+  server->setKeepAlive(5000, 2);
+  int fd = connectClient();
+  Response first = get(fd, "/");
+  TEST_ASSERT_TRUE(first.has("keep-alive: timeout=5, max=1"));
+  Response second = get(fd, "/");
+  TEST_ASSERT_TRUE(second.has("connection: close"));
+  TEST_ASSERT_TRUE(second.closed);
+  close(fd);
+}
+
+void test_idle_connection_times_out() {
+  server->setKeepAlive(5000, 10);
+  int fd = connectClient();
+  TEST_ASSERT_EQUAL(200, get(fd, "/").status);
+  testAdvanceMillis(4000);
+  TEST_ASSERT_FALSE(isClosed(fd));
+  testAdvanceMillis(1001);
+  TEST_ASSERT_TRUE(isClosed(fd));
+  TEST_ASSERT_EQUAL(0, server->clientCount());
+  close(fd);
+}
+
+void test_short_body_closes_the_connection() {
+  int fd = connectClient();
+  const char* request = "GET /short HTTP/1.1\r\n\r\n";
+  send(fd, request, strlen(request), 0);
+  TEST_ASSERT_TRUE(isClosed(fd));  // The client cannot find the end of the response otherwise
+  close(fd);
+}
+
+void test_last_socket_does_not_keep_alive() {
+  int a = connectClient();
+  TEST_ASSERT_TRUE(get(a, "/").has("connection: keep-alive"));
+  int b = connectClient();
+  Response r = get(b, "/");  // maxClients is 2
+  TEST_ASSERT_TRUE(r.has("connection: close"));
+  TEST_ASSERT_TRUE(r.closed);
+  close(a);
+  close(b);
+}
+
+void test_full_server_evicts_idle_connection() {
+  delete server;
+  server = new AsyncHttpTransport(PORT, 3);
+  server->on("/", HTTP_GET, []() { server->send(200, "text/plain", "home"); });
+  server->begin();
+
+  // Two idle keep-alive connections and a spare one the client has not used yet
+  int a = connectClient();
+  TEST_ASSERT_FALSE(get(a, "/").closed);
+  testAdvanceMillis(10);
+  int b = connectClient();
+  TEST_ASSERT_FALSE(get(b, "/").closed);
+  int spare = connectClient();
+  TEST_ASSERT_EQUAL(3, server->clientCount());
+
+  // A fourth client takes the place of the longest idle one
+  int d = connectClient();
+  TEST_ASSERT_EQUAL(200, get(d, "/").status);
+  TEST_ASSERT_TRUE(isClosed(a));
+  TEST_ASSERT_EQUAL(200, get(b, "/").status);
+  close(a);
+  close(b);
+  close(spare);
+  close(d);
+}
+
+void test_full_server_queues_new_clients() {
+  // Both connections are in a request, the third client waits instead of getting 503
+  int a = connectClient();
+  int b = connectClient();
+  send(a, "GET / HTTP/1.1\r\n", 16, 0);
+  send(b, "GET / HTTP/1.1\r\n", 16, 0);
+  server->handleClient();
+
+  int c = connectClient();
+  send(c, "GET / HTTP/1.1\r\n\r\n", 18, 0);
+  for (int i = 0; i < 10; i++) server->handleClient();
+  TEST_ASSERT_EQUAL(2, server->clientCount());
+
+  Response done = exchange(a, "Connection: close\r\n\r\n")[0];
+  TEST_ASSERT_TRUE(done.closed);
+  std::vector<Response> r = exchange(c, "", 1);
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(200, r[0].status);
+  close(a);
+  close(b);
+  close(c);
+}
+
+static std::string multipartForm(const std::string& note) {
+  std::string body = "--b\r\nContent-Disposition: form-data; name=\"note\"\r\n\r\n" + note + "\r\n--b--\r\n";
+  return "POST /form HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=b\r\nContent-Length: " +
+         std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+void test_multipart_field_is_passed_on() {
+  int fd = connectClient();
+  std::vector<Response> r = exchange(fd, multipartForm("hello"));
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(200, r[0].status);
+  TEST_ASSERT_EQUAL_STRING("hello", r[0].body.c_str());
+  close(fd);
+}
+
+void test_oversized_multipart_field_is_rejected() {
+  int fd = connectClient();
+  std::vector<Response> r = exchange(fd, multipartForm(std::string(CP_HTTP_BODY_MAX + 1, 'x')));
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(413, r[0].status);  // Not a truncated value
+  TEST_ASSERT_TRUE(r[0].closed);
+  close(fd);
+}
+
+static std::string post(const char* path, const std::string& body) {
+  return std::string("POST ") + path + " HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+         std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+void test_oversized_body_is_rejected() {
+  int fd = connectClient();
+  std::vector<Response> r = exchange(fd, post("/echo", std::string(CP_HTTP_BODY_MAX + 1, 'x')));
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(413, r[0].status);
+  close(fd);
+}
+
+void test_body_limit_applies_to_its_uri() {
+  std::string content(3 * CP_HTTP_BODY_MAX, 'x');  // A file saved from edit.html
+  int fd = connectClient();
+  std::vector<Response> r = exchange(fd, post("/big", "name=%2Fbig.txt&content=" + content));
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(200, r[0].status);
+  TEST_ASSERT_EQUAL_STRING(std::to_string(content.size()).c_str(), r[0].body.c_str());
+
+  r = exchange(fd, post("/big", std::string(4 * CP_HTTP_BODY_MAX + 1, 'x')));
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(413, r[0].status);
+  close(fd);
+}
+
+void test_not_modified_has_no_framing_headers() {
+  int fd = connectClient();
+  Response r = get(fd, "/cached");
+  TEST_ASSERT_EQUAL(200, r.status);
+  TEST_ASSERT_TRUE(r.has("content-length: 6"));
+
+  r = get(fd, "/cached", "If-None-Match: \"v1\"\r\n");
+  TEST_ASSERT_EQUAL(304, r.status);
+  TEST_ASSERT_TRUE(r.has("etag: \"v1\""));
+  TEST_ASSERT_FALSE(r.has("content-length"));  // Would replace the cached length
+  TEST_ASSERT_FALSE(r.has("content-type"));
+  TEST_ASSERT_FALSE(r.has("transfer-encoding"));
+  TEST_ASSERT_TRUE(r.has("connection: keep-alive"));
+  TEST_ASSERT_FALSE(r.closed);
+
+  r = get(fd, "/nocontent");
+  TEST_ASSERT_EQUAL(204, r.status);
+  TEST_ASSERT_FALSE(r.has("content-length"));
+  TEST_ASSERT_FALSE(r.closed);
+
+  // The connection is still in step
+  r = get(fd, "/");
+  TEST_ASSERT_EQUAL(200, r.status);
+  TEST_ASSERT_EQUAL_STRING("home", r.body.c_str());
+  TEST_ASSERT_EQUAL(1, server->clientCount());
+  close(fd);
+}
+
+void test_not_modified_in_a_pipeline() {
+  int fd = connectClient();
+  std::vector<Response> r = exchange(fd,
+                                     "GET /cached HTTP/1.1\r\nIf-None-Match: \"v1\"\r\n\r\n"
+                                     "GET /cached HTTP/1.1\r\n\r\n",
+                                     2);
+  TEST_ASSERT_EQUAL(2, r.size());
+  TEST_ASSERT_EQUAL(304, r[0].status);
+  TEST_ASSERT_EQUAL(200, r[1].status);
+  TEST_ASSERT_EQUAL_STRING("body{}", r[1].body.c_str());
+  close(fd);
+}
+
+int main(int argc, char** argv) {
+  signal(SIGPIPE, SIG_IGN);  // lwIP has no SIGPIPE, a write to a closed socket just fails
+  UNITY_BEGIN();
+  RUN_TEST(test_requests_share_one_connection);
+  RUN_TEST(test_pipelined_requests_are_answered_in_order);
+  RUN_TEST(test_not_found_keeps_the_connection);
+  RUN_TEST(test_connection_close_is_honoured);
+  RUN_TEST(test_request_limit_closes_the_connection);
+  RUN_TEST(test_idle_connection_times_out);
+  RUN_TEST(test_short_body_closes_the_connection);
+  RUN_TEST(test_last_socket_does_not_keep_alive);
+  RUN_TEST(test_full_server_evicts_idle_connection);
+  RUN_TEST(test_full_server_queues_new_clients);
+  RUN_TEST(test_multipart_field_is_passed_on);
+  RUN_TEST(test_oversized_multipart_field_is_rejected);
+  RUN_TEST(test_oversized_body_is_rejected);
+  RUN_TEST(test_body_limit_applies_to_its_uri);
+  RUN_TEST(test_not_modified_has_no_framing_headers);
+  RUN_TEST(test_not_modified_in_a_pipeline);
+  return UNITY_END();
+}
@@ -0,0 +1,254 @@
+#include <AllocCount.h>
+#include <Arduino.h>
+#include <unity.h>
+
+#include <string>
+
+#include "JsonWriter.h"
+
+// Collects the output and counts the write calls
+class Capture : public Print {
+ public:
+  std::string text;
+  size_t writes = 0;
+
+  size_t write(uint8_t c) override {
+    writes++;
+    text += (char)c;
+    return 1;
+  }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    writes++;
+    text.append((const char*)buffer, size);
+    return size;
+  }
+};
+
+// Fixed buffer, so the sink itself never allocates
+class FixedSink : public Print {
+ public:
+  char data[8192];
+  size_t len = 0;
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    if (len + size > sizeof(data)) return 0;
+    memcpy(data + len, buffer, size);
+    len += size;
+    return size;
+  }
+};
+
+struct Network {
+  const char* ssid;
+  int rssi;
+  int channel;
+  bool secure;
+};
+
+static const Network NETWORKS[] = {
+    {"Home \"5G\"", -41, 36, true},
+    {"guest\\lobby", -67, 6, false},
+    {"caf\xc3\xa9 wifi", -72, 11, true},
+    {"tab\tname", -80, 1, true},
+};
+#define SCAN_SIZE 64  // Networks in the scan, the names repeat
+
+static void writeScan(JsonWriter& json) {
+  json.beginArray();
+  for (int i = 0; i < SCAN_SIZE; i++) {
+    const Network& n = NETWORKS[i % 4];
+    json.beginObject();
+    json.member("ssid", n.ssid);
+    json.member("rssi", n.rssi);
+    json.member("channel", n.channel);
+    json.member("secure", n.secure);
+    json.endObject();
+  }
+  json.endArray();
+}
+
+// /wifiscan before JsonWriter: the body concatenated in a String
+static String legacyEscape(const String& in) {
+  String out;
+  for (size_t i = 0; i < in.length(); ++i) {
+    char c = in[i];
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\b': out += "\\b"; break;
+      case '\f': out += "\\f"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if ((uint8_t)c < 0x20) {
+          char buf[7];
+          snprintf(buf, sizeof(buf), "\\u%04X", (uint8_t)c);
+          out += buf;
+        } else {
+          out += c;
+        }
+    }
+  }
+  return out;
+}
+
+static String legacyScan() {
+  String json = "[";
+  for (int i = 0; i < SCAN_SIZE; ++i) {
+    const Network& n = NETWORKS[i % 4];
+    if (i) json += ",";
+    json += "{";
+    json += "\"ssid\":\"" + legacyEscape(String(n.ssid)) + "\",";
+    json += "\"rssi\":" + String(n.rssi) + ",";
+    json += "\"channel\":" + String(n.channel) + ",";
+    json += "\"secure\":" + String(n.secure ? "true" : "false");
+    json += "}";
+  }
+  json += "]";
+  return json;
+}
+
+static std::string escaped(const char* s, size_t len) {
+  Capture out;
+  JsonWriter::escape(out, s, len);
+  return out.text;
+}
+
+static std::string escaped(const char* s) {
+  return escaped(s, strlen(s));
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_escape_plain_run_is_one_write() {
+  Capture out;
+  JsonWriter::escape(out, "plain text", 10);
+  TEST_ASSERT_EQUAL_STRING("plain text", out.text.c_str());
+  TEST_ASSERT_EQUAL(1, out.writes);
+  TEST_ASSERT_EQUAL_STRING("", escaped("").c_str());
+}
+
+void test_escape_quote_and_backslash() {
+  TEST_ASSERT_EQUAL_STRING("say \\\"hi\\\"", escaped("say \"hi\"").c_str());
+  TEST_ASSERT_EQUAL_STRING("C:\\\\dir\\\\", escaped("C:\\dir\\").c_str());
+  TEST_ASSERT_EQUAL_STRING("\\\"", escaped("\"").c_str());
+}
+
+void test_escape_control_characters() {
+  TEST_ASSERT_EQUAL_STRING("a\\nb\\tc\\rd\\be\\ff", escaped("a\nb\tc\rd\be\ff").c_str());
+  TEST_ASSERT_EQUAL_STRING("\\u0001\\u001f", escaped("\x01\x1f").c_str());
+  TEST_ASSERT_EQUAL_STRING("x\\u0000y", escaped("x\0y", 3).c_str());  // Length, not the terminator, ends the string
+}
+
+void test_escape_passes_utf8_and_del() {
+  const char* s = "caf\xc3\xa9 \xe2\x82\xac \x7f";
+  TEST_ASSERT_EQUAL_STRING(s, escaped(s).c_str());
+}
+
+void test_escape_writes_runs_between_escapes() {
+  Capture out;
+  JsonWriter::escape(out, "ab\"cd\"ef", 8);
+  TEST_ASSERT_EQUAL_STRING("ab\\\"cd\\\"ef", out.text.c_str());
+  TEST_ASSERT_EQUAL(5, out.writes);  // ab, \", cd, \", ef
+}
+
+void test_object_members_and_types() {
+  Capture out;
+  JsonWriter json(out);
+  json.beginObject();
+  json.member("ssid", "Home \"5G\"");
+  json.member("rssi", -67);
+  json.member("channel", 11u);
+  json.member("open", false);
+  json.member("bssid", (const char*)nullptr);
+  json.member("name", String("esp"));
+  json.key("none");
+  json.null();
+  json.endObject();
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"ssid\":\"Home \\\"5G\\\"\",\"rssi\":-67,\"channel\":11,\"open\":false,\"bssid\":null,\"name\":\"esp\",\"none\":null}",
+      out.text.c_str());
+}
+
+void test_nested_containers_get_commas() {
+  Capture out;
+  JsonWriter json(out);
+  json.beginArray();
+  for (int i = 0; i < 2; i++) {
+    json.beginObject();
+    json.member("id", i);
+    json.key("tags");
+    json.beginArray();
+    json.value("a");
+    json.value("b");
+    json.endArray();
+    json.endObject();
+  }
+  json.beginArray();
+  json.endArray();
+  json.value(true);
+  json.endArray();
+  TEST_ASSERT_EQUAL_STRING("[{\"id\":0,\"tags\":[\"a\",\"b\"]},{\"id\":1,\"tags\":[\"a\",\"b\"]},[],true]", out.text.c_str());
+}
+
+void test_escaped_key() {
+  Capture out;
+  JsonWriter json(out);
+  json.beginObject();
+  json.member("a\"b", 1);
+  json.endObject();
+  TEST_ASSERT_EQUAL_STRING("{\"a\\\"b\":1}", out.text.c_str());
+}
+
+void test_commas_at_deepest_tracked_level() {
+  Capture out;
+  JsonWriter json(out);
+  std::string expected;
+  for (int i = 0; i < 32; i++) {
+    json.beginArray();
+    json.value(i);
+    expected += (i ? ",[" : "[") + std::to_string(i);
+  }
+  for (int i = 0; i < 32; i++) json.endArray();
+  expected += std::string(32, ']');
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), out.text.c_str());
+}
+
+void test_writer_does_not_allocate() {
+  static FixedSink out;
+  out.len = 0;
+  size_t before = testAllocations();
+  JsonWriter json(out);
+  writeScan(json);
+  size_t allocations = testAllocations() - before;
+
+  String legacy;
+  size_t legacyAllocations = testAllocations();
+  legacy = legacyScan();
+  legacyAllocations = testAllocations() - legacyAllocations;
+  printf("  %d networks, %u bytes: JsonWriter %u allocations, String concatenation %u\n", SCAN_SIZE, (unsigned)out.len,
+         (unsigned)allocations, (unsigned)legacyAllocations);
+
+  TEST_ASSERT_EQUAL(0, allocations);
+  TEST_ASSERT_EQUAL(legacy.length(), out.len);  // Same body
+  TEST_ASSERT_EQUAL(0, memcmp(legacy.c_str(), out.data, out.len));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_escape_plain_run_is_one_write);
+  RUN_TEST(test_escape_quote_and_backslash);
+  RUN_TEST(test_escape_control_characters);
+  RUN_TEST(test_escape_passes_utf8_and_del);
+  RUN_TEST(test_escape_writes_runs_between_escapes);
+  RUN_TEST(test_object_members_and_types);
+  RUN_TEST(test_nested_containers_get_commas);
+  RUN_TEST(test_escaped_key);
+  RUN_TEST(test_commas_at_deepest_tracked_level);
+  RUN_TEST(test_writer_does_not_allocate);
+  return UNITY_END();
+}
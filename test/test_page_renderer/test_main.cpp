@@ -0,0 +1,155 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <MockTransport.h>
+#include <unity.h>
+#include <zlib.h>
+
+#include <string>
+
+#include "PageRenderer.h"
+
+static const char MENU[] = "<nav><a class=\"{home}\">Home</a><a class=\"{system}\">System</a></nav>";
+
+static PageTemplate menu;
+
+static std::string gzip(const std::string& data, int level = Z_BEST_COMPRESSION) {
+  z_stream z = {};
+  deflateInit2(&z, level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&z, data.size()) + 64, '\0');
+  z.next_in = (Bytef*)data.data();
+  z.avail_in = data.size();
+  z.next_out = (Bytef*)&out[0];
+  z.avail_out = out.size();
+  deflate(&z, Z_FINISH);
+  out.resize(z.total_out);
+  deflateEnd(&z);
+  return out;
+}
+
+static bool gunzip(const std::string& in, std::string& out) {
+  z_stream z = {};
+  inflateInit2(&z, 16 + MAX_WBITS);  // Checks the CRC32 and ISIZE of the trailer
+  char buf[4096];
+  z.next_in = (Bytef*)in.data();
+  z.avail_in = in.size();
+  int rc;
+  do {
+    z.next_out = (Bytef*)buf;
+    z.avail_out = sizeof(buf);
+    rc = inflate(&z, Z_NO_FLUSH);
+    out.append(buf, sizeof(buf) - z.avail_out);
+  } while (rc == Z_OK);
+  inflateEnd(&z);
+  return rc == Z_STREAM_END && z.avail_in == 0;
+}
+
+static void writeFile(const char* path, const std::string& content) {
+  File f = LittleFS.open(path, "w");
+  f.write((const uint8_t*)content.data(), content.size());
+  f.close();
+}
+
+// A page that compresses into several deflate blocks
+static std::string pageBody() {
+  std::string body = "<h1>{{title}}</h1><ul>";
+  for (int i = 0; i < 3000; i++) body += "<li>entry " + std::to_string(i * 7919 % 1000) + "</li>";
+  return body + "</ul>";
+}
+
+static MockTransport* request(bool acceptGzip, const TemplateVars* vars = nullptr, FileCache* cache = nullptr) {
+  MockTransport* server = new MockTransport();
+  if (acceptGzip) server->requestHeaders["Accept-Encoding"] = "gzip, deflate";
+  streamPageWithMenu(server, LittleFS, menu, "/page.html", "home", "Page", nullptr, vars, cache);
+  return server;
+}
+
+void setUp() {
+  LittleFS.format();
+  menu.compile(String(MENU));
+  writeFile("/page.html", pageBody());
+  writeFile("/page.html.gz", gzip(pageBody()));
+}
+
+void tearDown() {}
+
+void test_plain_page_ends_with_the_footer() {
+  MockTransport* server = request(false);
+  TEST_ASSERT_EQUAL(200, server->code);
+  TEST_ASSERT_TRUE(server->responseHeader("Content-Encoding").empty());
+  const std::string& body = server->body;
+  TEST_ASSERT_TRUE(body.find("<nav><a class=\"active\">Home</a><a class=\"\">System</a></nav>") != std::string::npos);
+  TEST_ASSERT_TRUE(body.compare(body.size() - 14, 14, "</body></html>") == 0);
+  delete server;
+}
+
+void test_gzip_page_has_the_footer() {
+  MockTransport* plain = request(false);
+  MockTransport* server = request(true);
+  TEST_ASSERT_EQUAL_STRING("gzip", server->responseHeader("Content-Encoding").c_str());
+
+  std::string text;
+  TEST_ASSERT_TRUE(gunzip(server->body, text));  // Also checks the CRC and size in the trailer
+  TEST_ASSERT_TRUE(text == plain->body);
+  delete server;
+  delete plain;
+}
+
+void test_gzip_page_from_the_file_cache() {
+  FileCache cache(64 * 1024);
+  MockTransport* plain = request(false);
+  for (int i = 0; i < 2; i++) {  // The second request uses the located block end again
+    MockTransport* server = request(true, nullptr, &cache);
+    std::string text;
+    TEST_ASSERT_TRUE(gunzip(server->body, text));
+    TEST_ASSERT_TRUE(text == plain->body);
+    delete server;
+  }
+  TEST_ASSERT_TRUE(cache.hits() > 0);
+  delete plain;
+}
+
+void test_gzip_pages_of_every_size() {
+  // The footer block starts at a different bit of the body's last byte
+  std::string source = pageBody();
+  for (size_t len = 1; len < 40; len++) {
+    std::string body = source.substr(0, len * 3);
+    writeFile("/page.html", body);
+    writeFile("/page.html.gz", gzip(body, 1 + len % 9));
+    MockTransport* server = request(true);
+    std::string text;
+    TEST_ASSERT_TRUE(gunzip(server->body, text));
+    TEST_ASSERT_TRUE(text.size() > 14 && text.compare(text.size() - 14 - body.size(), std::string::npos, body + "</body></html>") == 0);
+    delete server;
+  }
+}
+
+void test_variables_use_the_plain_file() {
+  TemplateVars vars;
+  vars.set("title", [](Print& out) { out.print("Status"); });
+  MockTransport* server = request(true, &vars);
+  TEST_ASSERT_TRUE(server->responseHeader("Content-Encoding").empty());
+  TEST_ASSERT_TRUE(server->body.find("<h1>Status</h1>") != std::string::npos);
+  TEST_ASSERT_TRUE(server->body.find("{{title}}") == std::string::npos);
+  delete server;
+}
+
+void test_invalid_gzip_body_falls_back_to_the_plain_file() {
+  std::string gz = gzip(pageBody());
+  for (size_t i = 10; i < gz.size() - 8; i++) gz[i] = (char)0xff;  // Keeps header and trailer
+  writeFile("/page.html.gz", gz);
+  MockTransport* server = request(true);
+  TEST_ASSERT_TRUE(server->responseHeader("Content-Encoding").empty());
+  TEST_ASSERT_TRUE(server->body.find("<h1>{{title}}</h1>") != std::string::npos);
+  delete server;
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_plain_page_ends_with_the_footer);
+  RUN_TEST(test_gzip_page_has_the_footer);
+  RUN_TEST(test_gzip_page_from_the_file_cache);
+  RUN_TEST(test_gzip_pages_of_every_size);
+  RUN_TEST(test_variables_use_the_plain_file);
+  RUN_TEST(test_invalid_gzip_body_falls_back_to_the_plain_file);
+  return UNITY_END();
+}
@@ -0,0 +1,166 @@
+#include <AllocCount.h>
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <MockTransport.h>
+#include <unity.h>
+
+#include <string>
+
+#include "PageRenderer.h"
+#include "PageTemplate.h"
+
+#define BENCH_ROUNDS 20000
+
+static const char MENU[] =
+    "<div class=\"tabs\">\n"
+    "  <a href=\"/home\" class=\"{home}\">Home</a>\n"
+    "  <a href=\"/edit\" class=\"{edit}\">Edit</a>\n"
+    "  <a href=\"/devices\" class=\"{devices}\">Devices</a>\n"
+    "  <a href=\"/system\" class=\"{system}\">System</a>\n"
+    "</div>";
+
+// A customised menu with braces that are not tab slots
+static const char CUSTOM_MENU[] =
+    "<style>.tabs{gap:4px}</style>\n"
+    "<div class=\"tabs {theme}\">\n"
+    "  <a href=\"/home\" class=\"{home}\">Home</a>\n"
+    "  <a href=\"/system\" class=\"{system}\">System</a>\n"
+    "</div>\n"
+    "<script>let t = `{count}`; if (x) {y()}</script>";
+
+static std::string rendered;
+
+static const char* tabSlots(const char* name, size_t len) {
+  return (len == 4 && strncmp(name, "home", 4) == 0) ? "active" : "";
+}
+
+static std::string render(const PageTemplate& t, const PageTemplate::Resolver& resolve) {
+  std::string out;
+  t.render([&](const char* data, size_t len) { out.append(data, len); }, resolve);
+  return out;
+}
+
+// The menu rendering before PageTemplate
+static String legacyMenu(String menu, const String& activeTab) {
+  menu.replace("{home}", activeTab == "home" ? "active" : "");
+  menu.replace("{devices}", activeTab == "devices" ? "active" : "");
+  menu.replace("{system}", activeTab == "system" ? "active" : "");
+  menu.replace("{edit}", activeTab == "edit" ? "active" : "");
+  return menu;
+}
+
+// Body of streamPageWithMenu() up to the end of the menu
+static std::string renderedMenu(const char* source, const char* activeTab) {
+  PageTemplate menu;
+  menu.compile(String(source));
+  MockTransport server;
+  streamPageWithMenu(&server, LittleFS, menu, "/page.html", activeTab, "Title");
+  size_t start = server.body.find("<body>") + 6;
+  size_t end = server.body.find("<p>page</p>");
+  return server.body.substr(start, end - start);
+}
+
+void setUp() {
+  LittleFS.format();
+  File f = LittleFS.open("/page.html", "w");
+  f.print("<p>page</p>");
+  f.close();
+}
+
+void tearDown() {}
+
+void test_template_is_split_into_literals_and_slots() {
+  PageTemplate t;
+  TEST_ASSERT_FALSE(t.isCompiled());
+  t.compile(String("a{x}bc{y_1}"));
+  TEST_ASSERT_TRUE(t.isCompiled());
+  TEST_ASSERT_EQUAL(3, t.literalLength());
+  std::string out = render(t, [](const char* name, size_t len) -> const char* { return len == 1 ? "X" : "Y"; });
+  TEST_ASSERT_EQUAL_STRING("aXbcY", out.c_str());
+}
+
+void test_other_braces_are_literal() {
+  PageTemplate t;
+  t.compile(String("{ } {a-b} {} {x:1} {{x}} {"));
+  std::string out = render(t, [](const char*, size_t) -> const char* { return "V"; });
+  TEST_ASSERT_EQUAL_STRING("{ } {a-b} {} {x:1} {V} {", out.c_str());
+}
+
+void test_null_value_keeps_the_placeholder() {
+  PageTemplate t;
+  t.compile(String("<{home}|{other}|{edit}>"));
+  std::string out = render(t, [](const char* name, size_t len) -> const char* {
+    if (len == 5 && strncmp(name, "other", 5) == 0) return nullptr;
+    return len == 4 && strncmp(name, "home", 4) == 0 ? "active" : "";
+  });
+  TEST_ASSERT_EQUAL_STRING("<active|{other}|>", out.c_str());
+}
+
+void test_menu_matches_string_replace() {
+  const char* tabs[] = {"home", "edit", "devices", "system", "", "unknown"};
+  for (const char* tab : tabs) {
+    TEST_ASSERT_EQUAL_STRING(legacyMenu(MENU, tab).c_str(), renderedMenu(MENU, tab).c_str());
+    TEST_ASSERT_EQUAL_STRING(legacyMenu(CUSTOM_MENU, tab).c_str(), renderedMenu(CUSTOM_MENU, tab).c_str());
+  }
+  std::string custom = renderedMenu(CUSTOM_MENU, "system");
+  TEST_ASSERT_TRUE(custom.find("class=\"tabs {theme}\"") != std::string::npos);
+  TEST_ASSERT_TRUE(custom.find("`{count}`") != std::string::npos);
+}
+
+void test_render_does_not_allocate() {
+  PageTemplate t;
+  t.compile(String(MENU));
+  rendered.reserve(1024);
+  PageTemplate::Emitter emit = [](const char* data, size_t len) { rendered.append(data, len); };
+  PageTemplate::Resolver resolve = tabSlots;
+
+  size_t before = testAllocations();
+  rendered.clear();
+  t.render(emit, resolve);
+  TEST_ASSERT_EQUAL(0, testAllocations() - before);
+  TEST_ASSERT_EQUAL_STRING(legacyMenu(MENU, "home").c_str(), rendered.c_str());
+}
+
+void test_bench_menu_rendering() {
+  PageTemplate t;
+  t.compile(String(MENU));
+  String source(MENU);
+  rendered.reserve(1024);
+  PageTemplate::Emitter emit = [](const char* data, size_t len) { rendered.append(data, len); };
+  PageTemplate::Resolver resolve = tabSlots;
+  size_t bytes = 0;
+
+  size_t allocs = testAllocations();
+  unsigned long start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) bytes += legacyMenu(source, "home").length();
+  unsigned long legacyUs = micros() - start;
+  allocs = testAllocations() - allocs;
+  printf("  String::replace  %6.0f ns/render, %.1f allocations/render\n", legacyUs * 1000.0 / BENCH_ROUNDS,
+         (double)allocs / BENCH_ROUNDS);
+
+  allocs = testAllocations();
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) {
+    rendered.clear();
+    t.render(emit, resolve);
+    bytes -= rendered.size();
+  }
+  unsigned long templateUs = micros() - start;
+  allocs = testAllocations() - allocs;
+  printf("  PageTemplate     %6.0f ns/render, %.1f allocations/render\n", templateUs * 1000.0 / BENCH_ROUNDS,
+         (double)allocs / BENCH_ROUNDS);
+
+  TEST_ASSERT_EQUAL(0, bytes);  // Same output size
+  TEST_ASSERT_EQUAL(0, allocs);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_template_is_split_into_literals_and_slots);
+  RUN_TEST(test_other_braces_are_literal);
+  RUN_TEST(test_null_value_keeps_the_placeholder);
+  RUN_TEST(test_menu_matches_string_replace);
+  RUN_TEST(test_render_does_not_allocate);
+  RUN_TEST(test_bench_menu_rendering);
+  return UNITY_END();
+}
@@ -0,0 +1,177 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "PortalTask.h"
+
+static void sleepMs(int ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// Waits up to one second for count to reach at least n
+static bool waitFor(const std::atomic<int>& count, int n) {
+  for (int i = 0; i < 1000 && count < n; i++) sleepMs(1);
+  return count >= n;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_body_runs_until_stop() {
+  std::atomic<int> runs{0};
+  PortalTask task;
+  TEST_ASSERT_TRUE(task.start("t", [&runs]() { runs++; }, PortalTaskConfig(4096, 1, -1, 1)));
+  TEST_ASSERT_TRUE(task.isRunning());
+  TEST_ASSERT_TRUE(waitFor(runs, 3));
+
+  TEST_ASSERT_TRUE(task.stop());
+  TEST_ASSERT_FALSE(task.isRunning());
+  int stopped = runs;
+  sleepMs(20);
+  TEST_ASSERT_EQUAL(stopped, (int)runs);
+}
+
+void test_stop_waits_for_the_current_iteration() {
+  std::atomic<int> entered{0};
+  std::atomic<bool> inside{false};
+  PortalTask task;
+  task.start("t", [&]() {
+    inside = true;
+    entered++;
+    sleepMs(50);
+    inside = false;
+  });
+  TEST_ASSERT_TRUE(waitFor(entered, 1));
+  TEST_ASSERT_TRUE(task.stop());
+  TEST_ASSERT_FALSE(inside);
+}
+
+void test_stop_from_the_task_itself() {
+  std::atomic<int> runs{0};
+  std::atomic<bool> result{false};
+  PortalTask task;
+  task.start("t", [&]() {
+    if (++runs == 2) result = task.stop();  // Like a handler that stops the portal
+  });
+  TEST_ASSERT_TRUE(waitFor(runs, 2));
+  sleepMs(20);
+  TEST_ASSERT_TRUE(result);
+  TEST_ASSERT_FALSE(task.isRunning());
+  TEST_ASSERT_EQUAL(2, (int)runs);
+
+  // The thread is joined by the next start()
+  TEST_ASSERT_TRUE(task.start("t", [&runs]() { runs++; }));
+  TEST_ASSERT_TRUE(waitFor(runs, 4));
+  TEST_ASSERT_TRUE(task.stop());
+}
+
+void test_start_while_running_keeps_the_body() {
+  std::atomic<int> first{0};
+  std::atomic<int> second{0};
+  PortalTask task;
+  task.start("t", [&first]() { first++; });
+  TEST_ASSERT_TRUE(task.start("t", [&second]() { second++; }));
+  TEST_ASSERT_TRUE(waitFor(first, 3));
+  task.stop();
+  TEST_ASSERT_EQUAL(0, (int)second);
+}
+
+void test_kill_ends_the_task() {
+  std::atomic<int> runs{0};
+  PortalTask task;
+  task.start("t", [&runs]() { runs++; });
+  TEST_ASSERT_TRUE(waitFor(runs, 1));
+  task.kill();
+  TEST_ASSERT_FALSE(task.isRunning());
+  int stopped = runs;
+  sleepMs(20);
+  TEST_ASSERT_EQUAL(stopped, (int)runs);
+}
+
+void test_destructor_stops_the_task() {
+  std::atomic<int> runs{0};
+  {
+    PortalTask task;
+    task.start("t", [&runs]() { runs++; });
+    TEST_ASSERT_TRUE(waitFor(runs, 1));
+  }
+  int stopped = runs;
+  sleepMs(20);
+  TEST_ASSERT_EQUAL(stopped, (int)runs);
+}
+
+void test_mutex_is_recursive() {
+  PortalMutex mutex;
+  std::atomic<int> runs{0};
+  PortalTask task;
+  mutex.lock();
+  mutex.lock();  // Handlers call locking portal functions with the lock held
+  task.start("t", [&]() {
+    PortalLock lock(mutex);
+    runs++;
+  });
+  mutex.unlock();
+  sleepMs(30);
+  TEST_ASSERT_EQUAL(0, (int)runs);  // Still held once
+  mutex.unlock();
+  TEST_ASSERT_TRUE(waitFor(runs, 1));
+  task.stop();
+}
+
+void test_mutex_excludes_other_tasks() {
+  PortalMutex mutex;
+  std::atomic<int> runs{0};
+  PortalTask task;
+  {
+    PortalLock lock(mutex);
+    task.start("t", [&]() {
+      PortalLock inner(mutex);
+      runs++;
+    });
+    sleepMs(30);
+    TEST_ASSERT_EQUAL(0, (int)runs);
+  }
+  TEST_ASSERT_TRUE(waitFor(runs, 1));
+  task.stop();
+}
+
+void test_slow_client_does_not_hold_the_lock() {
+  // The HTTP task locks only around shared state, waiting for a client happens outside
+  PortalMutex mutex;
+  std::atomic<int> requests{0};
+  PortalTask task;
+  task.start("http", [&]() {
+    {
+      PortalLock lock(mutex);
+      requests++;
+    }
+    sleepMs(200);  // A send that waits for a slow client
+  });
+  TEST_ASSERT_TRUE(waitFor(requests, 1));
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    PortalLock lock(mutex);  // loop() changing Settings
+  }
+  long waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_TRUE(waited < 100);
+  task.stop();
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_body_runs_until_stop);
+  RUN_TEST(test_stop_waits_for_the_current_iteration);
+  RUN_TEST(test_stop_from_the_task_itself);
+  RUN_TEST(test_start_while_running_keeps_the_body);
+  RUN_TEST(test_kill_ends_the_task);
+  RUN_TEST(test_destructor_stops_the_task);
+  RUN_TEST(test_mutex_is_recursive);
+  RUN_TEST(test_mutex_excludes_other_tasks);
+  RUN_TEST(test_slow_client_does_not_hold_the_lock);
+  return UNITY_END();
+}
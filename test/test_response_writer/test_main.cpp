@@ -0,0 +1,222 @@
+#include <AllocCount.h>
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <MockTransport.h>
+#include <unity.h>
+
+#include <string>
+
+#include "ResponseWriter.h"
+
+#define BUF CP_RESPONSE_BUFFER_SIZE
+
+static MockTransport* server;
+static std::string content;  // Test pattern, 16 buffers long
+
+// Sends the headers the way a handler does before a chunked response
+static void sendChunkedHeaders() {
+  server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server->send(200, "text/html", "");
+}
+
+void setUp() {
+  server = new MockTransport();
+  if (content.empty()) {
+    for (int i = 0; i < 16 * BUF; i++) content += (char)('a' + i % 26);
+  }
+}
+
+void tearDown() {
+  delete server;
+}
+
+void test_small_writes_are_coalesced() {
+  sendChunkedHeaders();
+  size_t before = testAllocations();
+  {
+    ResponseWriter out(server);
+    for (int i = 0; i < 100; i++) out.write((const uint8_t*)content.data() + i * 10, 10);
+    TEST_ASSERT_EQUAL(0, server->chunks.size());
+    out.end();
+    TEST_ASSERT_EQUAL(1, out.chunks());
+    TEST_ASSERT_EQUAL(1000, out.bytes());
+  }
+  TEST_ASSERT_EQUAL(0, testAllocations() - before);
+  TEST_ASSERT_EQUAL(1, server->chunks.size());
+  TEST_ASSERT_EQUAL(1000, server->chunks[0]);
+  TEST_ASSERT_EQUAL(1, server->terminators);
+  TEST_ASSERT_TRUE(server->body == content.substr(0, 1000));
+}
+
+void test_content_is_sent_in_full_buffers() {
+  sendChunkedHeaders();
+  size_t total = 3 * BUF + 5;
+  size_t before = testAllocations();
+  {
+    ResponseWriter out(server);
+    for (size_t i = 0; i < total; i++) out.write((uint8_t)content[i]);
+    TEST_ASSERT_EQUAL(3, server->chunks.size());  // Only full buffers until end()
+    out.end();
+  }
+  TEST_ASSERT_EQUAL(0, testAllocations() - before);
+  TEST_ASSERT_EQUAL(4, server->chunks.size());
+  for (int i = 0; i < 3; i++) TEST_ASSERT_EQUAL(BUF, server->chunks[i]);
+  TEST_ASSERT_EQUAL(5, server->chunks[3]);
+  TEST_ASSERT_TRUE(server->body == content.substr(0, total));
+}
+
+void test_full_buffer_write_is_passed_through() {
+  sendChunkedHeaders();
+  ResponseWriter out(server);
+  const char* asset = content.data();
+  out.write((const uint8_t*)asset, 2 * BUF + 7);
+  TEST_ASSERT_EQUAL(1, server->chunks.size());
+  TEST_ASSERT_EQUAL(2 * BUF + 7, server->chunks[0]);
+  TEST_ASSERT_EQUAL_PTR(asset, server->chunkData[0]);  // Not copied
+
+  // With something already buffered it is copied to keep the order
+  out.write('x');
+  out.write((const uint8_t*)asset, BUF);
+  TEST_ASSERT_EQUAL(2, server->chunks.size());
+  TEST_ASSERT_EQUAL(BUF, server->chunks[1]);
+  TEST_ASSERT_TRUE(server->chunkData[1] != asset);
+  out.end();
+  TEST_ASSERT_EQUAL(3, server->chunks.size());
+  TEST_ASSERT_EQUAL(1, server->chunks[2]);
+  TEST_ASSERT_TRUE(server->body == content.substr(0, 2 * BUF + 7) + "x" + content.substr(0, BUF));
+}
+
+void test_begin_sends_small_content_with_its_length() {
+  ResponseWriter out(server);
+  out.begin(200, "application/json");
+  out.print("{\"ok\":true}");
+  TEST_ASSERT_EQUAL(0, server->headerSends);  // Held back until the length is known
+  out.end();
+  TEST_ASSERT_EQUAL(200, server->code);
+  TEST_ASSERT_EQUAL(11, server->contentLength);
+  TEST_ASSERT_EQUAL(1, server->chunks.size());
+  TEST_ASSERT_EQUAL(0, server->terminators);
+  TEST_ASSERT_EQUAL_STRING("{\"ok\":true}", server->body.c_str());
+}
+
+void test_begin_sends_large_content_chunked() {
+  ResponseWriter out(server);
+  out.begin(200, "text/html");
+  out.write((const uint8_t*)content.data(), BUF - 1);
+  TEST_ASSERT_EQUAL(0, server->headerSends);
+  out.write((const uint8_t*)content.data(), 2);
+  TEST_ASSERT_EQUAL(1, server->headerSends);
+  TEST_ASSERT_EQUAL(CONTENT_LENGTH_UNKNOWN, server->contentLength);
+  out.end(false);  // Ignored after begin(), the response is already chunked
+  TEST_ASSERT_EQUAL(2, server->chunks.size());
+  TEST_ASSERT_EQUAL(1, server->terminators);
+}
+
+void test_begin_with_a_full_buffer_write_is_chunked() {
+  ResponseWriter out(server);
+  out.begin(200, "text/css");
+  out.write((const uint8_t*)content.data(), BUF);
+  TEST_ASSERT_EQUAL(CONTENT_LENGTH_UNKNOWN, server->contentLength);
+  TEST_ASSERT_EQUAL_PTR(content.data(), server->chunkData[0]);
+  out.end();
+  TEST_ASSERT_EQUAL(1, server->terminators);
+}
+
+void test_end_without_content() {
+  {
+    ResponseWriter out(server);
+    out.begin(204, "text/plain");
+    out.end();
+  }
+  TEST_ASSERT_EQUAL(1, server->headerSends);
+  TEST_ASSERT_EQUAL(204, server->code);
+  TEST_ASSERT_EQUAL(0, server->contentLength);
+  TEST_ASSERT_EQUAL(0, server->chunks.size());
+  TEST_ASSERT_EQUAL(0, server->terminators);
+
+  // Headers sent by the handler: end() only closes a chunked response
+  delete server;
+  server = new MockTransport();
+  sendChunkedHeaders();
+  {
+    ResponseWriter out(server);
+    out.end();
+  }
+  TEST_ASSERT_EQUAL(0, server->chunks.size());
+  TEST_ASSERT_EQUAL(1, server->terminators);
+}
+
+void test_destructor_completes_the_response() {
+  {
+    ResponseWriter out(server);
+    out.begin(200, "text/plain");
+    out.print("bye");
+  }
+  TEST_ASSERT_EQUAL(3, server->contentLength);
+  TEST_ASSERT_EQUAL_STRING("bye", server->body.c_str());
+
+  // Without begin() it only flushes, the handler ends the response
+  delete server;
+  server = new MockTransport();
+  sendChunkedHeaders();
+  {
+    ResponseWriter out(server);
+    out.print("bye");
+  }
+  TEST_ASSERT_EQUAL(1, server->chunks.size());
+  TEST_ASSERT_EQUAL(0, server->terminators);
+}
+
+void test_write_from_stream() {
+  LittleFS.format();
+  File f = LittleFS.open("/page.html", "w");
+  f.write((const uint8_t*)content.data(), 2 * BUF + 100);
+  f.close();
+  f = LittleFS.open("/page.html", "r");
+
+  size_t before = testAllocations();
+  ResponseWriter out(server);
+  out.begin(200, "text/html");
+  out.print("<!-- header -->");
+  TEST_ASSERT_EQUAL(2 * BUF + 100, out.writeFrom(f));
+  out.end();
+  TEST_ASSERT_EQUAL(0, testAllocations() - before);
+  f.close();
+
+  TEST_ASSERT_EQUAL(3, server->chunks.size());
+  TEST_ASSERT_EQUAL(BUF, server->chunks[0]);
+  TEST_ASSERT_EQUAL(BUF, server->chunks[1]);
+  TEST_ASSERT_EQUAL(115, server->chunks[2]);
+  TEST_ASSERT_TRUE(server->body == "<!-- header -->" + content.substr(0, 2 * BUF + 100));
+  TEST_ASSERT_EQUAL(2 * BUF + 115, out.bytes());
+}
+
+void test_write_from_stops_at_max_len() {
+  LittleFS.format();
+  File f = LittleFS.open("/page.html", "w");
+  f.print("0123456789");
+  f.close();
+  f = LittleFS.open("/page.html", "r");
+
+  ResponseWriter out(server);
+  out.begin(200, "text/plain");
+  TEST_ASSERT_EQUAL(4, out.writeFrom(f, 4));
+  out.end();
+  TEST_ASSERT_EQUAL_STRING("0123", server->body.c_str());
+  TEST_ASSERT_EQUAL('4', f.read());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_small_writes_are_coalesced);
+  RUN_TEST(test_content_is_sent_in_full_buffers);
+  RUN_TEST(test_full_buffer_write_is_passed_through);
+  RUN_TEST(test_begin_sends_small_content_with_its_length);
+  RUN_TEST(test_begin_sends_large_content_chunked);
+  RUN_TEST(test_begin_with_a_full_buffer_write_is_chunked);
+  RUN_TEST(test_end_without_content);
+  RUN_TEST(test_destructor_completes_the_response);
+  RUN_TEST(test_write_from_stream);
+  RUN_TEST(test_write_from_stops_at_max_len);
+  return UNITY_END();
+}
@@ -0,0 +1,189 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include "Config.h"
+#include "SaveScheduler.h"
+
+void setUp() {
+  LittleFS.format();
+}
+
+void tearDown() {}
+
+void test_nothing_is_due_without_a_request() {
+  SaveScheduler s(2000, 10000);
+  TEST_ASSERT_FALSE(s.isPending());
+  TEST_ASSERT_FALSE(s.isDue(0));
+  TEST_ASSERT_FALSE(s.isDue(100000));
+}
+
+void test_debounce_waits_for_a_quiet_window() {
+  SaveScheduler s(2000, 10000);
+  s.request(1000);
+  TEST_ASSERT_TRUE(s.isPending());
+  TEST_ASSERT_FALSE(s.isDue(2999));
+  TEST_ASSERT_TRUE(s.isDue(3000));
+
+  // Each change starts the window again
+  s.request(2500);
+  TEST_ASSERT_FALSE(s.isDue(3000));
+  TEST_ASSERT_FALSE(s.isDue(4499));
+  TEST_ASSERT_TRUE(s.isDue(4500));
+  TEST_ASSERT_EQUAL(2, s.stats().requested);
+}
+
+void test_max_delay_caps_a_burst() {
+  SaveScheduler s(2000, 10000);
+  unsigned long t = 5000;
+  s.request(t);
+  // A change every second never leaves a quiet window
+  for (int i = 1; i < 10; i++) {
+    s.request(t + i * 1000);
+    TEST_ASSERT_FALSE(s.isDue(t + i * 1000 + 999));
+  }
+  TEST_ASSERT_TRUE(s.isDue(t + 10000));  // 10 s after the first change
+}
+
+void test_max_delay_is_at_least_the_debounce() {
+  SaveScheduler s;
+  s.setWindow(5000, 1000);
+  s.request(0);
+  TEST_ASSERT_FALSE(s.isDue(4999));
+  TEST_ASSERT_TRUE(s.isDue(5000));
+}
+
+void test_due_survives_millis_wrap() {
+  SaveScheduler s(2000, 10000);
+  unsigned long nearWrap = (unsigned long)-1000;
+  s.request(nearWrap);
+  TEST_ASSERT_FALSE(s.isDue(nearWrap + 1999));
+  TEST_ASSERT_TRUE(s.isDue(nearWrap + 2000));  // Past zero
+}
+
+void test_unchanged_contents_are_skipped() {
+  SaveScheduler s(2000, 10000);
+  TEST_ASSERT_FALSE(s.isUnchanged(0x1234, 10));  // Flash contents unknown
+
+  s.setFlashContent(0x1234, 10);
+  TEST_ASSERT_TRUE(s.isUnchanged(0x1234, 10));
+  TEST_ASSERT_FALSE(s.isUnchanged(0x1234, 11));
+  TEST_ASSERT_FALSE(s.isUnchanged(0x4321, 10));
+
+  s.request(0);
+  s.skipped();
+  TEST_ASSERT_FALSE(s.isPending());
+  TEST_ASSERT_EQUAL(1, s.stats().skipped);
+  TEST_ASSERT_EQUAL(0, s.stats().performed);
+
+  s.written(0x4321, 12);
+  TEST_ASSERT_TRUE(s.isUnchanged(0x4321, 12));
+  TEST_ASSERT_FALSE(s.isUnchanged(0x1234, 10));
+  TEST_ASSERT_EQUAL(1, s.stats().performed);
+  TEST_ASSERT_EQUAL(12, s.stats().bytesWritten);
+}
+
+void test_failure_retries_after_a_window() {
+  SaveScheduler s(2000, 10000);
+  s.setFlashContent(0x1234, 10);
+  s.request(0);
+  TEST_ASSERT_TRUE(s.isDue(2000));
+
+  s.failed(2000);
+  TEST_ASSERT_TRUE(s.isPending());
+  TEST_ASSERT_FALSE(s.isDue(3999));
+  TEST_ASSERT_TRUE(s.isDue(4000));
+  TEST_ASSERT_FALSE(s.isUnchanged(0x1234, 10));  // The file may be anything now
+  TEST_ASSERT_EQUAL(1, s.stats().failed);
+
+  s.written(0x1234, 10);
+  TEST_ASSERT_FALSE(s.isPending());
+}
+
+void test_cancel_drops_the_pending_save() {
+  SaveScheduler s(2000, 10000);
+  s.request(0);
+  s.cancel();
+  TEST_ASSERT_FALSE(s.isPending());
+  TEST_ASSERT_FALSE(s.isDue(100000));
+}
+
+// The same rules as seen through the settings write-back
+
+static void seedConfig() {
+  File f = LittleFS.open("/config.json", "w");
+  f.print("{}");
+  f.close();
+}
+
+void test_config_writes_a_burst_once() {
+  seedConfig();
+  CaptivePortalConfig cfg(LittleFS);
+  cfg.setWriteBackDelay(2000, 10000);
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_TRUE(cfg.set("app.counter", String(i)));
+    testAdvanceMillis(500);
+    cfg.handle();
+  }
+  TEST_ASSERT_EQUAL(0, cfg.getSaveStats().performed);
+  testAdvanceMillis(2000);
+  cfg.handle();
+  TEST_ASSERT_EQUAL(1, cfg.getSaveStats().performed);
+  TEST_ASSERT_EQUAL(5, cfg.getSaveStats().requested);
+  TEST_ASSERT_FALSE(cfg.isDirty());
+}
+
+void test_config_skips_a_save_without_changes() {
+  seedConfig();
+  CaptivePortalConfig cfg(LittleFS);
+  cfg.setWriteBackDelay(0);
+  TEST_ASSERT_TRUE(cfg.set("app.mode", "fast"));
+  TEST_ASSERT_EQUAL(1, cfg.getSaveStats().performed);
+
+  TEST_ASSERT_TRUE(cfg.set("app.mode", "fast"));
+  TEST_ASSERT_EQUAL(1, cfg.getSaveStats().performed);
+  TEST_ASSERT_EQUAL(1, cfg.getSaveStats().skipped);
+  TEST_ASSERT_FALSE(cfg.isDirty());
+}
+
+void test_config_retries_a_failed_write() {
+  seedConfig();
+  CaptivePortalConfig cfg(LittleFS);
+  cfg.setWriteBackDelay(2000, 10000);
+  LittleFS.faults().openFailures = 1;
+
+  TEST_ASSERT_TRUE(cfg.set("app.mode", "fast"));
+  testAdvanceMillis(2000);
+  cfg.handle();
+  TEST_ASSERT_TRUE(cfg.writeFailed());
+  TEST_ASSERT_TRUE(cfg.isDirty());
+  TEST_ASSERT_EQUAL(1, cfg.getSaveStats().failed);
+
+  testAdvanceMillis(1999);
+  cfg.handle();
+  TEST_ASSERT_EQUAL(0, cfg.getSaveStats().performed);  // Waits a full window
+  testAdvanceMillis(1);
+  cfg.handle();
+  TEST_ASSERT_EQUAL(1, cfg.getSaveStats().performed);
+  TEST_ASSERT_FALSE(cfg.writeFailed());
+  TEST_ASSERT_FALSE(cfg.isDirty());
+
+  CaptivePortalConfig reloaded(LittleFS);
+  TEST_ASSERT_EQUAL_STRING("fast", reloaded.getString("app.mode").c_str());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_is_due_without_a_request);
+  RUN_TEST(test_debounce_waits_for_a_quiet_window);
+  RUN_TEST(test_max_delay_caps_a_burst);
+  RUN_TEST(test_max_delay_is_at_least_the_debounce);
+  RUN_TEST(test_due_survives_millis_wrap);
+  RUN_TEST(test_unchanged_contents_are_skipped);
+  RUN_TEST(test_failure_retries_after_a_window);
+  RUN_TEST(test_cancel_drops_the_pending_save);
+  RUN_TEST(test_config_writes_a_burst_once);
+  RUN_TEST(test_config_skips_a_save_without_changes);
+  RUN_TEST(test_config_retries_a_failed_write);
+  return UNITY_END();
+}
@@ -0,0 +1,243 @@
+#include <AllocCount.h>
+#include <Arduino.h>
+#include <unity.h>
+
+#include <map>
+#include <vector>
+
+#include "SessionStore.h"
+
+#define BENCH_ROUNDS 100000
+
+void setUp() {}
+void tearDown() {}
+
+static bool isHex(const String& s) {
+  for (unsigned i = 0; i < s.length(); i++) {
+    if (!isxdigit((unsigned char)s[i])) return false;
+  }
+  return true;
+}
+
+void test_create_returns_hex_id() {
+  SessionStore store(4, 60000);
+  String sid = store.create();
+  TEST_ASSERT_EQUAL(CP_SESSION_ID_SIZE * 2, sid.length());
+  TEST_ASSERT_TRUE(isHex(sid));
+  TEST_ASSERT_TRUE(store.isValid(sid));
+  TEST_ASSERT_EQUAL(1, store.size());
+}
+
+void test_rejects_malformed_and_unknown_ids() {
+  SessionStore store(4, 60000);
+  String sid = store.create();
+  TEST_ASSERT_FALSE(store.isValid(""));
+  TEST_ASSERT_FALSE(store.isValid(sid.substring(1)));
+  TEST_ASSERT_FALSE(store.isValid(sid + "0"));
+  String bad = sid;
+  bad[0] = 'x';
+  TEST_ASSERT_FALSE(store.isValid(bad));
+  String other = sid;
+  other[0] = sid[0] == '0' ? '1' : '0';
+  TEST_ASSERT_FALSE(store.isValid(other));
+  TEST_ASSERT_TRUE(store.isValid(sid));
+}
+
+void test_ids_accept_upper_case() {
+  SessionStore store(4, 60000);
+  String sid = store.create();
+  String upper = sid;
+  upper.toUpperCase();
+  TEST_ASSERT_TRUE(store.isValid(upper));
+}
+
+void test_remove_and_clear() {
+  SessionStore store(4, 60000);
+  String a = store.create();
+  String b = store.create();
+  store.remove(a);
+  store.remove(a);  // No-op
+  TEST_ASSERT_FALSE(store.isValid(a));
+  TEST_ASSERT_TRUE(store.isValid(b));
+  TEST_ASSERT_EQUAL(1, store.size());
+  store.clear();
+  TEST_ASSERT_FALSE(store.isValid(b));
+  TEST_ASSERT_EQUAL(0, store.size());
+}
+
+void test_sessions_expire() {
+  SessionStore store(4, 1000);
+  String sid = store.create();
+  testAdvanceMillis(999);
+  TEST_ASSERT_TRUE(store.isValid(sid));  // Use does not extend the lifetime
+  testAdvanceMillis(1);
+  TEST_ASSERT_FALSE(store.isValid(sid));
+  TEST_ASSERT_EQUAL(0, store.size());
+}
+
+void test_sweep_removes_expired_sessions() {
+  SessionStore store(8, 1000);
+  store.create();
+  store.create();
+  testAdvanceMillis(500);
+  String young = store.create();
+  testAdvanceMillis(600);
+  TEST_ASSERT_EQUAL(2, store.sweep());
+  TEST_ASSERT_EQUAL(1, store.size());
+  TEST_ASSERT_TRUE(store.isValid(young));
+}
+
+void test_full_table_evicts_least_recently_used() {
+  SessionStore store(3, 60000);
+  String a = store.create();
+  testAdvanceMillis(10);
+  String b = store.create();
+  testAdvanceMillis(10);
+  String c = store.create();
+  testAdvanceMillis(10);
+  TEST_ASSERT_TRUE(store.isValid(a));  // a is now used more recently than b
+  testAdvanceMillis(10);
+
+  String d = store.create();
+  TEST_ASSERT_EQUAL(3, store.size());
+  TEST_ASSERT_FALSE(store.isValid(b));
+  TEST_ASSERT_TRUE(store.isValid(a));
+  TEST_ASSERT_TRUE(store.isValid(c));
+  TEST_ASSERT_TRUE(store.isValid(d));
+}
+
+void test_full_table_drops_expired_before_evicting() {
+  SessionStore store(2, 1000);
+  String old = store.create();
+  testAdvanceMillis(600);
+  String recent = store.create();
+  testAdvanceMillis(500);  // old expired, recent not
+  String added = store.create();
+  TEST_ASSERT_EQUAL(2, store.size());
+  TEST_ASSERT_TRUE(store.isValid(recent));
+  TEST_ASSERT_TRUE(store.isValid(added));
+  TEST_ASSERT_FALSE(store.isValid(old));
+}
+
+void test_expiry_survives_millis_wrap() {
+  SessionStore store(4, 60000);
+  testAdvanceMillis(0x100000000ULL - (millis() & 0xffffffffUL) - 500);  // 500 ms before the 32 bit wrap
+  String sid = store.create();
+  testAdvanceMillis(1000);
+  TEST_ASSERT_TRUE(store.isValid(sid));
+  testAdvanceMillis(60000);
+  TEST_ASSERT_FALSE(store.isValid(sid));
+}
+
+void test_random_operations_match_a_model() {
+  // Many inserts and deletes exercise the probing and the backward shift deletion
+  SessionStore store(16, 1000000);
+  std::vector<String> live;
+  std::vector<String> gone;
+  srand(1);
+  for (int step = 0; step < 5000; step++) {
+    testAdvanceMillis(1);
+    if (live.size() < 16 && (live.empty() || rand() % 3)) {
+      live.push_back(store.create());
+    } else {
+      size_t i = rand() % live.size();
+      store.remove(live[i]);
+      gone.push_back(live[i]);
+      live.erase(live.begin() + i);
+    }
+    TEST_ASSERT_EQUAL(live.size(), store.size());
+  }
+  for (const String& sid : live) TEST_ASSERT_TRUE(store.isValid(sid));
+  for (const String& sid : gone) TEST_ASSERT_FALSE(store.isValid(sid));
+}
+
+// The session table before SessionStore (from CaptivePortal): a map of 32 character
+// ids to expiry times, without a limit on the number of sessions
+class LegacySessions {
+ public:
+  String create() {
+    char buf[33];
+    for (int i = 0; i < 32; i++) buf[i] = "0123456789abcdef"[(uint8_t)esp_random() % 16];
+    buf[32] = 0;
+    String sid(buf);
+    sessions[sid] = millis() + 3600UL * 1000UL;
+    return sid;
+  }
+
+  bool isValid(const String& sid) {
+    auto it = sessions.find(sid);
+    if (it == sessions.end()) return false;
+    if (millis() > it->second) {
+      sessions.erase(it);
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  std::map<String, unsigned long> sessions;
+};
+
+// Host numbers only show the relative cost
+static void report(const char* what, unsigned long us, size_t allocs, size_t rounds) {
+  printf("  %-30s %7.1f ns/call, %4.2f allocations/call\n", what, us * 1000.0 / rounds, (double)allocs / rounds);
+}
+
+template <typename Store>
+static void bench(const char* name, Store& store) {
+  std::vector<String> sids;
+  sids.reserve(CP_MAX_SESSIONS);
+  size_t allocs = testAllocations();
+  unsigned long start = micros();
+  for (int i = 0; i < CP_MAX_SESSIONS; i++) sids.push_back(store.create());
+  String label = String(name) + " create";
+  report(label.c_str(), micros() - start, testAllocations() - allocs - CP_MAX_SESSIONS, CP_MAX_SESSIONS);  // Less the returned id Strings
+
+  size_t valid = 0;
+  allocs = testAllocations();
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) valid += store.isValid(sids[i % CP_MAX_SESSIONS]);
+  label = String(name) + " isValid (known)";
+  report(label.c_str(), micros() - start, testAllocations() - allocs, BENCH_ROUNDS);
+  TEST_ASSERT_EQUAL(BENCH_ROUNDS, valid);
+
+  String unknown("0123456789abcdef0123456789abcdef");
+  valid = 0;
+  allocs = testAllocations();
+  start = micros();
+  for (int i = 0; i < BENCH_ROUNDS; i++) valid += store.isValid(unknown);
+  label = String(name) + " isValid (unknown)";
+  report(label.c_str(), micros() - start, testAllocations() - allocs, BENCH_ROUNDS);
+  TEST_ASSERT_EQUAL(0, valid);
+}
+
+void test_bench_against_map_store() {
+  LegacySessions legacy;
+  bench("std::map", legacy);
+
+  SessionStore store(CP_MAX_SESSIONS, 3600UL * 1000UL);
+  bench("SessionStore", store);
+
+  // A request with a session cookie costs no heap in the lookup
+  String sid = store.create();
+  size_t before = testAllocations();
+  TEST_ASSERT_TRUE(store.isValid(sid));
+  TEST_ASSERT_FALSE(store.isValid("not a session"));
+  TEST_ASSERT_EQUAL(0, testAllocations() - before);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_create_returns_hex_id);
+  RUN_TEST(test_rejects_malformed_and_unknown_ids);
+  RUN_TEST(test_ids_accept_upper_case);
+  RUN_TEST(test_remove_and_clear);
+  RUN_TEST(test_sessions_expire);
+  RUN_TEST(test_sweep_removes_expired_sessions);
+  RUN_TEST(test_full_table_evicts_least_recently_used);
+  RUN_TEST(test_full_table_drops_expired_before_evicting);
+  RUN_TEST(test_expiry_survives_millis_wrap);
+  RUN_TEST(test_random_operations_match_a_model);
+  RUN_TEST(test_bench_against_map_store);
+  return UNITY_END();
+}
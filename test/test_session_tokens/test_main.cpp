@@ -0,0 +1,179 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <mbedtls/md.h>
+#include <unity.h>
+
+#include "SessionTokens.h"
+
+static void putLE32(uint8_t* p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+// Builds a token the way SessionTokens::issue() does, from the key file
+static String forge(uint32_t expiry, uint32_t nonce) {
+  uint8_t key[CP_SESSION_KEY_SIZE + 4];
+  File f = LittleFS.open(CP_SESSION_KEY_FILE, "r");
+  f.read(key, sizeof(key));
+  f.close();
+
+  uint8_t msg[12];
+  putLE32(msg, expiry);
+  putLE32(msg + 4, nonce);
+  memcpy(msg + 8, key + CP_SESSION_KEY_SIZE, 4);  // Epoch
+  uint8_t mac[32];
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), key, CP_SESSION_KEY_SIZE, msg, sizeof(msg), mac);
+
+  char buf[CP_SESSION_TOKEN_LENGTH + 1];
+  snprintf(buf, 17, "%08x%08x", (unsigned)expiry, (unsigned)nonce);
+  for (int i = 0; i < CP_SESSION_MAC_SIZE; i++) snprintf(buf + 16 + 2 * i, 3, "%02x", mac[i]);
+  return String(buf);
+}
+
+void setUp() {
+  LittleFS.format();
+}
+void tearDown() {}
+
+void test_hmac_sha256_rfc4231() {
+  // RFC 4231 test case 2, the host stand-in has to match mbed TLS
+  const char* key = "Jefe";
+  const char* data = "what do ya want for nothing?";
+  const uint8_t expected[32] = {0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+                                0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43};
+  uint8_t mac[32];
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const uint8_t*)key, strlen(key), (const uint8_t*)data, strlen(data), mac);
+  TEST_ASSERT_EQUAL_MEMORY(expected, mac, sizeof(mac));
+}
+
+void test_not_ready_before_begin() {
+  SessionTokens tokens;
+  TEST_ASSERT_FALSE(tokens.ready());
+  TEST_ASSERT_EQUAL(0, tokens.issue(3600).length());
+  TEST_ASSERT_FALSE(tokens.isValid("0123456789abcdef0123456789abcdef0123456789abcdef", 3600));
+}
+
+void test_begin_creates_key_file() {
+  SessionTokens tokens;
+  TEST_ASSERT_TRUE(tokens.begin(LittleFS));
+  TEST_ASSERT_TRUE(tokens.ready());
+  File f = LittleFS.open(CP_SESSION_KEY_FILE, "r");
+  TEST_ASSERT_TRUE((bool)f);
+  TEST_ASSERT_EQUAL(CP_SESSION_KEY_SIZE + 4, f.size());
+  TEST_ASSERT_EQUAL(0, tokens.epoch());
+}
+
+void test_issued_token_is_valid() {
+  SessionTokens tokens;
+  tokens.begin(LittleFS);
+  String token = tokens.issue(3600);
+  TEST_ASSERT_EQUAL(CP_SESSION_TOKEN_LENGTH, token.length());
+  TEST_ASSERT_TRUE(tokens.isValid(token, 3600));
+  TEST_ASSERT_TRUE(token != tokens.issue(3600));  // Random nonce
+}
+
+void test_token_survives_reboot() {
+  SessionTokens before;
+  before.begin(LittleFS);
+  String token = before.issue(3600);
+
+  SessionTokens after;
+  TEST_ASSERT_TRUE(after.begin(LittleFS));
+  TEST_ASSERT_TRUE(after.isValid(token, 3600));
+}
+
+void test_tampered_token_is_rejected() {
+  SessionTokens tokens;
+  tokens.begin(LittleFS);
+  String token = tokens.issue(3600);
+  for (unsigned i = 0; i < token.length(); i++) {
+    String changed = token;
+    changed[i] = token[i] == '0' ? '1' : '0';
+    TEST_ASSERT_FALSE(tokens.isValid(changed, 3600));
+  }
+  TEST_ASSERT_FALSE(tokens.isValid(token.substring(2), 3600));
+  String notHex = token;
+  notHex[0] = 'g';
+  TEST_ASSERT_FALSE(tokens.isValid(notHex, 3600));
+}
+
+void test_expired_token_is_rejected() {
+  SessionTokens tokens;
+  tokens.begin(LittleFS);
+  TEST_ASSERT_FALSE(tokens.isValid(tokens.issue(0), 3600));
+  TEST_ASSERT_FALSE(tokens.isValid(forge((uint32_t)time(nullptr) - 1, 7), 3600));
+}
+
+void test_lifetime_is_capped() {
+  // A token that expires later than the current lifetime allows (e.g. after the timeout was lowered)
+  SessionTokens tokens;
+  tokens.begin(LittleFS);
+  String token = tokens.issue(3600);
+  TEST_ASSERT_TRUE(tokens.isValid(token, 3600));
+  TEST_ASSERT_FALSE(tokens.isValid(token, 60));
+}
+
+void test_token_from_unset_clock_is_rejected() {
+  // The host clock is set, a token issued shortly after a boot without NTP has a small expiry
+  SessionTokens tokens;
+  tokens.begin(LittleFS);
+  TEST_ASSERT_TRUE(tokens.isValid(forge((uint32_t)time(nullptr) + 60, 1), 3600));
+  TEST_ASSERT_FALSE(tokens.isValid(forge(3600, 1), 0xffffffffUL));
+}
+
+void test_revoke_all_invalidates_tokens() {
+  SessionTokens tokens;
+  tokens.begin(LittleFS);
+  String old = tokens.issue(3600);
+  TEST_ASSERT_TRUE(tokens.revokeAll());
+  TEST_ASSERT_EQUAL(1, tokens.epoch());
+  TEST_ASSERT_FALSE(tokens.isValid(old, 3600));
+  String fresh = tokens.issue(3600);
+  TEST_ASSERT_TRUE(tokens.isValid(fresh, 3600));
+
+  // The epoch is kept in the key file
+  SessionTokens reloaded;
+  reloaded.begin(LittleFS);
+  TEST_ASSERT_EQUAL(1, reloaded.epoch());
+  TEST_ASSERT_FALSE(reloaded.isValid(old, 3600));
+  TEST_ASSERT_TRUE(reloaded.isValid(fresh, 3600));
+}
+
+void test_remove_key_creates_new_secret() {
+  SessionTokens tokens;
+  tokens.begin(LittleFS);
+  String old = tokens.issue(3600);
+  TEST_ASSERT_TRUE(SessionTokens::removeKey(LittleFS));
+  TEST_ASSERT_FALSE(LittleFS.exists(CP_SESSION_KEY_FILE));
+  TEST_ASSERT_TRUE(SessionTokens::removeKey(LittleFS));  // Nothing to remove
+
+  SessionTokens reset;
+  reset.begin(LittleFS);
+  TEST_ASSERT_FALSE(reset.isValid(old, 3600));
+}
+
+void test_short_key_file_is_replaced() {
+  File f = LittleFS.open(CP_SESSION_KEY_FILE, "w");
+  f.write((const uint8_t*)"short", 5);
+  f.close();
+  SessionTokens tokens;
+  TEST_ASSERT_TRUE(tokens.begin(LittleFS));
+  TEST_ASSERT_EQUAL(CP_SESSION_KEY_SIZE + 4, LittleFS.open(CP_SESSION_KEY_FILE, "r").size());
+  TEST_ASSERT_TRUE(tokens.isValid(tokens.issue(60), 60));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_hmac_sha256_rfc4231);
+  RUN_TEST(test_not_ready_before_begin);
+  RUN_TEST(test_begin_creates_key_file);
+  RUN_TEST(test_issued_token_is_valid);
+  RUN_TEST(test_token_survives_reboot);
+  RUN_TEST(test_tampered_token_is_rejected);
+  RUN_TEST(test_expired_token_is_rejected);
+  RUN_TEST(test_lifetime_is_capped);
+  RUN_TEST(test_token_from_unset_clock_is_rejected);
+  RUN_TEST(test_revoke_all_invalidates_tokens);
+  RUN_TEST(test_remove_key_creates_new_secret);
+  RUN_TEST(test_short_key_file_is_replaced);
+  return UNITY_END();
+}
@@ -0,0 +1,237 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include "Config.h"
+#include "SettingsApplier.h"
+
+// Records the calls instead of touching WiFi or GPIO
+class MockTarget : public SettingsApplier::Target {
+ public:
+  int timezoneCalls = 0;
+  int ledCalls = 0;
+  int resetPinCalls = 0;
+  int apCalls = 0;
+  int apFailures = 0;  // Restarts that fail before one succeeds
+  String timezone;
+  uint8_t resetPinBefore = 0, resetPinAfter = 0;
+  AppliedSettings ap;
+
+  void setTimezone(const String& tz) override {
+    timezoneCalls++;
+    timezone = tz;
+  }
+  void setupLed(const AppliedSettings& before, const AppliedSettings& after) override { ledCalls++; }
+  void setupResetPin(uint8_t before, uint8_t after) override {
+    resetPinCalls++;
+    resetPinBefore = before;
+    resetPinAfter = after;
+  }
+  bool restartAccessPoint(const AppliedSettings& settings) override {
+    apCalls++;
+    ap = settings;
+    if (apFailures == 0) return true;
+    apFailures--;
+    return false;
+  }
+};
+
+static CaptivePortalConfig* config;
+static SettingsApplier* applier;
+static MockTarget* target;
+
+// Marks the members as changed, like a settings page that saved them
+static void changed() {
+  config->save();
+}
+
+void setUp() {
+  LittleFS.format();
+  config = new CaptivePortalConfig(LittleFS);
+  applier = new SettingsApplier();
+  target = new MockTarget();
+  applier->begin(*config);
+}
+
+void tearDown() {
+  delete target;
+  delete applier;
+  delete config;
+}
+
+void test_plan_is_empty_without_changes() {
+  AppliedSettings s = AppliedSettings::from(*config);
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::None, SettingsApplier::plan(s, s));
+}
+
+void test_plan_maps_each_field_to_its_action() {
+  const AppliedSettings before = AppliedSettings::from(*config);
+  AppliedSettings after;
+
+  after = before;
+  after.timezone = "Europe/Amsterdam";
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::Timezone, SettingsApplier::plan(before, after));
+
+  after = before;
+  after.ledPin = 13;
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::Led, SettingsApplier::plan(before, after));
+  after = before;
+  after.rgbLed = !before.rgbLed;
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::Led, SettingsApplier::plan(before, after));
+  after = before;
+  after.rgbBrightness = 10;
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::Led, SettingsApplier::plan(before, after));
+
+  after = before;
+  after.resetPin = 0;
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::ResetPin, SettingsApplier::plan(before, after));
+
+  after = before;
+  after.ssid = "kitchen";
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::AccessPoint, SettingsApplier::plan(before, after));
+  after = before;
+  after.password = "secret123";
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::AccessPoint, SettingsApplier::plan(before, after));
+  after = before;
+  after.ip = IPAddress(10, 0, 0, 1);
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::AccessPoint, SettingsApplier::plan(before, after));
+  after = before;
+  after.mask = IPAddress(255, 255, 0, 0);
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::AccessPoint, SettingsApplier::plan(before, after));
+
+  after = before;
+  after.timezone = "Europe/Amsterdam";
+  after.resetPin = 0;
+  after.ssid = "kitchen";
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::Timezone | SettingsApplier::ResetPin | SettingsApplier::AccessPoint,
+                         SettingsApplier::plan(before, after));
+}
+
+void test_apply_runs_only_the_needed_actions() {
+  TEST_ASSERT_FALSE(applier->hasChanges(*config));
+  config->DeviceTimezone = "Europe/Amsterdam";
+  config->ResetPin = 0;
+  changed();
+  TEST_ASSERT_TRUE(applier->hasChanges(*config));
+
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::Timezone | SettingsApplier::ResetPin, applier->apply(*config, *target));
+  TEST_ASSERT_EQUAL(1, target->timezoneCalls);
+  TEST_ASSERT_EQUAL_STRING("Europe/Amsterdam", target->timezone.c_str());
+  TEST_ASSERT_EQUAL(1, target->resetPinCalls);
+  TEST_ASSERT_EQUAL(4, target->resetPinBefore);
+  TEST_ASSERT_EQUAL(0, target->resetPinAfter);
+  TEST_ASSERT_EQUAL(0, target->ledCalls);
+  TEST_ASSERT_EQUAL(0, target->apCalls);
+  TEST_ASSERT_FALSE(applier->hasChanges(*config));
+
+  // A save that changes nothing that is applied
+  config->DeviceHostname = "esp32-portal";
+  changed();
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::None, applier->apply(*config, *target));
+  TEST_ASSERT_EQUAL(1, target->timezoneCalls);
+}
+
+void test_access_point_restarts_after_the_delay() {
+  config->DeviceName = "kitchen";
+  changed();
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::None, applier->apply(*config, *target));  // The response goes out first
+  TEST_ASSERT_TRUE(applier->accessPointPending());
+  TEST_ASSERT_EQUAL(0, target->apCalls);
+
+  testAdvanceMillis(CP_AP_RESTART_DELAY - 10);
+  TEST_ASSERT_FALSE(applier->hasChanges(*config));
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::None, applier->apply(*config, *target));
+
+  testAdvanceMillis(10);
+  TEST_ASSERT_TRUE(applier->hasChanges(*config));
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::AccessPoint, applier->apply(*config, *target));
+  TEST_ASSERT_EQUAL(1, target->apCalls);
+  TEST_ASSERT_EQUAL_STRING("kitchen", target->ap.ssid.c_str());
+  TEST_ASSERT_FALSE(applier->accessPointPending());
+  TEST_ASSERT_FALSE(applier->accessPointFailed());
+  TEST_ASSERT_FALSE(applier->hasChanges(*config));
+}
+
+void test_access_point_restart_is_retried() {
+  target->apFailures = CP_AP_RESTART_TRIES - 1;
+  config->DeviceIP = IPAddress(10, 0, 0, 1);
+  changed();
+  applier->apply(*config, *target);
+
+  for (int i = 1; i < CP_AP_RESTART_TRIES; i++) {
+    testAdvanceMillis(CP_AP_RESTART_DELAY);
+    applier->apply(*config, *target);
+    TEST_ASSERT_EQUAL(i, target->apCalls);
+    TEST_ASSERT_TRUE(applier->accessPointPending());
+
+    applier->apply(*config, *target);  // Waits a full delay before the next try
+    TEST_ASSERT_EQUAL(i, target->apCalls);
+  }
+
+  testAdvanceMillis(CP_AP_RESTART_DELAY);
+  applier->apply(*config, *target);
+  TEST_ASSERT_EQUAL(CP_AP_RESTART_TRIES, target->apCalls);
+  TEST_ASSERT_FALSE(applier->accessPointPending());
+  TEST_ASSERT_FALSE(applier->accessPointFailed());
+  TEST_ASSERT_EQUAL_STRING("10.0.0.1", target->ap.ip.toString().c_str());
+}
+
+void test_access_point_gives_up_after_the_last_try() {
+  target->apFailures = CP_AP_RESTART_TRIES;
+  config->AdminPassword = "secret123";
+  changed();
+  applier->apply(*config, *target);
+
+  for (int i = 0; i < CP_AP_RESTART_TRIES; i++) {
+    testAdvanceMillis(CP_AP_RESTART_DELAY);
+    applier->apply(*config, *target);
+  }
+  TEST_ASSERT_EQUAL(CP_AP_RESTART_TRIES, target->apCalls);
+  TEST_ASSERT_FALSE(applier->accessPointPending());
+  TEST_ASSERT_TRUE(applier->accessPointFailed());
+
+  testAdvanceMillis(CP_AP_RESTART_DELAY);
+  applier->apply(*config, *target);
+  TEST_ASSERT_EQUAL(CP_AP_RESTART_TRIES, target->apCalls);  // Until the next change
+
+  config->AdminPassword = "secret456";
+  changed();
+  applier->apply(*config, *target);
+  TEST_ASSERT_TRUE(applier->accessPointPending());
+  TEST_ASSERT_FALSE(applier->accessPointFailed());
+  testAdvanceMillis(CP_AP_RESTART_DELAY);
+  TEST_ASSERT_EQUAL_HEX8(SettingsApplier::AccessPoint, applier->apply(*config, *target));
+  TEST_ASSERT_EQUAL(CP_AP_RESTART_TRIES + 1, target->apCalls);
+  TEST_ASSERT_FALSE(applier->accessPointFailed());
+}
+
+void test_change_during_the_delay_restarts_once_with_the_latest_settings() {
+  config->DeviceName = "kitchen";
+  changed();
+  applier->apply(*config, *target);
+  testAdvanceMillis(CP_AP_RESTART_DELAY / 2);
+
+  config->DeviceName = "garage";
+  changed();
+  applier->apply(*config, *target);
+  testAdvanceMillis(CP_AP_RESTART_DELAY / 2);
+  applier->apply(*config, *target);
+  TEST_ASSERT_EQUAL(0, target->apCalls);  // The delay starts again
+
+  testAdvanceMillis(CP_AP_RESTART_DELAY / 2);
+  applier->apply(*config, *target);
+  TEST_ASSERT_EQUAL(1, target->apCalls);
+  TEST_ASSERT_EQUAL_STRING("garage", target->ap.ssid.c_str());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_plan_is_empty_without_changes);
+  RUN_TEST(test_plan_maps_each_field_to_its_action);
+  RUN_TEST(test_apply_runs_only_the_needed_actions);
+  RUN_TEST(test_access_point_restarts_after_the_delay);
+  RUN_TEST(test_access_point_restart_is_retried);
+  RUN_TEST(test_access_point_gives_up_after_the_last_try);
+  RUN_TEST(test_change_during_the_delay_restarts_once_with_the_latest_settings);
+  return UNITY_END();
+}
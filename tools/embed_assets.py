@@ -0,0 +1,106 @@
+"""
+Generates EmbeddedAssetsData.h from the files in the data/ directory.
+
+The generated header contains every file as a byte array (plus a gzip
+compressed copy when that is smaller) and a table sorted by path that
+src/EmbeddedAssets.cpp compiles in when CP_EMBED_ASSETS is defined.
+
+PlatformIO:   extra_scripts = pre:tools/embed_assets.py
+Command line: python tools/embed_assets.py <data dir> <output dir>
+"""
+
+import gzip
+import os
+import sys
+import zlib
+
+MIME_TYPES = {
+    ".html": "text/html; charset=utf-8",
+    ".htm": "text/html; charset=utf-8",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".txt": "text/plain; charset=utf-8",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".jpg": "image/jpeg",
+    ".ico": "image/x-icon",
+}
+
+MIN_GZIP_SAVING = 0.10  # Only embed a gzip copy if it is at least 10% smaller
+
+
+def collect(data_dir):
+    assets = []
+    for root, _, files in os.walk(data_dir):
+        for name in files:
+            if name.endswith(".gz") or name.startswith("."):
+                continue
+            full = os.path.join(root, name)
+            path = "/" + os.path.relpath(full, data_dir).replace(os.sep, "/")
+            with open(full, "rb") as f:
+                assets.append((path, f.read()))
+    return sorted(assets, key=lambda a: a[0].encode())
+
+
+def c_array(name, data):
+    lines = []
+    for i in range(0, len(data), 20):
+        lines.append("  " + ", ".join("0x%02x" % b for b in data[i:i + 20]) + ",")
+    return "static const uint8_t %s[] PROGMEM = {\n%s\n};\n" % (name, "\n".join(lines))
+
+
+def generate(data_dir, out_dir):
+    assets = collect(data_dir)
+    out = [
+        "// Generated by tools/embed_assets.py from %s -- do not edit" % os.path.basename(os.path.abspath(data_dir)),
+        "#pragma once",
+        "",
+        "#define CP_EMBEDDED_ASSET_COUNT %d" % len(assets),
+        "",
+    ]
+    rows = []
+    for i, (path, data) in enumerate(assets):
+        ext = os.path.splitext(path)[1].lower()
+        mime = MIME_TYPES.get(ext, "application/octet-stream")
+        out.append(c_array("cp_asset_%d" % i, data))
+
+        gz = gzip.compress(data, 9, mtime=0)
+        gz_name, gz_len, gz_crc = "nullptr", 0, 0
+        # Files with {{variables}} are expanded while streaming and must stay uncompressed
+        templated = b"{{" in data
+        if not templated and len(gz) <= len(data) * (1 - MIN_GZIP_SAVING):
+            out.append(c_array("cp_asset_%d_gz" % i, gz))
+            gz_name, gz_len, gz_crc = "cp_asset_%d_gz" % i, len(gz), zlib.crc32(gz)
+
+        rows.append('  {"%s", "%s", cp_asset_%d, %d, %s, %d, 0x%08xUL, 0x%08xUL, %s},'
+                    % (path, mime, i, len(data), gz_name, gz_len, zlib.crc32(data), gz_crc,
+                       "true" if templated else "false"))
+
+    out.append("#define CP_EMBEDDED_ASSET_TABLE \\")
+    out.append(" \\\n".join(rows) if rows else "")
+    out.append("")
+
+    os.makedirs(out_dir, exist_ok=True)
+    target = os.path.join(out_dir, "EmbeddedAssetsData.h")
+    content = "\n".join(out)
+    if os.path.exists(target):
+        with open(target) as f:
+            if f.read() == content:
+                return target  # Unchanged, avoid a rebuild
+    with open(target, "w") as f:
+        f.write(content)
+    print("embed_assets: %d file(s) from %s -> %s" % (len(assets), data_dir, target))
+    return target
+
+
+if __name__ == "__main__" and len(sys.argv) == 3:
+    generate(sys.argv[1], sys.argv[2])
+else:
+    try:
+        Import("env")  # noqa: F821 (PlatformIO / SCons)
+        out_dir = os.path.join(env.subst("$BUILD_DIR"), "cp_generated")  # noqa: F821
+        generate(env.subst("$PROJECT_DATA_DIR"), out_dir)  # noqa: F821
+        env.Append(CPPPATH=[out_dir])  # noqa: F821
+    except NameError:
+        print("usage: python tools/embed_assets.py <data dir> <output dir>")